@@ -0,0 +1,98 @@
+#include <map>
+
+#include "kglt/kglt.h"
+#include "kglt/renderer.h"
+#include "kglt/render_queue.h"
+#include "kglt/batcher.h"
+
+#include "benchmark.h"
+
+/*
+ * Compares building and walking a RootGroup tree with filling, sorting and
+ * rendering a RenderQueue for the same set of subactors. Both paths bind the
+ * real GL state, only the draw call itself is skipped.
+ */
+
+namespace {
+
+const uint32_t ACTOR_COUNT = 5000;
+
+class NullRenderer : public kglt::Renderer {
+public:
+    NullRenderer(kglt::Scene& scene):
+        kglt::Renderer(scene) {}
+
+    void render_subactor(kglt::SubActor& buffer, kglt::CameraID camera) {
+        ++draw_count;
+    }
+
+    uint32_t draw_count = 0;
+};
+
+void batching_benchmarks(kglt::bench::Context& context) {
+    kglt::Scene& scene = context.window().scene();
+
+    kglt::StageID stage_id = scene.new_stage();
+    kglt::Stage& stage = scene.stage(stage_id);
+    kglt::Camera& camera = scene.camera();
+
+    //A handful of meshes and textures so that the keys actually vary
+    std::vector<kglt::MeshID> meshes;
+    for(uint32_t i = 0; i < 8; ++i) {
+        kglt::MeshID mid = stage.new_mesh();
+        kglt::procedural::mesh::cube(stage.mesh(mid).lock(), 1.0 + i);
+        stage.mesh(mid).lock()->set_texture_on_material(0, stage.new_texture());
+        meshes.push_back(mid);
+    }
+
+    std::vector<kglt::SubActor*> subactors;
+    for(uint32_t i = 0; i < ACTOR_COUNT; ++i) {
+        kglt::Actor& actor = stage.actor(stage.new_actor(meshes[i % meshes.size()]));
+        actor.set_render_priority(kglt::RENDER_PRIORITIES[i % kglt::RENDER_PRIORITIES.size()]);
+        for(uint16_t j = 0; j < actor.subactor_count(); ++j) {
+            subactors.push_back(&actor.subactor(j));
+        }
+    }
+
+    NullRenderer renderer(scene);
+    renderer.set_current_stage(stage.id());
+
+    context.measure("batching/root_group", 20, [&]() {
+        std::map<uint32_t, std::vector<kglt::RootGroup::ptr> > queues;
+        for(kglt::SubActor* subactor: subactors) {
+            auto& priority_queue = queues[subactor->_parent().render_priority()];
+            auto mat = stage.material(subactor->material_id());
+            for(uint8_t pass = 0; pass < mat->technique().pass_count(); ++pass) {
+                if(priority_queue.size() <= pass) {
+                    priority_queue.push_back(kglt::RootGroup::ptr(new kglt::RootGroup(stage, camera)));
+                }
+                priority_queue[pass]->insert(*subactor, pass);
+            }
+        }
+
+        for(auto& queue: queues) {
+            for(kglt::RootGroup::ptr group: queue.second) {
+                std::function<void (kglt::SubActor&)> f = [&](kglt::SubActor& subactor) {
+                    renderer.render_subactor(subactor, camera.id());
+                };
+                group->traverse(f);
+            }
+        }
+    }, subactors.size());
+
+    kglt::RenderQueue queue;
+    context.measure("batching/render_queue", 20, [&]() {
+        queue.reset(stage, camera);
+        for(kglt::SubActor* subactor: subactors) {
+            queue.insert(*subactor);
+        }
+        queue.sort();
+        queue.render(renderer, camera.id());
+    }, subactors.size());
+
+    scene.delete_stage(stage_id);
+}
+
+}
+
+KGLT_BENCHMARK("batching", batching_benchmarks);
@@ -0,0 +1,74 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "kglt/idle_task_manager.h"
+
+#include "benchmark.h"
+
+/*
+ * IdleTaskManager throughput: queueing and running one-off tasks (from this
+ * thread and from several others at once) and running repeating tasks. No
+ * window is needed.
+ */
+
+namespace {
+
+const uint32_t TASK_COUNT = 10000;
+const uint32_t THREAD_COUNT = 4;
+
+void idle_task_benchmarks(kglt::bench::Context& context) {
+    uint32_t counter = 0;
+
+    {
+        kglt::IdleTaskManager idle;
+        context.measure("idle_tasks/add_once", 20, [&]() {
+            for(uint32_t i = 0; i < TASK_COUNT; ++i) {
+                idle.add_once([&counter]() { ++counter; });
+            }
+            idle.execute();
+        }, TASK_COUNT);
+    }
+
+    {
+        kglt::IdleTaskManager idle;
+        for(uint32_t i = 0; i < TASK_COUNT; ++i) {
+            idle.add([&counter]() -> bool { ++counter; return true; });
+        }
+
+        context.measure("idle_tasks/repeating", 20, [&]() {
+            idle.execute();
+        }, TASK_COUNT);
+    }
+
+    {
+        //Loader threads queueing GL work while the main thread runs it
+        kglt::IdleTaskManager idle;
+        std::atomic<uint32_t> executed(0);
+
+        context.measure("idle_tasks/add_once_threaded", 20, [&]() {
+            executed = 0;
+
+            std::vector<std::thread> threads;
+            for(uint32_t t = 0; t < THREAD_COUNT; ++t) {
+                threads.push_back(std::thread([&]() {
+                    for(uint32_t i = 0; i < TASK_COUNT / THREAD_COUNT; ++i) {
+                        idle.add_once([&executed]() { ++executed; });
+                    }
+                }));
+            }
+
+            while(executed < TASK_COUNT) {
+                idle.execute();
+            }
+
+            for(std::thread& thread: threads) {
+                thread.join();
+            }
+        }, TASK_COUNT);
+    }
+}
+
+}
+
+KGLT_BENCHMARK("idle_tasks", idle_task_benchmarks);
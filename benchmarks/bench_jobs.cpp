@@ -0,0 +1,243 @@
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include <boost/lexical_cast.hpp>
+
+#include "kglt/kglt.h"
+#include "kglt/partitioners/octree.h"
+#include "kglt/utils/job_system.h"
+
+#include "benchmark.h"
+
+/*
+ * How the JobSystem scales with the number of threads. Each benchmark is run
+ * with 1, 2, 4... threads up to the number of cores, so the results for one
+ * machine can be compared with each other: the raw parallel_for overhead, the
+ * octree culling (on its own, no window needed), transform propagation
+ * through a large actor hierarchy and a parallel Scene::update() of lots of
+ * small ones (on the window's JobSystem).
+ */
+
+namespace {
+
+const float WORLD_SIZE = 2000.0;
+
+class Box : public kglt::Boundable {
+public:
+    void set(const kmVec3& centre, float size) {
+        centre_ = centre;
+        kmAABBInitialize(&bounds_, &centre_, size, size, size);
+    }
+
+    const kmAABB absolute_bounds() const { return bounds_; }
+    const kmAABB local_bounds() const { return bounds_; }
+    const kmVec3 centre() const { return centre_; }
+
+private:
+    kmAABB bounds_;
+    kmVec3 centre_;
+};
+
+//A top level object which turns a little on every update, taking whatever is attached to it along
+class Spinner : public kglt::Object {
+public:
+    Spinner(kglt::Stage* stage):
+        kglt::Object(stage) {}
+
+    void destroy() {}
+
+    void do_update(double dt) {
+        angle_ += 1.0;
+        rotate_to(angle_, 0, 1, 0);
+    }
+
+private:
+    float angle_ = 0;
+};
+
+std::vector<uint32_t> thread_counts() {
+    uint32_t cores = std::thread::hardware_concurrency();
+    cores = (cores) ? cores : 1;
+
+    std::vector<uint32_t> counts;
+    for(uint32_t count = 1; count < cores; count *= 2) {
+        counts.push_back(count);
+    }
+    counts.push_back(cores);
+    return counts;
+}
+
+std::string thread_suffix(uint32_t threads) {
+    return "/" + boost::lexical_cast<std::string>(threads) + "t";
+}
+
+void parallel_for_benchmarks(kglt::bench::Context& context) {
+    const uint32_t count = (context.quick()) ? 100000 : 1000000;
+
+    std::vector<float> values(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        values[i] = float(i);
+    }
+
+    for(uint32_t threads: thread_counts()) {
+        kglt::JobSystem jobs(threads - 1);
+
+        context.measure("jobs/parallel_for" + thread_suffix(threads), 20, [&]() {
+            jobs.parallel_for(0, count, 4096, [&](uint32_t first, uint32_t last) {
+                for(uint32_t i = first; i < last; ++i) {
+                    values[i] = std::sqrt(values[i] * values[i] + 1.0f);
+                }
+            });
+        }, count);
+
+        //Lots of tiny jobs, this is mostly the cost of scheduling and stealing
+        std::atomic<uint32_t> ran(0);
+        context.measure("jobs/run_wait" + thread_suffix(threads), 20, [&]() {
+            kglt::JobCounter counter;
+            for(uint32_t i = 0; i < 10000; ++i) {
+                jobs.run([&ran]() { ++ran; }, counter);
+            }
+            jobs.wait(counter);
+        }, 10000);
+    }
+}
+
+void octree_cull_benchmarks(kglt::bench::Context& context) {
+    const uint32_t object_count = (context.quick()) ? 100000 : 1000000;
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(-WORLD_SIZE / 2, WORLD_SIZE / 2);
+    std::uniform_real_distribution<float> size(0.5, 10.0);
+
+    std::vector<Box> boxes(object_count);
+    kglt::Octree tree;
+    for(Box& box: boxes) {
+        kmVec3 centre;
+        kmVec3Fill(&centre, position(rng), position(rng), position(rng));
+        box.set(centre, size(rng));
+        tree.grow(&box);
+    }
+
+    //The same camera as the octree benchmarks
+    kmMat4 projection, view, view_projection;
+    kmMat4PerspectiveProjection(&projection, 60.0, 16.0 / 9.0, 1.0, WORLD_SIZE);
+    kmMat4Identity(&view);
+    kmMat4Multiply(&view_projection, &projection, &view);
+
+    kglt::Frustum frustum;
+    frustum.build(&view_projection);
+
+    std::vector<const kglt::Boundable*> visible;
+    visible.reserve(object_count);
+
+    for(uint32_t threads: thread_counts()) {
+        kglt::JobSystem jobs(threads - 1);
+
+        context.measure("jobs/octree_cull" + thread_suffix(threads), 10, [&]() {
+            jobs.new_frame();
+            visible.clear();
+            tree.objects_visible_from(frustum, jobs, visible, [](const kglt::Boundable* obj) { return obj; });
+        }, object_count);
+    }
+}
+
+void add_children(kglt::Stage& stage, kglt::Actor& parent, uint32_t depth) {
+    if(!depth) {
+        return;
+    }
+
+    for(uint32_t i = 0; i < 10; ++i) {
+        kglt::Actor& child = stage.actor(stage.new_actor_with_parent(parent));
+        child.move_to(i, 0, 0);
+        add_children(stage, child, depth - 1);
+    }
+}
+
+void transform_benchmarks(kglt::bench::Context& context) {
+    kglt::WindowBase& window = context.window();
+    kglt::Scene& scene = window.scene();
+
+    kglt::StageID stage_id = scene.new_stage();
+    kglt::Stage& stage = scene.stage(stage_id);
+
+    //1 + 10 + 100 + 1000 (+ 10000) actors
+    const uint32_t depth = (context.quick()) ? 3 : 4;
+    const uint32_t actor_count = (context.quick()) ? 1111 : 11111;
+
+    kglt::Actor& root = stage.actor(stage.new_actor());
+    add_children(stage, root, depth);
+
+    float angle = 0;
+    for(uint32_t threads: thread_counts()) {
+        window.jobs().set_worker_count(threads - 1);
+
+        context.measure("jobs/transforms" + thread_suffix(threads), 20, [&]() {
+            angle += 1.0;
+            root.rotate_to(angle, 0, 1, 0);
+        }, actor_count);
+    }
+
+    window.jobs().set_worker_count(kglt::JobSystem::AUTOMATIC_WORKER_COUNT);
+    scene.delete_stage(stage_id);
+}
+
+void scene_update_benchmarks(kglt::bench::Context& context) {
+    kglt::WindowBase& window = context.window();
+    kglt::Scene& scene = window.scene();
+
+    kglt::StageID stage_id = scene.new_stage();
+    kglt::Stage& stage = scene.stage(stage_id);
+
+    const uint32_t spinner_count = (context.quick()) ? 100 : 1000;
+    const uint32_t children = 10;
+
+    std::vector<std::unique_ptr<Spinner> > spinners;
+    std::vector<kglt::ActorID> actors;
+    for(uint32_t i = 0; i < spinner_count; ++i) {
+        spinners.push_back(std::unique_ptr<Spinner>(new Spinner(&stage)));
+        spinners.back()->set_parent(stage);
+
+        for(uint32_t j = 0; j < children; ++j) {
+            actors.push_back(stage.new_actor());
+            kglt::Actor& actor = stage.actor(actors.back());
+            actor.set_parent(*spinners.back());
+            actor.move_to(j, 0, 0);
+        }
+    }
+
+    scene.set_parallel_update(true);
+
+    for(uint32_t threads: thread_counts()) {
+        window.jobs().set_worker_count(threads - 1);
+
+        //The snapshot is part of it, that's where the deferred moves end up
+        context.measure("jobs/scene_update" + thread_suffix(threads), 20, [&]() {
+            scene.update(1.0 / 60.0);
+            scene.snapshot_transformations();
+        }, spinner_count * (children + 1));
+    }
+
+    scene.set_parallel_update(false);
+    window.jobs().set_worker_count(kglt::JobSystem::AUTOMATIC_WORKER_COUNT);
+
+    //Children aren't detached when their parent is destroyed, so the actors go first
+    for(kglt::ActorID actor: actors) {
+        stage.delete_actor(actor);
+    }
+    spinners.clear();
+    scene.delete_stage(stage_id);
+}
+
+void job_benchmarks(kglt::bench::Context& context) {
+    parallel_for_benchmarks(context);
+    octree_cull_benchmarks(context);
+    transform_benchmarks(context);
+    scene_update_benchmarks(context);
+}
+
+}
+
+KGLT_BENCHMARK("jobs", job_benchmarks);
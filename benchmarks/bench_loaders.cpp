@@ -0,0 +1,79 @@
+#include "kglt/kglt.h"
+
+#include "benchmark.h"
+
+/*
+ * Loading meshes and maps through the registered loaders. The files come from
+ * the data paths (samples/data and tests/test-data, plus any --data
+ * directories), anything that isn't there is skipped. There's no OPT file in
+ * the repository, so put a sample.opt in a --data directory to time that one.
+ */
+
+namespace {
+
+struct MeshFile {
+    const char* name;
+    const char* filename;
+    uint32_t iterations;
+};
+
+const MeshFile MESH_FILES[] = {
+    { "loaders/obj/cube", "cube.obj", 50 },
+    { "loaders/obj/space_frigate", "fighter_good/space_frigate_6.obj", 5 },
+    { "loaders/opt/sample", "sample.opt", 5 }
+};
+
+void loader_benchmarks(kglt::bench::Context& context) {
+    for(const MeshFile& file: MESH_FILES) {
+        unicode path = context.find_data(file.filename);
+        if(path.empty()) {
+            context.skip(file.name, std::string(file.filename) + " not found");
+            continue;
+        }
+
+        kglt::Scene& scene = context.window().scene();
+        context.measure(file.name, file.iterations, [&]() {
+            scene.new_mesh_from_file(path);
+        });
+    }
+
+    unicode path = context.find_data("sample.bsp");
+    if(path.empty()) {
+        context.skip("loaders/q2bsp/sample", "sample.bsp not found");
+        return;
+    }
+
+    //The BSP loader fills the default stage, so each iteration starts by deleting what the last one added
+    kglt::WindowBase& window = context.window();
+    kglt::Stage& stage = window.scene().stage();
+
+    std::vector<kglt::ActorID> actors;
+    std::vector<kglt::LightID> lights;
+    sigc::connection actor_connection = stage.signal_actor_created().connect([&](kglt::ActorID actor_id) {
+        actors.push_back(actor_id);
+    });
+    sigc::connection light_connection = stage.signal_light_created().connect([&](kglt::LightID light_id) {
+        lights.push_back(light_id);
+    });
+
+    context.measure("loaders/q2bsp/sample", 3,
+        [&]() {
+            for(kglt::ActorID actor_id: actors) {
+                stage.delete_actor(actor_id);
+            }
+            for(kglt::LightID light_id: lights) {
+                stage.delete_light(light_id);
+            }
+            actors.clear();
+            lights.clear();
+        },
+        [&]() { window.loader_for(path)->into(window.scene()); }
+    );
+
+    actor_connection.disconnect();
+    light_connection.disconnect();
+}
+
+}
+
+KGLT_BENCHMARK("loaders", loader_benchmarks);
@@ -0,0 +1,67 @@
+#include "kglt/kglt.h"
+#include "kglt/loaders/material_script.h"
+
+#include "benchmark.h"
+
+/*
+ * Parsing the built in material scripts and generating materials from them,
+ * which includes compiling and linking their shaders.
+ */
+
+namespace {
+
+const char* MATERIAL_FILES[] = {
+    "kglt/materials/background.kglm",
+    "kglt/materials/diffuse_render.kglm",
+    "kglt/materials/generic_multitexture.kglm",
+    "kglt/materials/instanced_diffuse.kglm",
+    "kglt/materials/multitexture_and_lighting.kglm"
+};
+
+const std::string INLINE_SCRIPT = R"(
+    BEGIN(technique "my_technique")
+        BEGIN(pass)
+            BEGIN_DATA(vertex)
+                #version 120
+                void main() {
+                    gl_Position = vec4(1.0);
+                }
+            END_DATA(vertex)
+            BEGIN_DATA(fragment)
+                #version 120
+                void main() {
+                    gl_FragColor = vec4(1.0);
+                }
+            END_DATA(fragment)
+        END(pass)
+    END(technique)
+)";
+
+void material_script_benchmarks(kglt::bench::Context& context) {
+    kglt::WindowBase& window = context.window();
+    kglt::Scene& scene = window.scene();
+
+    kglt::MaterialID material_id;
+
+    context.measure("material_script/inline", 20,
+        [&]() { material_id = scene.new_material(); },
+        [&]() {
+            kglt::MaterialScript script((MaterialLanguageText(INLINE_SCRIPT)));
+            script.generate(*scene.material(material_id));
+        }
+    );
+
+    for(const char* filename: MATERIAL_FILES) {
+        std::string name = filename;
+        name = "material_script/" + name.substr(name.rfind('/') + 1);
+
+        context.measure(name, 10,
+            [&]() { material_id = scene.new_material(); },
+            [&]() { window.loader_for(filename)->into(*scene.material(material_id)); }
+        );
+    }
+}
+
+}
+
+KGLT_BENCHMARK("material_script", material_script_benchmarks);
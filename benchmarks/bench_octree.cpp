@@ -0,0 +1,118 @@
+#include <memory>
+#include <random>
+
+#include <boost/lexical_cast.hpp>
+
+#include "kglt/partitioners/octree.h"
+
+#include "benchmark.h"
+
+/*
+ * Octree insertion, relocation and culling with randomly placed boxes, plus
+ * the per-object scalar Frustum::classify_aabb test to compare the culling
+ * with. No window is needed.
+ */
+
+namespace {
+
+const float WORLD_SIZE = 2000.0;
+
+class Box : public kglt::Boundable {
+public:
+    void set(const kmVec3& centre, float size) {
+        centre_ = centre;
+        kmAABBInitialize(&bounds_, &centre_, size, size, size);
+    }
+
+    const kmAABB absolute_bounds() const { return bounds_; }
+    const kmAABB local_bounds() const { return bounds_; }
+    const kmVec3 centre() const { return centre_; }
+
+private:
+    kmAABB bounds_;
+    kmVec3 centre_;
+};
+
+void run_octree_benchmark(kglt::bench::Context& context, uint32_t object_count) {
+    std::string suffix = "/" + boost::lexical_cast<std::string>(object_count);
+    uint32_t iterations = (object_count >= 1000000) ? 3 : 10;
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(-WORLD_SIZE / 2, WORLD_SIZE / 2);
+    std::uniform_real_distribution<float> size(0.5, 10.0);
+
+    std::vector<Box> boxes(object_count);
+    for(Box& box: boxes) {
+        kmVec3 centre;
+        kmVec3Fill(&centre, position(rng), position(rng), position(rng));
+        box.set(centre, size(rng));
+    }
+
+    std::unique_ptr<kglt::Octree> tree;
+
+    context.measure("octree/insert" + suffix, iterations,
+        [&]() { tree.reset(new kglt::Octree()); },
+        [&]() {
+            for(Box& box: boxes) {
+                tree->grow(&box);
+            }
+        },
+        object_count
+    );
+
+    //A camera at the origin looking down -z, so roughly an eighth of the world is visible
+    kmMat4 projection, view, view_projection;
+    kmMat4PerspectiveProjection(&projection, 60.0, 16.0 / 9.0, 1.0, WORLD_SIZE);
+    kmMat4Identity(&view);
+    kmMat4Multiply(&view_projection, &projection, &view);
+
+    kglt::Frustum frustum;
+    frustum.build(&view_projection);
+
+    uint32_t visible = 0;
+    context.measure("octree/cull" + suffix, iterations * 2, [&]() {
+        visible = 0;
+        tree->each_object_visible_from(frustum, [&visible](const kglt::Boundable*) {
+            ++visible;
+        });
+    }, object_count);
+
+    context.measure("octree/cull_brute_force" + suffix, iterations * 2, [&]() {
+        visible = 0;
+        for(const Box& box: boxes) {
+            if(frustum.classify_aabb(box.absolute_bounds()) != kglt::FRUSTUM_CONTAINS_NONE) {
+                ++visible;
+            }
+        }
+    }, object_count);
+
+    //A tenth of the objects move a little each iteration
+    std::uniform_real_distribution<float> nudge(-5.0, 5.0);
+    uint32_t frame = 0;
+    context.measure("octree/relocate" + suffix, iterations * 2, [&]() {
+        for(uint32_t i = frame++ % 10; i < object_count; i += 10) {
+            kmVec3 centre = boxes[i].centre();
+            centre.x += nudge(rng);
+            centre.y += nudge(rng);
+            centre.z += nudge(rng);
+            kmAABB bounds = boxes[i].absolute_bounds();
+            boxes[i].set(centre, kmAABBDiameterX(&bounds));
+            tree->relocate(&boxes[i]);
+        }
+    }, object_count / 10);
+}
+
+void octree_benchmarks(kglt::bench::Context& context) {
+    run_octree_benchmark(context, 10000);
+    run_octree_benchmark(context, 100000);
+
+    if(context.quick()) {
+        context.skip("octree/*/1000000", "--quick");
+    } else {
+        run_octree_benchmark(context, 1000000);
+    }
+}
+
+}
+
+KGLT_BENCHMARK("octree", octree_benchmarks);
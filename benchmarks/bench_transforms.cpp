@@ -0,0 +1,73 @@
+#include "kglt/kglt.h"
+
+#include "benchmark.h"
+
+/*
+ * Object transform propagation through a hierarchy of actors: moving and
+ * rotating the root has to update every descendent's absolute position and
+ * orientation, and the world matrices are rebuilt when they're next used.
+ */
+
+namespace {
+
+const uint32_t BRANCHING = 10;
+const uint32_t DEPTH = 3; //1 + 10 + 100 + 1000 actors
+
+void add_children(kglt::Stage& stage, kglt::Actor& parent, uint32_t depth, std::vector<kglt::Actor*>& actors) {
+    if(!depth) {
+        return;
+    }
+
+    for(uint32_t i = 0; i < BRANCHING; ++i) {
+        kglt::Actor& child = stage.actor(stage.new_actor_with_parent(parent));
+        child.move_to(i, 0, 0);
+        actors.push_back(&child);
+        add_children(stage, child, depth - 1, actors);
+    }
+}
+
+void transform_benchmarks(kglt::bench::Context& context) {
+    kglt::Scene& scene = context.window().scene();
+
+    kglt::StageID stage_id = scene.new_stage();
+    kglt::Stage& stage = scene.stage(stage_id);
+
+    kglt::Actor& root = stage.actor(stage.new_actor());
+    std::vector<kglt::Actor*> actors(1, &root);
+    add_children(stage, root, DEPTH, actors);
+
+    float angle = 0;
+    context.measure("transforms/rotate_root", 50, [&]() {
+        angle += 1.0;
+        root.rotate_to(angle, 0, 1, 0);
+    }, actors.size());
+
+    float x = 0;
+    context.measure("transforms/move_root", 50, [&]() {
+        x += 1.0;
+        root.move_to(x, 0, 0);
+    }, actors.size());
+
+    context.measure("transforms/absolute_transformation", 50,
+        [&]() {
+            angle += 1.0;
+            root.rotate_to(angle, 0, 1, 0);
+        },
+        [&]() {
+            for(kglt::Actor* actor: actors) {
+                actor->absolute_transformation();
+            }
+        },
+        actors.size()
+    );
+
+    context.measure("transforms/stage_update", 50, [&]() {
+        stage.update(1.0 / 60.0);
+    }, actors.size());
+
+    scene.delete_stage(stage_id);
+}
+
+}
+
+KGLT_BENCHMARK("transforms", transform_benchmarks);
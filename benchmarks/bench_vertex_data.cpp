@@ -0,0 +1,84 @@
+#include "kglt/kglt.h"
+#include "kglt/vertex_data.h"
+
+#include "benchmark.h"
+
+/*
+ * Filling a VertexData and IndexData with a grid, the way the procedural
+ * generators and loaders do, and then packing and uploading it with done().
+ */
+
+namespace {
+
+const uint32_t GRID_SIZE = 256;
+const uint32_t VERTEX_COUNT = GRID_SIZE * GRID_SIZE;
+const uint32_t INDEX_COUNT = (GRID_SIZE - 1) * (GRID_SIZE - 1) * 6;
+
+void fill_vertices(kglt::VertexData& data) {
+    data.clear();
+    for(uint32_t z = 0; z < GRID_SIZE; ++z) {
+        for(uint32_t x = 0; x < GRID_SIZE; ++x) {
+            data.position(x, 0, z);
+            data.normal(0, 1, 0);
+            data.tex_coord0(float(x) / GRID_SIZE, float(z) / GRID_SIZE);
+            data.diffuse(1, 1, 1, 1);
+            data.move_next();
+        }
+    }
+}
+
+void fill_indices(kglt::IndexData& data) {
+    data.clear();
+    data.reserve(INDEX_COUNT);
+    for(uint32_t z = 0; z < GRID_SIZE - 1; ++z) {
+        for(uint32_t x = 0; x < GRID_SIZE - 1; ++x) {
+            uint32_t i = z * GRID_SIZE + x;
+            data.index(i);
+            data.index(i + GRID_SIZE);
+            data.index(i + 1);
+            data.index(i + 1);
+            data.index(i + GRID_SIZE);
+            data.index(i + GRID_SIZE + 1);
+        }
+    }
+}
+
+void vertex_data_benchmarks(kglt::bench::Context& context) {
+    kglt::Scene& scene = context.window().scene();
+
+    kglt::VertexData::ptr vertices = kglt::VertexData::create(scene);
+    kglt::IndexData indices(scene);
+
+    context.measure("vertex_data/fill", 20, [&]() { fill_vertices(*vertices); }, VERTEX_COUNT);
+
+    context.measure("vertex_data/done", 20,
+        [&]() { fill_vertices(*vertices); },
+        [&]() { vertices->done(); },
+        VERTEX_COUNT
+    );
+
+    //Only the first row changes, so done() only has to send that part
+    context.measure("vertex_data/done_partial", 20,
+        [&]() {
+            vertices->move_to_start();
+            for(uint32_t x = 0; x < GRID_SIZE; ++x) {
+                vertices->position(x, 1, 0);
+                vertices->move_next();
+            }
+        },
+        [&]() { vertices->done(); },
+        GRID_SIZE
+    );
+
+    context.measure("index_data/fill", 20, [&]() { fill_indices(indices); }, INDEX_COUNT);
+
+    context.measure("index_data/done", 20,
+        [&]() { fill_indices(indices); },
+        [&]() { indices.done(); },
+        INDEX_COUNT
+    );
+}
+
+}
+
+KGLT_BENCHMARK("vertex_data", vertex_data_benchmarks);
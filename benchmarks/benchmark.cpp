@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "kglt/kglt.h"
+#include "kglt/testing/mock_window.h"
+#include "kglt/kazbase/os/path.h"
+
+#include "benchmark.h"
+
+namespace kglt {
+namespace bench {
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::vector<Benchmark>& registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+Context::Context(bool use_mock_window, bool quick):
+    use_mock_window_(use_mock_window),
+    quick_(quick) {
+
+    unicode source_dir = os::path::dir_name(__FILE__);
+    add_data_path(os::path::join(source_dir, "../samples/data"));
+    add_data_path(os::path::join(source_dir, "../tests/test-data"));
+}
+
+WindowBase& Context::window() {
+    if(!window_) {
+        if(use_mock_window_) {
+            window_ = testing::MockWindow::create();
+        } else {
+            window_ = Window::create();
+        }
+        window_->set_logging_level(LOG_LEVEL_NONE);
+
+        for(const unicode& path: data_paths_) {
+            window_->resource_locator().add_search_path(path);
+        }
+    }
+
+    return *window_;
+}
+
+void Context::add_data_path(const unicode& path) {
+    data_paths_.push_back(path);
+
+    if(window_) {
+        window_->resource_locator().add_search_path(path);
+    }
+}
+
+unicode Context::find_data(const unicode& filename) const {
+    for(const unicode& path: data_paths_) {
+        unicode candidate = os::path::join(path, filename);
+        if(os::path::exists(candidate)) {
+            return candidate;
+        }
+    }
+
+    return unicode();
+}
+
+void Context::measure(const std::string& name, uint32_t iterations, std::function<void ()> run, uint64_t items) {
+    measure(name, iterations, std::function<void ()>(), run, items);
+}
+
+void Context::measure(
+        const std::string& name,
+        uint32_t iterations,
+        std::function<void ()> setup,
+        std::function<void ()> run,
+        uint64_t items) {
+
+    //Warm up caches, lazily created GL objects and so on
+    if(setup) {
+        setup();
+    }
+    run();
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+
+    for(uint32_t i = 0; i < iterations; ++i) {
+        if(setup) {
+            setup();
+        }
+
+        auto start = Clock::now();
+        run();
+        samples.push_back(elapsed_ms(start));
+    }
+
+    Result result;
+    result.name = name;
+    result.iterations = iterations;
+    result.items = items;
+
+    if(!samples.empty()) {
+        std::sort(samples.begin(), samples.end());
+
+        double total = 0;
+        for(double sample: samples) {
+            total += sample;
+        }
+
+        result.min_ms = samples.front();
+        result.median_ms = samples[samples.size() / 2];
+        result.mean_ms = total / samples.size();
+    }
+
+    results_.push_back(result);
+
+    std::cout << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(12) << result.median_ms << "ms (min " << result.min_ms << "ms)" << std::endl;
+}
+
+void Context::skip(const std::string& name, const std::string& reason) {
+    std::cout << std::left << std::setw(48) << name << "skipped: " << reason << std::endl;
+}
+
+bool write_json(const std::string& filename, const std::vector<Result>& results) {
+    std::ofstream file(filename.c_str());
+    if(!file.good()) {
+        return false;
+    }
+
+    //One result per line, read_baseline() relies on that
+    file << std::setprecision(6) << std::fixed;
+    file << "{\n    \"results\": [\n";
+    for(uint32_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        file << "        {\"name\": \"" << result.name << "\", "
+             << "\"iterations\": " << result.iterations << ", "
+             << "\"items\": " << result.items << ", "
+             << "\"min_ms\": " << result.min_ms << ", "
+             << "\"median_ms\": " << result.median_ms << ", "
+             << "\"mean_ms\": " << result.mean_ms << "}"
+             << ((i + 1 < results.size()) ? ",\n" : "\n");
+    }
+    file << "    ]\n}\n";
+
+    return file.good();
+}
+
+static bool find_value(const std::string& line, const std::string& key, std::string& value) {
+    std::string marker = "\"" + key + "\": ";
+    std::string::size_type start = line.find(marker);
+    if(start == std::string::npos) {
+        return false;
+    }
+
+    start += marker.size();
+    if(line[start] == '"') {
+        ++start;
+        std::string::size_type end = line.find('"', start);
+        if(end == std::string::npos) {
+            return false;
+        }
+        value = line.substr(start, end - start);
+    } else {
+        std::string::size_type end = line.find_first_of(",}", start);
+        value = line.substr(start, end - start);
+    }
+
+    return true;
+}
+
+bool read_baseline(const std::string& filename, Baseline& baseline) {
+    std::ifstream file(filename.c_str());
+    if(!file.good()) {
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(file, line)) {
+        Result result;
+        std::string value;
+
+        if(!find_value(line, "name", result.name)) {
+            continue;
+        }
+
+        if(find_value(line, "iterations", value)) result.iterations = std::strtoul(value.c_str(), nullptr, 10);
+        if(find_value(line, "items", value)) result.items = std::strtoull(value.c_str(), nullptr, 10);
+        if(find_value(line, "min_ms", value)) result.min_ms = std::strtod(value.c_str(), nullptr);
+        if(find_value(line, "median_ms", value)) result.median_ms = std::strtod(value.c_str(), nullptr);
+        if(find_value(line, "mean_ms", value)) result.mean_ms = std::strtod(value.c_str(), nullptr);
+
+        baseline[result.name] = result;
+    }
+
+    return true;
+}
+
+uint32_t compare(const std::vector<Result>& results, const Baseline& baseline, double threshold) {
+    uint32_t regressions = 0;
+
+    std::cout << std::endl << "Compared with the baseline (median, +" << threshold << "% is a regression):" << std::endl;
+
+    for(const Result& result: results) {
+        auto it = baseline.find(result.name);
+        std::cout << std::left << std::setw(48) << result.name << std::right;
+
+        if(it == baseline.end() || (*it).second.median_ms <= 0) {
+            std::cout << "         new" << std::endl;
+            continue;
+        }
+
+        double before = (*it).second.median_ms;
+        double change = (result.median_ms - before) / before * 100.0;
+
+        std::cout << std::fixed << std::setprecision(1) << std::showpos << std::setw(11) << change << "%" << std::noshowpos;
+        if(change > threshold) {
+            std::cout << "  REGRESSION";
+            ++regressions;
+        }
+        std::cout << std::endl;
+    }
+
+    return regressions;
+}
+
+}
+}
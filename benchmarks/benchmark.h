@@ -0,0 +1,110 @@
+#ifndef KGLT_BENCHMARK_H
+#define KGLT_BENCHMARK_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "kglt/window_base.h"
+
+namespace kglt {
+namespace bench {
+
+struct Result {
+    std::string name;
+    uint32_t iterations = 0;
+    uint64_t items = 0; //The work done by one iteration (objects, vertices...), 0 if it doesn't apply
+    double min_ms = 0;
+    double median_ms = 0;
+    double mean_ms = 0;
+};
+
+typedef std::map<std::string, Result> Baseline;
+
+/*
+ * Handed to every benchmark. measure() times a function over a number of
+ * iterations (after one untimed warm up run) and records the result, setup is
+ * run before every iteration but isn't timed. Benchmarks that need a scene use
+ * window(), which is created the first time it's asked for.
+ *
+ * By default that's a testing::MockWindow so that swap_buffers() and
+ * check_events() cost nothing and frames aren't tied to vsync. MockWindow
+ * doesn't create a GL context though, so anything that has to reach a driver
+ * should be run with --window=sdl (on a build machine, under Xvfb with a
+ * software renderer like llvmpipe).
+ */
+class Context {
+public:
+    Context(bool use_mock_window, bool quick);
+
+    WindowBase& window();
+    bool has_window() const { return bool(window_); }
+
+    //Use smaller data sets, for a quick check rather than numbers to keep
+    bool quick() const { return quick_; }
+
+    void add_data_path(const unicode& path);
+    //Returns an empty string if the file isn't in any of the data paths
+    unicode find_data(const unicode& filename) const;
+
+    void measure(
+        const std::string& name,
+        uint32_t iterations,
+        std::function<void ()> run,
+        uint64_t items=0
+    );
+
+    void measure(
+        const std::string& name,
+        uint32_t iterations,
+        std::function<void ()> setup,
+        std::function<void ()> run,
+        uint64_t items=0
+    );
+
+    void skip(const std::string& name, const std::string& reason);
+
+    const std::vector<Result>& results() const { return results_; }
+
+private:
+    bool use_mock_window_;
+    bool quick_;
+
+    WindowBase::ptr window_;
+    std::vector<unicode> data_paths_;
+    std::vector<Result> results_;
+};
+
+typedef std::function<void (Context&)> BenchmarkFunction;
+
+struct Benchmark {
+    std::string name;
+    BenchmarkFunction function;
+};
+
+std::vector<Benchmark>& registry();
+
+struct Registrar {
+    Registrar(const std::string& name, BenchmarkFunction function) {
+        registry().push_back(Benchmark{name, function});
+    }
+};
+
+bool write_json(const std::string& filename, const std::vector<Result>& results);
+bool read_baseline(const std::string& filename, Baseline& baseline);
+
+/*
+ * Prints each result alongside its baseline (if there is one) and returns the
+ * number of results whose median got slower by more than threshold percent.
+ */
+uint32_t compare(const std::vector<Result>& results, const Baseline& baseline, double threshold);
+
+}
+}
+
+#define KGLT_BENCHMARK(name, function) \
+    static kglt::bench::Registrar kglt_benchmark_##function(name, function)
+
+#endif // KGLT_BENCHMARK_H
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "benchmark.h"
+
+/*
+ * kglt_bench [--filter TEXT] [--quick] [--window=mock|sdl] [--data DIR]
+ *            [--json FILE] [--baseline FILE] [--threshold PERCENT]
+ *
+ * Runs every registered benchmark whose name contains TEXT, optionally writes
+ * the results out as JSON and compares them with the JSON from an earlier run.
+ * Exits with 1 if anything got slower than the baseline by more than
+ * PERCENT (10 by default), so it can gate a CI job.
+ */
+
+static void usage() {
+    std::cout << "USAGE: kglt_bench [--filter TEXT] [--quick] [--window=mock|sdl] [--data DIR]" << std::endl;
+    std::cout << "                  [--json FILE] [--baseline FILE] [--threshold PERCENT]" << std::endl;
+    std::cout << std::endl << "Benchmarks:" << std::endl;
+    for(const kglt::bench::Benchmark& benchmark: kglt::bench::registry()) {
+        std::cout << "    " << benchmark.name << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    //Registration order depends on link order, so sort to keep runs comparable
+    std::vector<kglt::bench::Benchmark>& benchmarks = kglt::bench::registry();
+    std::sort(benchmarks.begin(), benchmarks.end(), [](const kglt::bench::Benchmark& lhs, const kglt::bench::Benchmark& rhs) {
+        return lhs.name < rhs.name;
+    });
+
+    std::string filter, json_file, baseline_file;
+    std::vector<std::string> data_paths;
+    double threshold = 10.0;
+    bool quick = false;
+    bool mock_window = true;
+
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if(arg == "--filter" && has_value) {
+            filter = argv[++i];
+        } else if(arg == "--json" && has_value) {
+            json_file = argv[++i];
+        } else if(arg == "--baseline" && has_value) {
+            baseline_file = argv[++i];
+        } else if(arg == "--threshold" && has_value) {
+            threshold = std::strtod(argv[++i], nullptr);
+        } else if(arg == "--data" && has_value) {
+            data_paths.push_back(argv[++i]);
+        } else if(arg == "--quick") {
+            quick = true;
+        } else if(arg == "--window=mock") {
+            mock_window = true;
+        } else if(arg == "--window=sdl") {
+            mock_window = false;
+        } else {
+            usage();
+            return (arg == "--help") ? 0 : 2;
+        }
+    }
+
+    kglt::bench::Baseline baseline;
+    if(!baseline_file.empty() && !kglt::bench::read_baseline(baseline_file, baseline)) {
+        std::cerr << "Unable to read the baseline from " << baseline_file << std::endl;
+        return 2;
+    }
+
+    kglt::bench::Context context(mock_window, quick);
+    for(const std::string& path: data_paths) {
+        context.add_data_path(path);
+    }
+
+    for(const kglt::bench::Benchmark& benchmark: benchmarks) {
+        if(!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        benchmark.function(context);
+    }
+
+    if(!json_file.empty() && !kglt::bench::write_json(json_file, context.results())) {
+        std::cerr << "Unable to write the results to " << json_file << std::endl;
+        return 2;
+    }
+
+    if(!baseline_file.empty()) {
+        uint32_t regressions = kglt::bench::compare(context.results(), baseline, threshold);
+        if(regressions) {
+            std::cout << std::endl << regressions << " benchmark(s) regressed" << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
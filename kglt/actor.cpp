@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "stage.h"
 #include "actor.h"
 
@@ -31,6 +33,17 @@ const VertexData& Actor::shared_data() const {
 }
 
 void Actor::set_mesh(MeshID mesh) {
+    //The old SubActors might be in the frame being drawn, so they go at the handoff
+    Stage* stage = &this->stage();
+    ActorID actor_id = id();
+    if(!subactors_.empty() && stage->defer_to_handoff([stage, actor_id, mesh]() {
+        if(stage->has_actor(actor_id)) {
+            stage->actor(actor_id).set_mesh(mesh);
+        }
+    })) {
+        return;
+    }
+
     //Increment the ref-count on this mesh
     mesh_ = stage().mesh(mesh).lock();
 
@@ -42,6 +55,14 @@ void Actor::set_mesh(MeshID mesh) {
     signal_mesh_changed_(id());
 }
 
+void Actor::transformation_changed() {
+    for(SubActor::ptr subactor: subactors_) {
+        subactor->bounds_dirty_ = true;
+    }
+
+    signal_transformation_changed_(id());
+}
+
 void Actor::destroy() {
     stage().delete_actor(id());
 }
@@ -54,6 +75,40 @@ const MaterialID SubActor::material_id() const {
     return submesh().material_id();
 }
 
+/*
+ * Transforms all eight corners of the submesh bounds, so the box still
+ * encloses the mesh when the actor is rotated. Rather than transforming each
+ * corner, each axis of the result is built from the smallest and largest
+ * contribution of every matrix element (Arvo's method), which gives the same box.
+ */
+void SubActor::update_absolute_bounds() const {
+    const kmAABB local = local_bounds();
+    const kmMat4& transform = parent_.absolute_transformation();
+
+    const float local_min[3] = { local.min.x, local.min.y, local.min.z };
+    const float local_max[3] = { local.max.x, local.max.y, local.max.z };
+
+    float result_min[3], result_max[3];
+    for(uint8_t i = 0; i < 3; ++i) {
+        //Start with the translation
+        result_min[i] = result_max[i] = transform.mat[12 + i];
+
+        for(uint8_t j = 0; j < 3; ++j) {
+            //Column major, so row i column j is mat[j * 4 + i]
+            const float a = transform.mat[(j * 4) + i] * local_min[j];
+            const float b = transform.mat[(j * 4) + i] * local_max[j];
+            result_min[i] += std::min(a, b);
+            result_max[i] += std::max(a, b);
+        }
+    }
+
+    kmVec3Fill(&absolute_bounds_.min, result_min[0], result_min[1], result_min[2]);
+    kmVec3Fill(&absolute_bounds_.max, result_max[0], result_max[1], result_max[2]);
+    kmAABBCentre(&absolute_bounds_, &absolute_centre_);
+
+    bounds_dirty_ = false;
+}
+
 void SubActor::override_material_id(MaterialID material) {
     //Store the pointer to maintain the ref-count
     material_ = parent_.stage().material(material).__object;
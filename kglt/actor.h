@@ -45,6 +45,10 @@ public:
     const std::vector<std::shared_ptr<SubActor> >& _subactors() { return subactors_; }
 
     sigc::signal<void, ActorID>& signal_mesh_changed() { return signal_mesh_changed_; }
+    sigc::signal<void, ActorID>& signal_transformation_changed() { return signal_transformation_changed_; }
+
+    //After the mesh's vertices are changed in place, so the new bounds are picked up like a move
+    void mesh_bounds_changed() { transformation_changed(); }
 
     void destroy();
 
@@ -57,6 +61,9 @@ private:
     RenderPriority render_priority_;
 
     sigc::signal<void, ActorID> signal_mesh_changed_;
+    sigc::signal<void, ActorID> signal_transformation_changed_;
+
+    void transformation_changed() override;
 
     void do_update(double dt) {
         update_source(dt);
@@ -74,7 +81,8 @@ public:
     SubActor(Actor& parent, SubMeshIndex idx):
         parent_(parent),
         index_(idx),
-        material_(0) {
+        material_(0),
+        bounds_dirty_(true) {
     }
 
     const MaterialID material_id() const;
@@ -94,17 +102,13 @@ public:
     /**
      * @brief absolute_bounds
      * @return the bounds of the linked submesh, transformed by the actors absolute
-     * transformation matrix.
+     * transformation matrix. The result is cached until the actor next moves.
      */
     const kmAABB absolute_bounds() const {
-        kmAABB local = local_bounds();
-        kmMat4 transform = parent_.absolute_transformation();
-
-        //Transform local by the transformation matrix of the parent
-        kmVec3Transform(&local.min, &local.min, &transform);
-        kmVec3Transform(&local.max, &local.max, &transform);
-
-        return local;
+        if(bounds_dirty_) {
+            update_absolute_bounds();
+        }
+        return absolute_bounds_;
     }
 
     /**
@@ -119,10 +123,10 @@ public:
         // Return the centre point of the absolute bounds of this subactor
         // which is the submesh().bounds() transformed by the parent actor's
         // location
-        kmVec3 centre;
-        kmAABB abs_bounds = absolute_bounds();
-        kmAABBCentre(&abs_bounds, &centre);
-        return centre;
+        if(bounds_dirty_) {
+            update_absolute_bounds();
+        }
+        return absolute_centre_;
     }
 
 private:
@@ -130,6 +134,14 @@ private:
     SubMeshIndex index_;
     MaterialPtr material_;
 
+    mutable kmAABB absolute_bounds_;
+    mutable kmVec3 absolute_centre_;
+    mutable bool bounds_dirty_;
+
+    void update_absolute_bounds() const;
+
+    friend class Actor;
+
     const SubMesh& submesh() const {
         return parent_.mesh().lock()->submesh(index_);
     }
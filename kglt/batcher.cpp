@@ -9,6 +9,7 @@
 #include "shader.h"
 #include "camera.h"
 #include "partitioner.h"
+#include "utils/gl_state.h"
 
 namespace kglt {
 
@@ -16,8 +17,6 @@ void RootGroup::bind() {
 }
 
 void RootGroup::generate_mesh_groups(RenderGroup* parent, SubActor& ent, MaterialPass& pass) {
-    Vec3 pos;
-    std::vector<LightID> lights = stage().partitioner().lights_within_range(pos);
     uint32_t iteration_count = 1;
     if(pass.iteration() == ITERATE_N) {
         iteration_count = pass.max_iterations();
@@ -26,6 +25,7 @@ void RootGroup::generate_mesh_groups(RenderGroup* parent, SubActor& ent, Materia
             parent->get_or_create<MeshGroup>(MeshGroupData(ent._parent().mesh_id(), ent.submesh_id())).add(&ent);
         }
     } else if (pass.iteration() == ITERATE_ONCE_PER_LIGHT) {
+        std::vector<LightID> lights = stage().partitioner().lights_within_range(ent.absolute_bounds());
         iteration_count = std::min<uint32_t>(lights.size(), pass.max_iterations());
         for(uint8_t i = 0; i < iteration_count; ++i) {
             parent->get_or_create<LightGroup>(LightGroupData(&stage().light(lights[i]))).
@@ -76,8 +76,20 @@ void RootGroup::insert(SubActor &ent, uint8_t pass_number) {
     }
 }
 
+Stage& RenderGroup::root_stage() {
+    return static_cast<RootGroup&>(get_root()).stage();
+}
+
 void LightGroup::bind() {
-    Light* light = data_.light;
+    bind_state(data_, root_stage());
+}
+
+void LightGroup::unbind() {
+    unbind_state(data_, root_stage());
+}
+
+void LightGroup::bind_state(const LightGroupData& data, Stage& stage) {
+    Light* light = data.light;
     if(!light) {
         return;
     }
@@ -88,73 +100,87 @@ void LightGroup::bind() {
     ShaderParams& params = active_shader->params();
 
     if(params.uses_auto(SP_AUTO_LIGHT_POSITION)) {
-        Vec4 light_pos = Vec4(light->absolute_position(), (light->type() == LIGHT_TYPE_DIRECTIONAL) ? 0.0 : 1.0);
+        Vec4 light_pos = Vec4(light->render_position(), (light->type() == LIGHT_TYPE_DIRECTIONAL) ? 0.0 : 1.0);
 
         params.set_vec4(
-            params.auto_uniform_variable_name(SP_AUTO_LIGHT_POSITION),
+            SP_AUTO_LIGHT_POSITION,
             light_pos
         );
     }
 
     if(params.uses_auto(SP_AUTO_LIGHT_AMBIENT)) {
         params.set_colour(
-            params.auto_uniform_variable_name(SP_AUTO_LIGHT_AMBIENT),
+            SP_AUTO_LIGHT_AMBIENT,
             light->ambient()
         );
     }
 
     if(params.uses_auto(SP_AUTO_LIGHT_DIFFUSE)) {
         params.set_colour(
-            params.auto_uniform_variable_name(SP_AUTO_LIGHT_DIFFUSE),
+            SP_AUTO_LIGHT_DIFFUSE,
             light->diffuse()
         );
     }
 
     if(params.uses_auto(SP_AUTO_LIGHT_SPECULAR)) {
         params.set_colour(
-            params.auto_uniform_variable_name(SP_AUTO_LIGHT_SPECULAR),
+            SP_AUTO_LIGHT_SPECULAR,
             light->specular()
         );
     }
 
     if(params.uses_auto(SP_AUTO_LIGHT_CONSTANT_ATTENUATION)) {
         params.set_float(
-            params.auto_uniform_variable_name(SP_AUTO_LIGHT_CONSTANT_ATTENUATION),
+            SP_AUTO_LIGHT_CONSTANT_ATTENUATION,
             light->constant_attenuation()
         );
     }
 
     if(params.uses_auto(SP_AUTO_LIGHT_LINEAR_ATTENUATION)) {
         params.set_float(
-            params.auto_uniform_variable_name(SP_AUTO_LIGHT_LINEAR_ATTENUATION),
+            SP_AUTO_LIGHT_LINEAR_ATTENUATION,
             light->linear_attenuation()
         );
     }
 
     if(params.uses_auto(SP_AUTO_LIGHT_QUADRATIC_ATTENUATION)) {
         params.set_float(
-            params.auto_uniform_variable_name(SP_AUTO_LIGHT_QUADRATIC_ATTENUATION),
+            SP_AUTO_LIGHT_QUADRATIC_ATTENUATION,
             light->quadratic_attenuation()
         );
     }
 }
 
-void LightGroup::unbind() {
+void LightGroup::unbind_state(const LightGroupData& data, Stage& stage) {
 
 }
 
 void MeshGroup::bind() {
-
+    bind_state(data_, root_stage());
 }
 
 void MeshGroup::unbind() {
+    unbind_state(data_, root_stage());
+}
+
+void MeshGroup::bind_state(const MeshGroupData& data, Stage& stage) {
+
+}
+
+void MeshGroup::unbind_state(const MeshGroupData& data, Stage& stage) {
 
 }
 
 void ShaderGroup::bind() {
-    RootGroup& root = static_cast<RootGroup&>(get_root());
+    bind_state(data_, root_stage());
+}
+
+void ShaderGroup::unbind() {
+    unbind_state(data_, root_stage());
+}
 
-    ShaderProgram* s = data_.shader_;
+void ShaderGroup::bind_state(const ShaderGroupData& data, Stage& stage) {
+    ShaderProgram* s = data.shader_;
     s->activate(); //Activate the shader
 
     //Pass in the global ambient here, as it's the earliest place
@@ -163,12 +189,16 @@ void ShaderGroup::bind() {
 
     if(params.uses_auto(SP_AUTO_LIGHT_GLOBAL_AMBIENT)) {
         params.set_colour(
-            params.auto_uniform_variable_name(SP_AUTO_LIGHT_GLOBAL_AMBIENT),
-            root.stage().ambient_light()
+            SP_AUTO_LIGHT_GLOBAL_AMBIENT,
+            stage.ambient_light()
         );
     }
 }
 
+void ShaderGroup::unbind_state(const ShaderGroupData& data, Stage& stage) {
+
+}
+
 std::size_t ShaderGroupData::hash() const {
     size_t seed = 0;
     hash_combine(seed, typeid(ShaderGroupData).name());
@@ -176,60 +206,81 @@ std::size_t ShaderGroupData::hash() const {
     return seed;
 }
 
-void ShaderGroup::unbind() {
+void DepthGroup::bind() {
+    bind_state(data_, root_stage());
+}
 
+void DepthGroup::unbind() {
+    unbind_state(data_, root_stage());
 }
 
-void DepthGroup::bind() {
-    if(data_.depth_test) {
-        glEnable(GL_DEPTH_TEST);
-    } else {
-        glDisable(GL_DEPTH_TEST);
-    }
+/*
+ * The unbind_state() functions of the groups that only change GL state are
+ * empty. Every sibling sets all of the state it depends on when it's bound, and
+ * GLState drops whatever is already set, so resetting here would only cost an
+ * extra pair of calls between each sibling.
+ */
 
-    if(data_.depth_write) {
-        glDepthMask(GL_TRUE);
-    } else {
-        glDepthMask(GL_FALSE);
-    }
+void DepthGroup::bind_state(const DepthGroupData& data, Stage& stage) {
+    GLState::get().set_enabled(GL_DEPTH_TEST, data.depth_test);
+    GLState::get().depth_mask(data.depth_write);
 }
 
-void DepthGroup::unbind() {
-    if(data_.depth_test) {
-        glDisable(GL_DEPTH_TEST);
-    }
+void DepthGroup::unbind_state(const DepthGroupData& data, Stage& stage) {
+
 }
 
 void TextureGroup::bind() {
-    glActiveTexture(GL_TEXTURE0 + data_.unit);
-    RootGroup& root = static_cast<RootGroup&>(get_root());
-    glBindTexture(GL_TEXTURE_2D, root.stage().texture(data_.texture_id)->gl_tex());
+    bind_state(data_, root_stage());
 }
 
 void TextureGroup::unbind() {
-    glActiveTexture(GL_TEXTURE0 + data_.unit);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    unbind_state(data_, root_stage());
+}
+
+void TextureGroup::bind_state(const TextureGroupData& data, Stage& stage) {
+    GLState::get().bind_texture(data.unit, stage.texture(data.texture_id)->gl_tex());
+}
+
+void TextureGroup::unbind_state(const TextureGroupData& data, Stage& stage) {
+
 }
 
 void TextureMatrixGroup::bind() {
+    bind_state(data_, root_stage());
+}
+
+void TextureMatrixGroup::unbind() {
+    unbind_state(data_, root_stage());
+}
+
+void TextureMatrixGroup::bind_state(const TextureMatrixGroupData& data, Stage& stage) {
     ShaderProgram* active_shader = ShaderProgram::active_shader();
     assert(active_shader);
 
     ShaderParams& params = active_shader->params();
 
-    if(params.uses_auto(ShaderAvailableAuto(SP_AUTO_MATERIAL_TEX_MATRIX0 + data_.unit))) {
+    if(params.uses_auto(ShaderAvailableAuto(SP_AUTO_MATERIAL_TEX_MATRIX0 + data.unit))) {
         params.set_mat4x4(
-            params.auto_uniform_variable_name(ShaderAvailableAuto(SP_AUTO_MATERIAL_TEX_MATRIX0 + data_.unit)),
-            data_.matrix
+            ShaderAvailableAuto(SP_AUTO_MATERIAL_TEX_MATRIX0 + data.unit),
+            data.matrix
         );
     }
 }
 
-void TextureMatrixGroup::unbind() {
+void TextureMatrixGroup::unbind_state(const TextureMatrixGroupData& data, Stage& stage) {
 
 }
 
 void MaterialGroup::bind() {
+    bind_state(data_, root_stage());
+}
+
+void MaterialGroup::unbind() {
+    unbind_state(data_, root_stage());
+}
+
+void MaterialGroup::bind_state(const MaterialGroupData& data, Stage& stage) {
     ShaderProgram* active_shader = ShaderProgram::active_shader();
     assert(active_shader);
 
@@ -238,79 +289,96 @@ void MaterialGroup::bind() {
 
     if(params.uses_auto(SP_AUTO_MATERIAL_AMBIENT)) {
         params.set_colour(
-            params.auto_uniform_variable_name(SP_AUTO_MATERIAL_AMBIENT),
-            data_.ambient
+            SP_AUTO_MATERIAL_AMBIENT,
+            data.ambient
         );
     }
 
     if(params.uses_auto(SP_AUTO_MATERIAL_DIFFUSE)) {
         params.set_colour(
-            params.auto_uniform_variable_name(SP_AUTO_MATERIAL_DIFFUSE),
-            data_.diffuse
+            SP_AUTO_MATERIAL_DIFFUSE,
+            data.diffuse
         );
     }
 
     if(params.uses_auto(SP_AUTO_MATERIAL_SPECULAR)) {
         params.set_colour(
-            params.auto_uniform_variable_name(SP_AUTO_MATERIAL_SPECULAR),
-            data_.specular
+            SP_AUTO_MATERIAL_SPECULAR,
+            data.specular
         );
     }
 
     if(params.uses_auto(SP_AUTO_MATERIAL_SHININESS)) {
         params.set_float(
-            params.auto_uniform_variable_name(SP_AUTO_MATERIAL_SHININESS),
-            data_.shininess
+            SP_AUTO_MATERIAL_SHININESS,
+            data.shininess
         );
     }
 
     if(params.uses_auto(SP_AUTO_MATERIAL_ACTIVE_TEXTURE_UNITS)) {
         params.set_int(
-            params.auto_uniform_variable_name(SP_AUTO_MATERIAL_ACTIVE_TEXTURE_UNITS),
-            data_.active_texture_count
+            SP_AUTO_MATERIAL_ACTIVE_TEXTURE_UNITS,
+            data.active_texture_count
         );
     }
 }
 
-void MaterialGroup::unbind() {
+void MaterialGroup::unbind_state(const MaterialGroupData& data, Stage& stage) {
 
 }
 
 void BlendGroup::bind() {
-    if(data_.type == BLEND_NONE) {
-        glDisable(GL_BLEND);
+    bind_state(data_, root_stage());
+}
+
+void BlendGroup::unbind() {
+    unbind_state(data_, root_stage());
+}
+
+void BlendGroup::bind_state(const BlendGroupData& data, Stage& stage) {
+    GLState& state = GLState::get();
+
+    if(data.type == BLEND_NONE) {
+        state.disable(GL_BLEND);
         return;
     }
 
-    glEnable(GL_BLEND);
-    switch(data_.type) {
-        case BLEND_ADD: glBlendFunc(GL_ONE, GL_ONE);
+    state.enable(GL_BLEND);
+    switch(data.type) {
+        case BLEND_ADD: state.blend_func(GL_ONE, GL_ONE);
         break;
-        case BLEND_ALPHA: glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        case BLEND_ALPHA: state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         break;
-        case BLEND_COLOUR: glBlendFunc(GL_SRC_COLOR, GL_ONE_MINUS_SRC_COLOR);
+        case BLEND_COLOUR: state.blend_func(GL_SRC_COLOR, GL_ONE_MINUS_SRC_COLOR);
         break;
-        case BLEND_MODULATE: glBlendFunc(GL_DST_COLOR, GL_ZERO);
+        case BLEND_MODULATE: state.blend_func(GL_DST_COLOR, GL_ZERO);
         break;
-        case BLEND_ONE_ONE_MINUS_ALPHA: glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        case BLEND_ONE_ONE_MINUS_ALPHA: state.blend_func(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
         break;
     default:
         throw ValueError("Invalid blend type specified");
     }
 }
 
-void BlendGroup::unbind() {
-    glDisable(GL_BLEND);
+void BlendGroup::unbind_state(const BlendGroupData& data, Stage& stage) {
+
 }
 
 void RenderSettingsGroup::bind() {
-    glPointSize(data_.point_size);
-    glLineWidth(data_.line_width);
+    bind_state(data_, root_stage());
 }
 
 void RenderSettingsGroup::unbind() {
-    glPointSize(1);
-    glLineWidth(1);
+    unbind_state(data_, root_stage());
+}
+
+void RenderSettingsGroup::bind_state(const RenderSettingsData& data, Stage& stage) {
+    GLState::get().point_size(data.point_size);
+    GLState::get().line_width(data.line_width);
+}
+
+void RenderSettingsGroup::unbind_state(const RenderSettingsData& data, Stage& stage) {
+
 }
 
 }
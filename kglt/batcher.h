@@ -140,6 +140,8 @@ public:
 protected:
     RenderGroup* parent_;
 
+    Stage& root_stage();
+
 private:
     typedef std::tr1::unordered_map<std::size_t, std::shared_ptr<RenderGroup> > RenderGroups;
     typedef std::tr1::unordered_map<std::size_t, RenderGroups> RenderGroupChildren;
@@ -206,6 +208,9 @@ public:
     void bind();
     void unbind();
 
+    static void bind_state(const data_type& data, Stage& stage);
+    static void unbind_state(const data_type& data, Stage& stage);
+
 private:
     DepthGroupData data_;
 };
@@ -232,6 +237,9 @@ public:
     void bind();
     void unbind();
 
+    static void bind_state(const data_type& data, Stage& stage);
+    static void unbind_state(const data_type& data, Stage& stage);
+
 private:
     ShaderGroupData data_;
 };
@@ -266,6 +274,9 @@ public:
     void bind();
     void unbind();
 
+    static void bind_state(const data_type& data, Stage& stage);
+    static void unbind_state(const data_type& data, Stage& stage);
+
 private:
     MeshGroupData data_;
 };
@@ -329,6 +340,9 @@ public:
     void bind();
     void unbind();
 
+    static void bind_state(const data_type& data, Stage& stage);
+    static void unbind_state(const data_type& data, Stage& stage);
+
 private:
     MaterialGroupData data_;
 };
@@ -363,6 +377,9 @@ public:
     void bind();
     void unbind();
 
+    static void bind_state(const data_type& data, Stage& stage);
+    static void unbind_state(const data_type& data, Stage& stage);
+
 private:
     TextureGroupData data_;
 };
@@ -399,6 +416,9 @@ public:
     void bind();
     void unbind();
 
+    static void bind_state(const data_type& data, Stage& stage);
+    static void unbind_state(const data_type& data, Stage& stage);
+
 private:
     TextureMatrixGroupData data_;
 };
@@ -430,6 +450,9 @@ public:
     void bind();
     void unbind();
 
+    static void bind_state(const data_type& data, Stage& stage);
+    static void unbind_state(const data_type& data, Stage& stage);
+
 private:
     LightGroupData data_;
 };
@@ -460,6 +483,9 @@ public:
     void bind();
     void unbind();
 
+    static void bind_state(const data_type& data, Stage& stage);
+    static void unbind_state(const data_type& data, Stage& stage);
+
 private:
     BlendGroupData data_;
 };
@@ -492,6 +518,9 @@ public:
     void bind();
     void unbind();
 
+    static void bind_state(const data_type& data, Stage& stage);
+    static void unbind_state(const data_type& data, Stage& stage);
+
 private:
     RenderSettingsData data_;
 };
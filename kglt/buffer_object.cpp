@@ -1,15 +1,34 @@
 #include <GLee.h>
+#include <atomic>
+#include <cstring>
 #include "kazbase/logging.h"
 #include "buffer_object.h"
 #include "utils/gl_thread_check.h"
+#include "utils/gl_state.h"
+#include "render_stats.h"
 
 namespace kglt {
 
+static uint64_t next_generation() {
+    //Buffers are built on the loader threads too
+    static std::atomic<uint64_t> generation(0);
+    return ++generation;
+}
+
 BufferObject::BufferObject(BufferObjectType type, BufferObjectUsage usage):
     usage_(usage),
     gl_target_(0),
     buffer_id_(0),
-    initialized_(false) {
+    initialized_(false),
+    byte_size_(0),
+    base_offset_(0),
+    generation_(next_generation()),
+    region_size_(0),
+    current_region_(0) {
+
+    for(uint8_t i = 0; i < BUFFER_OBJECT_STREAM_REGIONS; ++i) {
+        fences_[i] = nullptr;
+    }
 
     //FIXME: Totally need to support more than this
     switch(type) {
@@ -25,7 +44,28 @@ BufferObject::BufferObject(BufferObjectType type, BufferObjectUsage usage):
 }
 
 BufferObject::~BufferObject() {
+    destroy();
+}
 
+void BufferObject::destroy() {
+    if(buffer_id_) {
+        release_fences();
+        GLState::get().buffer_deleted(buffer_id_);
+        glDeleteBuffers(1, &buffer_id_);
+        buffer_id_ = 0;
+    }
+}
+
+void BufferObject::reset(BufferObjectUsage usage) {
+    destroy();
+
+    usage_ = usage;
+    initialized_ = false;
+    byte_size_ = 0;
+    base_offset_ = 0;
+    region_size_ = 0;
+    current_region_ = 0;
+    generation_ = next_generation();
 }
 
 void BufferObject::bind() const {
@@ -33,7 +73,7 @@ void BufferObject::bind() const {
 
     assert(initialized_);
     assert(buffer_id_);
-    glBindBuffer(gl_target_, buffer_id_);
+    GLState::get().bind_buffer(gl_target_, buffer_id_);
 }
 
 void BufferObject::create(uint32_t byte_size, const void* data) {
@@ -78,11 +118,22 @@ void BufferObject::create(uint32_t byte_size, const void* data) {
             throw std::logic_error("What the...?");
     }
 
-    glBindBuffer(gl_target_, buffer_id_);
+    GLState::get().bind_buffer(gl_target_, buffer_id_);
     assert(glGetError() == 0);
     glBufferData(gl_target_, byte_size, data, usage);
+    if(data) {
+        RenderStats::totals().buffer_bytes_uploaded += byte_size;
+    }
     assert(glGetError() == 0);
     initialized_ = true;
+    byte_size_ = byte_size;
+
+    //Anything that was streamed into the old storage is gone
+    release_fences();
+    base_offset_ = 0;
+    region_size_ = 0;
+    current_region_ = 0;
+    generation_ = next_generation();
 }
 
 void BufferObject::modify(uint32_t offset, uint32_t byte_size, const void* data) {
@@ -90,8 +141,83 @@ void BufferObject::modify(uint32_t offset, uint32_t byte_size, const void* data)
 
     assert(buffer_id_);
 
-    glBindBuffer(gl_target_, buffer_id_);
+    GLState::get().bind_buffer(gl_target_, buffer_id_);
     glBufferSubData(gl_target_, offset, byte_size, data);
+    RenderStats::totals().buffer_bytes_uploaded += byte_size;
+}
+
+void BufferObject::release_fences() {
+    if(!GLEE_ARB_sync) {
+        return;
+    }
+
+    for(uint8_t i = 0; i < BUFFER_OBJECT_STREAM_REGIONS; ++i) {
+        if(fences_[i]) {
+            glDeleteSync((GLsync) fences_[i]);
+            fences_[i] = nullptr;
+        }
+    }
+}
+
+void BufferObject::stream(uint32_t byte_size, const void* data) {
+    GLThreadCheck::check();
+
+    if(!GLEE_ARB_sync || !GLEE_ARB_map_buffer_range) {
+        /*
+         * No fences, so fall back to orphaning. Respecifying the storage lets the
+         * driver hand us a fresh block while the old one is still being drawn from
+         */
+        create(byte_size, nullptr);
+        modify(0, byte_size, data);
+        return;
+    }
+
+    if(!initialized_ || byte_size > region_size_) {
+        //Leave some room so that the buffer doesn't need to grow every time
+        uint32_t region_size = byte_size + (byte_size / 2);
+        create(region_size * BUFFER_OBJECT_STREAM_REGIONS, nullptr);
+        region_size_ = region_size;
+        current_region_ = 0;
+    } else {
+        //Everything issued so far may read the current region, fence it and move on
+        fences_[current_region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        current_region_ = (current_region_ + 1) % BUFFER_OBJECT_STREAM_REGIONS;
+
+        if(fences_[current_region_]) {
+            GLsync fence = (GLsync) fences_[current_region_];
+            if(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+                //Only say so once, this happens every frame while the GPU is behind. The stats count them all
+                static bool warned = false;
+                if(!warned) {
+                    L_WARN("Waiting for the GPU to release a streamed buffer region");
+                    warned = true;
+                }
+                ++RenderStats::totals().buffer_stalls;
+
+                while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+            }
+            glDeleteSync(fence);
+            fences_[current_region_] = nullptr;
+        }
+    }
+
+    base_offset_ = current_region_ * region_size_;
+    generation_ = next_generation();
+
+    GLState::get().bind_buffer(gl_target_, buffer_id_);
+    void* dest = glMapBufferRange(
+        gl_target_, base_offset_, byte_size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+    );
+
+    if(!dest) {
+        L_ERROR("Unable to map the streamed buffer region");
+        return;
+    }
+
+    memcpy(dest, data, byte_size);
+    RenderStats::totals().buffer_bytes_uploaded += byte_size;
+    glUnmapBuffer(gl_target_);
 }
 
 }
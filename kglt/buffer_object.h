@@ -1,6 +1,8 @@
 #ifndef BUFFER_OBJECT_H
 #define BUFFER_OBJECT_H
 
+#include <cstdint>
+
 namespace kglt {
 
 enum BufferObjectType {
@@ -20,21 +22,64 @@ enum BufferObjectUsage {
     MODIFY_REPEATEDLY_USED_FOR_QUERYING_AND_RENDERING
 };
 
+/*
+ * The number of regions a streamed buffer cycles through. Each region is only
+ * rewritten once the GPU has signalled that it's finished with it
+ */
+const uint8_t BUFFER_OBJECT_STREAM_REGIONS = 3;
+
 class BufferObject {
 public:
     BufferObject(BufferObjectType type, BufferObjectUsage usage=MODIFY_ONCE_USED_FOR_RENDERING);
     ~BufferObject();
 
+    //Owns the GL buffer and its fences, use reset() to start again
+    BufferObject(const BufferObject&) = delete;
+    BufferObject& operator=(const BufferObject&) = delete;
+
+    //Deletes the GL buffer (if there is one) and starts again with a new usage
+    void reset(BufferObjectUsage usage);
+
     void bind() const;
     void create(uint32_t byte_size, const void* data);
     void modify(uint32_t offset, uint32_t byte_size, const void* data);
 
+    /*
+     * Writes the data into the next region of a ring buffer, without waiting for
+     * draws which are still reading the previous regions. Offsets used for drawing
+     * must be relative to base_offset() afterwards.
+     */
+    void stream(uint32_t byte_size, const void* data);
+
+    BufferObjectUsage usage() const { return usage_; }
+    bool is_initialized() const { return initialized_; }
+    bool is_streamed() const { return usage_ == MODIFY_ONCE_USED_FOR_LIMITED_RENDERING; }
+    uint32_t size() const { return byte_size_; }
+    uint32_t base_offset() const { return base_offset_; }
+
+    /*
+     * Changes whenever the storage is respecified or streaming moves on to a new
+     * region, i.e. whenever anything holding on to the buffer id and base offset
+     * (like a vertex array object) needs to be rebuilt. Unique across all buffers.
+     */
+    uint64_t generation() const { return generation_; }
+
 private:
     BufferObjectUsage usage_;
 
     uint32_t gl_target_;
     uint32_t buffer_id_;
     bool initialized_;
+    uint32_t byte_size_;
+
+    uint32_t base_offset_;
+    uint64_t generation_;
+    uint32_t region_size_;
+    uint8_t current_region_;
+    void* fences_[BUFFER_OBJECT_STREAM_REGIONS]; //GLsync, kept opaque to avoid including GL here
+
+    void release_fences();
+    void destroy();
 };
 
 }
@@ -16,6 +16,14 @@ Camera::Camera(Scene *scene, CameraID id):
     kmMat4Identity(&view_matrix_);
 
     set_perspective_projection(45.0, 16.0 / 9.0);
+    snapshot_transformation();
+}
+
+void Camera::snapshot_transformation() {
+    Object::snapshot_transformation();
+
+    render_view_matrix_ = view_matrix_;
+    render_projection_matrix_ = projection_matrix_;
 }
 
 void Camera::update_frustum() {
@@ -26,6 +26,12 @@ public:
     const kmMat4& view_matrix() { return view_matrix_; }
     const kmMat4& projection_matrix() const { return projection_matrix_; }
 
+    //The view and projection as of the last snapshot, these are what rendering uses
+    const kmMat4& render_view_matrix() const { return render_view_matrix_; }
+    const kmMat4& render_projection_matrix() const { return render_projection_matrix_; }
+
+    void snapshot_transformation() override;
+
     Frustum& frustum() { return frustum_; }
 
     void set_perspective_projection(double fov, double aspect, double near=1.0, double far=1000.0f);
@@ -43,6 +49,9 @@ private:
     kmMat4 view_matrix_;
     kmMat4 projection_matrix_;
 
+    kmMat4 render_view_matrix_;
+    kmMat4 render_projection_matrix_;
+
     ActorRef following_actor_;
     Vec3 following_offset_;
     float following_lag_ = 0.0;
@@ -157,6 +157,10 @@ void Boid::enable_debug(bool value) {
         auto smi = mesh->new_submesh(kglt::MaterialID(), MESH_ARRANGEMENT_LINE_STRIP, false);
         normal_points_mesh_ = mesh->new_submesh(kglt::MaterialID(), MESH_ARRANGEMENT_POINTS, false);
 
+        //The normal points are rebuilt every update, so stream them
+        mesh->submesh(normal_points_mesh_).vertex_data().reset(MODIFY_ONCE_USED_FOR_LIMITED_RENDERING);
+        mesh->submesh(normal_points_mesh_).index_data().reset(MODIFY_ONCE_USED_FOR_LIMITED_RENDERING);
+
         {
             auto mat = stage->material(mesh->submesh(normal_points_mesh_).material_id());
             mat->technique().pass(0).set_point_size(5);
@@ -1,5 +1,9 @@
+#include <stdexcept>
+
 #include "sprite.h"
 
+#include "../kazbase/logging.h"
+
 #include "../scene.h"
 #include "../stage.h"
 #include "../procedural/mesh.h"
@@ -28,32 +32,62 @@ bool Sprite::init() {
     //FIXME: Entities should be connected to mesh->signal_changed() and update automatically
     actor()->set_mesh(actor()->mesh_id()); //Rebuild the actor
 
-    //Load the image
-    auto tex = stage()->texture(stage()->new_texture_from_file(image_path_));
-    image_width_ = tex->width();
-    image_height_ = tex->height();
-
-    //Hold a reference to the new material
-    auto mat = stage()->material(stage()->scene().clone_default_material());
-    material_id_ = mat->id();
+    try {
+        frames_ = stage()->atlas().add_sheet(image_path_, frame_size_.width, frame_size_.height);
+    } catch(std::logic_error& e) {
+        L_WARN(std::string("Sprite isn't using the texture atlas: ") + e.what());
+        frames_.clear();
+    }
 
-    //Set the texture on the material
-    mat->technique().pass(0).set_texture_unit(0, tex->id());
-    mat->technique().pass(0).set_blending(BLEND_ALPHA);
+    if(!frames_.empty()) {
+        //Shared with every other sprite on the same page
+        material_id_ = stage()->atlas().page_material(frames_[0].page);
+    } else {
+        //Load the image
+        auto tex = stage()->texture(stage()->new_texture_from_file(image_path_));
+        image_width_ = tex->width();
+        image_height_ = tex->height();
+
+        //Hold a reference to the new material
+        auto mat = stage()->material(stage()->scene().clone_default_material());
+        material_id_ = mat->id();
+
+        //Set the texture on the material
+        mat->technique().pass(0).set_texture_unit(0, tex->id());
+        mat->technique().pass(0).set_blending(BLEND_ALPHA);
+    }
 
     //Finally set the material on the mesh
     actor()->mesh().lock()->set_material_id(material_id_);
 
     update_texture_coordinates();
 
-    stage()->window().signal_step().connect(std::bind(&Sprite::update, this, std::placeholders::_1));
+    step_connection_ = stage()->window().signal_step().connect(std::bind(&Sprite::update, this, std::placeholders::_1));
     return true;
 }
 
 Sprite::~Sprite() {
+    step_connection_.disconnect();
+    if(pending_rebuild_) {
+        stage()->window().idle().remove(pending_rebuild_);
+    }
+
     stage()->delete_actor(actor_id_);
 }
 
+void Sprite::rebuild() {
+    if(pending_rebuild_) {
+        //Already queued, it reads the frame when it runs
+        return;
+    }
+
+    //Idle tasks run just before the frame is prepared, while the simulation is stopped
+    pending_rebuild_ = stage()->window().idle().add_once([this]() {
+        pending_rebuild_ = 0;
+        update_texture_coordinates();
+    }).id();
+}
+
 void Sprite::update(double dt) {
     if(current_animation_.empty()) {
         return;
@@ -77,7 +111,7 @@ void Sprite::update(double dt) {
         if(next_frame_ >= anim.frames.end) {
             next_frame_ = anim.frames.start;
         }
-        update_texture_coordinates();
+        rebuild();
     }
 }
 
@@ -123,11 +157,23 @@ void Sprite::rotate_to(float angle, float x, float y, float z) {
 }
 
 void Sprite::update_texture_coordinates() {
-    uint8_t across = image_width_ / frame_size_.width;
-    uint8_t down = image_height_ / frame_size_.height;
-
-    double u = (1.0 / double(across)) * (current_frame_ % across);
-    double v = (1.0 / double(down)) * (current_frame_ / across);
+    double u, v, u_end, v_end;
+
+    if(!frames_.empty()) {
+        const AtlasRegion& frame = frames_.at(current_frame_ % frames_.size());
+        u = frame.u0;
+        v = frame.v0;
+        u_end = frame.u1;
+        v_end = frame.v1;
+    } else {
+        uint8_t across = image_width_ / frame_size_.width;
+        uint8_t down = image_height_ / frame_size_.height;
+
+        u = (1.0 / double(across)) * (current_frame_ % across);
+        v = (1.0 / double(down)) * (current_frame_ / across);
+        u_end = u + (1.0 / double(across));
+        v_end = v + (1.0 / double(down));
+    }
 
     kglt::MeshPtr mesh = actor()->mesh().lock();
 
@@ -135,13 +181,13 @@ void Sprite::update_texture_coordinates() {
     mesh->shared_data().tex_coord0(u, v);
 
     mesh->shared_data().move_next();
-    mesh->shared_data().tex_coord0(u + (1.0 / double(across)) , v);
+    mesh->shared_data().tex_coord0(u_end, v);
 
     mesh->shared_data().move_next();
-    mesh->shared_data().tex_coord0(u + (1.0 / double(across)) , v + (1.0 / double(down)));
+    mesh->shared_data().tex_coord0(u_end, v_end);
 
     mesh->shared_data().move_next();
-    mesh->shared_data().tex_coord0(u, v + (1.0 / double(down)));
+    mesh->shared_data().tex_coord0(u, v_end);
 
     mesh->shared_data().done();
 }
@@ -2,9 +2,14 @@
 #define ADDITIONAL_SPRITE_H
 
 #include <unordered_map>
+#include <vector>
+#include <sigc++/sigc++.h>
+
 #include "../generic/managed.h"
 #include "../types.h"
 #include "../base.h"
+#include "../texture_atlas.h"
+#include "../idle_task_manager.h"
 
 namespace kglt {
 
@@ -15,12 +20,18 @@ namespace extra {
 /**
   USAGE:
 
-  TextureID tex = stage.new_texture_from_file("sprite.png");
-
-  //Split a texture into parts, 64 pixels wide
-  Sprite::ptr sprite = Sprite::create(stage, tex, FrameSize(64, 64));
+  //Split an image into frames of 64x64 pixels
+  Sprite::ptr sprite = Sprite::create(scene, stage_id, "sprite.png", FrameSize(64, 64));
   sprite->add_animation("running", FrameRange(0, 15), 5.0);
   sprite->update(window.deltatime());
+
+  The frames go into the resource manager's TextureAtlas and are numbered in reading
+  order from the top left. Sprites on the same atlas page share a material (so they
+  batch together), and animating only changes the texture coordinates of the sprite's
+  own mesh. Frames too big for an atlas page fall back to a texture and material of
+  the sprite's own. update() only picks the frame, the texture coordinates are written
+  by an idle task just before the next frame is prepared, so it's safe to call from a
+  step handler when the window is rendering threaded.
 */
 
 struct FrameSize {
@@ -100,6 +111,15 @@ private:
     std::string current_animation_;
     std::string next_animation_;
 
+    //Empty when the sprite has a texture of its own
+    std::vector<AtlasRegion> frames_;
+
+    sigc::connection step_connection_;
+
+    //update() can run on the simulation thread, so the mesh is only touched by an idle task
+    ConnectionID pending_rebuild_ = 0;
+    void rebuild();
+
     void update_texture_coordinates();
 };
 
@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <boost/lexical_cast.hpp>
+#include <kazmath/utility.h>
+
+#include "sprite_batch.h"
+
+#include "../scene.h"
+#include "../stage.h"
+#include "../actor.h"
+#include "../mesh.h"
+#include "../camera.h"
+#include "../window_base.h"
+#include "../utils/profiler.h"
+
+namespace kglt {
+namespace extra {
+
+namespace {
+
+const uint8_t FLAG_ALIVE = 1;
+const uint8_t FLAG_VISIBLE = 2;
+
+}
+
+uint32_t SpriteRecords::new_sheet(const std::vector<AtlasRegion>& frames) {
+    if(frames.empty()) {
+        throw std::logic_error("A sprite sheet needs at least one frame");
+    }
+
+    Sheet sheet;
+    sheet.frames = frames;
+    sheets_.push_back(sheet);
+    return sheets_.size() - 1;
+}
+
+void SpriteRecords::add_animation(uint32_t sheet, const std::string& name, const FrameRange& frames, double duration) {
+    if(frames.end <= frames.start || duration <= 0.0) {
+        throw std::logic_error("Animations need at least one frame and a duration: " + name);
+    }
+
+    Animation animation = { frames, duration };
+
+    //Assigned rather than replaced, sprites playing it keep pointing at it
+    auto& animations = sheets_.at(sheet).animations;
+    auto it = animations.find(name);
+    if(it == animations.end()) {
+        animations.insert(std::make_pair(name, animation));
+    } else {
+        (*it).second = animation;
+    }
+}
+
+bool SpriteRecords::has_animation(uint32_t sheet, const std::string& name) const {
+    const auto& animations = sheets_.at(sheet).animations;
+    return animations.find(name) != animations.end();
+}
+
+BatchedSpriteID SpriteRecords::new_sprite(uint32_t sheet) {
+    const AtlasRegion& first = sheets_.at(sheet).frames.at(0);
+
+    BatchedSpriteID sprite;
+    if(!free_.empty()) {
+        sprite = free_.back();
+        free_.pop_back();
+    } else {
+        sprite = x_.size();
+
+        x_.push_back(0); y_.push_back(0);
+        cos_.push_back(1); sin_.push_back(0);
+        scale_x_.push_back(1); scale_y_.push_back(1);
+        radius_.push_back(0);
+        colour_.push_back(Colour::white);
+        layer_.push_back(0);
+        flags_.push_back(0);
+        sheet_.push_back(0);
+        page_.push_back(0);
+        frame_.push_back(0);
+        playing_.push_back(nullptr);
+        next_frame_.push_back(0);
+        interp_.push_back(0);
+    }
+
+    x_[sprite] = y_[sprite] = 0;
+    cos_[sprite] = 1;
+    sin_[sprite] = 0;
+    scale_x_[sprite] = scale_y_[sprite] = 1; //The same size as Sprite's rectangle
+    colour_[sprite] = Colour::white;
+    layer_[sprite] = 0;
+    flags_[sprite] = FLAG_ALIVE | FLAG_VISIBLE;
+    sheet_[sprite] = sheet;
+    page_[sprite] = first.page;
+    frame_[sprite] = 0;
+    playing_[sprite] = nullptr;
+    next_frame_[sprite] = 0;
+    interp_[sprite] = 0;
+
+    update_radius(sprite);
+
+    ++alive_count_;
+    return sprite;
+}
+
+void SpriteRecords::check(BatchedSpriteID sprite) const {
+    if(!is_alive(sprite)) {
+        throw std::logic_error("Tried to use a sprite that doesn't exist");
+    }
+}
+
+bool SpriteRecords::is_alive(BatchedSpriteID sprite) const {
+    return sprite < flags_.size() && (flags_[sprite] & FLAG_ALIVE);
+}
+
+void SpriteRecords::delete_sprite(BatchedSpriteID sprite) {
+    check(sprite);
+
+    flags_[sprite] = 0;
+    playing_[sprite] = nullptr;
+    free_.push_back(sprite);
+    --alive_count_;
+}
+
+void SpriteRecords::set_active_animation(BatchedSpriteID sprite, const std::string& name) {
+    check(sprite);
+
+    const auto& animations = sheets_[sheet_[sprite]].animations;
+    auto it = animations.find(name);
+    if(it == animations.end()) {
+        throw std::logic_error("No such animation: " + name);
+    }
+
+    playing_[sprite] = &(*it).second;
+    next_frame_[sprite] = (*it).second.frames.start;
+    interp_[sprite] = 0;
+}
+
+void SpriteRecords::set_frame(BatchedSpriteID sprite, uint32_t frame) {
+    check(sprite);
+
+    const Sheet& sheet = sheets_[sheet_[sprite]];
+    frame_[sprite] = frame % sheet.frames.size();
+    page_[sprite] = sheet.frames[frame_[sprite]].page;
+}
+
+void SpriteRecords::move_to(BatchedSpriteID sprite, float x, float y) {
+    check(sprite);
+    x_[sprite] = x;
+    y_[sprite] = y;
+}
+
+void SpriteRecords::rotate_to(BatchedSpriteID sprite, float degrees) {
+    check(sprite);
+
+    const float radians = kmDegreesToRadians(degrees);
+    cos_[sprite] = std::cos(radians);
+    sin_[sprite] = std::sin(radians);
+}
+
+void SpriteRecords::set_scale(BatchedSpriteID sprite, float x, float y) {
+    check(sprite);
+    scale_x_[sprite] = x;
+    scale_y_[sprite] = y;
+    update_radius(sprite);
+}
+
+void SpriteRecords::update_radius(BatchedSpriteID sprite) {
+    radius_[sprite] = 0.5f * std::sqrt(scale_x_[sprite] * scale_x_[sprite] + scale_y_[sprite] * scale_y_[sprite]);
+}
+
+void SpriteRecords::set_colour(BatchedSpriteID sprite, const Colour& colour) {
+    check(sprite);
+    colour_[sprite] = colour;
+}
+
+void SpriteRecords::set_layer(BatchedSpriteID sprite, int16_t layer) {
+    check(sprite);
+    layer_[sprite] = layer;
+}
+
+void SpriteRecords::set_visible(BatchedSpriteID sprite, bool value) {
+    check(sprite);
+
+    if(value) {
+        flags_[sprite] |= FLAG_VISIBLE;
+    } else {
+        flags_[sprite] &= ~FLAG_VISIBLE;
+    }
+}
+
+void SpriteRecords::update(double dt) {
+    const uint32_t size = playing_.size();
+    for(uint32_t i = 0; i < size; ++i) {
+        const Animation* animation = playing_[i];
+        if(!animation) {
+            continue;
+        }
+
+        const double change_per_second = double(animation->frames.end - animation->frames.start) / animation->duration;
+        interp_[i] += change_per_second * dt;
+
+        if(interp_[i] >= 1.0) {
+            interp_[i] = 0.0;
+            set_frame(i, next_frame_[i]);
+
+            next_frame_[i]++;
+            if(next_frame_[i] >= animation->frames.end) {
+                next_frame_[i] = animation->frames.start;
+            }
+        }
+    }
+}
+
+void SpriteRecords::cull(float min_x, float min_y, float max_x, float max_y, std::vector<BatchedSpriteID>& visible) const {
+    const uint32_t size = flags_.size();
+    for(uint32_t i = 0; i < size; ++i) {
+        if(flags_[i] != (FLAG_ALIVE | FLAG_VISIBLE)) {
+            continue;
+        }
+
+        const float r = radius_[i];
+        if(x_[i] + r < min_x || x_[i] - r > max_x || y_[i] + r < min_y || y_[i] - r > max_y) {
+            continue;
+        }
+
+        visible.push_back(i);
+    }
+}
+
+void SpriteRecords::corners(BatchedSpriteID sprite, float out[8]) const {
+    const float hw = scale_x_[sprite] * 0.5f;
+    const float hh = scale_y_[sprite] * 0.5f;
+    const float c = cos_[sprite];
+    const float s = sin_[sprite];
+
+    const float local[8] = { -hw, -hh, hw, -hh, hw, hh, -hw, hh };
+    for(uint8_t i = 0; i < 4; ++i) {
+        const float lx = local[i * 2];
+        const float ly = local[(i * 2) + 1];
+        out[i * 2] = x_[sprite] + (lx * c) - (ly * s);
+        out[(i * 2) + 1] = y_[sprite] + (lx * s) + (ly * c);
+    }
+}
+
+void SpriteRecords::texture_coordinates(BatchedSpriteID sprite, float out[4]) const {
+    const AtlasRegion& frame = sheets_[sheet_[sprite]].frames[frame_[sprite]];
+    out[0] = frame.u0;
+    out[1] = frame.v0;
+    out[2] = frame.u1;
+    out[3] = frame.v1;
+}
+
+SpriteBatch::SpriteBatch(Scene& scene, StageID stage_id, CameraID camera_id):
+    scene_(scene),
+    stage_id_(stage_id),
+    camera_id_(camera_id) {
+
+}
+
+bool SpriteBatch::init() {
+    WindowBase& window = stage().window();
+
+    step_connection_ = window.signal_step().connect(std::bind(&SpriteBatch::update, this, std::placeholders::_1));
+
+    //Idle tasks run just before the frame is prepared, while the simulation is stopped
+    rebuild_connection_ = window.idle().add(std::bind(&SpriteBatch::rebuild, this));
+    return true;
+}
+
+SpriteBatch::~SpriteBatch() {
+    step_connection_.disconnect();
+    stage().window().idle().remove(rebuild_connection_);
+
+    for(Batch& batch: batches_) {
+        if(batch.mesh) {
+            stage().delete_actor(batch.actor);
+        }
+    }
+}
+
+Stage& SpriteBatch::stage() {
+    return scene_.stage(stage_id_);
+}
+
+BatchedSpriteID SpriteBatch::new_sprite(const std::string& image_path, const FrameSize& frame_size) {
+    const std::string key = image_path + ":" +
+        boost::lexical_cast<std::string>(frame_size.width) + "x" +
+        boost::lexical_cast<std::string>(frame_size.height);
+
+    auto it = sheets_.find(key);
+    if(it == sheets_.end()) {
+        uint32_t sheet = records_.new_sheet(stage().atlas().add_sheet(image_path, frame_size.width, frame_size.height));
+        it = sheets_.insert(std::make_pair(key, sheet)).first;
+    }
+
+    return records_.new_sprite((*it).second);
+}
+
+void SpriteBatch::add_animation(BatchedSpriteID sprite, const std::string& anim_name, const FrameRange& frames, double duration) {
+    records_.add_animation(records_.sheet(sprite), anim_name, frames, duration);
+
+    if(!records_.is_animating(sprite)) {
+        records_.set_active_animation(sprite, anim_name);
+    }
+}
+
+void SpriteBatch::set_active_animation(BatchedSpriteID sprite, const std::string& anim_name) {
+    records_.set_active_animation(sprite, anim_name);
+}
+
+SpriteBatch::Batch& SpriteBatch::batch(uint32_t page) {
+    if(page >= batches_.size()) {
+        batches_.resize(page + 1);
+    }
+
+    Batch& batch = batches_[page];
+    if(!batch.mesh) {
+        batch.mesh = stage().mesh(stage().new_mesh()).lock();
+        batch.submesh = batch.mesh->new_submesh(stage().atlas().page_material(page), MESH_ARRANGEMENT_TRIANGLES, false);
+
+        //Rewritten every frame, so stream it and keep the colours small
+        VertexData& vertices = batch.mesh->submesh(batch.submesh).vertex_data();
+        vertices.reset(MODIFY_ONCE_USED_FOR_LIMITED_RENDERING);
+        vertices.set_attribute_encoding(BM_DIFFUSE, ATTRIBUTE_ENCODING_NORMALIZED_BYTE);
+
+        batch.actor = stage().new_actor(batch.mesh->id());
+    }
+
+    return batch;
+}
+
+bool SpriteBatch::rebuild() {
+    KGLT_PROFILE_SCOPE("SpriteBatch::rebuild");
+
+    float min_x = -std::numeric_limits<float>::max(), min_y = min_x;
+    float max_x = std::numeric_limits<float>::max(), max_y = max_x;
+
+    //An orthographic camera looks straight down z, so what it sees is the rectangle its corners span
+    Frustum& frustum = scene_.camera(camera_id_).frustum();
+    if(frustum.initialized()) {
+        std::vector<kmVec3> corners = frustum.near_corners();
+        std::vector<kmVec3> far = frustum.far_corners();
+        corners.insert(corners.end(), far.begin(), far.end());
+
+        min_x = min_y = std::numeric_limits<float>::max();
+        max_x = max_y = -std::numeric_limits<float>::max();
+        for(const kmVec3& corner: corners) {
+            min_x = std::min(min_x, corner.x);
+            min_y = std::min(min_y, corner.y);
+            max_x = std::max(max_x, corner.x);
+            max_y = std::max(max_y, corner.y);
+        }
+    }
+
+    visible_.clear();
+    records_.cull(min_x, min_y, max_x, max_y, visible_);
+
+    //Sorting page, layer, ID gives each page's quads together and in the order they're drawn
+    order_.clear();
+    for(BatchedSpriteID sprite: visible_) {
+        const uint64_t layer = uint16_t(int32_t(records_.layer(sprite)) + 32768);
+        order_.push_back((uint64_t(records_.page(sprite)) << 48) | (layer << 32) | sprite);
+    }
+    std::sort(order_.begin(), order_.end());
+
+    batches_drawn_ = 0;
+
+    std::vector<bool> drawn(batches_.size(), false);
+    for(auto first = order_.begin(); first != order_.end();) {
+        const uint32_t page = uint32_t(*first >> 48);
+        auto last = std::find_if(first, order_.end(), [page](uint64_t key) {
+            return uint32_t(key >> 48) != page;
+        });
+
+        fill(batch(page), first, last);
+        drawn.resize(batches_.size(), false);
+        drawn[page] = true;
+        ++batches_drawn_;
+        first = last;
+    }
+
+    for(uint32_t page = 0; page < batches_.size(); ++page) {
+        if(batches_[page].mesh && !drawn[page]) {
+            stage().actor(batches_[page].actor).set_visible(false);
+        }
+    }
+
+    return true;
+}
+
+void SpriteBatch::fill(Batch& batch, std::vector<uint64_t>::const_iterator first, std::vector<uint64_t>::const_iterator last) {
+    SubMesh& submesh = batch.mesh->submesh(batch.submesh);
+    VertexData& vertices = submesh.vertex_data();
+    IndexData& indices = submesh.index_data();
+
+    const uint32_t quads = last - first;
+
+    //Every done() recalculates the bounds, so the indices can't point past the vertices at any point
+    auto build_indices = [&]() {
+        indices.clear();
+        indices.reserve(quads * 6);
+        for(uint32_t i = 0; i < quads * 4; i += 4) {
+            indices.index(i);
+            indices.index(i + 1);
+            indices.index(i + 2);
+            indices.index(i);
+            indices.index(i + 2);
+            indices.index(i + 3);
+        }
+        indices.done();
+        batch.quads = quads;
+    };
+
+    if(quads < batch.quads) {
+        build_indices();
+    }
+
+    vertices.clear();
+
+    float corners[8];
+    float uv[4];
+    for(auto it = first; it != last; ++it) {
+        const BatchedSpriteID sprite = uint32_t(*it & 0xFFFFFFFF);
+        records_.corners(sprite, corners);
+        records_.texture_coordinates(sprite, uv);
+
+        //The layer is also the depth, inside the -1 to 1 an orthographic projection has by default
+        const float z = float(records_.layer(sprite)) / 32768.0f;
+        const Colour& colour = records_.colour(sprite);
+
+        const float u[4] = { uv[0], uv[2], uv[2], uv[0] };
+        const float v[4] = { uv[1], uv[1], uv[3], uv[3] };
+        for(uint8_t i = 0; i < 4; ++i) {
+            vertices.position(corners[i * 2], corners[(i * 2) + 1], z);
+            vertices.tex_coord0(u[i], v[i]);
+            vertices.diffuse(colour);
+            vertices.move_next();
+        }
+    }
+
+    vertices.done();
+
+    if(quads > batch.quads) {
+        build_indices();
+    }
+
+    Actor& actor = stage().actor(batch.actor);
+    actor.set_visible(true);
+    actor.mesh_bounds_changed();
+}
+
+}
+}
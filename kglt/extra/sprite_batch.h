@@ -0,0 +1,227 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sigc++/sigc++.h>
+
+#include "../generic/managed.h"
+#include "../types.h"
+#include "../colour.h"
+#include "../mesh.h"
+#include "../texture_atlas.h"
+#include "../idle_task_manager.h"
+#include "sprite.h"
+
+namespace kglt {
+
+class Scene;
+class Stage;
+
+namespace extra {
+
+typedef uint32_t BatchedSpriteID;
+
+/*
+ * The sprites of a SpriteBatch, one array per field so that culling and animating
+ * only touch the fields they need. Nothing in here uses GL, the batch turns the
+ * visible records into quads.
+ *
+ * Frames come from sheets (lists of atlas regions). Animations belong to a sheet and
+ * are shared by every sprite made from it, each sprite only keeps where it is in the
+ * one that's playing. IDs are reused once a sprite has been deleted.
+ */
+class SpriteRecords {
+public:
+    uint32_t new_sheet(const std::vector<AtlasRegion>& frames);
+    uint32_t sheet_frame_count(uint32_t sheet) const { return sheets_.at(sheet).frames.size(); }
+
+    //Replaces the frames and duration of an animation of the same name
+    void add_animation(uint32_t sheet, const std::string& name, const FrameRange& frames, double duration);
+    bool has_animation(uint32_t sheet, const std::string& name) const;
+
+    BatchedSpriteID new_sprite(uint32_t sheet);
+    void delete_sprite(BatchedSpriteID sprite);
+    bool is_alive(BatchedSpriteID sprite) const;
+
+    //The number of live sprites
+    uint32_t count() const { return alive_count_; }
+    //One past the highest ID in use, for looping over the arrays
+    uint32_t capacity() const { return x_.size(); }
+
+    //Throws std::logic_error if the sprite's sheet has no such animation
+    void set_active_animation(BatchedSpriteID sprite, const std::string& name);
+    bool is_animating(BatchedSpriteID sprite) const { return playing_.at(sprite) != nullptr; }
+    void set_frame(BatchedSpriteID sprite, uint32_t frame);
+
+    void move_to(BatchedSpriteID sprite, float x, float y);
+    void rotate_to(BatchedSpriteID sprite, float degrees);
+    void set_scale(BatchedSpriteID sprite, float x, float y);
+    void set_colour(BatchedSpriteID sprite, const Colour& colour);
+    void set_layer(BatchedSpriteID sprite, int16_t layer);
+    void set_visible(BatchedSpriteID sprite, bool value);
+
+    float x(BatchedSpriteID sprite) const { return x_.at(sprite); }
+    float y(BatchedSpriteID sprite) const { return y_.at(sprite); }
+    int16_t layer(BatchedSpriteID sprite) const { return layer_.at(sprite); }
+    uint32_t sheet(BatchedSpriteID sprite) const { return sheet_.at(sprite); }
+    uint32_t frame(BatchedSpriteID sprite) const { return frame_.at(sprite); }
+    uint32_t page(BatchedSpriteID sprite) const { return page_.at(sprite); }
+    const Colour& colour(BatchedSpriteID sprite) const { return colour_.at(sprite); }
+
+    //Advances every playing animation, the same way Sprite::update() does
+    void update(double dt);
+
+    /*
+     * Appends the live, visible sprites that overlap the rectangle, in ID order. A
+     * sprite is tested with the circle around it, so rotating it never hides it.
+     */
+    void cull(float min_x, float min_y, float max_x, float max_y, std::vector<BatchedSpriteID>& visible) const;
+
+    //The corners anticlockwise from the bottom left, as x, y pairs
+    void corners(BatchedSpriteID sprite, float out[8]) const;
+    //u0, v0, u1, v1 of the current frame
+    void texture_coordinates(BatchedSpriteID sprite, float out[4]) const;
+
+private:
+    struct Animation {
+        FrameRange frames;
+        double duration;
+    };
+
+    struct Sheet {
+        std::vector<AtlasRegion> frames;
+        std::unordered_map<std::string, Animation> animations;
+    };
+
+    //A deque so that adding a sheet doesn't move the animations being played
+    std::deque<Sheet> sheets_;
+
+    std::vector<float> x_;
+    std::vector<float> y_;
+    std::vector<float> cos_; //The rotation is kept as its cosine and sine
+    std::vector<float> sin_;
+    std::vector<float> scale_x_;
+    std::vector<float> scale_y_;
+    std::vector<float> radius_; //Half the diagonal, for culling
+    std::vector<Colour> colour_;
+    std::vector<int16_t> layer_;
+    std::vector<uint8_t> flags_;
+
+    std::vector<uint32_t> sheet_;
+    std::vector<uint32_t> page_;
+    std::vector<uint32_t> frame_;
+
+    //Null when not animating
+    std::vector<const Animation*> playing_;
+    std::vector<uint32_t> next_frame_;
+    std::vector<float> interp_;
+
+    std::vector<BatchedSpriteID> free_;
+    uint32_t alive_count_ = 0;
+
+    void check(BatchedSpriteID sprite) const;
+    void update_radius(BatchedSpriteID sprite);
+};
+
+/**
+  USAGE:
+
+  SpriteBatch::ptr batch = SpriteBatch::create(scene, stage_id, camera_id);
+  BatchedSpriteID id = batch->new_sprite("sprite.png", FrameSize(64, 64));
+  batch->add_animation(id, "running", FrameRange(0, 15), 5.0);
+  batch->move_to(id, 10, 20);
+
+  For lots of sprites that don't need to be actors. Frames go into the stage's
+  TextureAtlas as they do for Sprite, and before each frame is drawn the sprites the
+  camera can see are written into one mesh per atlas page, so each page is a single
+  draw call however many sprites are on it. The meshes are streamed (see
+  BufferObject), so rewriting them every frame doesn't stall on the last one.
+
+  Sprites are drawn in layer order within a page, and the layer is also their z, so
+  depth testing puts pages in the same order. Frames too big for an atlas page can't
+  be batched, use Sprite for those.
+
+  Animations advance on the window's step and the meshes are rebuilt by an idle task,
+  so like everything else the sprites can be changed from step handlers but not from
+  other threads.
+*/
+class SpriteBatch :
+    public Managed<SpriteBatch> {
+
+public:
+    typedef std::shared_ptr<SpriteBatch> ptr;
+
+    SpriteBatch(Scene& scene, StageID stage_id, CameraID camera_id);
+    ~SpriteBatch();
+
+    bool init();
+
+    //Throws std::logic_error if the frames don't fit on an atlas page
+    BatchedSpriteID new_sprite(const std::string& image_path, const FrameSize& frame_size);
+    void delete_sprite(BatchedSpriteID sprite) { records_.delete_sprite(sprite); }
+
+    /*
+     * Animations are per image and frame size, adding one to a sprite makes it
+     * available to all of the sprites using the same frames. As with Sprite, the
+     * first one a sprite is given starts playing.
+     */
+    void add_animation(BatchedSpriteID sprite, const std::string& anim_name, const FrameRange& frames, double duration);
+    void set_active_animation(BatchedSpriteID sprite, const std::string& anim_name);
+
+    void move_to(BatchedSpriteID sprite, float x, float y) { records_.move_to(sprite, x, y); }
+    void rotate_to(BatchedSpriteID sprite, float degrees) { records_.rotate_to(sprite, degrees); }
+    void set_render_dimensions(BatchedSpriteID sprite, float width, float height) { records_.set_scale(sprite, width, height); }
+    void set_colour(BatchedSpriteID sprite, const Colour& colour) { records_.set_colour(sprite, colour); }
+    void set_layer(BatchedSpriteID sprite, int16_t layer) { records_.set_layer(sprite, layer); }
+    void set_visible(BatchedSpriteID sprite, bool value=true) { records_.set_visible(sprite, value); }
+
+    void update(double dt) { records_.update(dt); }
+
+    uint32_t sprite_count() const { return records_.count(); }
+    //How many were drawn last frame, and with how many meshes
+    uint32_t visible_count() const { return visible_.size(); }
+    uint32_t batch_count() const { return batches_drawn_; }
+
+    StageID stage_id() const { return stage_id_; }
+    CameraID camera_id() const { return camera_id_; }
+
+private:
+    struct Batch {
+        ActorID actor;
+        MeshPtr mesh;
+        SubMeshIndex submesh = 0;
+        uint32_t quads = 0; //What the indices were built for
+    };
+
+    Scene& scene_;
+    StageID stage_id_;
+    CameraID camera_id_;
+
+    SpriteRecords records_;
+    std::unordered_map<std::string, uint32_t> sheets_;
+
+    //Indexed by atlas page
+    std::vector<Batch> batches_;
+
+    std::vector<BatchedSpriteID> visible_;
+    std::vector<uint64_t> order_;
+    uint32_t batches_drawn_ = 0;
+
+    sigc::connection step_connection_;
+    ConnectionID rebuild_connection_ = 0;
+
+    Stage& stage();
+
+    bool rebuild();
+    Batch& batch(uint32_t page);
+    void fill(Batch& batch, std::vector<uint64_t>::const_iterator first, std::vector<uint64_t>::const_iterator last);
+};
+
+}
+}
+
+#endif // SPRITE_BATCH_H
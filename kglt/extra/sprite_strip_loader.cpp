@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <boost/lexical_cast.hpp>
 
 #include "kglt/kazbase/exceptions.h"
@@ -6,6 +7,8 @@
 
 #include "../scene.h"
 #include "../shortcuts.h"
+#include "../window_base.h"
+#include "../loaders/texture_loader.h"
 
 namespace kglt {
 namespace extra {
@@ -17,34 +20,32 @@ SpriteStripLoader::SpriteStripLoader(ResourceManager& rm, const std::string& fil
 }
 
 std::vector<TextureID> SpriteStripLoader::load_frames() {
-    //Load texture, but don't upload to OpenGL
-    auto tmp = rm_.texture(rm_.new_texture_from_file(filename_));
-
-    if(tmp->width() % frame_width_ != 0) {
+    /*
+     * Decode the strip without uploading it, or going through the texture cache,
+     * which would hand back a compiled texture that can't be cut up
+     */
+    Texture image(&rm_, TextureID());
+    LoaderOptions options;
+    options["dont_fallback"] = "true";
+    loaders::TextureLoader(rm_.window().resource_locator().locate_file(filename_)).into(image, options);
+
+    if(image.width() % frame_width_ != 0) {
         throw IOError("Invalid texture width. Should be a multiple of: " + boost::lexical_cast<std::string>(frame_width_));
     }
 
-    std::vector< Texture::Data > frame_data;
-    frame_data.resize(tmp->width() / frame_width_);
-
     /*
-      Go through the loaded texture data in rows, keep track of the
-      x position so we can copy the data to the correct frame
+      Each row of the strip holds one row of every frame, side by side, so
+      copy a frame's worth of bytes at a time
     */
-    uint32_t bytes = tmp->bpp() / 8;
-    for(uint32_t y = 0; y < tmp->height(); ++y) {
-        uint32_t current_frame = 0;        
+    const uint32_t frame_count = image.width() / frame_width_;
+    const uint32_t row_bytes = frame_width_ * (image.bpp() / 8);
 
-        for(uint32_t x = 0; x < tmp->width(); ++x) {
-            uint32_t idx = ((y * bytes) * tmp->width()) + (x * bytes);
+    std::vector< Texture::Data > frame_data(frame_count, Texture::Data(row_bytes * image.height()));
+    for(uint32_t y = 0; y < image.height(); ++y) {
+        const uint8_t* row = &image.data()[y * row_bytes * frame_count];
 
-            for(uint32_t i = 0; i < tmp->bpp() / 8; ++i) {
-                frame_data[current_frame].push_back(tmp->data().at(idx + i));
-            }
-
-            if(x && (x % frame_width_) == 0) {
-                current_frame++;
-            }
+        for(uint32_t frame = 0; frame < frame_count; ++frame) {
+            std::copy(row + frame * row_bytes, row + (frame + 1) * row_bytes, &frame_data[frame][y * row_bytes]);
         }
     }
 
@@ -52,8 +53,8 @@ std::vector<TextureID> SpriteStripLoader::load_frames() {
     for(Texture::Data& data: frame_data) {
         auto tex = rm_.texture(rm_.new_texture());
 
-        tex->set_bpp(tmp->bpp()); //Set the bpp
-        tex->resize(frame_width_, tmp->height()); //Resize the texture
+        tex->set_bpp(image.bpp()); //Set the bpp
+        tex->resize(frame_width_, image.height()); //Resize the texture
         tex->data().assign(data.begin(), data.end()); //Copy the frame data
         tex->upload(true, true, false, false);
 
@@ -63,5 +64,9 @@ std::vector<TextureID> SpriteStripLoader::load_frames() {
     return results;
 }
 
+std::vector<AtlasRegion> SpriteStripLoader::load_regions() {
+    return rm_.atlas().add_sheet(filename_, frame_width_);
+}
+
 }
 }
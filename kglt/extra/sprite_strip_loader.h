@@ -7,6 +7,7 @@
 #include "../generic/creator.h"
 #include "../types.h"
 #include "../resource_manager.h"
+#include "../texture_atlas.h"
 
 namespace kglt {
 
@@ -20,6 +21,9 @@ public:
     SpriteStripLoader(ResourceManager& rm, const std::string& filename, uint32_t frame_width);
     std::vector<TextureID> load_frames();
 
+    //The frames as regions of the resource manager's atlas, so they share a texture
+    std::vector<AtlasRegion> load_regions();
+
 private:
     ResourceManager& rm_;
     std::string filename_;
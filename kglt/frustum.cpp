@@ -1,4 +1,9 @@
 #include <cassert>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 #include "frustum.h"
 #include "types.h"
 
@@ -10,27 +15,111 @@ Frustum::Frustum():
 }
 
 bool Frustum::intersects_aabb(const kmAABB &aabb) const {
-    for(const kmPlane& plane: planes_) {
-        const kglt::Vec3 pv(
-            plane.a > 0 ? aabb.max.x : aabb.min.x,
-            plane.b > 0 ? aabb.max.y : aabb.min.y,
-            plane.c > 0 ? aabb.max.z : aabb.min.z
-        );
+    return classify_aabb(aabb) != FRUSTUM_CONTAINS_NONE;
+}
 
-        kglt::Vec4 v1(pv, 1.0f);
-        kmVec4Normalize(&v1, &v1);
+/**
+ * @brief Frustum::classify_aabb
+ * @param aabb - The box to test
+ * @return FRUSTUM_CONTAINS_NONE if the box is outside any plane, FRUSTUM_CONTAINS_ALL
+ * if it's inside all of them and FRUSTUM_CONTAINS_PARTIAL otherwise.
+ *
+ * For each plane, the corner furthest along the plane normal (the p-vertex) tells us if
+ * the box is outside, and the opposite corner (the n-vertex) tells us if it crosses it.
+ */
+FrustumClassification Frustum::classify_aabb(const kmAABB &aabb) const {
+    FrustumClassification result = FRUSTUM_CONTAINS_ALL;
 
-        kglt::Vec4 v2(plane.a, plane.b, plane.c, plane.d);
-        kmVec4Normalize(&v2, &v2);
+    for(const kmPlane& plane: planes_) {
+        const float px = plane.a > 0 ? aabb.max.x : aabb.min.x;
+        const float py = plane.b > 0 ? aabb.max.y : aabb.min.y;
+        const float pz = plane.c > 0 ? aabb.max.z : aabb.min.z;
+
+        if((plane.a * px) + (plane.b * py) + (plane.c * pz) + plane.d < 0) {
+            return FRUSTUM_CONTAINS_NONE;
+        }
 
-        const float n = kmVec4Dot(&v1, &v2);
+        const float nx = plane.a > 0 ? aabb.min.x : aabb.max.x;
+        const float ny = plane.b > 0 ? aabb.min.y : aabb.max.y;
+        const float nz = plane.c > 0 ? aabb.min.z : aabb.max.z;
 
-        if (n < 0) {
-            return false;
+        if((plane.a * nx) + (plane.b * ny) + (plane.c * nz) + plane.d < 0) {
+            result = FRUSTUM_CONTAINS_PARTIAL;
         }
     }
 
-    return true;
+    return result;
+}
+
+/**
+ * @brief Frustum::intersects_aabbs
+ * @param boxes - The list of boxes to test
+ * @param group - Which group of AABBList::GROUP_SIZE boxes to test
+ * @return A bitmask with bit N set if box (group * GROUP_SIZE) + N intersects the frustum
+ *
+ * The same p-vertex test as classify_aabb, but for four boxes at once. Bits for the
+ * unused lanes of the last group are always clear.
+ */
+uint32_t Frustum::intersects_aabbs(const AABBList& boxes, uint32_t group) const {
+    assert(group < boxes.group_count());
+
+    const uint32_t first = group * AABBList::GROUP_SIZE;
+    const uint32_t remaining = boxes.size() - first;
+    const uint32_t valid = (remaining < AABBList::GROUP_SIZE) ? remaining : AABBList::GROUP_SIZE;
+    const uint32_t lanes = (1u << valid) - 1;
+
+    const float* min_x = boxes.component(group, AABBList::MIN_X);
+    const float* min_y = boxes.component(group, AABBList::MIN_Y);
+    const float* min_z = boxes.component(group, AABBList::MIN_Z);
+    const float* max_x = boxes.component(group, AABBList::MAX_X);
+    const float* max_y = boxes.component(group, AABBList::MAX_Y);
+    const float* max_z = boxes.component(group, AABBList::MAX_Z);
+
+#ifdef __SSE__
+    const __m128 mn_x = _mm_loadu_ps(min_x);
+    const __m128 mn_y = _mm_loadu_ps(min_y);
+    const __m128 mn_z = _mm_loadu_ps(min_z);
+    const __m128 mx_x = _mm_loadu_ps(max_x);
+    const __m128 mx_y = _mm_loadu_ps(max_y);
+    const __m128 mx_z = _mm_loadu_ps(max_z);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 outside = zero;
+    for(const kmPlane& plane: planes_) {
+        const __m128 px = plane.a > 0 ? mx_x : mn_x;
+        const __m128 py = plane.b > 0 ? mx_y : mn_y;
+        const __m128 pz = plane.c > 0 ? mx_z : mn_z;
+
+        __m128 distance = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.a), px), _mm_mul_ps(_mm_set1_ps(plane.b), py)),
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.c), pz), _mm_set1_ps(plane.d))
+        );
+
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+    }
+
+    return ~uint32_t(_mm_movemask_ps(outside)) & lanes;
+#else
+    uint32_t result = 0;
+    for(uint32_t i = 0; i < valid; ++i) {
+        bool inside = true;
+        for(const kmPlane& plane: planes_) {
+            const float px = plane.a > 0 ? max_x[i] : min_x[i];
+            const float py = plane.b > 0 ? max_y[i] : min_y[i];
+            const float pz = plane.c > 0 ? max_z[i] : min_z[i];
+
+            if((plane.a * px) + (plane.b * py) + (plane.c * pz) + plane.d < 0) {
+                inside = false;
+                break;
+            }
+        }
+
+        if(inside) {
+            result |= (1u << i);
+        }
+    }
+    return result & lanes;
+#endif
 }
 
 void Frustum::build(const kmMat4* modelview_projection) {
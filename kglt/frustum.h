@@ -8,6 +8,8 @@
 #include <cstdint>
 #include <vector>
 
+#include "utils/aabb_list.h"
+
 namespace kglt {
 
 enum FrustumCorner {
@@ -45,6 +47,8 @@ public:
     bool contains_point(const kmVec3& point) const; ///< Returns true if the frustum contains point
 
     bool intersects_aabb(const kmAABB& box) const;
+    FrustumClassification classify_aabb(const kmAABB& box) const;
+    uint32_t intersects_aabbs(const AABBList& boxes, uint32_t group) const;
 
     bool initialized() const { return initialized_; }
 
@@ -0,0 +1,106 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+
+namespace kglt {
+namespace generic {
+
+/*
+ * An unbounded, lock-free queue that any number of threads can push to but only
+ * one thread may pop from (Dmitry Vyukov's intrusive MPSC queue). push() is a single
+ * atomic exchange, so producers never wait on each other or on the consumer.
+ *
+ * pop() can briefly return false while a push is half way through even though the
+ * queue isn't empty; the item shows up on a later pop(), so the consumer should treat
+ * false as "nothing more for now" rather than "definitely empty".
+ */
+template<typename T>
+class MPSCQueue {
+public:
+    MPSCQueue():
+        head_(&stub_),
+        tail_(&stub_) {
+
+        stub_.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~MPSCQueue() {
+        T discarded;
+        while(pop(discarded)) {}
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    void push(const T& value) {
+        push_node(new Node(value));
+    }
+
+    bool pop(T& out) {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+
+        if(tail == &stub_) {
+            if(!next) {
+                return false;
+            }
+
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if(next) {
+            tail_ = next;
+            return take(tail, out);
+        }
+
+        if(tail != head_.load(std::memory_order_acquire)) {
+            //A producer has swapped the head but not linked its node in yet
+            return false;
+        }
+
+        //tail is the last node, put the stub behind it so that it can be removed
+        push_node(&stub_);
+
+        next = tail->next.load(std::memory_order_acquire);
+        if(next) {
+            tail_ = next;
+            return take(tail, out);
+        }
+
+        return false;
+    }
+
+private:
+    struct Node {
+        Node() = default;
+        Node(const T& value):
+            value(value) {}
+
+        std::atomic<Node*> next;
+        T value;
+    };
+
+    std::atomic<Node*> head_; //Producers push here
+    Node* tail_; //Only touched by the consumer
+    Node stub_;
+
+    void push_node(Node* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    bool take(Node* node, T& out) {
+        out = std::move(node->value);
+        delete node;
+        return true;
+    }
+};
+
+}
+}
+
+#endif // MPSC_QUEUE_H
@@ -1,73 +1,215 @@
+#include <algorithm>
+#include <chrono>
 #include <utility>
-#include <tr1/functional>
 #include "kazbase/logging.h"
 #include "idle_task_manager.h"
+#include "utils/profiler.h"
 
 namespace kglt {
 
-static ConnectionID connection_counter = 0;
+bool IdleTaskToken::is_done() const {
+    return done_.valid() && done_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void IdleTaskToken::wait() const {
+    if(!done_.valid()) {
+        throw std::logic_error("Attempted to wait on an empty idle task token");
+    }
 
-IdleTaskManager::IdleTaskManager() {
+    done_.get();
+}
+
+IdleTaskManager::IdleTaskManager():
+    next_id_(0),
+    pending_(0),
+    budget_(DEFAULT_BUDGET_MS),
+    execution_count_(0) {
 
 }
 
 ConnectionID IdleTaskManager::add(std::function<bool ()> callback) {
-    std::lock_guard<std::mutex> lock(signals_mutex_);
+    Command command;
+    command.type = COMMAND_ADD;
+    command.id = ++next_id_;
+    command.priority = IDLE_TASK_PRIORITY_NORMAL;
+    command.repeating = callback;
+
+    commands_.push(command);
+    return command.id;
+}
 
-    ConnectionID new_id = ++connection_counter;
-    signals_.insert(std::make_pair(new_id, callback));
-    return new_id;
+IdleTaskToken IdleTaskManager::add_once(std::function<void ()> callback, IdleTaskPriority priority) {
+    Command command;
+    command.type = COMMAND_ADD_ONCE;
+    command.id = ++next_id_;
+    command.priority = priority;
+    command.once = callback;
+    command.done = std::make_shared<std::promise<void> >();
+
+    IdleTaskToken token(command.id, command.done->get_future().share());
+
+    ++pending_;
+    commands_.push(command);
+    return token;
 }
 
-ConnectionID IdleTaskManager::add_once(std::function<void ()> callback) {
-    std::lock_guard<std::mutex> lock(signals_once_mutex_);
+void IdleTaskManager::remove(ConnectionID connection) {
+    Command command;
+    command.type = COMMAND_REMOVE;
+    command.id = connection;
+    command.priority = IDLE_TASK_PRIORITY_NORMAL;
 
-    ConnectionID new_id = ++connection_counter;
-    signals_once_.insert(std::make_pair(new_id, callback));
-    return new_id;
+    commands_.push(command);
 }
 
 void IdleTaskManager::wait() {
     std::unique_lock<std::mutex> lk(cv_mutex_);
-    cv_.wait(lk);
+
+    uint64_t target = execution_count_ + 1;
+    cv_.wait(lk, [=]() { return execution_count_ >= target; });
+}
+
+void IdleTaskManager::apply_repeating(const Command& command) {
+    if(command.type == COMMAND_ADD) {
+        RepeatingTask task = { command.id, command.repeating };
+        repeating_.push_back(task);
+    } else {
+        ConnectionID id = command.id;
+
+        repeating_.erase(
+            std::remove_if(repeating_.begin(), repeating_.end(), [=](const RepeatingTask& task) {
+                return task.id == id;
+            }),
+            repeating_.end()
+        );
+    }
+}
+
+void IdleTaskManager::apply_commands(bool repeating) {
+    if(repeating) {
+        for(const Command& command: deferred_) {
+            apply_repeating(command);
+        }
+        deferred_.clear();
+    }
+
+    Command command;
+    while(commands_.pop(command)) {
+        switch(command.type) {
+            case COMMAND_ADD:
+                if(repeating) {
+                    apply_repeating(command);
+                } else {
+                    deferred_.push_back(command);
+                }
+            break;
+            case COMMAND_ADD_ONCE:
+                once_[command.priority].push_back(command);
+            break;
+            case COMMAND_REMOVE: {
+                ConnectionID id = command.id;
+
+                if(repeating) {
+                    apply_repeating(command);
+                } else {
+                    deferred_.push_back(command);
+                }
+
+                //Dropping the promise wakes anyone waiting on the token with broken_promise
+                for(std::deque<Command>& queue: once_) {
+                    auto it = std::find_if(queue.begin(), queue.end(), [=](const Command& task) {
+                        return task.id == id;
+                    });
+
+                    if(it != queue.end()) {
+                        queue.erase(it);
+                        --pending_;
+                    }
+                }
+            } break;
+        }
+    }
+}
+
+void IdleTaskManager::run_once(Command& task) {
+    --pending_;
+
+    try {
+        task.once();
+    } catch(std::exception& e) {
+        //Let whoever is waiting see what went wrong
+        task.done->set_exception(std::current_exception());
+
+        if(task.priority == IDLE_TASK_PRIORITY_UPLOAD) {
+            L_ERROR(std::string("Upload failed: ") + e.what());
+            return;
+        }
+        throw;
+    } catch(...) {
+        task.done->set_exception(std::current_exception());
+        throw;
+    }
+
+    task.done->set_value();
 }
 
 void IdleTaskManager::execute() {
-    {
-        //FIXME: If (*it).second tries to queue on idle this will deadlock
-        std::lock_guard<std::mutex> lock(signals_mutex_);
-        for(auto it = signals_.begin(); it != signals_.end();) {
-            bool result = (*it).second();
-            if(!result) {
-                L_DEBUG("Idle task returned false. Removing.");
-                it = signals_.erase(it);
-            } else {
-                ++it;
-            }
+    KGLT_PROFILE_SCOPE("IdleTaskManager::execute");
+
+    typedef std::chrono::steady_clock Clock;
+    auto start = Clock::now();
+
+    apply_commands();
+
+    //Index based, the vector isn't touched by anything else until the next apply_commands()
+    for(uint32_t i = 0; i < repeating_.size();) {
+        if(!repeating_[i].callback()) {
+            L_DEBUG("Idle task returned false. Removing.");
+            repeating_.erase(repeating_.begin() + i);
+        } else {
+            ++i;
         }
     }
 
-    SignalOnceMap to_iter; //Create an empty map
-    {
-        //Lock the signals once mutex and then swap to clear
-        std::lock_guard<std::mutex> lock(signals_once_mutex_);
-        std::swap(to_iter, signals_once_);
+    double budget = budget_;
+    bool ran_one = false;
+
+    for(std::deque<Command>& queue: once_) {
+        while(!queue.empty()) {
+            if(ran_one && budget > 0) {
+                double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                if(elapsed >= budget) {
+                    break;
+                }
+            }
+
+            //Take it off the queue first, it might throw
+            Command task = queue.front();
+            queue.pop_front();
+
+            run_once(task);
+            ran_one = true;
+        }
     }
 
-    //Iterate over the copy
-    for(auto p: to_iter) {
-        p.second();
+    {
+        std::lock_guard<std::mutex> lk(cv_mutex_);
+        ++execution_count_;
     }
 
     cv_.notify_all(); //Unblock any threads waiting
 }
 
-void IdleTaskManager::remove(ConnectionID connection) {
-    std::lock_guard<std::mutex> lock1(signals_mutex_);
-    std::lock_guard<std::mutex> lock2(signals_once_mutex_);
+void IdleTaskManager::flush(IdleTaskPriority priority) {
+    apply_commands(false);
 
-    signals_.erase(connection);
-    signals_once_.erase(connection);
+    std::deque<Command>& queue = once_[priority];
+    while(!queue.empty()) {
+        Command task = queue.front();
+        queue.pop_front();
+
+        run_once(task);
+    }
 }
 
 }
@@ -1,42 +1,147 @@
 #ifndef IDLE_TASK_MANAGER_H
 #define IDLE_TASK_MANAGER_H
 
+#include <atomic>
 #include <cstdint>
 #include <sigc++/sigc++.h>
 #include <functional>
-#include <map>
+#include <future>
+#include <deque>
+#include <memory>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 
+#include "generic/mpsc_queue.h"
+
 namespace kglt {
 
 typedef uint32_t ConnectionID;
 
+enum IdleTaskPriority {
+    IDLE_TASK_PRIORITY_HIGH,
+    IDLE_TASK_PRIORITY_NORMAL,
+    IDLE_TASK_PRIORITY_UPLOAD, //GL work queued from other threads, see below
+    IDLE_TASK_PRIORITY_LOW
+};
+
+const uint8_t IDLE_TASK_PRIORITY_COUNT = 4;
+
+/*
+ * Returned by IdleTaskManager::add_once() for waiting on that one task. wait()
+ * rethrows anything the task threw, and throws std::future_error if the task was
+ * removed before it ran. Don't wait() on the thread that runs execute().
+ */
+class IdleTaskToken {
+public:
+    IdleTaskToken():
+        id_(0) {}
+
+    ConnectionID id() const { return id_; }
+
+    bool is_done() const;
+    void wait() const;
+
+private:
+    friend class IdleTaskManager;
+
+    IdleTaskToken(ConnectionID id, std::shared_future<void> done):
+        id_(id),
+        done_(done) {}
+
+    ConnectionID id_;
+    std::shared_future<void> done_;
+};
+
+/*
+ * Work handed to the main thread from anywhere. Adding and removing tasks only
+ * pushes onto a lock-free queue, so no thread ever waits on another to queue
+ * something, and execute() runs the callbacks without holding any locks (so a
+ * task can queue or remove other tasks).
+ *
+ * Repeating tasks run on every execute() until they return false or are removed.
+ * One-off tasks run highest priority first, in the order they were added, until
+ * budget() milliseconds have passed; whatever is left over runs on the next
+ * execute(). At least one one-off task runs each time so the queue always drains.
+ * Removing a task only takes effect on the next execute().
+ *
+ * Anything another thread needs done with GL (texture and buffer uploads, shader
+ * compiles) goes in as IDLE_TASK_PRIORITY_UPLOAD, which WindowBase runs before
+ * preparing each frame. Those run in the order they were queued, so waiting on a
+ * no-op upload waits for every upload queued before it. An upload that throws is
+ * logged and the exception only goes to its token, as whoever queued it is the one
+ * waiting to hear; other one-off tasks let it propagate out of execute().
+ */
 class IdleTaskManager {
 public:
     IdleTaskManager();
 
     ConnectionID add(std::function<bool ()> callback);
-    ConnectionID add_once(std::function<void ()> callback);
-    
+    IdleTaskToken add_once(std::function<void ()> callback, IdleTaskPriority priority=IDLE_TASK_PRIORITY_NORMAL);
+
     void remove(ConnectionID connection);
 
+    static const uint32_t DEFAULT_BUDGET_MS = 4;
+
+    //In milliseconds, shared by all of the one-off tasks. 0 runs every one of them each time
+    double budget() const { return budget_; }
+    void set_budget(double milliseconds) { budget_ = milliseconds; }
+
+    //One-off tasks that haven't run yet, including ones carried over by the budget
+    uint32_t pending() const { return pending_; }
+
     void execute();
 
+    /*
+     * Runs every one-off task of the priority queued so far, ignoring the budget.
+     * Only from the thread that runs execute(), for when it's about to depend on
+     * uploads it queued itself.
+     */
+    void flush(IdleTaskPriority priority);
+
+    //Blocks until the next execute() has finished
     void wait();
 
 private:
-    typedef std::map<ConnectionID, std::function<bool ()> > SignalMap;
-    typedef std::map<ConnectionID, std::function<void ()> > SignalOnceMap;
+    enum CommandType {
+        COMMAND_ADD,
+        COMMAND_ADD_ONCE,
+        COMMAND_REMOVE
+    };
+
+    struct Command {
+        CommandType type;
+        ConnectionID id;
+        IdleTaskPriority priority;
+        std::function<bool ()> repeating;
+        std::function<void ()> once;
+        std::shared_ptr<std::promise<void> > done;
+    };
+
+    struct RepeatingTask {
+        ConnectionID id;
+        std::function<bool ()> callback;
+    };
+
+    generic::MPSCQueue<Command> commands_;
+    std::atomic<ConnectionID> next_id_;
+    std::atomic<uint32_t> pending_;
+    std::atomic<double> budget_;
+
+    //Only touched by the thread calling execute()
+    std::vector<RepeatingTask> repeating_;
+    std::deque<Command> once_[IDLE_TASK_PRIORITY_COUNT];
 
-    SignalMap signals_;
-    SignalOnceMap signals_once_;
+    //Changes to the repeating tasks seen by flush(), which can run inside one of them
+    std::vector<Command> deferred_;
 
-    std::mutex signals_mutex_;
-    std::mutex signals_once_mutex_;
+    void apply_commands(bool repeating=true);
+    void apply_repeating(const Command& command);
+    void run_once(Command& task);
 
     std::mutex cv_mutex_;
     std::condition_variable cv_;
+    uint64_t execution_count_;
 };
 
 }
@@ -20,6 +20,7 @@
 #include "procedural/mesh.h"
 #include "procedural/texture.h"
 #include "batcher.h"
+#include "render_queue.h"
 #include "loader.h"
 #include "ui/interface.h"
 #include "procedural/geom_factory.h"
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "stage.h"
 #include "light.h"
 
@@ -28,6 +30,8 @@ void Light::set_attenuation(float range, float constant, float linear, float qua
     const_attenuation_ = constant;
     linear_attenuation_ = linear;
     quadratic_attenuation_ = quadratic;
+
+    signal_bounds_changed_(id());
 }
 
 /**
@@ -43,6 +47,43 @@ void Light::set_attenuation_from_range(float range) {
     const_attenuation_ = 1.0;
     linear_attenuation_ = 4.5 / range;
     quadratic_attenuation_ = 75.0 / (range * range);
+
+    signal_bounds_changed_(id());
+}
+
+/**
+ * @brief Light::distance_to
+ * @param box - An absolute bounding box
+ * @return The distance from the light to the nearest point of the box, zero if
+ * the light is inside it or is directional (directional lights are everywhere)
+ */
+float Light::distance_to(const kmAABB& box) const {
+    if(type() == LIGHT_TYPE_DIRECTIONAL) {
+        return 0.0;
+    }
+
+    const kmVec3& pos = absolute_position();
+
+    kmVec3 nearest;
+    kmVec3Fill(
+        &nearest,
+        std::max(box.min.x, std::min(pos.x, box.max.x)),
+        std::max(box.min.y, std::min(pos.y, box.max.y)),
+        std::max(box.min.z, std::min(pos.z, box.max.z))
+    );
+
+    kmVec3 diff;
+    kmVec3Subtract(&diff, &nearest, &pos);
+    return kmVec3Length(&diff);
+}
+
+/**
+ * @brief Light::reaches
+ * @param box - An absolute bounding box
+ * @return true if any part of the box is within range() of the light
+ */
+bool Light::reaches(const kmAABB& box) const {
+    return distance_to(box) <= range();
 }
 
 void Light::destroy() {
@@ -19,7 +19,10 @@ public:
     typedef std::shared_ptr<Light> ptr;
 
     Light(Stage* stage, LightID lid);
-    void set_type(LightType type) { type_ = type; }
+    void set_type(LightType type) {
+        type_ = type;
+        signal_bounds_changed_(id());
+    }
 
     /*
      *  Direction (ab)uses the light's position.
@@ -67,23 +70,29 @@ public:
     float linear_attenuation() const { return linear_attenuation_; }
     float quadratic_attenuation() const { return quadratic_attenuation_; }
 
-    /** Boundable interface **/
+    float distance_to(const kmAABB& box) const;
+    bool reaches(const kmAABB& box) const;
+
+    /** Boundable interface, the bounds enclose everything within range() **/
     const kmAABB absolute_bounds() const {
         kmAABB result;
-        kmAABBInitialize(&result, &absolute_position(), range(), range(), range());
+        kmAABBInitialize(&result, &absolute_position(), range() * 2, range() * 2, range() * 2);
         return result;
     }
 
     const kmAABB local_bounds() const {
         kmAABB result;
-        kmAABBInitialize(&result, nullptr, range(), range(), range());
+        kmAABBInitialize(&result, nullptr, range() * 2, range() * 2, range() * 2);
         return result;
     }
 
     const kmVec3 centre() const {
-        return position();
+        return absolute_position();
     }
 
+    ///Emitted when the light moves or its range changes
+    sigc::signal<void, LightID>& signal_bounds_changed() { return signal_bounds_changed_; }
+
     void destroy();
 
 private:
@@ -98,6 +107,9 @@ private:
     float linear_attenuation_;
     float quadratic_attenuation_;
 
+    sigc::signal<void, LightID> signal_bounds_changed_;
+
+    void transformation_changed() override { signal_bounds_changed_(id()); }
 };
 
 }
@@ -0,0 +1,72 @@
+#include <map>
+#include <stdexcept>
+
+#include "kglmesh_loader.h"
+
+#include "../mesh.h"
+#include "../resource_manager.h"
+#include "../shortcuts.h"
+#include "../kazbase/logging.h"
+#include "../utils/mesh_compiler.h"
+#include "../utils/profiler.h"
+#include "../utils/gl_thread_check.h"
+#include "../window_base.h"
+
+namespace kglt {
+namespace loaders {
+
+void KGLMeshLoader::into(Loadable& resource, const LoaderOptions& options) {
+    KGLT_PROFILE_SCOPE("KGLMeshLoader::into");
+
+    Mesh* mesh = loadable_to<Mesh>(resource);
+    CompiledMesh compiled = map_kglmesh(filename_.encode());
+
+    ResourceManager& resource_manager = mesh->resource_manager();
+
+    mesh->clear();
+    mesh->shared_data().set_packed(compiled.vertices.at(0));
+
+    //Submeshes with the same material file share the material
+    std::map<std::pair<MaterialSourceType, std::string>, MaterialID> materials;
+
+    for(const CompiledSubMesh& submesh: compiled.submeshes) {
+        MaterialID material;
+
+        if(submesh.material_type != MATERIAL_SOURCE_DEFAULT) {
+            auto key = std::make_pair(submesh.material_type, submesh.material_file);
+            auto it = materials.find(key);
+            if(it != materials.end()) {
+                material = (*it).second;
+            } else {
+                try {
+                    if(submesh.material_type == MATERIAL_SOURCE_TEXTURE) {
+                        material = create_material_from_texture(
+                            resource_manager, resource_manager.new_texture_from_file(submesh.material_file)
+                        );
+                    } else if(GLThreadCheck::is_current()) {
+                        material = resource_manager.new_material_from_file(submesh.material_file);
+                    } else {
+                        //Material scripts compile shaders, so when loading in the background run them on the main thread
+                        const std::string& file = submesh.material_file;
+                        resource_manager.window().idle().add_once([&]() {
+                            material = resource_manager.new_material_from_file(file);
+                        }, IDLE_TASK_PRIORITY_UPLOAD).wait();
+                    }
+                } catch(WrongThreadError& e) {
+                    throw;
+                } catch(std::exception& e) {
+                    L_WARN("Couldn't load the material of a submesh, using the default: " + submesh.material_file + " (" + e.what() + ")");
+                }
+                materials[key] = material;
+            }
+        }
+
+        SubMeshIndex index = mesh->new_submesh(material, submesh.arrangement, submesh.vertices == 0);
+
+        const PackedVertices* vertices = (submesh.vertices) ? &compiled.vertices.at(submesh.vertices) : nullptr;
+        mesh->submesh(index).set_packed(vertices, submesh.indices, submesh.bounds);
+    }
+}
+
+}
+}
@@ -0,0 +1,42 @@
+#ifndef KGLMESH_LOADER_H
+#define KGLMESH_LOADER_H
+
+#include "../loader.h"
+
+namespace kglt {
+namespace loaders {
+
+/*
+ * Loads meshes saved by save_kglmesh(). The file is mapped and its buffers go to GL
+ * as they are, with none of the vertices being unpacked unless something edits them.
+ */
+class KGLMeshLoader : public Loader {
+public:
+    KGLMeshLoader(const unicode& filename):
+        Loader(filename) {}
+
+    void into(Loadable& resource, const LoaderOptions& options = LoaderOptions());
+};
+
+class KGLMeshLoaderType : public LoaderType {
+public:
+    KGLMeshLoaderType() {
+
+    }
+
+    ~KGLMeshLoaderType() {}
+
+    unicode name() { return "kglmesh_loader"; }
+    bool supports(const unicode& filename) const override {
+        return filename.lower().contains(".kglmesh");
+    }
+
+    Loader::ptr loader_for(const unicode& filename) const {
+        return Loader::ptr(new KGLMeshLoader(filename));
+    }
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,18 @@
+#include "ktx_loader.h"
+
+#include "../texture.h"
+#include "../utils/texture_compiler.h"
+#include "../utils/profiler.h"
+
+namespace kglt {
+namespace loaders {
+
+void KTXLoader::into(Loadable& resource, const LoaderOptions& options) {
+    KGLT_PROFILE_SCOPE("KTXLoader::into");
+
+    Texture* tex = loadable_to<Texture>(resource);
+    tex->set_compiled(map_ktx(filename_.encode()));
+}
+
+}
+}
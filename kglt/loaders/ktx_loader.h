@@ -0,0 +1,42 @@
+#ifndef KGLT_KTX_LOADER_H
+#define KGLT_KTX_LOADER_H
+
+#include "../loader.h"
+
+namespace kglt {
+namespace loaders {
+
+/*
+ * Loads textures that were compiled ahead of time (see TextureCompiler). The file
+ * is mapped rather than read, and its levels are uploaded exactly as they are.
+ */
+class KTXLoader : public Loader {
+public:
+    KTXLoader(const unicode& filename):
+        Loader(filename) {}
+
+    void into(Loadable& resource, const LoaderOptions& options = LoaderOptions());
+};
+
+class KTXLoaderType : public LoaderType {
+public:
+    KTXLoaderType() {
+
+    }
+
+    ~KTXLoaderType() {}
+
+    unicode name() { return "ktx_loader"; }
+    bool supports(const unicode& filename) const override {
+        return filename.lower().contains(".ktx");
+    }
+
+    Loader::ptr loader_for(const unicode& filename) const {
+        return Loader::ptr(new KTXLoader(filename));
+    }
+};
+
+}
+}
+
+#endif
@@ -8,6 +8,7 @@
 #include "../scene.h"
 #include "../shortcuts.h"
 #include "../resource_manager.h"
+#include "../utils/profiler.h"
 
 namespace kglt {
 
@@ -87,6 +88,8 @@ void MaterialScript::handle_pass_set_command(Material& mat, const std::vector<st
                 shader->params().register_attribute(SP_ATTR_VERTEX_NORMAL, variable_name);
             } else if(arg_1 == "DIFFUSE") {
                 shader->params().register_attribute(SP_ATTR_VERTEX_DIFFUSE, variable_name);
+            } else if(arg_1 == "INSTANCE_MODEL_MATRIX") {
+                shader->params().register_attribute(SP_ATTR_INSTANCE_MODEL_MATRIX, variable_name);
             } else {
                 throw SyntaxError("Unhandled attribute: " + arg_1);
             }
@@ -121,6 +124,10 @@ void MaterialScript::handle_pass_set_command(Material& mat, const std::vector<st
             shader->params().register_auto(SP_AUTO_MODELVIEW_MATRIX, variable_name);
         } else if(arg_1 == "MODELVIEW_PROJECTION_MATRIX") {
             shader->params().register_auto(SP_AUTO_MODELVIEW_PROJECTION_MATRIX, variable_name);
+        } else if(arg_1 == "PROJECTION_MATRIX") {
+            shader->params().register_auto(SP_AUTO_PROJECTION_MATRIX, variable_name);
+        } else if(arg_1 == "VIEW_PROJECTION_MATRIX") {
+            shader->params().register_auto(SP_AUTO_VIEW_PROJECTION_MATRIX, variable_name);
         } else if(arg_1 == "INVERSE_TRANSPOSE_MODELVIEW_PROJECTION_MATRIX" || arg_1 == "NORMAL_MATRIX") {
             shader->params().register_auto(SP_AUTO_INVERSE_TRANSPOSE_MODELVIEW_MATRIX, variable_name);
         } else if(arg_1 == "TEXTURE_MATRIX0") {
@@ -377,6 +384,8 @@ void MaterialScript::generate(Material& material) {
 namespace loaders {
 
 void MaterialScriptLoader::into(Loadable& resource, const LoaderOptions& options) {
+    KGLT_PROFILE_SCOPE("MaterialScriptLoader::into");
+
     Material* mat = loadable_to<Material>(resource);
     parser_->generate(*mat);
 
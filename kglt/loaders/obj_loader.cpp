@@ -8,6 +8,7 @@
 #include "../kazbase/file_utils.h"
 #include "../kazbase/os.h"
 #include "../shortcuts.h"
+#include "../utils/profiler.h"
 
 namespace kglt {
 namespace loaders {
@@ -59,6 +60,8 @@ void parse_face(const unicode& input, int32_t& vertex_index, int32_t& tex_index,
 }
 
 void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
+    KGLT_PROFILE_SCOPE("OBJLoader::into");
+
     Mesh* mesh = loadable_to<Mesh>(resource);
 
     //Create a submesh with the default material
@@ -2,6 +2,7 @@
 #include "stb_vorbis.h"
 
 #include "../sound.h"
+#include "../utils/profiler.h"
 
 namespace kglt {
 namespace loaders {
@@ -61,6 +62,8 @@ void init_source(Sound* self, Source& source) {
 
 
 void OGGLoader::into(Loadable& resource, const LoaderOptions& options) {
+    KGLT_PROFILE_SCOPE("OGGLoader::into");
+
     Loadable* res_ptr = &resource;
     Sound* sound = dynamic_cast<Sound*>(res_ptr);
     assert(sound && "You passed a Resource that is not a Sound to the OGG loader");
@@ -9,6 +9,7 @@
 #include "../shortcuts.h"
 
 #include "../kazbase/unicode.h"
+#include "../utils/profiler.h"
 #include "opt_loader.h"
 
 namespace kglt {
@@ -430,6 +431,8 @@ void OPTLoader::read_block(std::istream& file, Offset offset) {
 }
 
 void OPTLoader::into(Loadable& resource, const LoaderOptions &options) {
+    KGLT_PROFILE_SCOPE("OPTLoader::into");
+
     Loadable* res_ptr = &resource;
     Mesh* mesh = dynamic_cast<Mesh*>(res_ptr);
     assert(mesh && "You passed a Resource that is not a mesh to the OPT loader");
@@ -16,6 +16,7 @@
 #include "../types.h"
 #include "../light.h"
 #include "../camera.h"
+#include "../utils/profiler.h"
 #include "../procedural/texture.h"
 #include "../kazbase/string.h"
 #include "q2bsp_loader.h"
@@ -218,6 +219,8 @@ void add_lights_to_scene(Scene& scene, const std::vector<ActorProperties>& actor
 }
 
 void Q2BSPLoader::into(Loadable& resource, const LoaderOptions &options) {
+    KGLT_PROFILE_SCOPE("Q2BSPLoader::into");
+
     Loadable* res_ptr = &resource;
     Scene* scene = dynamic_cast<Scene*>(res_ptr);
     assert(scene && "You passed a Resource that is not a scene to the Scene loader");
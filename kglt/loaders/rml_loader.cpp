@@ -3,11 +3,14 @@
 
 #include "../ui/ui_private.h"
 #include "../ui/interface.h"
+#include "../utils/profiler.h"
 
 namespace kglt {
 namespace loaders {
 
 void RMLLoader::into(Loadable& resource, const LoaderOptions &options) {
+    KGLT_PROFILE_SCOPE("RMLLoader::into");
+
     Loadable* res_ptr = &resource;
     ui::Interface* iface = dynamic_cast<ui::Interface*>(res_ptr);
     assert(iface && "You passed a Resource that is not a Interface to the RML loader");
@@ -8,16 +8,32 @@
 
 #include "../kazbase/exceptions.h"
 #include "../kazbase/list_utils.h"
+#include "../kazbase/logging.h"
 #include "../texture.h"
+#include "../window_base.h"
+#include "../utils/profiler.h"
+#include "../utils/texture_compiler.h"
 
 namespace kglt {
 namespace loaders {
 
 void TextureLoader::into(Loadable& resource, const LoaderOptions& options) {
+    KGLT_PROFILE_SCOPE("TextureLoader::into");
+
     Loadable* res_ptr = &resource;
     Texture* tex = dynamic_cast<Texture*>(res_ptr);
     assert(tex && "You passed a Resource that is not a texture to the TGA loader");
 
+    if(cache_) {
+        //Anything the cache can't load falls through to the usual handling below
+        try {
+            tex->set_compiled(cache_->load(filename_.encode()));
+            return;
+        } catch(std::exception& e) {
+            L_WARN("Couldn't load " + filename_.encode() + " through the texture cache: " + e.what());
+        }
+    }
+
     int width, height, channels;
     unsigned char* data = SOIL_load_image(
         filename_.encode().c_str(),
@@ -79,5 +95,14 @@ void TextureLoader::into(Loadable& resource, const LoaderOptions& options) {
     }
 }
 
+Loader::ptr TextureLoaderType::loader_for(const unicode& filename) const {
+    std::shared_ptr<TextureCache> cache;
+    if(window_) {
+        cache = window_->texture_cache();
+    }
+
+    return Loader::ptr(new TextureLoader(filename, cache));
+}
+
 }
 }
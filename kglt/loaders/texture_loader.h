@@ -4,19 +4,32 @@
 #include "../loader.h"
 
 namespace kglt {
+
+class WindowBase;
+class TextureCache;
+
 namespace loaders {
 
+/*
+ * Decodes images with SOIL. When the window has a texture cache the image is
+ * loaded through that instead, so it's only decoded the first time.
+ */
 class TextureLoader : public Loader {
 public:
-    TextureLoader(const unicode& filename):
-        Loader(filename) {}
+    TextureLoader(const unicode& filename, std::shared_ptr<TextureCache> cache=std::shared_ptr<TextureCache>()):
+        Loader(filename),
+        cache_(cache) {}
 
     void into(Loadable& resource, const LoaderOptions& options = LoaderOptions());
+
+private:
+    std::shared_ptr<TextureCache> cache_;
 };
 
 class TextureLoaderType : public LoaderType {
 public:
-    TextureLoaderType() {
+    TextureLoaderType(WindowBase* window=nullptr):
+        window_(window) {
 
     }
 
@@ -27,9 +40,10 @@ public:
         return filename.lower().contains(".tga") || filename.lower().contains(".png") || filename.lower().contains(".jpg");
     }
 
-    Loader::ptr loader_for(const unicode& filename) const {
-        return Loader::ptr(new TextureLoader(filename));
-    }
+    Loader::ptr loader_for(const unicode& filename) const;
+
+private:
+    WindowBase* window_;
 };
 
 }
@@ -1,9 +1,32 @@
 #include "interpreter.h"
 
 #include "../kglt.h"
+#include "../utils/profiler.h"
+#include "../render_stats.h"
 
 namespace kglt {
 
+//Lua gets copies of the stats in a plain table, indexed from 1 and oldest first
+static luabind::object stats_history(const RenderSequence& sequence, lua_State* state) {
+    luabind::object result = luabind::newtable(state);
+
+    int i = 1;
+    for(const RenderStats& stats: sequence.stats_history()) {
+        result[i++] = stats;
+    }
+    return result;
+}
+
+static luabind::object active_pipelines(const RenderSequence& sequence, lua_State* state) {
+    luabind::object result = luabind::newtable(state);
+
+    int i = 1;
+    for(PipelineID pipeline: sequence.active_pipelines()) {
+        result[i++] = pipeline;
+    }
+    return result;
+}
+
 void export_lua_api(lua_State* state) {
     luabind::module(state) [
         luabind::class_<StageID>("StageID")
@@ -29,6 +52,12 @@ void export_lua_api(lua_State* state) {
             .property("value", &MeshID::value)
     ];
 
+    luabind::module(state) [
+        luabind::class_<PipelineID>("PipelineID")
+            .def(luabind::constructor<int>())
+            .property("value", &PipelineID::value)
+    ];
+
     luabind::module(state) [
         luabind::class_<kmVec3>("kmVec3")
             .property("x", &Vec3::x)
@@ -119,10 +148,42 @@ void export_lua_api(lua_State* state) {
             .property("render_sequence", &Scene::render_sequence)
     ];
 
+    luabind::module(state) [
+        luabind::class_<RenderStats>("RenderStats")
+            .def_readonly("draw_calls", &RenderStats::draw_calls)
+            .def_readonly("triangles", &RenderStats::triangles)
+            .def_readonly("visible_subactors", &RenderStats::visible_subactors)
+            .def_readonly("culled_subactors", &RenderStats::culled_subactors)
+            .def_readonly("shader_binds", &RenderStats::shader_binds)
+            .def_readonly("texture_binds", &RenderStats::texture_binds)
+            .def_readonly("uniform_uploads", &RenderStats::uniform_uploads)
+            .def_readonly("buffer_bytes_uploaded", &RenderStats::buffer_bytes_uploaded)
+            .def_readonly("texture_bytes_uploaded", &RenderStats::texture_bytes_uploaded)
+            .def_readonly("buffer_stalls", &RenderStats::buffer_stalls)
+            .property("bytes_uploaded", &RenderStats::bytes_uploaded)
+    ];
+
+    luabind::module(state) [
+        luabind::class_<RenderSequence>("RenderSequence")
+            .def("set_stats_history_size", &RenderSequence::set_stats_history_size)
+            .def("pipeline_stats", &RenderSequence::pipeline_stats)
+            .def("stats_history", &stats_history)
+            .def("active_pipelines", &active_pipelines)
+            .property("frame_stats", &RenderSequence::frame_stats)
+    ];
+
     luabind::module(state) [
         luabind::class_<GeomFactory>("GeomFactory")
             .def("new_line", &GeomFactory::new_line)
     ];
+
+    luabind::module(state) [
+        luabind::class_<Profiler>("Profiler")
+            .def("dump", &Profiler::dump)
+            .def("clear", &Profiler::clear)
+            .property("enabled", &Profiler::is_enabled, &Profiler::set_enabled)
+            .property("spike_threshold", &Profiler::spike_threshold, &Profiler::set_spike_threshold)
+    ];
 }
 
 }
@@ -13,6 +13,7 @@
 #include "../camera.h"
 #include "../render_sequence.h"
 #include "../ui_stage.h"
+#include "../utils/profiler.h"
 
 #include "interpreter.h"
 #include "api.h"
@@ -69,6 +70,7 @@ Console::Console(WindowBase &window):
 
     interpreter_->add_global("window", window_);
     interpreter_->add_global("scene", window_.scene());
+    interpreter_->add_global("profiler", Profiler::get());
 
     lua_register(interpreter_->state(), "print", print);
 }
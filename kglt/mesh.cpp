@@ -44,7 +44,7 @@ void Mesh::enable_debug(bool value) {
 
         //Go through the submeshes, and for each index draw a normal line
         for(SubMeshIndex smi: submesh_ids()) {
-            for(uint16_t idx: submesh(smi).index_data().all()) {
+            for(uint32_t idx: submesh(smi).index_data().all()) {
                 kmVec3 pos1 = submesh(smi).vertex_data().position_at(idx);
                 kmVec3 n = submesh(smi).vertex_data().normal_at(idx);
                 kmVec3Scale(&n, &n, 10.0);
@@ -148,7 +148,7 @@ void SubMesh::set_material_id(MaterialID mat) {
 
 void SubMesh::transform_vertices(const kmMat4& transformation) {
     vertex_data().move_to_start();
-    for(uint16_t i = 0; i < vertex_data().count(); ++i) {
+    for(uint32_t i = 0; i < vertex_data().count(); ++i) {
         kmVec3 v = vertex_data().position_at(i);
 
         kmVec3MultiplyMat4(&v, &v, &transformation);
@@ -164,7 +164,7 @@ void SubMesh::reverse_winding() {
         throw NotImplementedError(__FILE__, __LINE__);
     }
 
-    std::vector<uint16_t> original = index_data().all();
+    std::vector<uint32_t> original = index_data().all();
 
     index_data().clear();
     for(uint32_t i = 0; i < original.size() / 3; ++i) {
@@ -193,7 +193,7 @@ void SubMesh::recalc_bounds() {
         return;
     }
 
-    for(uint16_t idx: index_data().all()) {
+    for(uint32_t idx: index_data().all()) {
         kmVec3 pos = vertex_data().position_at(idx);
         if(pos.x < bounds_.min.x) bounds_.min.x = pos.x;
         if(pos.y < bounds_.min.y) bounds_.min.y = pos.y;
@@ -205,6 +205,27 @@ void SubMesh::recalc_bounds() {
     }
 }
 
+void SubMesh::set_packed(const PackedVertices* vertices, const PackedIndices& indices, const kmAABB& bounds) {
+    vrecalc_.block();
+    irecalc_.block();
+
+    try {
+        if(!uses_shared_data_ && vertices) {
+            vertex_data_.set_packed(*vertices);
+        }
+        index_data_.set_packed(indices);
+    } catch(...) {
+        vrecalc_.unblock();
+        irecalc_.unblock();
+        throw;
+    }
+
+    vrecalc_.unblock();
+    irecalc_.unblock();
+
+    bounds_ = bounds;
+}
+
 VertexData& SubMesh::vertex_data() {
     if(uses_shared_data_) { return parent_.shared_data(); }
     return vertex_data_;
@@ -64,6 +64,13 @@ public:
 
     void recalc_bounds();
 
+    /*
+     * Loads vertices and indices from a compiled mesh (see map_kglmesh()), vertices is
+     * ignored when the submesh uses the shared data. The bounds are taken as they are,
+     * not recalculated.
+     */
+    void set_packed(const PackedVertices* vertices, const PackedIndices& indices, const kmAABB& bounds);
+
     void reverse_winding();
     void transform_vertices(const kmMat4& transformation);
     void set_texture_on_material(uint8_t unit, TextureID tex, uint8_t pass=0);
@@ -7,9 +7,19 @@
 #include "object.h"
 #include "object_visitor.h"
 #include "camera.h"
+#include "window_base.h"
+#include "utils/job_system.h"
 
 namespace kglt {
 
+namespace {
+
+//Below this many objects in a subtree, scheduling jobs costs more than it saves
+const uint32_t PARALLEL_TRANSFORM_THRESHOLD = 1024;
+const uint32_t TRANSFORM_GRAIN = 256;
+
+}
+
 uint64_t Object::object_counter = 0;
 
 Object::Object(Stage *stage):
@@ -17,12 +27,16 @@ Object::Object(Stage *stage):
     stage_(stage),
     is_visible_(true),
     rotation_locked_(false),
-    position_locked_(false) {
+    position_locked_(false),
+    absolute_transformation_dirty_(true),
+    snapshot_queued_(false),
+    move_deferred_(false) {
 
     kmVec3Fill(&position_, 0.0, 0.0, 0.0);
     kmQuaternionIdentity(&rotation_);
     kmVec3Fill(&absolute_position_, 0.0, 0.0, 0.0);
     kmQuaternionIdentity(&absolute_orientation_);
+    kmMat4Identity(&render_transformation_);
 
     update_from_parent();
 
@@ -32,6 +46,10 @@ Object::Object(Stage *stage):
 
 Object::~Object() {
     parent_changed_connection_.disconnect();
+
+    if(snapshot_queued_) {
+        stage_->cancel_snapshot(this);
+    }
 }
 
 void Object::attach_to_camera(CameraID cam) {
@@ -43,7 +61,8 @@ void Object::lock_rotation(float angle, float x, float y, float z) {
     kmVec3Fill(&axis, x, y, z);
     kmQuaternionRotationAxisAngle(&rotation_, &axis, kmDegreesToRadians(angle));
     kmQuaternionAssign(&absolute_orientation_, &rotation_);
-    transformation_changed();
+    absolute_transformation_dirty_ = true;
+    moved();
     rotation_locked_ = true;
 }
 
@@ -140,25 +159,27 @@ void Object::rotate_y(float amount) {
     update_from_parent();
 }
 
-kmMat4 Object::absolute_transformation() {
-    kmMat4 rot_matrix, trans_matrix, final;
-
-    kmMat4RotationQuaternion(&rot_matrix, &absolute_orientation_);
-    kmMat4Translation(&trans_matrix, absolute_position().x, absolute_position().y, absolute_position().z);
+const kmMat4& Object::absolute_transformation() const {
+    if(absolute_transformation_dirty_) {
+        //Translation * rotation, the translation just fills in the last column
+        kmMat4RotationQuaternion(&absolute_transformation_, &absolute_orientation_);
+        absolute_transformation_.mat[12] = absolute_position_.x;
+        absolute_transformation_.mat[13] = absolute_position_.y;
+        absolute_transformation_.mat[14] = absolute_position_.z;
+        absolute_transformation_dirty_ = false;
+    }
 
-    kmMat4Multiply(&final, &trans_matrix, &rot_matrix);
-    return final;
+    return absolute_transformation_;
 }
 
 void Object::set_position(const kmVec3& pos) {
     kmVec3Assign(&position_, &pos);
 }
 
-void Object::update_from_parent() {
+void Object::update_absolute_transformation() {
     if(!has_parent()) {
         kmVec3Assign(&absolute_position_, &position_);
         kmQuaternionAssign(&absolute_orientation_, &rotation_);
-        transformation_changed();
     } else {
         if(!position_locked_) {
             kmVec3Add(&absolute_position_, &parent().absolute_position_, &position_);
@@ -169,9 +190,85 @@ void Object::update_from_parent() {
         }
     }
 
-    transformation_changed(); //FIXME: Did it though?
+    absolute_transformation_dirty_ = true;
+}
+
+JobSystem* Object::job_system() {
+    return (stage_) ? &stage_->window().jobs() : nullptr;
+}
+
+void Object::update_from_parent() {
+    update_absolute_transformation();
+
+    if(!has_children()) {
+        moved();
+        return;
+    }
+
+    /*
+     * Gather the subtree breadth first; every object in a level only depends on
+     * its parent in the level before, so a whole level can be updated at once.
+     * levels holds where each level starts in order, plus the end of the last one.
+     */
+    std::vector<Object*> order(1, this);
+    std::vector<uint32_t> levels(1, 0);
+
+    for(uint32_t begin = 0; begin < order.size();) {
+        uint32_t end = order.size();
+        levels.push_back(end);
+
+        for(uint32_t i = begin; i < end; ++i) {
+            std::vector<Object*>& children = order[i]->children();
+            order.insert(order.end(), children.begin(), children.end());
+        }
+
+        begin = end;
+    }
+
+    JobSystem* jobs = (order.size() >= PARALLEL_TRANSFORM_THRESHOLD) ? job_system() : nullptr;
+
+    auto update_range = [&order](uint32_t first, uint32_t last) {
+        for(uint32_t i = first; i < last; ++i) {
+            order[i]->update_absolute_transformation();
+        }
+    };
+
+    for(uint32_t level = 1; level + 1 < levels.size(); ++level) {
+        if(jobs) {
+            jobs->parallel_for(levels[level], levels[level + 1], TRANSFORM_GRAIN, update_range);
+        } else {
+            update_range(levels[level], levels[level + 1]);
+        }
+    }
+
+    //Whatever listens for moves (e.g. the partitioner) isn't thread safe, so tell it afterwards
+    for(Object* object: order) {
+        object->moved();
+    }
+}
+
+void Object::moved() {
+    //During a parallel Scene::update() the stage passes the moves on once the jobs have finished
+    if(stage_ && stage_->defer_moves_) {
+        stage_->defer_move(this);
+        return;
+    }
+
+    transformation_changed();
+    queue_snapshot();
+}
+
+void Object::queue_snapshot() {
+    //Stages and cameras have no stage, the scene snapshots every camera anyway
+    if(!snapshot_queued_ && stage_) {
+        snapshot_queued_ = true;
+        stage_->queue_snapshot(this);
+    }
+}
 
-    std::for_each(children().begin(), children().end(), [](Object* x) { x->update_from_parent(); });    
+void Object::snapshot_transformation() {
+    render_transformation_ = absolute_transformation();
+    snapshot_queued_ = false;
 }
 
 void Object::destroy_children() {
@@ -21,6 +21,7 @@
 namespace kglt {
 
 class Scene;
+class JobSystem;
 
 class Object :
     public generic::TreeNode<Object>, //Objects form a tree
@@ -61,7 +62,22 @@ public:
     void lock_position(float x, float y, float z);
     void unlock_position();
 
-    kmMat4 absolute_transformation();
+    const kmMat4& absolute_transformation() const;
+
+    /*
+     * The absolute transformation as it was when the frame being drawn was prepared
+     * (see RenderSequence::prepare()). Rendering only reads these, so that objects
+     * can carry on moving while the previous frame is submitted.
+     */
+    const kmMat4& render_transformation() const { return render_transformation_; }
+    kmVec3 render_position() const {
+        kmVec3 result;
+        kmVec3Fill(&result, render_transformation_.mat[12], render_transformation_.mat[13], render_transformation_.mat[14]);
+        return result;
+    }
+
+    //Copies the current absolute transformation into render_transformation()
+    virtual void snapshot_transformation();
 
     const kmVec3& position() const { return position_; }
     const kmVec3& absolute_position() const { return absolute_position_; }
@@ -84,9 +100,17 @@ public:
     void attach_to_camera(CameraID cam);
 
 protected:
+    /*
+     * Recalculates the absolute position and orientation of this object and everything
+     * below it, then calls transformation_changed() on each of them (parents first).
+     * Large hierarchies are updated a level at a time on the stage's JobSystem.
+     */
     void update_from_parent();
     void set_position(const kmVec3& pos);
 
+    //Where update_from_parent() runs its jobs, nullptr keeps it on the calling thread
+    virtual JobSystem* job_system();
+
     kmVec3 position_;
     kmQuaternion rotation_;
 private:
@@ -99,6 +123,10 @@ private:
     kmVec3 absolute_position_;
     kmQuaternion absolute_orientation_;
 
+    //Rebuilt from the absolute position and orientation the first time it's needed after update_from_parent()
+    mutable kmMat4 absolute_transformation_;
+    mutable bool absolute_transformation_dirty_;
+
     sigc::connection parent_changed_connection_;
 
     void parent_changed_callback(Object* old_parent, Object* new_parent) {
@@ -109,7 +137,16 @@ private:
     bool rotation_locked_;
     bool position_locked_;
 
+    kmMat4 render_transformation_;
+    bool snapshot_queued_;
+    bool move_deferred_; //Guarded by the stage's deferred move lock
+
+    void update_absolute_transformation();
+    void moved();
+    void queue_snapshot();
     virtual void transformation_changed() {}
+
+    friend class Stage;
 };
 
 }
@@ -26,8 +26,27 @@ public:
     virtual void add_light(LightID obj) = 0;
     virtual void remove_light(LightID obj) = 0;
 
-    virtual std::vector<LightID> lights_within_range(const kmVec3& location) = 0;
-    virtual std::vector<std::shared_ptr<SubActor>> geometry_visible_from(CameraID camera_id) = 0;
+    /*
+     * Returns the lights that reach any part of bounds (an absolute AABB),
+     * nearest first. Directional lights are always included.
+     */
+    virtual std::vector<LightID> lights_within_range(const kmAABB& bounds) = 0;
+
+    /*
+     * Appends the subactors that are visible from the camera to results. The
+     * results vector isn't cleared, so callers can reuse the same one each frame
+     */
+    virtual void geometry_visible_from(CameraID camera_id, std::vector<SubActor*>& results) = 0;
+
+    ///The number of subactors geometry_visible_from() chooses from
+    virtual uint32_t geometry_count() = 0;
+
+    /*
+     * Called on the render thread before a frame's queries. Anything deferred or
+     * cached lazily has to be brought up to date here, so that the queries above
+     * only read and can run on several threads at once (one per camera).
+     */
+    virtual void prepare_for_queries() {}
 
 protected:
     Stage& stage() { return stage_; }
@@ -6,19 +6,17 @@
 
 namespace kglt {
 
-std::vector<LightID> NullPartitioner::lights_within_range(const kmVec3& location) {
+std::vector<LightID> NullPartitioner::lights_within_range(const kmAABB& bounds) {
     std::vector<std::pair<LightID, float> > lights_in_range;
 
-    //Find all the lights within range of the location
+    //Find all the lights within range of the bounds
     for(LightID light_id: all_lights_) {
         Light& light = stage().light(light_id);
 
-        kmVec3 diff;
-        kmVec3Subtract(&diff, &location, &light.position());
-        float dist = kmVec3Length(&diff);
-        //if(dist < light.range()) {
+        float dist = light.distance_to(bounds);
+        if(dist <= light.range()) {
             lights_in_range.push_back(std::make_pair(light_id, dist));
-        //}
+        }
     }
 
     //Sort them by distance
@@ -33,21 +31,39 @@ std::vector<LightID> NullPartitioner::lights_within_range(const kmVec3& location
     return result;
 }
 
-std::vector<SubActor::ptr> NullPartitioner::geometry_visible_from(CameraID camera_id) {
-    std::vector<SubActor::ptr> result;
+void NullPartitioner::geometry_visible_from(CameraID camera_id, std::vector<SubActor*>& results) {
+    const Frustum& frustum = stage().scene().camera(camera_id).frustum();
 
     //Just return all of the meshes in the stage
     for(ActorID eid: all_actors_) {
-        std::vector<SubActor::ptr> subactors = stage().actor(eid)._subactors();
+        Actor& actor = stage().actor(eid);
 
-        for(SubActor::ptr ent: subactors) {
-            if(stage().scene().camera(camera_id).frustum().intersects_aabb(ent->absolute_bounds())) {
-                result.push_back(ent);
+        for(uint16_t i = 0; i < actor.subactor_count(); ++i) {
+            SubActor& ent = actor.subactor(i);
+            if(frustum.intersects_aabb(ent.absolute_bounds())) {
+                results.push_back(&ent);
             }
         }
     }
+}
 
-    return result;
+void NullPartitioner::prepare_for_queries() {
+    //Subactor bounds are recalculated the first time they're read after a move
+    for(ActorID eid: all_actors_) {
+        Actor& actor = stage().actor(eid);
+
+        for(uint16_t i = 0; i < actor.subactor_count(); ++i) {
+            actor.subactor(i).absolute_bounds();
+        }
+    }
+}
+
+uint32_t NullPartitioner::geometry_count() {
+    uint32_t count = 0;
+    for(ActorID eid: all_actors_) {
+        count += stage().actor(eid).subactor_count();
+    }
+    return count;
 }
 
 }
@@ -28,8 +28,11 @@ public:
         all_lights_.erase(obj);
     }
 
-    std::vector<LightID> lights_within_range(const kmVec3& location);
-    std::vector<std::shared_ptr<SubActor>> geometry_visible_from(CameraID camera_id);
+    std::vector<LightID> lights_within_range(const kmAABB& bounds);
+    void geometry_visible_from(CameraID camera_id, std::vector<SubActor*>& results);
+    uint32_t geometry_count();
+
+    void prepare_for_queries();
 
 private:
     std::set<ActorID> all_actors_;
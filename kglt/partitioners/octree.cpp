@@ -8,16 +8,38 @@
 
 namespace kglt {
 
-Octree::Octree() {
+static float max_dimension(const kmAABB& bounds) {
+    return std::max(
+        kmAABBDiameterX(&bounds),
+        std::max(kmAABBDiameterY(&bounds), kmAABBDiameterZ(&bounds))
+    );
+}
+
+/*
+ * Which child contains a point on the positive (or negative) side of the
+ * centre on each axis
+ */
+static OctreePosition position_for(bool posx, bool posy, bool posz) {
+    static const OctreePosition positions[2][2][2] = {
+        { { NEGX_NEGY_NEGZ, NEGX_NEGY_POSZ }, { NEGX_POSY_NEGZ, NEGX_POSY_POSZ } },
+        { { POSX_NEGY_NEGZ, POSX_NEGY_POSZ }, { POSX_POSY_NEGZ, POSX_POSY_POSZ } }
+    };
+
+    return positions[posx][posy][posz];
+}
+
+Octree::Octree():
+    root_(OCTREE_NO_NODE) {
 
 }
 
 OctreeNode& Octree::find(const Boundable* object) {
-    if(!container::contains(object_node_lookup_, object)) {
+    auto it = object_node_lookup_.find(object);
+    if(it == object_node_lookup_.end()) {
         throw std::logic_error("Object does not exist in the tree");
     }
 
-    return *container::const_get(object_node_lookup_, object);
+    return nodes_[(*it).second.node];
 }
 
 void visible_node_finder(OctreeNode* self, std::vector<OctreeNode*>& result, const Frustum& frustum) {
@@ -44,41 +66,263 @@ std::vector<OctreeNode*> Octree::nodes_visible_from(const Frustum& frustum) {
     return result;
 }
 
+void Octree::collect_visible_nodes(OctreeNodeIndex index, const Frustum& frustum, FrustumClassification parent, std::vector<VisibleNode>& out) const {
+    const OctreeNode& node = nodes_[index];
+
+    FrustumClassification classification = parent;
+    if(classification != FRUSTUM_CONTAINS_ALL) {
+        classification = frustum.classify_aabb(node.absolute_loose_bounds());
+        if(classification == FRUSTUM_CONTAINS_NONE) {
+            return;
+        }
+    }
+
+    VisibleNode visible = { index, classification };
+    out.push_back(visible);
+
+    for(uint8_t i = 0; i < 8; ++i) {
+        if(node.children_[i] != OCTREE_NO_NODE) {
+            collect_visible_nodes(node.children_[i], frustum, classification, out);
+        }
+    }
+}
+
+OctreeNodeIndex Octree::new_node(OctreeNodeIndex parent, float strict_diameter, const kmVec3& centre) {
+    if(!free_nodes_.empty()) {
+        OctreeNodeIndex index = free_nodes_.back();
+        free_nodes_.pop_back();
+        nodes_[index] = OctreeNode(this, parent, strict_diameter, centre);
+        return index;
+    }
+
+    nodes_.push_back(OctreeNode(this, parent, strict_diameter, centre));
+    return nodes_.size() - 1;
+}
+
+void Octree::release_node(OctreeNodeIndex index) {
+    OctreeNode& node = nodes_[index];
+
+    assert(!node.has_objects());
+    assert(!node.child_count());
+
+    node.objects_.clear();
+    node.object_bounds_.clear();
+    free_nodes_.push_back(index);
+}
+
+void Octree::add_object(OctreeNodeIndex index, const Boundable* object, const kmAABB& bounds) {
+    OctreeNode& node = nodes_[index];
+
+    ObjectLocation location = { index, (uint32_t) node.objects_.size() };
+    node.objects_.push_back(object);
+    node.object_bounds_.push_back(bounds);
+
+    object_node_lookup_[object] = location;
+}
+
+void Octree::remove_object(const ObjectLocation& location) {
+    OctreeNode& node = nodes_[location.node];
+
+    //Fill the gap with the last object, and update where that object lives
+    const uint32_t last = node.objects_.size() - 1;
+    if(location.slot != last) {
+        const Boundable* moved = node.objects_[last];
+        node.objects_[location.slot] = moved;
+        object_node_lookup_[moved].slot = location.slot;
+    }
+
+    node.objects_.pop_back();
+    node.object_bounds_.swap_and_pop(location.slot);
+}
+
 void Octree::shrink(const Boundable* object) {
     assert(object);
 
-    if(!container::contains(this->object_node_lookup_, object)) {
+    auto it = object_node_lookup_.find(object);
+    if(it == object_node_lookup_.end()) {
         throw std::logic_error("Tried to remove an object that doesn't exist in the tree");
     }
 
-    OctreeNode& node = *container::const_get(this->object_node_lookup_, object);
-    node.remove_object(object);
+    ObjectLocation location = (*it).second;
+    object_node_lookup_.erase(it);
+
+    remove_object(location);
+    prune(location.node);
+}
+
+/**
+ * @brief Octree::prune
+ * @param index - A node which may have just become empty
+ *
+ * Deletes the node, and then any ancestors, for as long as they have no objects
+ * and no children. Afterwards, while the root has no objects and a single child, that
+ * child becomes the new root, so a tree that has followed objects across space sheds
+ * the nodes it left behind.
+ */
+void Octree::prune(OctreeNodeIndex index) {
+    while(index != OCTREE_NO_NODE) {
+        OctreeNode& node = nodes_[index];
+        if(node.is_root() || node.has_objects() || node.child_count()) {
+            break;
+        }
+
+        OctreeNodeIndex parent_index = node.parent_;
+        OctreeNode& parent = nodes_[parent_index];
+        for(uint8_t i = 0; i < 8; ++i) {
+            if(parent.children_[i] == index) {
+                parent.children_[i] = OCTREE_NO_NODE;
+                --parent.child_count_;
+                break;
+            }
+        }
+
+        release_node(index);
+        index = parent_index;
+    }
+
+    if(root_ == OCTREE_NO_NODE) {
+        return;
+    }
+
+    while(!nodes_[root_].has_objects() && nodes_[root_].child_count() == 1) {
+        OctreeNode& old_root = nodes_[root_];
+
+        OctreeNodeIndex new_root = OCTREE_NO_NODE;
+        for(uint8_t i = 0; i < 8; ++i) {
+            if(old_root.children_[i] != OCTREE_NO_NODE) {
+                new_root = old_root.children_[i];
+                old_root.children_[i] = OCTREE_NO_NODE;
+            }
+        }
+        old_root.child_count_ = 0;
+
+        release_node(root_);
+        nodes_[new_root].parent_ = OCTREE_NO_NODE;
+        root_ = new_root;
+    }
+
+    if(!nodes_[root_].has_objects() && !nodes_[root_].child_count()) {
+        release_node(root_);
+        root_ = OCTREE_NO_NODE;
+    }
+}
+
+/**
+ * @brief Octree::relocate
+ * @param object - An object in the tree whose bounds have changed
+ *
+ * If the object still belongs in the same node then only its cached bounds are updated.
+ * Otherwise it is removed, and we walk up from its old node only as far as the first
+ * ancestor that can hold it, and insert it into that subtree. If no ancestor can, the tree
+ * grows upwards as it would in grow(). The old node is pruned if it was left empty.
+ * An object whose bounds have collapsed to nothing is removed, as grow() wouldn't add it.
+ */
+void Octree::relocate(const Boundable* object) {
+    assert(object);
+
+    auto it = object_node_lookup_.find(object);
+    if(it == object_node_lookup_.end()) {
+        //Objects with no volume are never added, see grow()
+        grow(object);
+        return;
+    }
+
+    ObjectLocation location = (*it).second;
+
+    kmAABB bounds = object->absolute_bounds();
+    kmVec3 centre = object->centre();
+    float diameter = max_dimension(bounds);
+
+    if(diameter < kmEpsilon) {
+        //Like grow(), the tree doesn't keep objects with no volume (it'd keep halving to hold them)
+        L_DEBUG("Removing object from the octree because it has no volume");
+        object_node_lookup_.erase(it);
+        remove_object(location);
+        prune(location.node);
+        return;
+    }
+
+    //Nothing to do if it still fits, and wouldn't fit in a child
+    OctreeNode& node = nodes_[location.node];
+    if(node.can_hold(centre, diameter) && diameter >= node.strict_diameter() / 2) {
+        node.object_bounds_.set(location.slot, bounds);
+        return;
+    }
+
+    remove_object(location);
+
+    OctreeNodeIndex target = location.node;
+    while(target != OCTREE_NO_NODE && !nodes_[target].can_hold(centre, diameter)) {
+        target = nodes_[target].parent_;
+    }
+
+    if(target != OCTREE_NO_NODE) {
+        insert_into_subtree(target, object, bounds, diameter);
+    } else {
+        object_node_lookup_.erase(object);
+        grow(object);
+    }
+
+    prune(location.node);
+}
+
+uint32_t Octree::node_count() const {
+    return nodes_.size() - free_nodes_.size();
+}
+
+OctreeNode& OctreeNode::child(OctreePosition pos) {
+    if(!has_child(pos)) {
+        throw std::logic_error("Attempted to get a child node that doesn't exist");
+    }
+    return tree_->nodes_[children_[pos]];
+}
+
+const OctreeNode& OctreeNode::child(OctreePosition pos) const {
+    if(!has_child(pos)) {
+        throw std::logic_error("Attempted to get a child node that doesn't exist");
+    }
+    return tree_->nodes_[children_[pos]];
+}
+
+uint32_t OctreeNode::node_count() const {
+    uint32_t count = 1;
+    for(uint8_t i = 0; i < 8; ++i) {
+        if(has_child((OctreePosition) i)) {
+            count += child((OctreePosition) i).node_count();
+        }
+    }
+    return count;
+}
 
-    if(!node.has_objects() && !node.child_count()) {
-        L_WARN("FIXME: Node should be deleted but this is not yet implemented");
+uint32_t OctreeNode::object_count() const {
+    uint32_t count = objects_.size();
+    for(uint8_t i = 0; i < 8; ++i) {
+        if(has_child((OctreePosition) i)) {
+            count += child((OctreePosition) i).object_count();
+        }
     }
+    return count;
+}
 
-    _unregister_object(object);
+bool OctreeNode::can_hold(const kmVec3& centre, float diameter) const {
+    //Objects belong to the node whose strict bounds contain their centre, the
+    //loose bounds (twice the size) then contain the whole object
+    kmVec3 c = centre;
+    return diameter <= strict_diameter() && kmAABBContainsPoint(&strict_bounds_, &c);
 }
 
 void Octree::grow(const Boundable *object) {
     assert(object);
 
     kmAABB obj_bounds = object->absolute_bounds();
-    float obj_diameter = std::max(
-        kmAABBDiameterX(&obj_bounds),
-        std::max(
-            kmAABBDiameterY(&obj_bounds),
-            kmAABBDiameterZ(&obj_bounds)
-        )
-    );
+    float obj_diameter = max_dimension(obj_bounds);
 
     if(obj_diameter < kmEpsilon) {
         L_DEBUG("Not adding object to the octree because it has no volume");
         return;
     }
 
-    if(!root_) {
+    if(root_ == OCTREE_NO_NODE) {
         L_DEBUG("Creating root node");
         /*
          *  We don't have a root node yet, so create one centred around
@@ -86,11 +330,7 @@ void Octree::grow(const Boundable *object) {
          */
         float node_size = obj_diameter;
 
-        root_.reset(new OctreeNode(
-            nullptr,
-            node_size,
-            object->centre()
-        ));
+        root_ = new_node(OCTREE_NO_NODE, node_size, object->centre());
 
         L_DEBUG("Root node created with strict width of: " + boost::lexical_cast<std::string>(node_size));
     }
@@ -108,62 +348,36 @@ void Octree::grow(const Boundable *object) {
          * 4. Make the new node the root
          */
 
-        kmVec3 new_centre, obj_centre;
+        kmVec3 new_centre, obj_centre, old_centre;
         kmAABBCentre(&obj_bounds, &obj_centre);
-        kmVec3Assign(&new_centre, &root().centre());
+        kmVec3Assign(&old_centre, &root().centre());
+        kmVec3Assign(&new_centre, &old_centre);
         float half_current = root().strict_diameter() / 2;
-        new_centre.x += (obj_centre.x < root().centre().x) ? -half_current : half_current;
-        new_centre.y += (obj_centre.y < root().centre().y) ? -half_current : half_current;
-        new_centre.z += (obj_centre.z < root().centre().z) ? -half_current : half_current;
-
-        OctreeNode::ptr new_root(new OctreeNode(nullptr, root().strict_diameter() * 2, new_centre));
-
+        new_centre.x += (obj_centre.x < old_centre.x) ? -half_current : half_current;
+        new_centre.y += (obj_centre.y < old_centre.y) ? -half_current : half_current;
+        new_centre.z += (obj_centre.z < old_centre.z) ? -half_current : half_current;
 
         /*
-         * Which child of the new root is the current root
-         * to become?
+         * The current root becomes the child on the opposite side of the new
+         * centre to the object
          */
-        OctreePosition root_to_become_child;
-
-        if(new_centre.x < root().centre().x) {
-            if(new_centre.y < root().centre().y) {
-                if(new_centre.z < root().centre().z) {
-                    root_to_become_child = POSX_POSY_POSZ;
-                } else {
-                    root_to_become_child = POSX_POSY_NEGZ;
-                }
-            } else {
-                if(new_centre.z < root().centre().z) {
-                    root_to_become_child = POSX_NEGY_POSZ;
-                } else {
-                    root_to_become_child = POSX_NEGY_NEGZ;
-                }
-            }
-        } else {
-            if(new_centre.y < root().centre().y) {
-                if(new_centre.z < root().centre().z) {
-                    root_to_become_child = NEGX_POSY_POSZ;
-                } else {
-                    root_to_become_child = NEGX_POSY_NEGZ;
-                }
-            } else {
-                if(new_centre.z < root().centre().z) {
-                    root_to_become_child = NEGX_NEGY_POSZ;
-                } else {
-                    root_to_become_child = NEGX_NEGY_NEGZ;
-                }
-            }
-        }
+        OctreePosition root_to_become_child = position_for(
+            new_centre.x < old_centre.x,
+            new_centre.y < old_centre.y,
+            new_centre.z < old_centre.z
+        );
 
-        OctreeNode::ptr old_root = root_;
+        OctreeNodeIndex old_root = root_;
+        OctreeNodeIndex new_root = new_node(OCTREE_NO_NODE, root().strict_diameter() * 2, new_centre);
 
-        new_root->children_[root_to_become_child] = old_root;
-        old_root->parent_ = new_root.get();
+        nodes_[new_root].children_[root_to_become_child] = old_root;
+        nodes_[new_root].child_count_ = 1;
+        nodes_[old_root].parent_ = new_root;
         root_ = new_root;
     }
 
     //Now insert into the subtree
-    this->_register_object(&root().insert_into_subtree(object), object);
+    insert_into_subtree(root_, object, obj_bounds, obj_diameter);
 }
 
 kmAABB OctreeNode::calculate_child_bounds(OctreePosition pos, float child_width) {
@@ -291,20 +505,6 @@ kmAABB OctreeNode::calculate_child_bounds(OctreePosition pos, float child_width)
     return result;
 }
 
-OctreeNode& OctreeNode::create_child(OctreePosition pos) {
-    if(has_child(pos)) {
-        return child(pos);
-    }
-
-    kmAABB bounds = calculate_child_strict_bounds(pos);
-    kmVec3 centre;
-    kmAABBCentre(&bounds, &centre);
-
-    children_[pos].reset(new OctreeNode(this, kmAABBDiameterX(&bounds), centre));
-
-    return *children_[pos];
-}
-
 kmAABB OctreeNode::calculate_child_loose_bounds(OctreePosition pos) {
     return calculate_child_bounds(pos, this->strict_diameter());
 }
@@ -314,51 +514,54 @@ kmAABB OctreeNode::calculate_child_strict_bounds(OctreePosition pos) {
 }
 
 /**
- * @brief OctreeNode::insert_into_subtree
- * @param obj - The object to insert
- * @return The final OctreeNode that the object was inserted into
+ * @brief Octree::insert_into_subtree
+ * @param index - The node to start from, it must be able to hold the object
+ * @param object - The object to insert
+ * @param bounds - The object's absolute bounds
+ * @param diameter - The largest dimension of bounds
+ * @return The final node that the object was inserted into
  *
- * This method recursively searches down the tree to find the lowest
- * node that can fit the object. If the object doesn't fit inside any
- * nodes then an ObjectDoesNotFitError() is thrown.
+ * Descends into (creating where necessary) the child containing the object's centre
+ * for as long as the object would fit in it.
  */
-OctreeNode& OctreeNode::insert_into_subtree(const Boundable* obj) {
-    kmAABB obj_bounds = obj->absolute_bounds();
-
-    float obj_diameter = std::max(
-        kmAABBDiameterX(&obj_bounds),
-        std::max(
-            kmAABBDiameterY(&obj_bounds),
-            kmAABBDiameterZ(&obj_bounds)
-        )
-    );
+OctreeNodeIndex Octree::insert_into_subtree(OctreeNodeIndex index, const Boundable* object, const kmAABB& bounds, float diameter) {
+    kmVec3 centre = object->centre();
 
-    if(obj_diameter < this->strict_diameter() / 2) {
+    while(diameter < nodes_[index].strict_diameter() / 2) {
         //Object will fit into child
-        L_DEBUG("Object will fit into child, traversing next level");
-        for(uint8_t i = 0; i < 8; ++i) {
-            kmAABB bounds = calculate_child_strict_bounds((OctreePosition)i);
-            kmVec3 centre = obj->centre();
-            if(kmAABBContainsPoint(&bounds, &centre)) {
-                OctreeNode& child = create_child((OctreePosition) i);
-                return child.insert_into_subtree(obj);
-            }
-        }
+        OctreeNode& node = nodes_[index];
+        OctreePosition pos = position_for(
+            centre.x >= node.centre().x,
+            centre.y >= node.centre().y,
+            centre.z >= node.centre().z
+        );
 
-        throw std::logic_error("Something went wrong while adding the object to the Octree");
-    } else {
-        L_DEBUG("Destination node for object found");
+        if(!node.has_child(pos)) {
+            kmAABB child_bounds = node.calculate_child_strict_bounds(pos);
+            kmVec3 child_centre;
+            kmAABBCentre(&child_bounds, &child_centre);
 
-        //Add to this node
-        this->add_object(obj);
-        return *this;
+            //This may reallocate the pool, so node can't be used afterwards
+            OctreeNodeIndex child = new_node(index, kmAABBDiameterX(&child_bounds), child_centre);
+            nodes_[index].children_[pos] = child;
+            nodes_[index].child_count_++;
+        }
+
+        index = nodes_[index].children_[pos];
     }
+
+    add_object(index, object, bounds);
+    return index;
 }
 
-OctreeNode::OctreeNode(OctreeNode* parent, float strict_diameter, const kmVec3& centre):
+OctreeNode::OctreeNode(Octree* tree, OctreeNodeIndex parent, float strict_diameter, const kmVec3& centre):
+    tree_(tree),
     parent_(parent),
+    child_count_(0),
     centre_(centre) {
 
+    std::fill(children_, children_ + 8, OCTREE_NO_NODE);
+
     kmAABBInitialize(&strict_bounds_, &centre_, strict_diameter, strict_diameter, strict_diameter);
     kmAABBInitialize(&loose_bounds_, &centre_, strict_diameter * 2, strict_diameter * 2, strict_diameter * 2);
 }
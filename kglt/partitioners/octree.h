@@ -1,16 +1,18 @@
 #ifndef OCTREE_H
 #define OCTREE_H
 
-#include <set>
-#include <map>
+#include <algorithm>
+#include <unordered_map>
 #include <stdexcept>
 #include <vector>
 #include <tr1/memory>
 #include <kazmath/kazmath.h>
 
-#include "../generic/managed.h"
 #include "../boundable.h"
+#include "../frustum.h"
 #include "../types.h"
+#include "../utils/aabb_list.h"
+#include "../utils/job_system.h"
 
 #include "kglt/kazbase/list_utils.h"
 /*
@@ -68,32 +70,34 @@ public:
 
 class Octree;
 
-class OctreeNode :
-    public Managed<OctreeNode> {
+typedef uint32_t OctreeNodeIndex;
+const OctreeNodeIndex OCTREE_NO_NODE = 0xFFFFFFFF;
 
+/*
+ * Nodes live in a single pool owned by the Octree and refer to each other by
+ * index. References to a node are only valid until the tree is next modified.
+ */
+class OctreeNode {
 public:
-    OctreeNode(OctreeNode* parent, float strict_diameter, const kmVec3 &centre);
+    OctreeNode(Octree* tree, OctreeNodeIndex parent, float strict_diameter, const kmVec3 &centre);
 
     const kmVec3& centre() const {
         return centre_;
     }
 
-    float width() const;
-    float loose_width() const;
+    uint8_t child_count() const { return child_count_; }
+    uint32_t object_count() const; ///< The number of objects in this node and all of its descendents
+    uint32_t node_count() const; ///< This node plus all of its descendents
 
-    uint8_t child_count() const { return children_.size(); }
-    uint32_t object_count() const;
-
-    OctreeNode& child(OctreePosition pos) {
-        return *container::const_get(children_, pos);
-    }
+    OctreeNode& child(OctreePosition pos);
+    const OctreeNode& child(OctreePosition pos) const;
 
     bool has_child(OctreePosition pos) const {
-        return container::contains(children_, pos);
+        return children_[pos] != OCTREE_NO_NODE;
     }
     bool has_objects() const { return !objects_.empty(); }
 
-    bool is_root() const { return !parent_; }
+    bool is_root() const { return parent_ == OCTREE_NO_NODE; }
 
     const kmAABB& absolute_loose_bounds() const { return loose_bounds_; }
     const kmAABB& absolute_strict_bounds() const { return strict_bounds_; }
@@ -107,27 +111,26 @@ public:
         return kmAABBDiameterX(&strict_bounds_);
     }
 
-    const std::set<const Boundable*>& objects() const { return objects_; }
+    const std::vector<const Boundable*>& objects() const { return objects_; }
 private:
-    OctreeNode* parent_;
-    std::map<OctreePosition, std::shared_ptr<OctreeNode> > children_;
-    std::set<const Boundable*> objects_;
+    Octree* tree_;
+    OctreeNodeIndex parent_;
+    OctreeNodeIndex children_[8];
+    uint8_t child_count_;
+
+    /*
+     * objects_[i] has the bounds object_bounds_[i]. The bounds are a copy taken
+     * when the object was inserted or relocated, so that culling never needs to
+     * call back into the object.
+     */
+    std::vector<const Boundable*> objects_;
+    AABBList object_bounds_;
 
     kmAABB strict_bounds_;
     kmAABB loose_bounds_;
     kmVec3 centre_;
 
-    OctreeNode& create_child(OctreePosition pos);
-
-    OctreeNode& insert_into_subtree(const Boundable* obj);
-
-    void add_object(const Boundable* obj) {
-        objects_.insert(obj);
-    }
-
-    void remove_object(const Boundable* obj) {
-        objects_.erase(obj);
-    }
+    bool can_hold(const kmVec3& centre, float diameter) const;
 
     kmAABB calculate_child_loose_bounds(OctreePosition pos);
     kmAABB calculate_child_strict_bounds(OctreePosition pos);
@@ -155,22 +158,30 @@ private:
  *   large, and then as child nodes empty shift in the direction of the fleet.
  * * If a node has no objects, and no children, it is removed. If the root node has no objects and only
  *   one child, then the child becomes the new root.
+ * * The bounds of each object are cached in its node, an object that moves or changes size must be
+ *   passed to relocate() before the next query.
+ * * All nodes are stored in one contiguous pool, and removed nodes are recycled by later insertions.
  */
 
 class Octree {
 public:
     Octree();
 
+    Octree(const Octree&) = delete;
+    Octree& operator=(const Octree&) = delete;
+
     OctreeNode& root() {
-        if(!root_) {
+        if(root_ == OCTREE_NO_NODE) {
             throw std::logic_error("Octree has not been initialized");
         }
-        return *root_;
+        return nodes_[root_];
     }
 
     uint32_t node_count() const;
+    uint32_t object_count() const { return object_node_lookup_.size(); }
 
-    bool has_root() const { return root_ != nullptr; }
+    bool has_root() const { return root_ != OCTREE_NO_NODE; }
+    bool contains(const Boundable* object) const { return object_node_lookup_.count(object); }
 
     void grow(const Boundable* object);
     void shrink(const Boundable* object);
@@ -180,22 +191,199 @@ public:
 
     std::vector<OctreeNode*> nodes_visible_from(const Frustum& frustum);
 
+    /**
+     * @brief each_object_visible_from
+     * @param frustum - The frustum to cull against
+     * @param callback - Called with each const Boundable* that intersects the frustum
+     *
+     * Hierarchical culling. A node whose loose bounds are outside the frustum is skipped
+     * along with its whole subtree, and once a node is entirely inside, neither it nor any
+     * of its descendants (or their objects) are tested again. Objects in partially
+     * contained nodes are tested four at a time against their cached bounds.
+     */
+    template<typename Callback>
+    void each_object_visible_from(const Frustum& frustum, Callback callback) {
+        if(root_ == OCTREE_NO_NODE) {
+            return;
+        }
+
+        visit_visible(root_, frustum, FRUSTUM_CONTAINS_PARTIAL, callback);
+    }
+
+    /**
+     * @brief objects_visible_from
+     * @param frustum - The frustum to cull against
+     * @param jobs - Where to run the object tests
+     * @param results - Each visible object is appended as convert(const Boundable*)
+     * @param convert - Called from any of the job system's threads
+     *
+     * The same culling and the same order as each_object_visible_from, but only the
+     * node tests happen on the calling thread. The objects of the visible nodes are
+     * then tested in parallel, each node writing into its own part of results.
+     */
+    template<typename T, typename Convert>
+    void objects_visible_from(const Frustum& frustum, JobSystem& jobs, std::vector<T>& results, Convert convert) {
+        if(root_ == OCTREE_NO_NODE) {
+            return;
+        }
+
+        //Local rather than a member so that several cameras can query at once
+        std::vector<VisibleNode> visible_nodes;
+        collect_visible_nodes(root_, frustum, FRUSTUM_CONTAINS_PARTIAL, visible_nodes);
+
+        const uint32_t node_count = visible_nodes.size();
+
+        //Room for every object in every visible node, so each node knows where to write
+        ScratchArena& scratch = jobs.scratch();
+        uint32_t* offsets = scratch.allocate_array<uint32_t>(node_count);
+        uint32_t* counts = scratch.allocate_array<uint32_t>(node_count);
+
+        const uint32_t base = results.size();
+        uint32_t total = 0;
+        for(uint32_t i = 0; i < node_count; ++i) {
+            offsets[i] = base + total;
+            total += nodes_[visible_nodes[i].index].objects_.size();
+        }
+
+        results.resize(base + total);
+
+        jobs.parallel_for(0, node_count, CULL_GRAIN, [&](uint32_t first, uint32_t last) {
+            for(uint32_t i = first; i < last; ++i) {
+                const VisibleNode& visible = visible_nodes[i];
+                T* out = results.data() + offsets[i];
+                uint32_t count = 0;
+
+                visit_node_objects(nodes_[visible.index], frustum, visible.classification, [&](const Boundable* obj) {
+                    out[count++] = convert(obj);
+                });
+
+                counts[i] = count;
+            }
+        });
+
+        //Close the gaps left by culled objects, everything only ever moves towards the front
+        uint32_t write = base;
+        for(uint32_t i = 0; i < node_count; ++i) {
+            if(write != offsets[i]) {
+                std::copy(results.begin() + offsets[i], results.begin() + offsets[i] + counts[i], results.begin() + write);
+            }
+            write += counts[i];
+        }
+
+        results.resize(write);
+    }
+
+    /**
+     * @brief each_object_intersecting
+     * @param box - An absolute bounding box
+     * @param callback - Called with each const Boundable* whose bounds overlap box
+     */
+    template<typename Callback>
+    void each_object_intersecting(const kmAABB& box, Callback callback) {
+        if(root_ == OCTREE_NO_NODE) {
+            return;
+        }
+
+        visit_intersecting(root_, box, callback);
+    }
+
 private:
-    OctreeNode::ptr root_;
-    uint32_t node_count_;
+    static bool overlaps(const kmAABB& lhs, const kmAABB& rhs) {
+        return lhs.min.x <= rhs.max.x && lhs.max.x >= rhs.min.x &&
+               lhs.min.y <= rhs.max.y && lhs.max.y >= rhs.min.y &&
+               lhs.min.z <= rhs.max.z && lhs.max.z >= rhs.min.z;
+    }
 
-    void _increment_node_count();
-    void _decrement_node_count();
+    template<typename Callback>
+    void visit_intersecting(OctreeNodeIndex index, const kmAABB& box, Callback& callback) {
+        const OctreeNode& node = nodes_[index];
 
-    void _register_object(OctreeNode* node, const Boundable* obj) {
-        object_node_lookup_[obj] = node;
+        if(!overlaps(node.absolute_loose_bounds(), box)) {
+            return;
+        }
+
+        for(uint32_t i = 0; i < node.objects_.size(); ++i) {
+            if(overlaps(node.object_bounds_.get(i), box)) {
+                callback(node.objects_[i]);
+            }
+        }
+
+        for(uint8_t i = 0; i < 8; ++i) {
+            if(node.children_[i] != OCTREE_NO_NODE) {
+                visit_intersecting(node.children_[i], box, callback);
+            }
+        }
     }
 
-    void _unregister_object(const Boundable* obj) {
-        object_node_lookup_.erase(obj);
+    template<typename Callback>
+    void visit_visible(OctreeNodeIndex index, const Frustum& frustum, FrustumClassification parent, Callback& callback) {
+        const OctreeNode& node = nodes_[index];
+
+        FrustumClassification classification = parent;
+        if(classification != FRUSTUM_CONTAINS_ALL) {
+            classification = frustum.classify_aabb(node.absolute_loose_bounds());
+            if(classification == FRUSTUM_CONTAINS_NONE) {
+                return;
+            }
+        }
+
+        visit_node_objects(node, frustum, classification, callback);
+
+        for(uint8_t i = 0; i < 8; ++i) {
+            if(node.children_[i] != OCTREE_NO_NODE) {
+                visit_visible(node.children_[i], frustum, classification, callback);
+            }
+        }
+    }
+
+    template<typename Callback>
+    void visit_node_objects(const OctreeNode& node, const Frustum& frustum, FrustumClassification classification, Callback& callback) {
+        if(classification == FRUSTUM_CONTAINS_ALL) {
+            for(const Boundable* obj: node.objects_) {
+                callback(obj);
+            }
+        } else {
+            const uint32_t groups = node.object_bounds_.group_count();
+            for(uint32_t group = 0; group < groups; ++group) {
+                uint32_t mask = frustum.intersects_aabbs(node.object_bounds_, group);
+                for(uint32_t lane = 0; mask; ++lane, mask >>= 1) {
+                    if(mask & 1) {
+                        callback(node.objects_[(group * AABBList::GROUP_SIZE) + lane]);
+                    }
+                }
+            }
+        }
     }
 
-    std::map<const Boundable*, OctreeNode*> object_node_lookup_;
+    //Nodes per job when objects_visible_from tests their objects
+    static const uint32_t CULL_GRAIN = 8;
+
+    struct VisibleNode {
+        OctreeNodeIndex index;
+        FrustumClassification classification;
+    };
+
+    void collect_visible_nodes(OctreeNodeIndex index, const Frustum& frustum, FrustumClassification parent, std::vector<VisibleNode>& out) const;
+
+    struct ObjectLocation {
+        OctreeNodeIndex node;
+        uint32_t slot; ///< Index into the node's objects_ and object_bounds_
+    };
+
+    std::vector<OctreeNode> nodes_;
+    std::vector<OctreeNodeIndex> free_nodes_;
+    OctreeNodeIndex root_;
+
+    std::unordered_map<const Boundable*, ObjectLocation> object_node_lookup_;
+
+    OctreeNodeIndex new_node(OctreeNodeIndex parent, float strict_diameter, const kmVec3& centre);
+    void release_node(OctreeNodeIndex index);
+
+    OctreeNodeIndex insert_into_subtree(OctreeNodeIndex index, const Boundable* object, const kmAABB& bounds, float diameter);
+    void add_object(OctreeNodeIndex index, const Boundable* object, const kmAABB& bounds);
+    void remove_object(const ObjectLocation& location);
+
+    void prune(OctreeNodeIndex index);
 
     friend class OctreeNode;
 };
@@ -1,18 +1,57 @@
+#include <algorithm>
+
 #include "octree_partitioner.h"
 
 #include "../stage.h"
 #include "../light.h"
 #include "../actor.h"
 #include "../camera.h"
+#include "../window_base.h"
 
 namespace kglt {
 
+//Below this many objects a single thread culls faster than it can hand out the work
+const uint32_t PARALLEL_CULL_THRESHOLD = 4096;
+
 void OctreePartitioner::event_actor_changed(ActorID ent) {
     L_DEBUG("Actor changed, updating partitioner");
     remove_actor(ent);
     add_actor(ent);
 }
 
+void OctreePartitioner::event_actor_moved(ActorID ent) {
+    if(!pending_relocations_.empty() && pending_relocations_.back() == ent) {
+        return;
+    }
+
+    pending_relocations_.push_back(ent);
+}
+
+void OctreePartitioner::flush_pending_relocations() {
+    if(pending_relocations_.empty()) {
+        return;
+    }
+
+    std::sort(pending_relocations_.begin(), pending_relocations_.end());
+    pending_relocations_.erase(
+        std::unique(pending_relocations_.begin(), pending_relocations_.end()),
+        pending_relocations_.end()
+    );
+
+    for(ActorID actor_id: pending_relocations_) {
+        auto it = actor_to_registered_subactors_.find(actor_id);
+        if(it == actor_to_registered_subactors_.end()) {
+            continue;
+        }
+
+        for(Boundable* boundable: (*it).second) {
+            tree_.relocate(boundable);
+        }
+    }
+
+    pending_relocations_.clear();
+}
+
 void OctreePartitioner::add_actor(ActorID obj) {
     L_DEBUG("Adding actor to the partitioner");
 
@@ -23,11 +62,11 @@ void OctreePartitioner::add_actor(ActorID obj) {
         tree_.grow(boundable);
 
         actor_to_registered_subactors_[obj].push_back(boundable);
-        boundable_to_subactor_[boundable] = ent._subactors().at(i);
     }
 
     //Connect the changed signal
     actor_changed_connections_[obj] = ent.signal_mesh_changed().connect(sigc::mem_fun(this, &OctreePartitioner::event_actor_changed));
+    actor_moved_connections_[obj] = ent.signal_transformation_changed().connect(sigc::mem_fun(this, &OctreePartitioner::event_actor_moved));
 }
 
 void OctreePartitioner::remove_actor(ActorID obj) {
@@ -35,8 +74,10 @@ void OctreePartitioner::remove_actor(ActorID obj) {
 
     //Remove all boundable subactors that were linked to the actor
     for(Boundable* boundable: actor_to_registered_subactors_[obj]) {
-        tree_.shrink(boundable);
-        boundable_to_subactor_.erase(boundable);
+        //Subactors with no volume aren't in the tree
+        if(tree_.contains(boundable)) {
+            tree_.shrink(boundable);
+        }
     }
 
     //Erase the list of subactors linked to this actor
@@ -45,67 +86,147 @@ void OctreePartitioner::remove_actor(ActorID obj) {
     //Disconnect the changed signal
     actor_changed_connections_[obj].disconnect();
     actor_changed_connections_.erase(obj);
+
+    actor_moved_connections_[obj].disconnect();
+    actor_moved_connections_.erase(obj);
+
+    pending_relocations_.erase(
+        std::remove(pending_relocations_.begin(), pending_relocations_.end(), obj),
+        pending_relocations_.end()
+    );
 }
 
 void OctreePartitioner::add_light(LightID obj) {
     Light& light = stage().light(obj);
     Boundable* boundable = dynamic_cast<Boundable*>(&light);
     assert(boundable);
-    tree_.grow(boundable);
+
+    if(light.type() == LIGHT_TYPE_DIRECTIONAL) {
+        directional_lights_.insert(obj);
+    } else {
+        light_tree_.grow(boundable);
+    }
+
     boundable_to_light_[boundable] = obj;
+
+    light_moved_connections_[obj] = light.signal_bounds_changed().connect(sigc::mem_fun(this, &OctreePartitioner::event_light_moved));
 }
 
 void OctreePartitioner::remove_light(LightID obj) {
     Light& light = stage().light(obj);
     Boundable* boundable = dynamic_cast<Boundable*>(&light);
     assert(boundable);
-    tree_.shrink(boundable);
+
+    if(!directional_lights_.erase(obj) && light_tree_.contains(boundable)) {
+        light_tree_.shrink(boundable);
+    }
+
     boundable_to_light_.erase(boundable);
+
+    light_moved_connections_[obj].disconnect();
+    light_moved_connections_.erase(obj);
+
+    pending_light_relocations_.erase(
+        std::remove(pending_light_relocations_.begin(), pending_light_relocations_.end(), obj),
+        pending_light_relocations_.end()
+    );
 }
 
-std::vector<SubActor::ptr> OctreePartitioner::geometry_visible_from(CameraID camera_id) {
-    std::vector<SubActor::ptr> results;
+void OctreePartitioner::event_light_moved(LightID light_id) {
+    if(!pending_light_relocations_.empty() && pending_light_relocations_.back() == light_id) {
+        return;
+    }
+
+    pending_light_relocations_.push_back(light_id);
+}
 
-    //If the tree has no root then we return nothing
-    if(!tree_.has_root()) {
-        return results;
+void OctreePartitioner::flush_pending_light_relocations() {
+    if(pending_light_relocations_.empty()) {
+        return;
     }
 
-    Camera& cam = stage().scene().camera(camera_id);
+    std::sort(pending_light_relocations_.begin(), pending_light_relocations_.end());
+    pending_light_relocations_.erase(
+        std::unique(pending_light_relocations_.begin(), pending_light_relocations_.end()),
+        pending_light_relocations_.end()
+    );
+
+    for(LightID light_id: pending_light_relocations_) {
+        Light& light = stage().light(light_id);
+        Boundable* boundable = dynamic_cast<Boundable*>(&light);
 
-    /**
-     *  FIXME: A tree_->objects_visible_from(cam.frustum()); would be faster
-     */
-
-    //Go through the visible nodes
-    for(OctreeNode* node: tree_.nodes_visible_from(cam.frustum())) {
-        //Go through the objects
-        for(const Boundable* obj: node->objects()) {
-            if(container::contains(boundable_to_subactor_, obj)) {
-                //Build a list of visible subactors
-                results.push_back(boundable_to_subactor_[obj]);
+        //The light may have changed type since it was added
+        if(light.type() == LIGHT_TYPE_DIRECTIONAL) {
+            if(light_tree_.contains(boundable)) {
+                light_tree_.shrink(boundable);
             }
+            directional_lights_.insert(light_id);
+        } else {
+            directional_lights_.erase(light_id);
+            light_tree_.relocate(boundable);
         }
     }
 
-    return results;
+    pending_light_relocations_.clear();
 }
 
-std::vector<LightID> OctreePartitioner::lights_within_range(const kmVec3& location) {
-    std::vector<LightID> lights;
-/*
-    //Go through the visible nodes
-    for(OctreeNode* node: tree_.nodes_visible_from(cam.frustum())) {
-        //Go through the objects
-        for(const Boundable* obj: node->objects()) {
-            if(container::contains(boundable_to_light_, obj)) {
-                //Build a list of visible subactors
-                results.push_back(boundable_to_light_[obj]);
-            }
+void OctreePartitioner::prepare_for_queries() {
+    //Relocating also recalculates the bounds of whatever moved
+    flush_pending_relocations();
+    flush_pending_light_relocations();
+}
+
+void OctreePartitioner::geometry_visible_from(CameraID camera_id, std::vector<SubActor*>& results) {
+    flush_pending_relocations();
+
+    Camera& cam = stage().scene().camera(camera_id);
+
+    //Everything in tree_ is a SubActor (see add_actor)
+    auto to_subactor = [](const Boundable* obj) -> SubActor* {
+        return static_cast<SubActor*>(const_cast<Boundable*>(obj));
+    };
+
+    if(tree_.object_count() >= PARALLEL_CULL_THRESHOLD) {
+        tree_.objects_visible_from(cam.frustum(), stage().window().jobs(), results, to_subactor);
+    } else {
+        tree_.each_object_visible_from(cam.frustum(), [&](const Boundable* obj) {
+            results.push_back(to_subactor(obj));
+        });
+    }
+}
+
+std::vector<LightID> OctreePartitioner::lights_within_range(const kmAABB& bounds) {
+    flush_pending_light_relocations();
+
+    std::vector<std::pair<LightID, float> > lights_in_range;
+
+    //Directional lights reach everything
+    for(LightID light_id: directional_lights_) {
+        lights_in_range.push_back(std::make_pair(light_id, 0.0f));
+    }
+
+    //The bounds of each light in the tree enclose its range, so the tree only
+    //has to return the lights whose range box overlaps, then check their actual distance
+    light_tree_.each_object_intersecting(bounds, [&](const Boundable* obj) {
+        LightID light_id = container::const_get(boundable_to_light_, obj);
+        Light& light = stage().light(light_id);
+
+        float distance = light.distance_to(bounds);
+        if(distance <= light.range()) {
+            lights_in_range.push_back(std::make_pair(light_id, distance));
         }
-    }*/
+    });
+
+    //Nearest first, so that passes with a maximum iteration count get the most important lights
+    std::sort(lights_in_range.begin(), lights_in_range.end(),
+              [](std::pair<LightID, float> lhs, std::pair<LightID, float> rhs) { return lhs.second < rhs.second; });
 
-    return lights;
+    std::vector<LightID> result;
+    result.reserve(lights_in_range.size());
+    for(std::pair<LightID, float> p: lights_in_range) {
+        result.push_back(p.first);
+    }
+    return result;
 }
 
 }
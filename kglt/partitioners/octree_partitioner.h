@@ -25,18 +25,43 @@ public:
     void add_light(LightID obj);
     void remove_light(LightID obj);
 
-    std::vector<LightID> lights_within_range(const kmVec3& location);
-    std::vector<SubActorPtr> geometry_visible_from(CameraID camera_id);
+    std::vector<LightID> lights_within_range(const kmAABB& bounds);
+    void geometry_visible_from(CameraID camera_id, std::vector<SubActor*>& results);
+    uint32_t geometry_count() { return tree_.object_count(); }
+
+    void prepare_for_queries();
 
     void event_actor_changed(ActorID ent);
+    void event_actor_moved(ActorID ent);
+    void event_light_moved(LightID light);
 private:
+    /*
+     * Geometry and lights are kept in separate trees, so every object in tree_
+     * is known to be a SubActor and culling doesn't need a lookup per object
+     */
     Octree tree_;
+    Octree light_tree_;
 
     std::map<ActorID, std::vector<Boundable*> > actor_to_registered_subactors_;
 
     std::map<ActorID, sigc::connection> actor_changed_connections_;
-    std::map<const Boundable*, SubActorPtr> boundable_to_subactor_;
+    std::map<ActorID, sigc::connection> actor_moved_connections_;
+
+    /*
+     * Actors often move many times per frame (e.g. once per child update) so
+     * rather than relocating on every move we queue the actor and relocate its
+     * subactors once, right before the tree is next queried
+     */
+    std::vector<ActorID> pending_relocations_;
+    void flush_pending_relocations();
     std::map<const Boundable*, LightID> boundable_to_light_;
+
+    //Directional lights have no position or range, so they're kept out of light_tree_
+    std::set<LightID> directional_lights_;
+
+    std::map<LightID, sigc::connection> light_moved_connections_;
+    std::vector<LightID> pending_light_relocations_;
+    void flush_pending_light_relocations();
 };
 
 
@@ -13,7 +13,7 @@ SubMeshIndex rectangle(kglt::MeshPtr mesh_ptr, float width, float height, float
         mesh.clear();
     }
 
-    uint16_t offset = mesh.shared_data().count();
+    uint32_t offset = mesh.shared_data().count();
 
     mesh.shared_data().move_to_end();
 
@@ -80,7 +80,7 @@ SubMeshIndex rectangle_outline(kglt::MeshPtr mesh_ptr, float width, float height
         mesh.clear();
     }
 
-    uint16_t offset = mesh.shared_data().count();
+    uint32_t offset = mesh.shared_data().count();
 
     mesh.shared_data().position(x_offset + (-width / 2.0), y_offset + (-height / 2.0), z_offset);
     mesh.shared_data().diffuse(kglt::Colour::white);
@@ -0,0 +1,398 @@
+#include <GLee.h>
+#include <algorithm>
+#include <cstring>
+
+#include "render_queue.h"
+#include "batcher.h"
+#include "renderer.h"
+#include "actor.h"
+#include "light.h"
+#include "material.h"
+#include "stage.h"
+#include "shader.h"
+#include "camera.h"
+#include "partitioner.h"
+
+namespace kglt {
+
+/*
+ * The levels that state is bound at, in the same order as the RenderGroup
+ * tree. If two consecutive items differ at a level, that level and everything
+ * below it is unbound and rebound.
+ */
+enum RenderQueueLevel {
+    RENDER_QUEUE_LEVEL_SHADER = 0,
+    RENDER_QUEUE_LEVEL_DEPTH,
+    RENDER_QUEUE_LEVEL_MATERIAL,
+    RENDER_QUEUE_LEVEL_BLEND,
+    RENDER_QUEUE_LEVEL_SETTINGS,
+    RENDER_QUEUE_LEVEL_TEXTURES,
+    RENDER_QUEUE_LEVEL_LIGHT,
+    RENDER_QUEUE_LEVEL_MAX
+};
+
+const uint64_t RENDER_KEY_PRIORITY_AND_PASS_MASK = ~uint64_t(0) << RENDER_KEY_PASS_SHIFT;
+
+static uint64_t priority_index(RenderPriority priority) {
+    //RENDER_PRIORITIES are spaced 50 apart starting at RENDER_PRIORITY_BACKGROUND
+    int32_t idx = (int32_t(priority) - int32_t(RENDER_PRIORITY_BACKGROUND)) / 50;
+    return uint64_t(std::max(0, std::min(idx, 7)));
+}
+
+static uint64_t key_field(uint32_t value, uint32_t bits, uint32_t shift) {
+    return (uint64_t(value) & ((uint64_t(1) << bits) - 1)) << shift;
+}
+
+static bool texture_units_match(MaterialPass& lhs, MaterialPass& rhs) {
+    if(lhs.texture_unit_count() != rhs.texture_unit_count()) {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < lhs.texture_unit_count(); ++i) {
+        TextureUnit& l = lhs.texture_unit(i);
+        TextureUnit& r = rhs.texture_unit(i);
+
+        if(l.texture_id() != r.texture_id()) {
+            return false;
+        }
+
+        if(memcmp(l.matrix().mat, r.matrix().mat, sizeof(float) * 16) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static uint8_t first_changed_level(const RenderQueueItem& prev, const RenderQueueItem& next) {
+    //Each priority/pass combination was its own RootGroup, so everything is rebound
+    if((prev.key & RENDER_KEY_PRIORITY_AND_PASS_MASK) != (next.key & RENDER_KEY_PRIORITY_AND_PASS_MASK)) {
+        return RENDER_QUEUE_LEVEL_SHADER;
+    }
+
+    MaterialPass& lhs = *prev.pass;
+    MaterialPass& rhs = *next.pass;
+
+    if(&lhs != &rhs) {
+        if(lhs.__shader() != rhs.__shader()) {
+            return RENDER_QUEUE_LEVEL_SHADER;
+        }
+
+        if(lhs.depth_test_enabled() != rhs.depth_test_enabled() ||
+           lhs.depth_write_enabled() != rhs.depth_write_enabled()) {
+            return RENDER_QUEUE_LEVEL_DEPTH;
+        }
+
+        if(!(lhs.ambient() == rhs.ambient()) ||
+           !(lhs.diffuse() == rhs.diffuse()) ||
+           !(lhs.specular() == rhs.specular()) ||
+           lhs.shininess() != rhs.shininess() ||
+           lhs.texture_unit_count() != rhs.texture_unit_count()) {
+            return RENDER_QUEUE_LEVEL_MATERIAL;
+        }
+
+        if(lhs.blending() != rhs.blending()) {
+            return RENDER_QUEUE_LEVEL_BLEND;
+        }
+
+        if(lhs.line_width() != rhs.line_width() || lhs.point_size() != rhs.point_size()) {
+            return RENDER_QUEUE_LEVEL_SETTINGS;
+        }
+
+        if(!texture_units_match(lhs, rhs)) {
+            return RENDER_QUEUE_LEVEL_TEXTURES;
+        }
+    }
+
+    if(prev.light != next.light) {
+        return RENDER_QUEUE_LEVEL_LIGHT;
+    }
+
+    return RENDER_QUEUE_LEVEL_MAX;
+}
+
+RenderQueue::RenderQueue():
+    stage_(nullptr),
+    camera_(nullptr) {
+
+}
+
+void RenderQueue::reset(Stage& stage, Camera& camera) {
+    stage_ = &stage;
+    camera_ = &camera;
+
+    //Keep the capacity around, the queue is refilled every frame
+    items_.clear();
+    light_cache_.clear();
+}
+
+/*
+ * The lights for a subactor are looked up once per fill of the queue, however
+ * many of its passes iterate once per light
+ */
+const std::vector<LightID>& RenderQueue::lights_affecting(SubActor& subactor) {
+    auto it = light_cache_.find(&subactor);
+    if(it == light_cache_.end()) {
+        it = light_cache_.insert(
+            std::make_pair(&subactor, stage_->partitioner().lights_within_range(subactor.absolute_bounds()))
+        ).first;
+    }
+
+    return (*it).second;
+}
+
+uint64_t RenderQueue::generate_key(RenderPriority priority, uint8_t pass_number, MaterialPass& pass, SubActor& subactor, Light* light) {
+    uint64_t key = 0;
+
+    key |= priority_index(priority) << RENDER_KEY_PRIORITY_SHIFT;
+    key |= key_field(pass_number, 5, RENDER_KEY_PASS_SHIFT);
+    key |= key_field(pass.__shader()->id().value(), 12, RENDER_KEY_SHADER_SHIFT);
+    key |= key_field((pass.depth_test_enabled() ? 2 : 0) | (pass.depth_write_enabled() ? 1 : 0), 2, RENDER_KEY_DEPTH_SHIFT);
+
+    //The material and pass number uniquely identify the material properties
+    key |= key_field(subactor.material_id().value(), 12, RENDER_KEY_MATERIAL_SHIFT);
+    key |= key_field(pass.blending(), 3, RENDER_KEY_BLEND_SHIFT);
+    key |= key_field(uint32_t(pass.point_size()) ^ (uint32_t(pass.line_width()) << 1), 3, RENDER_KEY_SETTINGS_SHIFT);
+
+    if(pass.texture_unit_count()) {
+        key |= key_field(pass.texture_unit(0).texture_id().value(), 10, RENDER_KEY_TEXTURE_SHIFT);
+    }
+
+    if(light) {
+        key |= key_field(light->id().value(), 5, RENDER_KEY_LIGHT_SHIFT);
+    }
+
+    key |= key_field(subactor._parent().mesh_id().value() ^ (uint32_t(subactor.submesh_id()) << 4), 9, RENDER_KEY_MESH_SHIFT);
+
+    return key;
+}
+
+void RenderQueue::add_item(RenderPriority priority, uint8_t pass_number, MaterialPass& pass, SubActor& subactor, Light* light) {
+    RenderQueueItem item;
+    item.key = generate_key(priority, pass_number, pass, subactor, light);
+    item.subactor = &subactor;
+    item.pass = &pass;
+    item.light = light;
+    items_.push_back(item);
+}
+
+void RenderQueue::insert(SubActor& subactor) {
+    if(!subactor._parent().is_visible()) return;
+
+    auto mat = stage_->material(subactor.material_id());
+
+    for(uint8_t pass = 0; pass < mat->technique().pass_count(); ++pass) {
+        insert(subactor, pass);
+    }
+}
+
+void RenderQueue::insert(SubActor& subactor, uint8_t pass_number) {
+    assert(stage_);
+
+    if(!subactor._parent().is_visible()) return;
+
+    auto mat = stage_->material(subactor.material_id());
+    MaterialPass& pass = mat->technique().pass(pass_number);
+    RenderPriority priority = subactor._parent().render_priority();
+
+    if(pass.iteration() == ITERATE_N) {
+        //FIXME: What exactly is this for? Should we pass an iteration counter to the shader?
+        for(uint32_t i = 0; i < pass.max_iterations(); ++i) {
+            add_item(priority, pass_number, pass, subactor, nullptr);
+        }
+    } else if(pass.iteration() == ITERATE_ONCE_PER_LIGHT) {
+        const std::vector<LightID>& lights = lights_affecting(subactor);
+        uint32_t iteration_count = std::min<uint32_t>(lights.size(), pass.max_iterations());
+        for(uint32_t i = 0; i < iteration_count; ++i) {
+            add_item(priority, pass_number, pass, subactor, &stage_->light(lights[i]));
+        }
+    } else {
+        add_item(priority, pass_number, pass, subactor, nullptr);
+    }
+}
+
+void RenderQueue::sort() {
+    radix_sort(items_, scratch_);
+}
+
+void RenderQueue::bind_from(const RenderQueueItem& item, uint8_t level) {
+    MaterialPass& pass = *item.pass;
+    Stage& stage = *stage_;
+
+    switch(level) {
+    case RENDER_QUEUE_LEVEL_SHADER:
+        ShaderGroup::bind_state(ShaderGroupData(pass.__shader()), stage);
+    case RENDER_QUEUE_LEVEL_DEPTH:
+        DepthGroup::bind_state(DepthGroupData(pass.depth_test_enabled(), pass.depth_write_enabled()), stage);
+    case RENDER_QUEUE_LEVEL_MATERIAL:
+        MaterialGroup::bind_state(MaterialGroupData(pass.ambient(), pass.diffuse(), pass.specular(), pass.shininess(), pass.texture_unit_count()), stage);
+    case RENDER_QUEUE_LEVEL_BLEND:
+        BlendGroup::bind_state(BlendGroupData(pass.blending()), stage);
+    case RENDER_QUEUE_LEVEL_SETTINGS:
+        RenderSettingsGroup::bind_state(RenderSettingsData(pass.line_width(), pass.point_size()), stage);
+    case RENDER_QUEUE_LEVEL_TEXTURES:
+        for(uint8_t tu = 0; tu < pass.texture_unit_count(); ++tu) {
+            TextureGroup::bind_state(TextureGroupData(tu, pass.texture_unit(tu).texture_id()), stage);
+            TextureMatrixGroup::bind_state(TextureMatrixGroupData(tu, pass.texture_unit(tu).matrix()), stage);
+        }
+    case RENDER_QUEUE_LEVEL_LIGHT:
+        if(item.light) {
+            LightGroup::bind_state(LightGroupData(item.light), stage);
+        }
+    default:
+        break;
+    }
+}
+
+void RenderQueue::unbind_from(const RenderQueueItem& item, uint8_t level) {
+    MaterialPass& pass = *item.pass;
+    Stage& stage = *stage_;
+
+    //Unbind in the reverse order, from the deepest level up to (and including) 'level'
+    if(level <= RENDER_QUEUE_LEVEL_LIGHT && item.light) {
+        LightGroup::unbind_state(LightGroupData(item.light), stage);
+    }
+
+    if(level <= RENDER_QUEUE_LEVEL_TEXTURES) {
+        for(uint8_t tu = pass.texture_unit_count(); tu > 0; --tu) {
+            TextureMatrixGroup::unbind_state(TextureMatrixGroupData(tu - 1, pass.texture_unit(tu - 1).matrix()), stage);
+            TextureGroup::unbind_state(TextureGroupData(tu - 1, pass.texture_unit(tu - 1).texture_id()), stage);
+        }
+    }
+
+    if(level <= RENDER_QUEUE_LEVEL_SETTINGS) {
+        RenderSettingsGroup::unbind_state(RenderSettingsData(pass.line_width(), pass.point_size()), stage);
+    }
+
+    if(level <= RENDER_QUEUE_LEVEL_BLEND) {
+        BlendGroup::unbind_state(BlendGroupData(pass.blending()), stage);
+    }
+
+    if(level <= RENDER_QUEUE_LEVEL_MATERIAL) {
+        MaterialGroup::unbind_state(MaterialGroupData(pass.ambient(), pass.diffuse(), pass.specular(), pass.shininess(), pass.texture_unit_count()), stage);
+    }
+
+    if(level <= RENDER_QUEUE_LEVEL_DEPTH) {
+        DepthGroup::unbind_state(DepthGroupData(pass.depth_test_enabled(), pass.depth_write_enabled()), stage);
+    }
+
+    if(level <= RENDER_QUEUE_LEVEL_SHADER) {
+        ShaderGroup::unbind_state(ShaderGroupData(pass.__shader()), stage);
+    }
+}
+
+static bool shares_geometry(const RenderQueueItem& lhs, const RenderQueueItem& rhs) {
+    return lhs.subactor->submesh_id() == rhs.subactor->submesh_id() &&
+           lhs.subactor->_parent().mesh_id() == rhs.subactor->_parent().mesh_id();
+}
+
+void RenderQueue::render(Renderer& renderer, CameraID camera) {
+    const RenderQueueItem* previous = nullptr;
+
+    const uint32_t count = items_.size();
+    for(uint32_t i = 0; i < count; ) {
+        const RenderQueueItem& item = items_[i];
+
+        uint8_t level = RENDER_QUEUE_LEVEL_SHADER;
+        if(previous) {
+            level = first_changed_level(*previous, item);
+            if(level < RENDER_QUEUE_LEVEL_MAX) {
+                unbind_from(*previous, level);
+            }
+        }
+
+        bind_from(item, level);
+
+        /*
+         * The mesh is the lowest part of the key, so copies of the same submesh
+         * with identical state end up next to each other. If the shader can take
+         * the model matrix as an instanced attribute, draw the run in one go.
+         */
+        uint32_t end = i + 1;
+        if(renderer.supports_instancing(*item.pass->__shader())) {
+            while(end < count &&
+                  shares_geometry(items_[end - 1], items_[end]) &&
+                  first_changed_level(items_[end - 1], items_[end]) == RENDER_QUEUE_LEVEL_MAX) {
+                ++end;
+            }
+        }
+
+        if(end - i > 1) {
+            instances_.clear();
+            for(uint32_t j = i; j < end; ++j) {
+                instances_.push_back(items_[j].subactor);
+            }
+            renderer.render_instances(instances_, camera);
+        } else {
+            renderer.render_subactor(*item.subactor, camera);
+        }
+
+        previous = &items_[end - 1];
+        i = end;
+    }
+
+    if(previous) {
+        unbind_from(*previous, RENDER_QUEUE_LEVEL_SHADER);
+    }
+}
+
+/**
+ * @brief radix_sort
+ * @param items - The items to sort by key
+ * @param scratch - Working space, resized to match items
+ *
+ * A stable LSD radix sort over the 8 bytes of the key. The histograms for all
+ * of the bytes are built in one pass, and any byte which is the same for every
+ * item is skipped, which is common as the priority and pass bits rarely vary.
+ */
+void radix_sort(std::vector<RenderQueueItem>& items, std::vector<RenderQueueItem>& scratch) {
+    const uint32_t count = items.size();
+    if(count < 2) {
+        return;
+    }
+
+    scratch.resize(count);
+
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+
+    for(const RenderQueueItem& item: items) {
+        uint64_t key = item.key;
+        for(uint32_t b = 0; b < 8; ++b) {
+            histograms[b][(key >> (b * 8)) & 0xFF]++;
+        }
+    }
+
+    bool sorted_into_scratch = false;
+    for(uint32_t b = 0; b < 8; ++b) {
+        std::vector<RenderQueueItem>& source = (sorted_into_scratch) ? scratch : items;
+        std::vector<RenderQueueItem>& dest = (sorted_into_scratch) ? items : scratch;
+
+        uint32_t* histogram = histograms[b];
+        const uint32_t shift = b * 8;
+
+        if(histogram[(source[0].key >> shift) & 0xFF] == count) {
+            //Every key has the same value for this byte
+            continue;
+        }
+
+        uint32_t offsets[256];
+        uint32_t total = 0;
+        for(uint32_t i = 0; i < 256; ++i) {
+            offsets[i] = total;
+            total += histogram[i];
+        }
+
+        for(const RenderQueueItem& item: source) {
+            dest[offsets[(item.key >> shift) & 0xFF]++] = item;
+        }
+
+        sorted_into_scratch = !sorted_into_scratch;
+    }
+
+    if(sorted_into_scratch) {
+        items.swap(scratch);
+    }
+}
+
+}
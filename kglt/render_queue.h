@@ -0,0 +1,97 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+namespace kglt {
+
+class SubActor;
+class MaterialPass;
+class Light;
+class Renderer;
+
+/*
+ * Layout of the 64 bit sort key, from the most significant bit down. The
+ * fields are ordered in the same way that RootGroup nests its RenderGroups so
+ * that sorting by key clusters the draws exactly as the tree would. Fields
+ * that are wider than their slot (IDs, hashes) are masked, so two different
+ * states can share a key - the queue always compares the real state before
+ * skipping a bind, so this only costs an extra state change, never a wrong one.
+ */
+enum RenderKeyField {
+    RENDER_KEY_PRIORITY_SHIFT = 61, //3 bits, index into RENDER_PRIORITIES
+    RENDER_KEY_PASS_SHIFT = 56, //5 bits
+    RENDER_KEY_SHADER_SHIFT = 44, //12 bits
+    RENDER_KEY_DEPTH_SHIFT = 42, //2 bits
+    RENDER_KEY_MATERIAL_SHIFT = 30, //12 bits
+    RENDER_KEY_BLEND_SHIFT = 27, //3 bits
+    RENDER_KEY_SETTINGS_SHIFT = 24, //3 bits
+    RENDER_KEY_TEXTURE_SHIFT = 14, //10 bits
+    RENDER_KEY_LIGHT_SHIFT = 9, //5 bits
+    RENDER_KEY_MESH_SHIFT = 0 //9 bits
+};
+
+struct RenderQueueItem {
+    uint64_t key;
+    SubActor* subactor;
+    MaterialPass* pass;
+    Light* light;
+};
+
+/**
+ * @brief The RenderQueue class
+ *
+ * A flat replacement for building a RootGroup tree every frame. Each visible
+ * subactor is added once per material pass (and once per light or iteration
+ * where the pass asks for it) as a RenderQueueItem with a packed sort key. The
+ * items are radix sorted, and render() walks them in order, unbinding and
+ * rebinding state only where it differs from the previous item. Runs of the
+ * same submesh with the same state are handed to Renderer::render_instances
+ * when the renderer supports instancing for the pass' shader. State is
+ * applied with the same bind_state()/unbind_state() functions as the batcher's
+ * RenderGroups, and a change at one level rebinds every level below it, just as
+ * entering a new branch of the tree would.
+ */
+class RenderQueue {
+public:
+    RenderQueue();
+
+    void reset(Stage& stage, Camera& camera);
+
+    void insert(SubActor& subactor);
+    void insert(SubActor& subactor, uint8_t pass_number);
+
+    void sort();
+    void render(Renderer& renderer, CameraID camera);
+
+    uint32_t size() const { return items_.size(); }
+    const std::vector<RenderQueueItem>& items() const { return items_; }
+
+    static uint64_t generate_key(RenderPriority priority, uint8_t pass_number, MaterialPass& pass, SubActor& subactor, Light* light);
+
+private:
+    Stage* stage_;
+    Camera* camera_;
+
+    std::vector<RenderQueueItem> items_;
+    std::vector<RenderQueueItem> scratch_;
+    std::vector<SubActor*> instances_;
+    std::unordered_map<SubActor*, std::vector<LightID> > light_cache_;
+
+    const std::vector<LightID>& lights_affecting(SubActor& subactor);
+
+    void add_item(RenderPriority priority, uint8_t pass_number, MaterialPass& pass, SubActor& subactor, Light* light);
+
+    void bind_from(const RenderQueueItem& item, uint8_t level);
+    void unbind_from(const RenderQueueItem& item, uint8_t level);
+};
+
+void radix_sort(std::vector<RenderQueueItem>& items, std::vector<RenderQueueItem>& scratch);
+
+}
+
+#endif // RENDER_QUEUE_H
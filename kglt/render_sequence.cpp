@@ -1,4 +1,5 @@
 #include <GLee.h>
+#include <set>
 #include <tr1/unordered_map>
 
 #include "render_sequence.h"
@@ -13,8 +14,9 @@
 #include "partitioner.h"
 #include "partitioners/octree_partitioner.h"
 #include "renderers/generic_renderer.h"
-#include "batcher.h"
+#include "render_queue.h"
 #include "loader.h"
+#include "utils/profiler.h"
 
 namespace kglt {
 
@@ -68,6 +70,7 @@ Pipeline& RenderSequence::pipeline(PipelineID pipeline) {
 }
 
 void RenderSequence::delete_pipeline(PipelineID pipeline) {
+    ordered_pipelines_.remove_if([=](Pipeline::ptr p) { return p->id() == pipeline; });
     PipelineManager::manager_delete(pipeline);
 }
 
@@ -112,11 +115,144 @@ void RenderSequence::set_renderer(Renderer::ptr renderer) {
 }
 
 void RenderSequence::run() {
+    prepare();
+    submit();
+}
+
+void RenderSequence::submit() {
     scene_.window().apply_func_to_objects(std::bind(&Viewport::clear, std::tr1::placeholders::_1));
 
+    pipeline_stats_.clear();
+
     for(Pipeline::ptr pipeline: ordered_pipelines_) {
         run_pipeline(pipeline);
     }
+
+    RenderStats totals = RenderStats::totals();
+    frame_stats_ = totals - last_totals_;
+    last_totals_ = totals;
+
+    if(stats_history_size_) {
+        stats_history_.push_back(frame_stats_);
+        while(stats_history_.size() > stats_history_size_) {
+            stats_history_.pop_front();
+        }
+    }
+}
+
+RenderStats RenderSequence::pipeline_stats(PipelineID pipeline) const {
+    auto it = pipeline_stats_.find(pipeline);
+    return (it == pipeline_stats_.end()) ? RenderStats() : it->second;
+}
+
+void RenderSequence::set_stats_history_size(uint32_t frames) {
+    stats_history_size_ = frames;
+    while(stats_history_.size() > stats_history_size_) {
+        stats_history_.pop_front();
+    }
+}
+
+void RenderSequence::prepare() {
+    KGLT_PROFILE_SCOPE("RenderSequence::prepare");
+
+    ++frame_;
+
+    //From here on rendering only reads the snapshot, so the scene is free to move on
+    scene_.snapshot_transformations();
+
+    //One list for each distinct stage and camera, however many pipelines use it
+    std::vector<DrawList*> to_build;
+    for(Pipeline::ptr pipeline: ordered_pipelines_) {
+        if(!pipeline->is_active() || pipeline->ui_stage_id()) {
+            continue;
+        }
+
+        std::shared_ptr<DrawList>& list = draw_lists_[DrawListKey(pipeline->stage_id(), pipeline->camera_id())];
+        if(!list) {
+            list = std::make_shared<DrawList>();
+            list->stage = pipeline->stage_id();
+            list->camera = pipeline->camera_id();
+        }
+
+        if(list->prepared_frame != frame_) {
+            list->prepared_frame = frame_;
+            to_build.push_back(list.get());
+        }
+    }
+
+    //Drop the lists that no pipeline wanted, their stage or camera may not exist any more
+    for(auto it = draw_lists_.begin(); it != draw_lists_.end();) {
+        if((*it).second->prepared_frame != frame_) {
+            it = draw_lists_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    //Once each partitioner has caught up, the lists only read from them and can be built together
+    std::set<StageID> prepared_stages;
+    for(DrawList* list: to_build) {
+        if(prepared_stages.insert(list->stage).second) {
+            scene_.stage(list->stage).partitioner().prepare_for_queries();
+        }
+    }
+
+    scene_.window().jobs().parallel_for(0, to_build.size(), 1, [&](uint32_t first, uint32_t last) {
+        for(uint32_t i = first; i < last; ++i) {
+            build_draw_list(*to_build[i]);
+        }
+    });
+}
+
+void RenderSequence::build_draw_list(DrawList& list) {
+    KGLT_PROFILE_SCOPE("RenderSequence::build_draw_list");
+
+    Stage& stage = scene_.stage(list.stage);
+    Camera& camera = scene_.camera(list.camera);
+
+    list.visible.clear();
+    {
+        KGLT_PROFILE_SCOPE("Partitioner::geometry_visible_from");
+        stage.partitioner().geometry_visible_from(list.camera, list.visible);
+    }
+
+    list.candidates = stage.partitioner().geometry_count();
+
+    /*
+     * Go through the visible objects and add each one to the render queue
+     * once for every material pass. The queue is sorted by state, so when
+     * we render we only bind the shaders/textures/uniforms etc. that differ
+     * from the previous draw
+     */
+    KGLT_PROFILE_SCOPE("RenderQueue::build");
+    list.queue.reset(stage, camera);
+    for(SubActor* ent: list.visible) {
+        list.queue.insert(*ent);
+    }
+    list.queue.sort();
+}
+
+DrawList* RenderSequence::draw_list_for(Pipeline& pipeline) {
+    std::shared_ptr<DrawList>& list = draw_lists_[DrawListKey(pipeline.stage_id(), pipeline.camera_id())];
+    if(!list) {
+        list = std::make_shared<DrawList>();
+        list->stage = pipeline.stage_id();
+        list->camera = pipeline.camera_id();
+    }
+
+    if(list->prepared_frame != frame_) {
+        if(scene_.window().frame_in_flight()) {
+            //The simulation thread is changing the partitioner, so this has to wait for the next prepare()
+            return nullptr;
+        }
+
+        //Activated after prepare() (e.g. by a signal_pipeline_started() handler), so build it now
+        list->prepared_frame = frame_;
+        scene_.stage(list->stage).partitioner().prepare_for_queries();
+        build_draw_list(*list);
+    }
+
+    return list.get();
 }
 
 void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage) {
@@ -124,6 +260,11 @@ void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage) {
         return;
     }
 
+    KGLT_PROFILE_SCOPE("RenderSequence::run_pipeline");
+
+    RenderStats& totals = RenderStats::totals();
+    RenderStats before = totals;
+
     Camera& camera = scene_.camera(pipeline_stage->camera_id());
     Viewport& viewport = scene_.window().viewport(pipeline_stage->viewport_id());
     viewport.apply(); //FIXME apply shouldn't exist
@@ -138,7 +279,7 @@ void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage) {
         //FIXME: GL 2.x rubbish
         glPushMatrix();
         glMatrixMode(GL_PROJECTION);
-        glLoadMatrixf(camera.projection_matrix().mat);
+        glLoadMatrixf(camera.render_projection_matrix().mat);
         glMatrixMode(GL_MODELVIEW);
         glLoadIdentity();
 
@@ -149,66 +290,16 @@ void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage) {
 
         glMatrixMode(GL_MODELVIEW);
         glPopMatrix();
-    } else {
+    } else if(DrawList* list = draw_list_for(*pipeline_stage)) {
         Stage& stage = scene_.stage(pipeline_stage->stage_id());
 
-        std::vector<SubActor::ptr> buffers = stage.partitioner().geometry_visible_from(pipeline_stage->camera_id());
-
+        uint32_t visible = list->visible.size();
+        totals.visible_subactors += visible;
+        totals.culled_subactors += (list->candidates > visible) ? list->candidates - visible : 0;
 
-        /*
-         * Go through the visible objects, sort into queues and for
-         * each material pass add the subactor. The result is that a tree
-         * of material properties (uniforms) will be created with the child nodes
-         * being the meshes
-         */
-        typedef std::tr1::unordered_map<uint32_t, std::vector<RootGroup::ptr> > QueueGroups;
-        static QueueGroups queues;
-
-        //Empty the queues
-        for(auto queue: queues) {
-            for(auto group: queue.second) {
-                group->clear();
-            }
-        }
-
-        //Go through the visible actors
-        for(SubActor::ptr ent: buffers) {
-            //Get the priority queue for this actor (e.g. RENDER_PRIORITY_BACKGROUND)
-            QueueGroups::mapped_type& priority_queue = queues[(uint32_t)ent->_parent().render_priority()];
-
-            auto mat = stage.material(ent->material_id());
-
-            //Go through the actors material passes
-            for(uint8_t pass = 0; pass < mat->technique().pass_count(); ++pass) {
-                //Create a new render group if necessary
-                RootGroup::ptr group;
-                if(priority_queue.size() <= pass) {
-                    group = RootGroup::ptr(new RootGroup(stage, camera));
-                    priority_queue.push_back(group);
-                } else {
-                    group = priority_queue[pass];
-                }
-
-                //Insert the actor into the RenderGroup tree
-                group->insert(*ent, pass);
-            }
-        }
-
-        /*
-         * At this point, we will have a render group tree for each priority level
-         * when we render, we can apply the uniforms/textures/shaders etc. by traversing the
-         * tree and calling bind()/unbind() at each level
-         */
+        KGLT_PROFILE_SCOPE("RenderQueue::render");
         renderer_->set_current_stage(stage.id());
-        for(RenderPriority priority: RENDER_PRIORITIES) {
-            QueueGroups::mapped_type& priority_queue = queues[priority];
-            for(RootGroup::ptr pass_group: priority_queue) {
-                std::function<void (SubActor&)> f = [=](SubActor& subactor) {
-                    renderer_->render_subactor(subactor, pipeline_stage->camera_id());
-                };
-                pass_group->traverse(f);
-            }
-        }
+        list->queue.render(*renderer_, pipeline_stage->camera_id());
         renderer_->set_current_stage(StageID());
     }
 
@@ -223,6 +314,8 @@ void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage) {
         renderer_->render(buffers, stage->camera_id());
     renderer_->set_current_stage(StageID());*/
 
+    pipeline_stats_[pipeline_stage->id()] = totals - before;
+
     signal_pipeline_finished_(*pipeline_stage);
 }
 
@@ -1,6 +1,8 @@
 #ifndef PIPELINE_H
 #define PIPELINE_H
 
+#include <deque>
+#include <map>
 #include <vector>
 #include <tr1/memory>
 #include <sigc++/sigc++.h>
@@ -12,6 +14,8 @@
 #include "viewport.h"
 #include "partitioner.h"
 #include "renderer.h"
+#include "render_queue.h"
+#include "render_stats.h"
 
 namespace kglt {
 
@@ -68,6 +72,23 @@ struct RenderOptions {
     uint8_t point_size;
 };
 
+/*
+ * What one stage looks like from one camera this frame: the visible subactors
+ * and the sorted RenderQueue built from them. Built by RenderSequence::prepare()
+ * and only read after that, every pipeline with the same stage and camera
+ * draws from the same one.
+ */
+struct DrawList {
+    StageID stage;
+    CameraID camera;
+
+    std::vector<SubActor*> visible;
+    uint32_t candidates = 0;
+    RenderQueue queue;
+
+    uint64_t prepared_frame = 0;
+};
+
 typedef generic::TemplatedManager<RenderSequence, Pipeline, PipelineID> PipelineManager;
 
 class RenderSequence:
@@ -103,21 +124,65 @@ public:
     //void set_batcher(Batcher::ptr batcher);
     void set_renderer(Renderer::ptr renderer);
 
+    /*
+     * Renders every active pipeline in priority order, in two phases. prepare()
+     * snapshots the transformations, works out what's visible and builds the draw
+     * lists for all of the pipelines at once on the window's JobSystem. submit()
+     * then draws the pipelines one at a time from those lists, and only needs the
+     * GL thread. Handlers of signal_pipeline_started() run during submit(), so
+     * moving a camera from one only shows up in the next frame. A pipeline they
+     * activate has its list built there and then, except with threaded rendering
+     * where it isn't drawn until after the next prepare().
+     *
+     * run() is prepare() followed by submit(). With threaded rendering the window
+     * calls them separately, and the scene is updated on another thread while
+     * submit() runs (see WindowBase::set_threaded_rendering()).
+     */
     void run();
+    void prepare();
+    void submit();
 
     sigc::signal<void, Pipeline&>& signal_pipeline_started() { return signal_pipeline_started_; }
     sigc::signal<void, Pipeline&>& signal_pipeline_finished() { return signal_pipeline_finished_; }
 
     RenderOptions render_options;
 
+    /*
+     * What the last run() did: frame_stats() covers the whole frame, including
+     * anything uploaded since the previous run(), pipeline_stats() covers just
+     * the pipeline (and is empty if it didn't run). If a history size is set the
+     * last that many frame stats are kept, oldest first.
+     */
+    const RenderStats& frame_stats() const { return frame_stats_; }
+    RenderStats pipeline_stats(PipelineID pipeline) const;
+
+    //How many distinct (stage, camera) draw lists the last run() built
+    uint32_t draw_list_count() const { return draw_lists_.size(); }
+
+    void set_stats_history_size(uint32_t frames);
+    const std::deque<RenderStats>& stats_history() const { return stats_history_; }
+
 private:    
+    void build_draw_list(DrawList& list);
+    DrawList* draw_list_for(Pipeline& pipeline);
+
     void run_pipeline(Pipeline::ptr stage);
 
     Scene& scene_;
     Renderer::ptr renderer_;
 
+    typedef std::pair<StageID, CameraID> DrawListKey;
+    std::map<DrawListKey, std::shared_ptr<DrawList> > draw_lists_;
+    uint64_t frame_ = 0;
+
     std::list<Pipeline::ptr> ordered_pipelines_;
 
+    RenderStats last_totals_;
+    RenderStats frame_stats_;
+    std::map<PipelineID, RenderStats> pipeline_stats_;
+    uint32_t stats_history_size_ = 0;
+    std::deque<RenderStats> stats_history_;
+
     sigc::signal<void, Pipeline&> signal_pipeline_started_;
     sigc::signal<void, Pipeline&> signal_pipeline_finished_;
 
@@ -0,0 +1,39 @@
+#include "render_stats.h"
+
+namespace kglt {
+
+RenderStats& RenderStats::totals() {
+    static RenderStats stats;
+    return stats;
+}
+
+RenderStats& RenderStats::operator+=(const RenderStats& rhs) {
+    draw_calls += rhs.draw_calls;
+    triangles += rhs.triangles;
+    visible_subactors += rhs.visible_subactors;
+    culled_subactors += rhs.culled_subactors;
+    shader_binds += rhs.shader_binds;
+    texture_binds += rhs.texture_binds;
+    uniform_uploads += rhs.uniform_uploads;
+    buffer_bytes_uploaded += rhs.buffer_bytes_uploaded;
+    texture_bytes_uploaded += rhs.texture_bytes_uploaded;
+    buffer_stalls += rhs.buffer_stalls;
+    return *this;
+}
+
+RenderStats RenderStats::operator-(const RenderStats& rhs) const {
+    RenderStats result;
+    result.draw_calls = draw_calls - rhs.draw_calls;
+    result.triangles = triangles - rhs.triangles;
+    result.visible_subactors = visible_subactors - rhs.visible_subactors;
+    result.culled_subactors = culled_subactors - rhs.culled_subactors;
+    result.shader_binds = shader_binds - rhs.shader_binds;
+    result.texture_binds = texture_binds - rhs.texture_binds;
+    result.uniform_uploads = uniform_uploads - rhs.uniform_uploads;
+    result.buffer_bytes_uploaded = buffer_bytes_uploaded - rhs.buffer_bytes_uploaded;
+    result.texture_bytes_uploaded = texture_bytes_uploaded - rhs.texture_bytes_uploaded;
+    result.buffer_stalls = buffer_stalls - rhs.buffer_stalls;
+    return result;
+}
+
+}
@@ -0,0 +1,37 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <cstdint>
+
+namespace kglt {
+
+/*
+ * Counts of the work done to render. RenderStats::totals() holds running totals
+ * since startup, which the renderer, BufferObject, Texture, ShaderProgram and
+ * GLState add to as the work happens (always on the GL thread). RenderSequence
+ * takes the difference between snapshots of the totals to report each frame
+ * and each pipeline.
+ */
+struct RenderStats {
+    uint64_t draw_calls = 0;
+    uint64_t triangles = 0;
+    uint64_t visible_subactors = 0;
+    uint64_t culled_subactors = 0;
+    uint64_t shader_binds = 0;
+    uint64_t texture_binds = 0;
+    uint64_t uniform_uploads = 0;
+    uint64_t buffer_bytes_uploaded = 0; //glBufferData, glBufferSubData and streamed writes
+    uint64_t texture_bytes_uploaded = 0; //glTexImage2D
+    uint64_t buffer_stalls = 0; //Times streaming had to wait for the GPU to finish with a region
+
+    static RenderStats& totals();
+
+    uint64_t bytes_uploaded() const { return buffer_bytes_uploaded + texture_bytes_uploaded; }
+
+    RenderStats& operator+=(const RenderStats& rhs);
+    RenderStats operator-(const RenderStats& rhs) const;
+};
+
+}
+
+#endif // RENDER_STATS_H
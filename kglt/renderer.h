@@ -11,6 +11,7 @@
 namespace kglt {
 
 class SubActor;
+class ShaderProgram;
 
 class Renderer {
 public:
@@ -27,6 +28,18 @@ public:
 
     virtual void render_subactor(SubActor& buffer, CameraID camera) = 0;
 
+    /*
+     * Renders several subactors which share the same vertex and index data, and
+     * the same bound state, as one batch. Renderers that can't do that in a single
+     * draw call just render them one at a time.
+     */
+    virtual bool supports_instancing(ShaderProgram& shader) const { return false; }
+    virtual void render_instances(const std::vector<SubActor*>& instances, CameraID camera) {
+        for(SubActor* subactor: instances) {
+            render_subactor(*subactor, camera);
+        }
+    }
+
 protected:
     Stage& current_stage();
 
@@ -1,4 +1,5 @@
 #include <GLee.h>
+#include <functional>
 
 #include "generic_renderer.h"
 
@@ -11,6 +12,8 @@
 
 #include "kazmath/mat4.h"
 #include "../utils/gl_error.h"
+#include "../utils/gl_state.h"
+#include "../render_stats.h"
 
 namespace kglt {
 
@@ -28,41 +31,61 @@ void GenericRenderer::set_auto_uniforms_on_shader(
 
     kglt::Camera& cam = scene().camera(camera);
 
-    const kmMat4 model = subactor._parent().absolute_transformation();
-    const kmMat4& view = cam.view_matrix();
-    const kmMat4& projection = cam.projection_matrix();
+    const kmMat4& model = subactor._parent().render_transformation();
+    const kmMat4& view = cam.render_view_matrix();
+    const kmMat4& projection = cam.render_projection_matrix();
 
     kmMat4Multiply(&modelview, &view, &model);
     kmMat4Multiply(&modelview_projection, &projection, &modelview);
 
     if(s.params().uses_auto(SP_AUTO_VIEW_MATRIX)) {
         s.params().set_mat4x4(
-            s.params().auto_uniform_variable_name(SP_AUTO_VIEW_MATRIX),
+            SP_AUTO_VIEW_MATRIX,
             view
         );
     }
 
     if(s.params().uses_auto(SP_AUTO_MODELVIEW_PROJECTION_MATRIX)) {
         s.params().set_mat4x4(
-            s.params().auto_uniform_variable_name(SP_AUTO_MODELVIEW_PROJECTION_MATRIX),
+            SP_AUTO_MODELVIEW_PROJECTION_MATRIX,
             modelview_projection
         );
     }
 
     if(s.params().uses_auto(SP_AUTO_MODELVIEW_MATRIX)) {
         s.params().set_mat4x4(
-            s.params().auto_uniform_variable_name(SP_AUTO_MODELVIEW_MATRIX),
+            SP_AUTO_MODELVIEW_MATRIX,
             modelview
         );
     }
 
     if(s.params().uses_auto(SP_AUTO_PROJECTION_MATRIX)) {
         s.params().set_mat4x4(
-            s.params().auto_uniform_variable_name(SP_AUTO_PROJECTION_MATRIX),
+            SP_AUTO_PROJECTION_MATRIX,
             projection
         );
     }
 
+    if(s.params().uses_auto(SP_AUTO_VIEW_PROJECTION_MATRIX)) {
+        kmMat4 view_projection;
+        kmMat4Multiply(&view_projection, &projection, &view);
+
+        s.params().set_mat4x4(
+            SP_AUTO_VIEW_PROJECTION_MATRIX,
+            view_projection
+        );
+    }
+
+    if(s.params().uses_attribute(SP_ATTR_INSTANCE_MODEL_MATRIX)) {
+        //Not instanced, so feed the model matrix in as a constant attribute value
+        int32_t loc = s.params().attribute_location(SP_ATTR_INSTANCE_MODEL_MATRIX);
+        if(loc >= 0) {
+            for(uint8_t column = 0; column < 4; ++column) {
+                glVertexAttrib4fv(loc + column, &model.mat[column * 4]);
+            }
+        }
+    }
+
     if(s.params().uses_auto(SP_AUTO_INVERSE_TRANSPOSE_MODELVIEW_MATRIX)) {
         kmMat3 inverse_transpose_modelview;
 
@@ -71,75 +94,79 @@ void GenericRenderer::set_auto_uniforms_on_shader(
         kmMat3Transpose(&inverse_transpose_modelview, &inverse_transpose_modelview);
 
         s.params().set_mat3x3(
-            s.params().auto_uniform_variable_name(SP_AUTO_INVERSE_TRANSPOSE_MODELVIEW_MATRIX),
+            SP_AUTO_INVERSE_TRANSPOSE_MODELVIEW_MATRIX,
             inverse_transpose_modelview
         );
     }
 /*
     if(s.params().uses_auto(SP_AUTO_MATERIAL_AMBIENT)) {
         s.params().set_colour(
-            s.params().auto_uniform_variable_name(SP_AUTO_MATERIAL_AMBIENT),
+            SP_AUTO_MATERIAL_AMBIENT,
             pass.ambient()
         );
     }
 
     if(s.params().uses_auto(SP_AUTO_MATERIAL_DIFFUSE)) {
         s.params().set_colour(
-            s.params().auto_uniform_variable_name(SP_AUTO_MATERIAL_DIFFUSE),
+            SP_AUTO_MATERIAL_DIFFUSE,
             pass.diffuse()
         );
     }
 
     if(s.params().uses_auto(SP_AUTO_MATERIAL_SPECULAR)) {
         s.params().set_colour(
-            s.params().auto_uniform_variable_name(SP_AUTO_MATERIAL_SPECULAR),
+            SP_AUTO_MATERIAL_SPECULAR,
             pass.specular()
         );
     }
 
     if(s.params().uses_auto(SP_AUTO_MATERIAL_SHININESS)) {
         s.params().set_float(
-            s.params().auto_uniform_variable_name(SP_AUTO_MATERIAL_SHININESS),
+            SP_AUTO_MATERIAL_SHININESS,
             pass.shininess()
         );
     }
 
     if(s.params().uses_auto(SP_AUTO_MATERIAL_ACTIVE_TEXTURE_UNITS)) {
         s.params().set_int(
-            s.params().auto_uniform_variable_name(SP_AUTO_MATERIAL_ACTIVE_TEXTURE_UNITS),
+            SP_AUTO_MATERIAL_ACTIVE_TEXTURE_UNITS,
             pass.texture_unit_count()
         );
     }*/
 }
 
-template<typename EnabledMethod, typename OffsetMethod>
-void send_attribute(ShaderProgram& s,
+static void send_attribute(ShaderProgram& s,
                     ShaderAvailableAttributes attr,
                     const VertexData& data,
-                    EnabledMethod exists_on_data_predicate,
-                    OffsetMethod offset_func) {
+                    AttributeBitMask data_attribute) {
 
     if(!s.params().uses_attribute(attr)) {
         return;
     }
 
-    int32_t loc = s.get_attrib_loc(s.params().attribute_variable_name(attr));
+    int32_t loc = s.params().attribute_location(attr);
     if(loc < 0) {
         L_WARN("Couldn't locate attribute, on the shader");
         return;
     }
 
-    auto get_has_attribute = sigc::mem_fun(data, exists_on_data_predicate);
-    auto get_offset = sigc::mem_fun(data, offset_func);
-    if(get_has_attribute()) {
+    if(data.has_attribute(data_attribute)) {
+        //The layout is packed, so the size, type and offset all come from the vertex data
+        GLenum type = GL_FLOAT;
+        GLboolean normalized = GL_FALSE;
+        if(data.attribute_encoding(data_attribute) == ATTRIBUTE_ENCODING_NORMALIZED_BYTE) {
+            type = (data_attribute == BM_NORMALS) ? GL_BYTE : GL_UNSIGNED_BYTE;
+            normalized = GL_TRUE;
+        }
+
         glEnableVertexAttribArray(loc);
         glVertexAttribPointer(
             loc,
-            SHADER_ATTRIBUTE_SIZES.find(attr)->second,
-            GL_FLOAT,
-            GL_FALSE,
+            data.attribute_components(data_attribute),
+            type,
+            normalized,
             data.stride(),
-            BUFFER_OFFSET(get_offset())
+            BUFFER_OFFSET(data.buffer_object().base_offset() + data.attribute_offset(data_attribute))
         );
     } else {
         L_WARN("Couldn't locate attribute on the mesh: " + boost::lexical_cast<std::string>(attr));
@@ -147,44 +174,171 @@ void send_attribute(ShaderProgram& s,
 }
 
 void GenericRenderer::set_auto_attributes_on_shader(ShaderProgram& s, SubActor& buffer) {
-    /*
-     *  Binding attributes generically is hard. So we have some template magic in the send_attribute
-     *  function above that takes the VertexData member functions we need to provide the attribute
-     *  and just makes the whole thing generic. Before this was 100s of lines of boilerplate. Thank god
-     *  for templates!
-     */
-    send_attribute(s, SP_ATTR_VERTEX_POSITION, buffer.vertex_data(), &VertexData::has_positions, &VertexData::position_offset);
-    send_attribute(s, SP_ATTR_VERTEX_TEXCOORD0, buffer.vertex_data(), &VertexData::has_texcoord0, &VertexData::texcoord0_offset);
-    send_attribute(s, SP_ATTR_VERTEX_TEXCOORD1, buffer.vertex_data(), &VertexData::has_texcoord1, &VertexData::texcoord1_offset);
-    send_attribute(s, SP_ATTR_VERTEX_TEXCOORD2, buffer.vertex_data(), &VertexData::has_texcoord2, &VertexData::texcoord2_offset);
-    send_attribute(s, SP_ATTR_VERTEX_TEXCOORD3, buffer.vertex_data(), &VertexData::has_texcoord3, &VertexData::texcoord3_offset);
-    send_attribute(s, SP_ATTR_VERTEX_DIFFUSE, buffer.vertex_data(), &VertexData::has_diffuse, &VertexData::diffuse_offset);
-    send_attribute(s, SP_ATTR_VERTEX_NORMAL, buffer.vertex_data(), &VertexData::has_normals, &VertexData::normal_offset);
+    send_attribute(s, SP_ATTR_VERTEX_POSITION, buffer.vertex_data(), BM_POSITIONS);
+    send_attribute(s, SP_ATTR_VERTEX_TEXCOORD0, buffer.vertex_data(), BM_TEXCOORD_0);
+    send_attribute(s, SP_ATTR_VERTEX_TEXCOORD1, buffer.vertex_data(), BM_TEXCOORD_1);
+    send_attribute(s, SP_ATTR_VERTEX_TEXCOORD2, buffer.vertex_data(), BM_TEXCOORD_2);
+    send_attribute(s, SP_ATTR_VERTEX_TEXCOORD3, buffer.vertex_data(), BM_TEXCOORD_3);
+    send_attribute(s, SP_ATTR_VERTEX_DIFFUSE, buffer.vertex_data(), BM_DIFFUSE);
+    send_attribute(s, SP_ATTR_VERTEX_NORMAL, buffer.vertex_data(), BM_NORMALS);
 }
 
 void GenericRenderer::set_blending_mode(BlendType type) {
+    GLState& state = GLState::get();
+
     if(type == BLEND_NONE) {
-        glDisable(GL_BLEND);
+        state.disable(GL_BLEND);
         return;
     }
 
-    glEnable(GL_BLEND);
+    state.enable(GL_BLEND);
     switch(type) {
-        case BLEND_ADD: glBlendFunc(GL_ONE, GL_ONE);
+        case BLEND_ADD: state.blend_func(GL_ONE, GL_ONE);
         break;
-        case BLEND_ALPHA: glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        case BLEND_ALPHA: state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         break;
-        case BLEND_COLOUR: glBlendFunc(GL_SRC_COLOR, GL_ONE_MINUS_SRC_COLOR);
+        case BLEND_COLOUR: state.blend_func(GL_SRC_COLOR, GL_ONE_MINUS_SRC_COLOR);
         break;
-        case BLEND_MODULATE: glBlendFunc(GL_DST_COLOR, GL_ZERO);
+        case BLEND_MODULATE: state.blend_func(GL_DST_COLOR, GL_ZERO);
         break;
-        case BLEND_ONE_ONE_MINUS_ALPHA: glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        case BLEND_ONE_ONE_MINUS_ALPHA: state.blend_func(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
         break;
     default:
         throw ValueError("Invalid blend type specified");
     }
 }
 
+static GLenum convert_arrangement(MeshArrangement arrangement) {
+    switch(arrangement) {
+        case MESH_ARRANGEMENT_POINTS: return GL_POINTS;
+        case MESH_ARRANGEMENT_LINES: return GL_LINES;
+        case MESH_ARRANGEMENT_LINE_STRIP: return GL_LINE_STRIP;
+        case MESH_ARRANGEMENT_TRIANGLES: return GL_TRIANGLES;
+        case MESH_ARRANGEMENT_TRIANGLE_STRIP: return GL_TRIANGLE_STRIP;
+        case MESH_ARRANGEMENT_TRIANGLE_FAN: return GL_TRIANGLE_FAN;
+    default:
+        throw ValueError("Invalid mesh arrangement");
+    }
+}
+
+static uint32_t triangle_count(MeshArrangement arrangement, uint32_t index_count) {
+    switch(arrangement) {
+        case MESH_ARRANGEMENT_TRIANGLES: return index_count / 3;
+        case MESH_ARRANGEMENT_TRIANGLE_STRIP:
+        case MESH_ARRANGEMENT_TRIANGLE_FAN: return (index_count > 2) ? index_count - 2 : 0;
+    default:
+        return 0;
+    }
+}
+
+static GLenum convert_index_type(IndexType type) {
+    switch(type) {
+        case INDEX_TYPE_8_BIT: return GL_UNSIGNED_BYTE;
+        case INDEX_TYPE_16_BIT: return GL_UNSIGNED_SHORT;
+        case INDEX_TYPE_32_BIT: return GL_UNSIGNED_INT;
+    default:
+        throw ValueError("Invalid index type");
+    }
+}
+
+GenericRenderer::~GenericRenderer() {
+    if(!GLEE_ARB_vertex_array_object) {
+        return;
+    }
+
+    for(auto& p: vertex_arrays_) {
+        glDeleteVertexArrays(1, &p.second.vao);
+    }
+}
+
+size_t GenericRenderer::VertexArrayKeyHash::operator()(const VertexArrayKey& key) const {
+    size_t seed = std::hash<const void*>()(key.vertex_data);
+    seed ^= std::hash<const void*>()(key.index_data) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= std::hash<const void*>()(key.shader) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+}
+
+void GenericRenderer::sweep_vertex_arrays() {
+    for(auto it = vertex_arrays_.begin(); it != vertex_arrays_.end();) {
+        if(it->second.last_used <= last_sweep_) {
+            glDeleteVertexArrays(1, &it->second.vao);
+            it = vertex_arrays_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    last_sweep_ = draw_count_;
+    uint32_t doubled = vertex_arrays_.size() * 2;
+    next_sweep_size_ = (doubled > VERTEX_ARRAY_SWEEP_SIZE) ? doubled : VERTEX_ARRAY_SWEEP_SIZE;
+}
+
+/*
+ * Binds the vertex array object for this subactor and shader, building (or
+ * rebuilding) it first if need be. Returns false if VAOs aren't supported, in
+ * which case the caller has to bind the buffers and attributes itself.
+ */
+bool GenericRenderer::bind_vertex_array(ShaderProgram& s, SubActor& buffer) {
+    if(!GLEE_ARB_vertex_array_object) {
+        return false;
+    }
+
+    const VertexData& vertex_data = buffer.vertex_data();
+    const IndexData& index_data = buffer.index_data();
+
+    ++draw_count_;
+
+    VertexArrayKey key = { &vertex_data, &index_data, &s };
+    auto it = vertex_arrays_.find(key);
+    if(it == vertex_arrays_.end()) {
+        if(vertex_arrays_.size() >= next_sweep_size_) {
+            sweep_vertex_arrays();
+        }
+        it = vertex_arrays_.insert(std::make_pair(key, VertexArray())).first;
+    }
+
+    VertexArray& vertex_array = it->second;
+    vertex_array.last_used = draw_count_;
+
+    if(vertex_array.vao &&
+       vertex_array.vertex_generation == vertex_data.buffer_object().generation() &&
+       vertex_array.index_generation == index_data.buffer_object().generation() &&
+       vertex_array.attribute_generation == s.attribute_generation()) {
+
+        GLState::get().bind_vertex_array(vertex_array.vao);
+        return true;
+    }
+
+    //Start from a fresh VAO, the previous build may have enabled attributes this one doesn't use
+    if(vertex_array.vao) {
+        glDeleteVertexArrays(1, &vertex_array.vao);
+    }
+
+    glGenVertexArrays(1, &vertex_array.vao);
+    GLState::get().bind_vertex_array(vertex_array.vao);
+
+    vertex_data.buffer_object().bind();
+    index_data.buffer_object().bind();
+    set_auto_attributes_on_shader(s, buffer);
+
+    vertex_array.vertex_generation = vertex_data.buffer_object().generation();
+    vertex_array.index_generation = index_data.buffer_object().generation();
+    vertex_array.attribute_generation = s.attribute_generation();
+
+    check_and_log_error(__FILE__, __LINE__);
+    return true;
+}
+
+void GenericRenderer::disable_vertex_attributes() {
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(2);
+    glDisableVertexAttribArray(3);
+    glDisableVertexAttribArray(4);
+    glDisableVertexAttribArray(5);
+    glDisableVertexAttribArray(6);
+}
+
 void GenericRenderer::render_subactor(SubActor& buffer, CameraID camera) {
 
     ShaderProgram* active_shader = ShaderProgram::active_shader();
@@ -197,44 +351,153 @@ void GenericRenderer::render_subactor(SubActor& buffer, CameraID camera) {
         return;
     }
 
-    buffer.vertex_data().buffer_object().bind();
-    buffer.index_data().buffer_object().bind();
+    bool vao_bound = bind_vertex_array(*active_shader, buffer);
+    if(!vao_bound) {
+        buffer.vertex_data().buffer_object().bind();
+        buffer.index_data().buffer_object().bind();
+
+        //Attributes don't change per-iteration of a pass
+        set_auto_attributes_on_shader(*active_shader, buffer);
+    }
 
     check_and_log_error(__FILE__, __LINE__);
 
-    //Attributes don't change per-iteration of a pass
-    set_auto_attributes_on_shader(*active_shader, buffer);
     set_auto_uniforms_on_shader(*active_shader, camera, buffer);
 
-    //Render the mesh, once for each iteration of the pass
-    if(buffer.arrangement() == MESH_ARRANGEMENT_POINTS) {
-        glDrawElements(GL_POINTS, buffer.index_data().count(), GL_UNSIGNED_SHORT, BUFFER_OFFSET(0));
-    } else if(buffer.arrangement() == MESH_ARRANGEMENT_LINES) {
-        glDrawElements(GL_LINES, buffer.index_data().count(), GL_UNSIGNED_SHORT, BUFFER_OFFSET(0));
-    } else if(buffer.arrangement() == MESH_ARRANGEMENT_LINE_STRIP) {
-        glDrawElements(GL_LINE_STRIP, buffer.index_data().count(), GL_UNSIGNED_SHORT, BUFFER_OFFSET(0));
-    } else if(buffer.arrangement() == MESH_ARRANGEMENT_TRIANGLES) {
-        glDrawElements(GL_TRIANGLES, buffer.index_data().count(), GL_UNSIGNED_SHORT, BUFFER_OFFSET(0));
-    } else if(buffer.arrangement() == MESH_ARRANGEMENT_TRIANGLE_STRIP)  {
-        glDrawElements(GL_TRIANGLE_STRIP, buffer.index_data().count(), GL_UNSIGNED_SHORT, BUFFER_OFFSET(0));
-    } else if(buffer.arrangement() == MESH_ARRANGEMENT_TRIANGLE_FAN)  {
-        glDrawElements(GL_TRIANGLE_FAN, buffer.index_data().count(), GL_UNSIGNED_SHORT, BUFFER_OFFSET(0));
+    glDrawElements(
+        convert_arrangement(buffer.arrangement()),
+        buffer.index_data().count(),
+        convert_index_type(buffer.index_data().index_type()),
+        BUFFER_OFFSET(buffer.index_data().buffer_object().base_offset())
+    );
+
+    RenderStats& stats = RenderStats::totals();
+    ++stats.draw_calls;
+    stats.triangles += triangle_count(buffer.arrangement(), buffer.index_data().count());
+
+    /*
+     * Everything else (the UI, and anything binding an element buffer) expects
+     * the default vertex array, and would quietly modify ours if it was left bound
+     */
+    if(vao_bound) {
+        GLState::get().bind_vertex_array(0);
+    } else {
+        disable_vertex_attributes();
     }
-    else {
-        assert(0);
+
+    check_and_log_error(__FILE__, __LINE__);
+
+}
+
+bool GenericRenderer::supports_instancing(ShaderProgram& shader) const {
+    return GLEE_ARB_draw_instanced && GLEE_ARB_instanced_arrays &&
+           shader.params().uses_attribute(SP_ATTR_INSTANCE_MODEL_MATRIX);
+}
+
+void GenericRenderer::set_instanced_uniforms_on_shader(ShaderProgram& s, CameraID camera) {
+    kglt::Camera& cam = scene().camera(camera);
+
+    const kmMat4& view = cam.render_view_matrix();
+    const kmMat4& projection = cam.render_projection_matrix();
+
+    if(s.params().uses_auto(SP_AUTO_VIEW_MATRIX)) {
+        s.params().set_mat4x4(SP_AUTO_VIEW_MATRIX, view);
     }
 
+    if(s.params().uses_auto(SP_AUTO_PROJECTION_MATRIX)) {
+        s.params().set_mat4x4(SP_AUTO_PROJECTION_MATRIX, projection);
+    }
 
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(2);
-    glDisableVertexAttribArray(3);
-    glDisableVertexAttribArray(4);
-    glDisableVertexAttribArray(5);
-    glDisableVertexAttribArray(6);
+    if(s.params().uses_auto(SP_AUTO_VIEW_PROJECTION_MATRIX)) {
+        kmMat4 view_projection;
+        kmMat4Multiply(&view_projection, &projection, &view);
+        s.params().set_mat4x4(SP_AUTO_VIEW_PROJECTION_MATRIX, view_projection);
+    }
+}
+
+void GenericRenderer::render_instances(const std::vector<SubActor*>& instances, CameraID camera) {
+    ShaderProgram* active_shader = ShaderProgram::active_shader();
+    if(!active_shader) {
+        L_ERROR("No shader is bound, so nothing will be rendered");
+        return;
+    }
+
+    if(instances.size() < 2 || !supports_instancing(*active_shader)) {
+        Renderer::render_instances(instances, camera);
+        return;
+    }
+
+    SubActor& buffer = *instances.front();
+    if(!buffer.index_data().count()) {
+        return;
+    }
+
+    int32_t loc = active_shader->params().attribute_location(SP_ATTR_INSTANCE_MODEL_MATRIX);
+
+    if(loc < 0) {
+        L_WARN("Couldn't locate the instance matrix attribute on the shader");
+        Renderer::render_instances(instances, camera);
+        return;
+    }
+
+    instance_matrices_.resize(instances.size());
+    for(uint32_t i = 0; i < instances.size(); ++i) {
+        instance_matrices_[i] = instances[i]->_parent().render_transformation();
+    }
+
+    bool vao_bound = bind_vertex_array(*active_shader, buffer);
+    if(!vao_bound) {
+        buffer.vertex_data().buffer_object().bind();
+        buffer.index_data().buffer_object().bind();
+        set_auto_attributes_on_shader(*active_shader, buffer);
+    }
+
+    set_instanced_uniforms_on_shader(*active_shader, camera);
+
+    //Respecifying the whole buffer each batch lets the driver orphan the old storage
+    //rather than stalling until the previous draw has finished reading it
+    instance_buffer_.create(sizeof(kmMat4) * instance_matrices_.size(), &instance_matrices_[0]);
+
+    for(uint8_t column = 0; column < 4; ++column) {
+        glEnableVertexAttribArray(loc + column);
+        glVertexAttribPointer(
+            loc + column,
+            4,
+            GL_FLOAT,
+            GL_FALSE,
+            sizeof(kmMat4),
+            BUFFER_OFFSET(sizeof(float) * 4 * column)
+        );
+        glVertexAttribDivisorARB(loc + column, 1);
+    }
 
     check_and_log_error(__FILE__, __LINE__);
 
+    glDrawElementsInstancedARB(
+        convert_arrangement(buffer.arrangement()),
+        buffer.index_data().count(),
+        convert_index_type(buffer.index_data().index_type()),
+        BUFFER_OFFSET(buffer.index_data().buffer_object().base_offset()),
+        instances.size()
+    );
+
+    RenderStats& stats = RenderStats::totals();
+    ++stats.draw_calls;
+    stats.triangles += triangle_count(buffer.arrangement(), buffer.index_data().count()) * instances.size();
+
+    //The instance matrix arrays were recorded into the VAO, if there is one, so put it back as it was built
+    for(uint8_t column = 0; column < 4; ++column) {
+        glVertexAttribDivisorARB(loc + column, 0);
+        glDisableVertexAttribArray(loc + column);
+    }
+
+    if(vao_bound) {
+        GLState::get().bind_vertex_array(0);
+    } else {
+        disable_vertex_attributes();
+    }
+
+    check_and_log_error(__FILE__, __LINE__);
 }
 
 }
@@ -2,25 +2,87 @@
 #define GENERIC_RENDERER_H
 
 #include <vector>
+#include <unordered_map>
 
 #include "../utils/geometry_buffer.h"
 #include "../renderer.h"
 #include "../material.h"
+#include "../buffer_object.h"
 
 namespace kglt {
 
+class VertexData;
+class IndexData;
+
 class GenericRenderer : public Renderer {
 public:
     GenericRenderer(Scene& scene):
-        Renderer(scene) {}
+        Renderer(scene),
+        instance_buffer_(BUFFER_OBJECT_VERTEX_DATA, MODIFY_ONCE_USED_FOR_LIMITED_RENDERING),
+        next_sweep_size_(VERTEX_ARRAY_SWEEP_SIZE) {}
+
+    ~GenericRenderer();
+
+    /*
+     * The number of cached vertex array objects that triggers a sweep of the ones
+     * that haven't been drawn with since the last sweep (their vertex data, index
+     * data or shader has probably been destroyed)
+     */
+    static const uint32_t VERTEX_ARRAY_SWEEP_SIZE = 1024;
 
 private:
     void render_subactor(SubActor& mesh, CameraID camera);
 
+    bool supports_instancing(ShaderProgram& shader) const;
+    void render_instances(const std::vector<SubActor*>& instances, CameraID camera);
+    void set_instanced_uniforms_on_shader(ShaderProgram& s, CameraID camera);
+
     void set_auto_uniforms_on_shader(ShaderProgram& s, CameraID camera, SubActor &subactor);
 
     void set_auto_attributes_on_shader(ShaderProgram& s, SubActor &buffer);
     void set_blending_mode(BlendType type);
+
+    BufferObject instance_buffer_;
+    std::vector<kmMat4> instance_matrices_;
+
+    /*
+     * A vertex array object per vertex data, index data and shader combination.
+     * The attribute pointers and the element buffer are captured when the VAO is
+     * built, so drawing with one is a single glBindVertexArray. Each VAO remembers
+     * the generations of the buffers and program it was built from and is
+     * respecified when any of them move on (new storage, a new streamed region,
+     * or different attribute locations).
+     */
+    struct VertexArrayKey {
+        const VertexData* vertex_data;
+        const IndexData* index_data;
+        const ShaderProgram* shader;
+
+        bool operator==(const VertexArrayKey& rhs) const {
+            return vertex_data == rhs.vertex_data && index_data == rhs.index_data && shader == rhs.shader;
+        }
+    };
+
+    struct VertexArrayKeyHash {
+        size_t operator()(const VertexArrayKey& key) const;
+    };
+
+    struct VertexArray {
+        uint32_t vao = 0;
+        uint64_t vertex_generation = 0;
+        uint64_t index_generation = 0;
+        uint64_t attribute_generation = 0;
+        uint64_t last_used = 0;
+    };
+
+    std::unordered_map<VertexArrayKey, VertexArray, VertexArrayKeyHash> vertex_arrays_;
+    uint64_t draw_count_ = 0;
+    uint64_t last_sweep_ = 0;
+    uint32_t next_sweep_size_;
+
+    bool bind_vertex_array(ShaderProgram& s, SubActor& buffer);
+    void sweep_vertex_arrays();
+    void disable_vertex_attributes();
 };
 
 }
@@ -2,7 +2,9 @@
 #define RESOURCE_H
 
 #include <cassert>
+#include <chrono>
 #include <mutex>
+#include <string>
 
 namespace kglt {
 
@@ -21,6 +23,10 @@ public:
 
     std::recursive_mutex& mutex() { return mutex_; }
 
+    //The file it was loaded from, empty if it wasn't
+    const std::string& source_file() const { return source_file_; }
+    void set_source_file(const std::string& filename) { source_file_ = filename; }
+
     int age() const {
         return std::chrono::duration_cast<std::chrono::seconds>(
                     created_ - std::chrono::system_clock::now()
@@ -33,6 +39,8 @@ private:
 
     std::chrono::time_point<std::chrono::system_clock> created_;
     std::recursive_mutex mutex_;
+
+    std::string source_file_;
 };
 
 }
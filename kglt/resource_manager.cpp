@@ -1,11 +1,53 @@
 #include "window_base.h"
 #include "resource_manager.h"
 #include "loader.h"
+#include "utils/gl_thread_check.h"
+#include "utils/thread_pool.h"
+#include "texture_atlas.h"
 
 #include "kazbase/datetime.h"
 
 namespace kglt {
 
+/*
+ * Runs load() on the loader pool. Anything it needs to do with GL is queued as an
+ * upload idle task as it goes, so once it returns a task is queued behind all of that and
+ * the future is only made ready when it runs. keep_alive holds a reference to the
+ * resource until then so that it can't be garbage collected with uploads outstanding.
+ * finished() runs in that task, on the main thread, so it's where any GL work that
+ * can't be queued by load() belongs. If load() or finished() throws, so does get().
+ */
+template<typename ID>
+static std::shared_future<ID> load_async(
+        ThreadPool& pool, IdleTaskManager& idle, ID id, std::shared_ptr<void> keep_alive,
+        std::function<void ()> load, std::function<void ()> finished) {
+
+    auto promise = std::make_shared<std::promise<ID> >();
+    std::shared_future<ID> result = promise->get_future().share();
+
+    pool.submit([=, &idle]() {
+        try {
+            load();
+        } catch(...) {
+            promise->set_exception(std::current_exception());
+            return;
+        }
+
+        idle.add_once([=]() {
+            (void) keep_alive;
+            try {
+                finished();
+            } catch(...) {
+                promise->set_exception(std::current_exception());
+                return;
+            }
+            promise->set_value(id);
+        }, IDLE_TASK_PRIORITY_UPLOAD);
+    });
+
+    return result;
+}
+
 ResourceManagerImpl::ResourceManagerImpl(WindowBase* window):
     window_(window) {
 
@@ -14,6 +56,21 @@ ResourceManagerImpl::ResourceManagerImpl(WindowBase* window):
     ShaderManager::signal_post_create().connect(sigc::mem_fun(this, &ResourceManagerImpl::post_create_shader_callback));
 }
 
+ResourceManagerImpl::~ResourceManagerImpl() {
+    //Finish any loads in progress while the managers they load into still exist
+    loader_pool_.reset();
+    atlas_.reset();
+}
+
+ThreadPool& ResourceManagerImpl::loader_pool() {
+    std::lock_guard<std::mutex> lock(loader_pool_mutex_);
+    if(!loader_pool_) {
+        loader_pool_.reset(new ThreadPool("Loader"));
+    }
+
+    return *loader_pool_;
+}
+
 void ResourceManagerImpl::update() {
     static datetime::DateTime last_collection = datetime::now();
 
@@ -69,9 +126,27 @@ MeshID ResourceManagerImpl::new_mesh_from_file(const unicode& path) {
     //Load the material
     MeshPtr m = mesh(new_mesh()).lock();
     window().loader_for(path.encode())->into(*m);
+
+    if(!GLThreadCheck::is_current()) {
+        //The buffers were queued for upload on the main thread, wait for them so the mesh is usable
+        window().idle().add_once([]() {}, IDLE_TASK_PRIORITY_UPLOAD).wait();
+    }
+
     return m->id();
 }
 
+std::shared_future<MeshID> ResourceManagerImpl::new_mesh_from_file_async(const unicode& path) {
+    MeshPtr m = mesh(new_mesh()).lock();
+    WindowBase* window = window_;
+
+    return load_async<MeshID>(loader_pool(), window->idle(), m->id(), m, [=]() {
+        window->loader_for(path.encode())->into(*m);
+    }, [=]() {
+        //Give whoever is waiting on the future a chance to claim it before it's collected
+        MeshManager::mark_as_uncollected(m->id());
+    });
+}
+
 bool ResourceManagerImpl::has_mesh(MeshID m) const {
     return MeshManager::manager_contains(m);
 }
@@ -89,9 +164,28 @@ MaterialID ResourceManagerImpl::new_material_from_file(const unicode& path) {
     //Load the material
     auto mat = material(new_material());
     window().loader_for(path.encode())->into(*mat);
+    mat->set_source_file(path.encode());
     return mat->id();
 }
 
+std::shared_future<MaterialID> ResourceManagerImpl::new_material_from_file_async(const unicode& path) {
+    MaterialPtr mat = MaterialManager::manager_get(new_material()).lock();
+    WindowBase* window = window_;
+
+    auto loader = std::make_shared<LoaderPtr>();
+
+    return load_async<MaterialID>(loader_pool(), window->idle(), mat->id(), mat, [=]() {
+        *loader = window->loader_for(path.encode());
+    }, [=]() {
+        //Generating the material compiles its shaders, so all of it has to happen on the main thread
+        (*loader)->into(*mat);
+        mat->set_source_file(path.encode());
+
+        //Give whoever is waiting on the future a chance to claim it before it's collected
+        MaterialManager::mark_as_uncollected(mat->id());
+    });
+}
+
 MaterialID ResourceManagerImpl::clone_material(MaterialID mat) {
     MaterialID result = MaterialManager::manager_clone(mat);
     return result;
@@ -125,10 +219,35 @@ TextureID ResourceManagerImpl::new_texture_from_file(const unicode& path) {
     //Load the texture
     auto tex = texture(new_texture());
     window().loader_for(path.encode())->into(*tex);
+    tex->set_source_file(path.encode());
     tex->upload(false, true, true, false);
     return tex->id();
 }
 
+std::shared_future<TextureID> ResourceManagerImpl::new_texture_from_file_async(const unicode& path) {
+    TexturePtr tex = TextureManager::manager_get(new_texture()).lock();
+    WindowBase* window = window_;
+
+    return load_async<TextureID>(loader_pool(), window->idle(), tex->id(), tex, [=]() {
+        window->loader_for(path.encode())->into(*tex);
+        tex->set_source_file(path.encode());
+    }, [=]() {
+        tex->__do_upload(false, true, true, false);
+
+        //Give whoever is waiting on the future a chance to claim it before it's collected
+        TextureManager::mark_as_uncollected(tex->id());
+    });
+}
+
+TextureAtlas& ResourceManagerImpl::atlas() {
+    std::lock_guard<std::mutex> lock(atlas_mutex_);
+    if(!atlas_) {
+        atlas_.reset(new TextureAtlas(*this));
+    }
+
+    return *atlas_;
+}
+
 ProtectedPtr<Texture> ResourceManagerImpl::texture(TextureID t) {
     return ProtectedPtr<Texture>(TextureManager::manager_get(t).lock());
 }
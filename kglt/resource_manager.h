@@ -3,6 +3,8 @@
 
 #include <string>
 #include <map>
+#include <memory>
+#include <future>
 
 #include "generic/refcount_manager.h"
 #include "generic/data_carrier.h"
@@ -55,6 +57,15 @@ private:
     std::shared_ptr<guard_type> lock_;
 };
 
+class ThreadPool;
+class TextureAtlas;
+
+/*
+ *  The *_from_file_async functions return straight away and load the file on a pool of
+ *  loader threads. Their GL work is queued as upload idle tasks so it's spread
+ *  across frames, and the future becomes ready once the resource can be used (or holds
+ *  the exception that stopped it loading).
+ */
 class ResourceManager {
 public:
     virtual ~ResourceManager() {}
@@ -62,6 +73,7 @@ public:
     //Mesh functions
     virtual MeshID new_mesh() = 0;
     virtual MeshID new_mesh_from_file(const unicode& path) = 0;
+    virtual std::shared_future<MeshID> new_mesh_from_file_async(const unicode& path) = 0;
 
     virtual MeshRef mesh(MeshID m) = 0;
     virtual const MeshRef mesh(MeshID m) const = 0;
@@ -73,6 +85,7 @@ public:
     //Texture functions
     virtual TextureID new_texture() = 0;
     virtual TextureID new_texture_from_file(const unicode& path) = 0;
+    virtual std::shared_future<TextureID> new_texture_from_file_async(const unicode& path) = 0;
 
     virtual ProtectedPtr<Texture> texture(TextureID t) = 0;
     virtual const ProtectedPtr<Texture> texture(TextureID t) const = 0;
@@ -81,6 +94,9 @@ public:
     virtual uint32_t texture_count() const = 0;
     virtual void mark_texture_as_uncollected(TextureID t) = 0;
 
+    //Shared pages for sprites, sprite sheets and other small images
+    virtual TextureAtlas& atlas() = 0;
+
     //Shader functions
     virtual ShaderID new_shader() = 0;
 
@@ -105,6 +121,7 @@ public:
     //Material functions
     virtual MaterialID new_material() = 0;
     virtual MaterialID new_material_from_file(const unicode& path) = 0;
+    virtual std::shared_future<MaterialID> new_material_from_file_async(const unicode& path) = 0;
 
     virtual ProtectedPtr<Material> material(MaterialID t) = 0;
     virtual const ProtectedPtr<Material> material(MaterialID t) const = 0;
@@ -130,9 +147,11 @@ class ResourceManagerImpl:
 
 public:
     ResourceManagerImpl(WindowBase* window);
+    ~ResourceManagerImpl();
 
     MeshID new_mesh();
     MeshID new_mesh_from_file(const unicode& path);
+    std::shared_future<MeshID> new_mesh_from_file_async(const unicode& path);
 
     MeshRef mesh(MeshID m);
     const MeshRef mesh(MeshID m) const;
@@ -142,11 +161,13 @@ public:
 
     TextureID new_texture();
     TextureID new_texture_from_file(const unicode& path);
+    std::shared_future<TextureID> new_texture_from_file_async(const unicode& path);
     ProtectedPtr<Texture> texture(TextureID t);
     const ProtectedPtr<Texture> texture(TextureID t) const;
     bool has_texture(TextureID t) const;
     uint32_t texture_count() const;
     void mark_texture_as_uncollected(TextureID t) override;
+    TextureAtlas& atlas() override;
 
     ShaderID new_shader();
     ShaderRef shader(ShaderID s);
@@ -158,6 +179,7 @@ public:
 
     MaterialID new_material();
     MaterialID new_material_from_file(const unicode& path);
+    std::shared_future<MaterialID> new_material_from_file_async(const unicode& path);
     MaterialID clone_material(MaterialID mat);
 
     ProtectedPtr<Material> material(MaterialID material);
@@ -194,6 +216,15 @@ private:
 
     generic::DataCarrier data_carrier_;
 
+    //Created the first time something is loaded asynchronously
+    std::unique_ptr<ThreadPool> loader_pool_;
+    std::mutex loader_pool_mutex_;
+    ThreadPool& loader_pool();
+
+    //Created the first time anything is added to it
+    std::unique_ptr<TextureAtlas> atlas_;
+    std::mutex atlas_mutex_;
+
     template<typename Func>
     void apply_func_to_materials(Func func) {
         MaterialManager::ObjectMap copy;
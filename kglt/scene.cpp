@@ -13,6 +13,7 @@
 
 #include "shaders/default_shaders.h"
 #include "window_base.h"
+#include "utils/profiler.h"
 
 namespace kglt {
 
@@ -20,7 +21,8 @@ Scene::Scene(WindowBase* window):
     ResourceManagerImpl(window),
     default_texture_(0),
     default_material_(0),
-    render_sequence_(new RenderSequence(*this)) {
+    render_sequence_(new RenderSequence(*this)),
+    parallel_update_(false) {
 
     CameraManager::signal_post_create().connect(sigc::mem_fun(this, &Scene::post_create_callback<Camera, CameraID>));
 }
@@ -183,9 +185,59 @@ bool Scene::init() {
 }
 
 void Scene::update(double dt) {
-    //Update the stages
-    StageManager::apply_func_to_objects(std::bind(&Object::update, std::tr1::placeholders::_1, dt));
-    CameraManager::apply_func_to_objects(std::bind(&Object::update, std::tr1::placeholders::_1, dt));
+    KGLT_PROFILE_SCOPE("Scene::update");
+
+    if(!parallel_update_) {
+        //Update the stages
+        StageManager::apply_func_to_objects(std::bind(&Object::update, std::tr1::placeholders::_1, dt));
+        CameraManager::apply_func_to_objects(std::bind(&Object::update, std::tr1::placeholders::_1, dt));
+        return;
+    }
+
+    //The stages themselves are updated here, then everything beneath them is updated
+    //as its own job, with the stages holding on to the moves until all of them finish
+    std::vector<Stage*> stages;
+    std::vector<Object*> roots;
+    StageManager::apply_func_to_objects([&](Stage* stage) {
+        stage->do_update(dt);
+        stage->defer_moves_ = true;
+        stages.push_back(stage);
+        roots.insert(roots.end(), stage->children().begin(), stage->children().end());
+    });
+
+    auto update_roots = [&](uint32_t first, uint32_t last) {
+        for(uint32_t i = first; i < last; ++i) {
+            roots[i]->update(dt);
+        }
+    };
+
+    try {
+        window().jobs().parallel_for(0, roots.size(), 1, update_roots);
+
+        //Cameras can follow actors, so they only move once the actors have finished moving
+        roots.clear();
+        CameraManager::apply_func_to_objects([&](Camera* camera) {
+            roots.push_back(camera);
+        });
+
+        window().jobs().parallel_for(0, roots.size(), 1, update_roots);
+    } catch(...) {
+        for(Stage* stage: stages) {
+            stage->apply_deferred_moves();
+        }
+        throw;
+    }
+
+    for(Stage* stage: stages) {
+        stage->apply_deferred_moves();
+    }
+}
+
+void Scene::snapshot_transformations() {
+    KGLT_PROFILE_SCOPE("Scene::snapshot_transformations");
+
+    StageManager::apply_func_to_objects(std::bind(&Stage::snapshot_transformations, std::tr1::placeholders::_1));
+    CameraManager::apply_func_to_objects(std::bind(&Camera::snapshot_transformation, std::tr1::placeholders::_1));
 }
 
 void Scene::render() {
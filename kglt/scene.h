@@ -54,6 +54,21 @@ public:
     void render();
     void update(double dt);
 
+    //Takes the render transformation snapshot of every stage and camera, see Object::render_transformation()
+    void snapshot_transformations();
+
+    /*
+     * Off by default. When on, update() splits the objects in each stage across the
+     * window's JobSystem, one top level object and everything attached to it per job,
+     * then does the same for the cameras. A do_update() can move its own object and
+     * anything attached to it: the stage collects the moves and passes them on to the
+     * partitioner and the transformation snapshot after the jobs finish. Only turn it
+     * on if every do_update() is safe to run alongside the others, and none of them
+     * create or destroy anything, or move objects from another hierarchy.
+     */
+    void set_parallel_update(bool value=true) { parallel_update_ = value; }
+    bool parallel_update() const { return parallel_update_; }
+
     MaterialID clone_default_material();
     MaterialID default_material_id() const;
     TextureID default_texture_id() const;
@@ -86,6 +101,8 @@ private:
 
     std::shared_ptr<RenderSequence> render_sequence_;
 
+    bool parallel_update_;
+
     friend class WindowBase;
 };
 
@@ -0,0 +1,130 @@
+#include <sstream>
+
+#include "../scene.h"
+#include "../render_sequence.h"
+#include "../render_stats.h"
+#include "../ui_stage.h"
+#include "../camera.h"
+#include "../window_base.h"
+#include "../utils/gl_state.h"
+
+#include "render_stats_overlay.h"
+
+namespace kglt {
+namespace screens {
+
+const double REFRESH_INTERVAL = 0.25;
+
+RenderStatsOverlay::RenderStatsOverlay(Scene& scene):
+    scene_(scene),
+    is_active_(false),
+    last_refresh_(0) {
+
+    stage_ = scene.new_ui_stage();
+
+    auto stage = scene.ui_stage(stage_);
+
+    stage->set_styles(R"X(
+        #render-stats {
+            position: absolute;
+            display: block;
+            top: 0px;
+            right: 0px;
+            padding: 4px;
+
+            font-family: "Ubuntu Mono";
+            font-size: 14px;
+            white-space: pre;
+            color: white;
+            background-color: #00000088;
+        }
+    )X");
+
+    stage->append("<div>").id("render-stats");
+
+    camera_ = scene.new_camera();
+
+    scene.camera(camera_).set_orthographic_projection(
+        0, scene_.window().width(), scene_.window().height(), 0
+    );
+
+    pipeline_ = scene.render_sequence().new_pipeline(
+        stage_,
+        camera_,
+        ViewportID(),
+        TextureID(),
+        PIPELINE_PRIORITY
+    );
+
+    scene.render_sequence().pipeline(pipeline_).deactivate();
+}
+
+RenderStatsOverlay::~RenderStatsOverlay() {
+    frame_finished_connection_.disconnect();
+
+    scene_.render_sequence().delete_pipeline(pipeline_);
+    scene_.delete_ui_stage(stage_);
+    scene_.delete_camera(camera_);
+}
+
+void RenderStatsOverlay::activate() {
+    if(is_active_) {
+        return;
+    }
+
+    is_active_ = true;
+    scene_.render_sequence().pipeline(pipeline_).activate();
+
+    frame_finished_connection_ = scene_.window().signal_frame_finished().connect(
+        sigc::mem_fun(this, &RenderStatsOverlay::refresh)
+    );
+
+    last_refresh_ = 0;
+    refresh();
+}
+
+void RenderStatsOverlay::deactivate() {
+    if(!is_active_) {
+        return;
+    }
+
+    is_active_ = false;
+    scene_.render_sequence().pipeline(pipeline_).deactivate();
+    frame_finished_connection_.disconnect();
+}
+
+void RenderStatsOverlay::toggle() {
+    if(is_active_) {
+        deactivate();
+    } else {
+        activate();
+    }
+}
+
+void RenderStatsOverlay::refresh() {
+    double now = scene_.window().total_time();
+    if(last_refresh_ && now - last_refresh_ < REFRESH_INTERVAL) {
+        return;
+    }
+
+    last_refresh_ = now;
+
+    const RenderStats& stats = scene_.render_sequence().frame_stats();
+    const GLStateStats& state = GLState::get().last_frame_stats();
+
+    std::ostringstream text;
+    text << "Draw calls:      " << stats.draw_calls << "\n"
+         << "Triangles:       " << stats.triangles << "\n"
+         << "Visible/culled:  " << stats.visible_subactors << "/" << stats.culled_subactors << "\n"
+         << "Shader binds:    " << stats.shader_binds << "\n"
+         << "Texture binds:   " << stats.texture_binds << "\n"
+         << "Uniform uploads: " << stats.uniform_uploads << "\n"
+         << "Uploaded:        " << stats.bytes_uploaded() / 1024 << "KB\n"
+         << "Buffer stalls:   " << stats.buffer_stalls << "\n"
+         << "State changes:   " << state.issued << " (" << state.elided << " elided)";
+
+    scene_.ui_stage(stage_)->$("#render-stats").text(unicode(text.str()));
+}
+
+}
+}
@@ -0,0 +1,52 @@
+#ifndef RENDER_STATS_OVERLAY_H
+#define RENDER_STATS_OVERLAY_H
+
+#include <sigc++/sigc++.h>
+
+#include "../generic/managed.h"
+#include "../types.h"
+
+namespace kglt {
+
+class Scene;
+
+namespace screens {
+
+/*
+ * A UI stage drawn over everything else which shows RenderSequence::frame_stats()
+ * and the GL state changes of the last frame. The text is refreshed a few times a
+ * second rather than every frame so that it's readable (and cheap).
+ */
+class RenderStatsOverlay:
+    public Managed<RenderStatsOverlay> {
+
+public:
+    RenderStatsOverlay(Scene& scene);
+    ~RenderStatsOverlay();
+
+    void activate();
+    void deactivate();
+    void toggle();
+
+    bool is_active() const { return is_active_; }
+
+    static const int32_t PIPELINE_PRIORITY = 1000;
+
+private:
+    Scene& scene_;
+    bool is_active_;
+
+    UIStageID stage_;
+    CameraID camera_;
+    PipelineID pipeline_;
+
+    sigc::connection frame_finished_connection_;
+    double last_refresh_;
+
+    void refresh();
+};
+
+}
+}
+
+#endif // RENDER_STATS_OVERLAY_H
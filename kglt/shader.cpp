@@ -1,9 +1,13 @@
 #include <GLee.h>
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include <boost/format.hpp>
 
 #include "utils/gl_thread_check.h"
 #include "utils/gl_error.h"
+#include "utils/gl_state.h"
+#include "render_stats.h"
 #include "kazbase/logging.h"
 #include "kglt/kazbase/exceptions.h"
 #include "kglt/kazbase/list_utils.h"
@@ -17,14 +21,81 @@ ShaderProgram* ShaderProgram::active_shader_ = nullptr;
 ShaderParams::ShaderParams(ShaderProgram& parent):
     program_(parent) {
 
+    std::fill(auto_uniform_locations_, auto_uniform_locations_ + SP_AUTO_MAX, -1);
+    std::fill(auto_attribute_locations_, auto_attribute_locations_ + SP_ATTR_MAX, -1);
 }
 
 void ShaderParams::register_auto(ShaderAvailableAuto auto_const, const std::string& uniform_name) {
-    auto_uniforms_[auto_const] = uniform_name;
+    auto_uniform_names_[auto_const] = uniform_name;
+
+    if(program_.is_linked()) {
+        resolve_location(auto_const);
+    }
+}
+
+static uint64_t next_attribute_generation() {
+    static uint64_t generation = 0;
+    return ++generation;
 }
 
 void ShaderParams::register_attribute(ShaderAvailableAttributes attr_const, const std::string& attrib_name) {
-    auto_attributes_[attr_const] = attrib_name;
+    auto_attribute_names_[attr_const] = attrib_name;
+
+    if(program_.is_linked()) {
+        resolve_location(attr_const);
+    }
+
+    program_.attribute_generation_ = next_attribute_generation();
+}
+
+void ShaderParams::resolve_location(ShaderAvailableAuto auto_const) {
+    const std::string& name = auto_uniform_names_[auto_const];
+    auto_uniform_locations_[auto_const] = (name.empty()) ? -1 : program_.get_uniform_loc(name);
+}
+
+void ShaderParams::resolve_location(ShaderAvailableAttributes attr_const) {
+    const std::string& name = auto_attribute_names_[attr_const];
+    auto_attribute_locations_[attr_const] = (name.empty()) ? -1 : program_.get_attrib_loc(name);
+}
+
+void ShaderParams::resolve_locations() {
+    for(uint32_t i = 0; i < SP_AUTO_MAX; ++i) {
+        resolve_location(ShaderAvailableAuto(i));
+    }
+
+    for(uint32_t i = 0; i < SP_ATTR_MAX; ++i) {
+        resolve_location(ShaderAvailableAttributes(i));
+    }
+}
+
+void ShaderParams::set_int(ShaderAvailableAuto auto_const, const int32_t value) {
+    program_.set_uniform(auto_uniform_locations_[auto_const], (int32_t) value);
+}
+
+void ShaderParams::set_float(ShaderAvailableAuto auto_const, const float value) {
+    program_.set_uniform(auto_uniform_locations_[auto_const], (float) value);
+}
+
+void ShaderParams::set_mat4x4(ShaderAvailableAuto auto_const, const kmMat4& values) {
+    program_.set_uniform(auto_uniform_locations_[auto_const], &values);
+}
+
+void ShaderParams::set_mat3x3(ShaderAvailableAuto auto_const, const kmMat3& values) {
+    program_.set_uniform(auto_uniform_locations_[auto_const], &values);
+}
+
+void ShaderParams::set_vec3(ShaderAvailableAuto auto_const, const kmVec3& values) {
+    program_.set_uniform(auto_uniform_locations_[auto_const], &values);
+}
+
+void ShaderParams::set_vec4(ShaderAvailableAuto auto_const, const kmVec4& values) {
+    program_.set_uniform(auto_uniform_locations_[auto_const], &values);
+}
+
+void ShaderParams::set_colour(ShaderAvailableAuto auto_const, const Colour& values) {
+    kmVec4 tmp;
+    kmVec4Fill(&tmp, values.r, values.g, values.b, values.a);
+    set_vec4(auto_const, tmp);
 }
 
 void ShaderParams::set_int(const std::string& uniform_name, const int32_t value) {
@@ -65,6 +136,8 @@ ShaderProgram::ShaderProgram(ResourceManager* resource_manager, ShaderID id):
     Resource(resource_manager),
     generic::Identifiable<ShaderID>(id),
     program_id_(0),
+    linked_(false),
+    attribute_generation_(next_attribute_generation()),
     params_(*this) {
 
     for(uint32_t i = 0; i < SHADER_TYPE_MAX; ++i) {
@@ -83,6 +156,7 @@ ShaderProgram::~ShaderProgram() {
         }
 
         if(program_id_) {
+            GLState::get().program_deleted(program_id_);
             glDeleteProgram(program_id_);
         }
         check_and_log_error(__FILE__, __LINE__);
@@ -92,7 +166,7 @@ ShaderProgram::~ShaderProgram() {
 void ShaderProgram::activate() {
     GLThreadCheck::check();
 
-    glUseProgram(program_id_);
+    GLState::get().use_program(program_id_);
     check_and_log_error(__FILE__, __LINE__);
 
     active_shader_ = this;
@@ -101,7 +175,7 @@ void ShaderProgram::activate() {
 void ShaderProgram::deactivate() {
     GLThreadCheck::check();
 
-    glUseProgram(0);
+    GLState::get().use_program(0);
     active_shader_ = nullptr;
 }
 
@@ -202,6 +276,14 @@ void ShaderProgram::relink() {
         L_ERROR(std::string(log.begin(), log.end()));
     }
     assert(linked);
+
+    linked_ = linked;
+
+    //Locations can change, and all uniforms go back to their defaults, when a program is relinked
+    cached_uniform_locations_.clear();
+    uniform_shadow_.clear();
+    params_.resolve_locations();
+    attribute_generation_ = next_attribute_generation();
 }
 
 int32_t ShaderProgram::get_attrib_loc(const std::string& name) {
@@ -237,79 +319,172 @@ bool ShaderProgram::has_uniform(const std::string& name) {
     return get_uniform_loc(name) != -1;
 }
 
-void ShaderProgram::set_uniform(const std::string& name, const float x) {
+/*
+ * Locations this high are unusual, and not worth a shadow entry for each one
+ * below them
+ */
+const int32_t MAX_SHADOWED_UNIFORM_LOCATION = 1024;
+
+bool ShaderProgram::uniform_changed(int32_t loc, const void* data, uint8_t size) {
+    assert(size <= 16);
+
+    if(loc >= MAX_SHADOWED_UNIFORM_LOCATION) {
+        return true;
+    }
+
+    if(loc >= (int32_t) uniform_shadow_.size()) {
+        UniformShadow empty;
+        empty.size = 0;
+        uniform_shadow_.resize(loc + 1, empty);
+    }
+
+    UniformShadow& shadow = uniform_shadow_[loc];
+    if(shadow.size == size && memcmp(shadow.data, data, size * sizeof(float)) == 0) {
+        return false;
+    }
+
+    shadow.size = size;
+    memcpy(shadow.data, data, size * sizeof(float));
+    return true;
+}
+
+void ShaderProgram::set_uniform(int32_t loc, const float x) {
+    if(loc < 0 || !uniform_changed(loc, &x, 1)) {
+        return;
+    }
+
     GLThreadCheck::check();
 
-    activate();
-    int32_t loc = get_uniform_loc(name);
-    if(loc > -1) {
-        glUniform1f(loc, x);
+    if(active_shader_ != this) {
+        activate();
     }
+
+    glUniform1f(loc, x);
+    ++RenderStats::totals().uniform_uploads;
 }
 
-void ShaderProgram::set_uniform(const std::string& name, const int32_t x) {
+void ShaderProgram::set_uniform(int32_t loc, const int32_t x) {
+    if(loc < 0 || !uniform_changed(loc, &x, 1)) {
+        return;
+    }
+
     GLThreadCheck::check();
 
-    activate();
-    int32_t loc = get_uniform_loc(name);
-    if(loc > -1) {
-        glUniform1i(loc, x);
+    if(active_shader_ != this) {
+        activate();
     }
+
+    glUniform1i(loc, x);
+    ++RenderStats::totals().uniform_uploads;
 }
 
-void ShaderProgram::set_uniform(const std::string& name, const kmMat4* matrix) {
+void ShaderProgram::set_uniform(int32_t loc, const kmMat4* matrix) {
+    float mat[16];
+    unsigned char i = 16;
+    while(i--) { mat[i] = (float) matrix->mat[i]; }
+
+    if(loc < 0 || !uniform_changed(loc, mat, 16)) {
+        return;
+    }
+
     GLThreadCheck::check();
 
-    activate();
-    GLint loc = get_uniform_loc(name);
-    if(loc > -1) {
-        float mat[16];
-        unsigned char i = 16;
-        while(i--) { mat[i] = (float) matrix->mat[i]; }
-        glUniformMatrix4fv(loc, 1, false, (GLfloat*)mat);
+    if(active_shader_ != this) {
+        activate();
     }
+
+    glUniformMatrix4fv(loc, 1, false, (GLfloat*)mat);
+    ++RenderStats::totals().uniform_uploads;
 }
 
-void ShaderProgram::set_uniform(const std::string& name, const kmMat3* matrix) {
+void ShaderProgram::set_uniform(int32_t loc, const kmMat3* matrix) {
+    float mat[9];
+    unsigned char i = 9;
+    while(i--) { mat[i] = (float) matrix->mat[i]; }
+
+    if(loc < 0 || !uniform_changed(loc, mat, 9)) {
+        return;
+    }
+
     GLThreadCheck::check();
 
-    activate();
-    GLint loc = get_uniform_loc(name);
-    if(loc > -1) {
-        float mat[9];
-        unsigned char i = 9;
-        while(i--) { mat[i] = (float) matrix->mat[i]; }
-        glUniformMatrix3fv(loc, 1, false, (GLfloat*)mat);
+    if(active_shader_ != this) {
+        activate();
     }
+
+    glUniformMatrix3fv(loc, 1, false, (GLfloat*)mat);
+    ++RenderStats::totals().uniform_uploads;
 }
 
-void ShaderProgram::set_uniform(const std::string& name, const kmVec3* vec) {
+void ShaderProgram::set_uniform(int32_t loc, const kmVec3* vec) {
+    if(loc < 0 || !uniform_changed(loc, vec, 3)) {
+        return;
+    }
+
     GLThreadCheck::check();
 
-    activate();
-    GLint loc = get_uniform_loc(name);
-    if(loc >= 0) {
-        glUniform3fv(loc, 1, (GLfloat*) vec);
+    if(active_shader_ != this) {
+        activate();
     }
+
+    glUniform3fv(loc, 1, (GLfloat*) vec);
+    ++RenderStats::totals().uniform_uploads;
 }
 
-void ShaderProgram::set_uniform(const std::string& name, const kmVec4* vec) {
+void ShaderProgram::set_uniform(int32_t loc, const kmVec4* vec) {
+    if(loc < 0 || !uniform_changed(loc, vec, 4)) {
+        return;
+    }
+
     GLThreadCheck::check();
 
-    activate();
-    GLint loc = get_uniform_loc(name);
-    if(loc >= 0) {
-        glUniform4fv(loc, 1, (GLfloat*) vec);
+    if(active_shader_ != this) {
+        activate();
     }
+
+    glUniform4fv(loc, 1, (GLfloat*) vec);
+    ++RenderStats::totals().uniform_uploads;
+}
+
+void ShaderProgram::set_uniform(const std::string& name, const float x) {
+    set_uniform(get_uniform_loc(name), x);
+}
+
+void ShaderProgram::set_uniform(const std::string& name, const int32_t x) {
+    set_uniform(get_uniform_loc(name), x);
+}
+
+void ShaderProgram::set_uniform(const std::string& name, const kmMat4* matrix) {
+    set_uniform(get_uniform_loc(name), matrix);
+}
+
+void ShaderProgram::set_uniform(const std::string& name, const kmMat3* matrix) {
+    set_uniform(get_uniform_loc(name), matrix);
+}
+
+void ShaderProgram::set_uniform(const std::string& name, const kmVec3* vec) {
+    set_uniform(get_uniform_loc(name), vec);
+}
+
+void ShaderProgram::set_uniform(const std::string& name, const kmVec4* vec) {
+    set_uniform(get_uniform_loc(name), vec);
 }
 
 void ShaderProgram::set_uniform(const std::string& name, const std::vector<kmMat4>& matrices) {
     GLThreadCheck::check();
 
-    activate();
+    if(active_shader_ != this) {
+        activate();
+    }
+
     GLint loc = get_uniform_loc(name);
     if(loc >= 0) {
+        //Arrays aren't shadowed, so forget anything recorded for the first element
+        if(loc < (int32_t) uniform_shadow_.size()) {
+            uniform_shadow_[loc].size = 0;
+        }
         glUniformMatrix4fv(loc, matrices.size(), false, (GLfloat*) &matrices[0]);
+        ++RenderStats::totals().uniform_uploads;
     }
 }
 
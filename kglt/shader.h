@@ -32,6 +32,7 @@ enum ShaderAvailableAuto {
     SP_AUTO_VIEW_MATRIX,
     SP_AUTO_MODELVIEW_MATRIX,
     SP_AUTO_PROJECTION_MATRIX,
+    SP_AUTO_VIEW_PROJECTION_MATRIX,
     SP_AUTO_INVERSE_TRANSPOSE_MODELVIEW_MATRIX,
     SP_AUTO_MATERIAL_DIFFUSE,
     SP_AUTO_MATERIAL_SPECULAR,
@@ -50,9 +51,10 @@ enum ShaderAvailableAuto {
     SP_AUTO_LIGHT_AMBIENT,
     SP_AUTO_LIGHT_CONSTANT_ATTENUATION,
     SP_AUTO_LIGHT_LINEAR_ATTENUATION,
-    SP_AUTO_LIGHT_QUADRATIC_ATTENUATION
+    SP_AUTO_LIGHT_QUADRATIC_ATTENUATION,
 
     //TODO: cameras(?)
+    SP_AUTO_MAX
 };
 
 const std::set<ShaderAvailableAuto> SHADER_AVAILABLE_AUTOS = {
@@ -78,6 +80,8 @@ enum ShaderAvailableAttributes {
     SP_ATTR_VERTEX_TEXCOORD5,
     SP_ATTR_VERTEX_TEXCOORD6,
     SP_ATTR_VERTEX_TEXCOORD7,
+    SP_ATTR_INSTANCE_MODEL_MATRIX, //A mat4, so it takes 4 attribute locations
+    SP_ATTR_MAX,
     SP_ATTR_VERTEX_COLOR = SP_ATTR_VERTEX_DIFFUSE
 };
 
@@ -92,7 +96,8 @@ const std::map<ShaderAvailableAttributes, uint8_t> SHADER_ATTRIBUTE_SIZES = {
     { SP_ATTR_VERTEX_TEXCOORD4, 2},
     { SP_ATTR_VERTEX_TEXCOORD5, 2},
     { SP_ATTR_VERTEX_TEXCOORD6, 2},
-    { SP_ATTR_VERTEX_TEXCOORD7, 2}
+    { SP_ATTR_VERTEX_TEXCOORD7, 2},
+    { SP_ATTR_INSTANCE_MODEL_MATRIX, 16}
 };
 
 
@@ -107,7 +112,8 @@ const std::set<ShaderAvailableAttributes> SHADER_AVAILABLE_ATTRS = {
     SP_ATTR_VERTEX_TEXCOORD4,
     SP_ATTR_VERTEX_TEXCOORD5,
     SP_ATTR_VERTEX_TEXCOORD6,
-    SP_ATTR_VERTEX_TEXCOORD7
+    SP_ATTR_VERTEX_TEXCOORD7,
+    SP_ATTR_INSTANCE_MODEL_MATRIX
 };
 }
 
@@ -136,6 +142,13 @@ namespace kglt {
 
 class ShaderProgram;
 
+/*
+ * The locations of the registered auto uniforms and attributes are looked up
+ * once, when the program is linked (or when they are registered on a program
+ * that is already linked), and stored in fixed arrays. The set_* overloads
+ * that take a ShaderAvailableAuto use those locations directly, so the render
+ * loop never touches a uniform name.
+ */
 class ShaderParams {
 public:
     ShaderParams(ShaderProgram& parent);
@@ -143,6 +156,14 @@ public:
     void register_auto(ShaderAvailableAuto auto_const, const std::string& uniform_name);
     void register_attribute(ShaderAvailableAttributes attr_const, const std::string& attrib_name);
 
+    void set_int(ShaderAvailableAuto auto_const, const int32_t value);
+    void set_float(ShaderAvailableAuto auto_const, const float value);
+    void set_mat4x4(ShaderAvailableAuto auto_const, const kmMat4& values);
+    void set_mat3x3(ShaderAvailableAuto auto_const, const kmMat3& values);
+    void set_vec3(ShaderAvailableAuto auto_const, const kmVec3& values);
+    void set_vec4(ShaderAvailableAuto auto_const, const kmVec4& values);
+    void set_colour(ShaderAvailableAuto auto_const, const Colour& values);
+
     void set_int(const std::string& uniform_name, const int32_t value);
     void set_float(const std::string& uniform_name, const float value);
     void set_mat4x4(const std::string& uniform_name, const kmMat4& values);
@@ -153,32 +174,43 @@ public:
 
     void set_mat4x4_array(const std::string& uniform_name, const std::vector<kmMat4>& matrices);
 
-    bool uses_auto(ShaderAvailableAuto auto_const) const { return container::contains(auto_uniforms_, auto_const); }
-    bool uses_attribute(ShaderAvailableAttributes attr_const) const { return container::contains(auto_attributes_, attr_const); }
+    bool uses_auto(ShaderAvailableAuto auto_const) const { return !auto_uniform_names_[auto_const].empty(); }
+    bool uses_attribute(ShaderAvailableAttributes attr_const) const { return !auto_attribute_names_[attr_const].empty(); }
 
-    std::string auto_uniform_variable_name(ShaderAvailableAuto auto_name) const {
-        auto it = auto_uniforms_.find(auto_name);
-        if(it == auto_uniforms_.end()) {
+    const std::string& auto_uniform_variable_name(ShaderAvailableAuto auto_name) const {
+        if(!uses_auto(auto_name)) {
             throw std::logic_error("Specified auto is not registered");
         }
 
-        return (*it).second;
+        return auto_uniform_names_[auto_name];
     }
 
-    std::string attribute_variable_name(ShaderAvailableAttributes attr_name) const {
-        auto it = auto_attributes_.find(attr_name);
-        if(it == auto_attributes_.end()) {
+    const std::string& attribute_variable_name(ShaderAvailableAttributes attr_name) const {
+        if(!uses_attribute(attr_name)) {
             throw std::logic_error("Specified attribute is not registered");
         }
 
-        return (*it).second;
+        return auto_attribute_names_[attr_name];
     }
 
+    ///-1 if the auto isn't registered, or the linked program doesn't use it
+    int32_t auto_uniform_location(ShaderAvailableAuto auto_name) const { return auto_uniform_locations_[auto_name]; }
+    int32_t attribute_location(ShaderAvailableAttributes attr_name) const { return auto_attribute_locations_[attr_name]; }
+
 private:
     ShaderProgram& program_;
 
-    std::unordered_map<ShaderAvailableAuto, std::string> auto_uniforms_;
-    std::unordered_map<ShaderAvailableAttributes, std::string> auto_attributes_;
+    std::string auto_uniform_names_[SP_AUTO_MAX];
+    std::string auto_attribute_names_[SP_ATTR_MAX];
+
+    int32_t auto_uniform_locations_[SP_AUTO_MAX];
+    int32_t auto_attribute_locations_[SP_ATTR_MAX];
+
+    void resolve_location(ShaderAvailableAuto auto_const);
+    void resolve_location(ShaderAvailableAttributes attr_const);
+    void resolve_locations();
+
+    friend class ShaderProgram;
 };
 
 enum ShaderType {
@@ -215,7 +247,23 @@ public:
 
     static ShaderProgram* active_shader() { return active_shader_; }
 
+    bool is_linked() const { return linked_; }
+
+    /*
+     * Changes whenever the attribute locations might have changed (a relink, or
+     * an attribute being registered) so that anything built from them, like a
+     * vertex array object, knows to rebuild. Unique across all programs.
+     */
+    uint64_t attribute_generation() const { return attribute_generation_; }
+
 private:
+    void set_uniform(int32_t loc, const float x);
+    void set_uniform(int32_t loc, const int32_t x);
+    void set_uniform(int32_t loc, const kmMat4* matrix);
+    void set_uniform(int32_t loc, const kmMat3* matrix);
+    void set_uniform(int32_t loc, const kmVec3* vec);
+    void set_uniform(int32_t loc, const kmVec4* vec);
+
     void set_uniform(const std::string& name, const float x);
     void set_uniform(const std::string& name, const int32_t x);
     void set_uniform(const std::string& name, const kmMat4* matrix);
@@ -230,8 +278,24 @@ private:
     uint32_t program_id_;
     uint32_t shader_ids_[SHADER_TYPE_MAX];
 
+    bool linked_;
+    uint64_t attribute_generation_;
+
     std::unordered_map<std::string, int32_t> cached_uniform_locations_;
 
+    /*
+     * The last value uploaded to each uniform location, so that setting a
+     * uniform to the value it already has skips the glUniform call (and the
+     * activate() that goes with it). Cleared whenever the program is relinked.
+     */
+    struct UniformShadow {
+        uint8_t size; //In floats, 0 if nothing has been uploaded yet
+        float data[16];
+    };
+
+    std::vector<UniformShadow> uniform_shadow_;
+    bool uniform_changed(int32_t loc, const void* data, uint8_t size);
+
     ShaderParams params_;
 
     friend class ShaderParams;
@@ -0,0 +1,99 @@
+#include <stdexcept>
+
+#include "simulation_thread.h"
+#include "utils/profiler.h"
+
+namespace kglt {
+
+SimulationThread::SimulationThread(std::function<void (double)> step):
+    step_(step),
+    steps_(0),
+    dt_(0),
+    busy_(false),
+    stopping_(false) {
+
+    //Started last, everything it reads is initialized by now
+    thread_ = std::thread(&SimulationThread::run, this);
+}
+
+SimulationThread::~SimulationThread() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    condition_.notify_all();
+    thread_.join();
+}
+
+void SimulationThread::start(uint32_t steps, double dt) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(busy_) {
+            throw std::logic_error("Tried to start the simulation while it was still running the last steps");
+        }
+
+        steps_ = steps;
+        dt_ = dt;
+        busy_ = true;
+    }
+
+    condition_.notify_all();
+}
+
+void SimulationThread::wait() {
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this]() { return !busy_; });
+        std::swap(error, error_);
+    }
+
+    if(error) {
+        std::rethrow_exception(error);
+    }
+}
+
+bool SimulationThread::is_busy() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return busy_;
+}
+
+void SimulationThread::run() {
+    Profiler::get().set_thread_name("Simulation");
+
+    while(true) {
+        uint32_t steps = 0;
+        double dt = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return stopping_ || busy_; });
+
+            if(stopping_) {
+                return;
+            }
+
+            steps = steps_;
+            dt = dt_;
+        }
+
+        std::exception_ptr error;
+        try {
+            for(uint32_t i = 0; i < steps; ++i) {
+                step_(dt);
+            }
+        } catch(...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = error;
+            busy_ = false;
+        }
+
+        condition_.notify_all();
+    }
+}
+
+}
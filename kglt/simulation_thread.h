@@ -0,0 +1,52 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace kglt {
+
+/*
+ * Runs fixed steps of the simulation on a thread of its own, for the window's
+ * threaded rendering. start() hands over a number of steps and returns straight
+ * away; wait() blocks until they have all run, and rethrows the first exception a
+ * step threw (the remaining steps of that batch are skipped). Only one batch can
+ * be in flight at a time.
+ */
+class SimulationThread {
+public:
+    SimulationThread(std::function<void (double)> step);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    void start(uint32_t steps, double dt);
+    void wait();
+
+    bool is_busy();
+
+private:
+    std::function<void (double)> step_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+
+    uint32_t steps_;
+    double dt_;
+    bool busy_;
+    bool stopping_;
+    std::exception_ptr error_;
+
+    std::thread thread_;
+
+    void run();
+};
+
+}
+
+#endif // SIMULATION_THREAD_H
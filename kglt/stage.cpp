@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "stage.h"
 #include "window_base.h"
 #include "scene.h"
@@ -20,6 +22,64 @@ Stage::Stage(Scene* parent, StageID id):
     LightManager::signal_post_create().connect(sigc::mem_fun(this, &Stage::post_create_callback<Light, LightID>));
 }
 
+Stage::~Stage() {
+    //The actors and lights are destroyed after moved_objects_, so stop them looking for it
+    for(Object* object: moved_objects_) {
+        object->snapshot_queued_ = false;
+    }
+    moved_objects_.clear();
+}
+
+void Stage::snapshot_transformations() {
+    std::vector<std::function<void ()>> changes;
+    {
+        std::lock_guard<std::mutex> lock(handoff_mutex_);
+        std::swap(changes, handoff_);
+    }
+
+    //Nothing is being drawn now, so whatever was held back can happen before the snapshot
+    for(auto& change: changes) {
+        change();
+    }
+
+    for(Object* object: moved_objects_) {
+        object->snapshot_transformation();
+    }
+    moved_objects_.clear();
+}
+
+bool Stage::defer_to_handoff(std::function<void ()> change) {
+    if(!window().frame_in_flight()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(handoff_mutex_);
+    handoff_.push_back(change);
+    return true;
+}
+
+void Stage::cancel_snapshot(Object* object) {
+    moved_objects_.erase(std::remove(moved_objects_.begin(), moved_objects_.end(), object), moved_objects_.end());
+}
+
+void Stage::defer_move(Object* object) {
+    std::lock_guard<std::mutex> lock(deferred_moves_mutex_);
+    if(!object->move_deferred_) {
+        object->move_deferred_ = true;
+        deferred_moves_.push_back(object);
+    }
+}
+
+void Stage::apply_deferred_moves() {
+    defer_moves_ = false;
+
+    for(Object* object: deferred_moves_) {
+        object->move_deferred_ = false;
+        object->moved();
+    }
+    deferred_moves_.clear();
+}
+
 void Stage::destroy() {
     scene().delete_stage(id());
 }
@@ -77,6 +137,10 @@ ActorRef Stage::actor_ref(ActorID e) {
 }
 
 void Stage::delete_actor(ActorID e) {
+    if(defer_to_handoff([this, e]() { if(has_actor(e)) delete_actor(e); })) {
+        return;
+    }
+
     signal_actor_destroyed_(e);
 
     actor(e).destroy_children();
@@ -111,6 +175,10 @@ Light& Stage::light(LightID light_id) {
 }
 
 void Stage::delete_light(LightID light_id) {
+    if(defer_to_handoff([this, light_id]() { if(LightManager::manager_contains(light_id)) delete_light(light_id); })) {
+        return;
+    }
+
     Light& obj = light(light_id);
     signal_light_destroyed_(light_id);
 
@@ -118,6 +186,10 @@ void Stage::delete_light(LightID light_id) {
     LightManager::manager_delete(light_id);
 }
 
+JobSystem* Stage::job_system() {
+    return &window().jobs();
+}
+
 void Stage::set_partitioner(Partitioner::ptr partitioner) {
     assert(partitioner);
 
@@ -1,6 +1,10 @@
 #ifndef STAGE_H
 #define STAGE_H
 
+#include <functional>
+#include <mutex>
+#include <vector>
+
 #include "generic/managed.h"
 #include "generic/manager.h"
 #include "object.h"
@@ -27,6 +31,7 @@ class Stage:
 
 public:
     Stage(Scene *parent, StageID id);
+    ~Stage();
 
     ActorID new_actor();
     ActorID new_actor(MeshID mid);
@@ -79,6 +84,7 @@ public:
     //Mesh functions
     virtual MeshID new_mesh() { return scene().new_mesh(); }
     virtual MeshID new_mesh_from_file(const unicode& path) { return scene().new_mesh_from_file(path); }
+    virtual std::shared_future<MeshID> new_mesh_from_file_async(const unicode& path) { return scene().new_mesh_from_file_async(path); }
 
     virtual MeshRef mesh(MeshID m) { return scene().mesh(m); }
     virtual const MeshRef mesh(MeshID m) const { return scene().mesh(m); }
@@ -90,6 +96,7 @@ public:
     //Texture functions
     virtual TextureID new_texture() { return scene().new_texture(); }
     virtual TextureID new_texture_from_file(const unicode& path) { return scene().new_texture_from_file(path); }
+    virtual std::shared_future<TextureID> new_texture_from_file_async(const unicode& path) { return scene().new_texture_from_file_async(path); }
 
     virtual ProtectedPtr<Texture> texture(TextureID t) { return scene().texture(t); }
     virtual const ProtectedPtr<Texture> texture(TextureID t) const { return scene().texture(t); }
@@ -97,6 +104,7 @@ public:
     virtual bool has_texture(TextureID t) const { return scene().has_texture(t); }
     virtual uint32_t texture_count() const { return scene().texture_count(); }
     virtual void mark_texture_as_uncollected(TextureID t) { scene().mark_texture_as_uncollected(t); }
+    virtual TextureAtlas& atlas() { return scene().atlas(); }
 
     //Shader functions
     virtual ShaderID new_shader() { return scene().new_shader(); }
@@ -122,6 +130,7 @@ public:
     //Material functions
     virtual MaterialID new_material() { return scene().new_material(); }
     virtual MaterialID new_material_from_file(const unicode& path) { return scene().new_material_from_file(path); }
+    virtual std::shared_future<MaterialID> new_material_from_file_async(const unicode& path) { return scene().new_material_from_file_async(path); }
 
     virtual ProtectedPtr<Material> material(MaterialID m) { return scene().material(m); }
     virtual const ProtectedPtr<Material> material(MaterialID m) const { return scene().material(m); }
@@ -137,6 +146,23 @@ public:
     virtual const Scene& scene() const { return scene_; }
 
     GeomFactory& geom_factory() { return *geom_factory_; }
+
+    //Snapshots the render transformation of everything that has moved since the last call
+    void snapshot_transformations();
+
+    /*
+     * While a threaded frame is in flight (see WindowBase::frame_in_flight()) the frame
+     * being drawn still points at this stage's actors, lights and their meshes. Anything
+     * that would destroy them is queued here instead and run by the next
+     * snapshot_transformations(). Returns false, without running change, if no frame is
+     * in flight and the caller can go ahead.
+     */
+    bool defer_to_handoff(std::function<void ()> change);
+
+protected:
+    //A stage has no stage of its own to ask, so moving it goes straight to the window
+    JobSystem* job_system();
+
 private:
     Scene& scene_;
 
@@ -154,7 +180,27 @@ private:
 
     std::shared_ptr<GeomFactory> geom_factory_;
 
+    //Objects that have moved since the last snapshot, each one at most once
+    std::vector<Object*> moved_objects_;
+    void queue_snapshot(Object* object) { moved_objects_.push_back(object); }
+    void cancel_snapshot(Object* object);
+
+    /*
+     * While Scene::update() runs in parallel, objects that move are collected here
+     * instead of telling the partitioner and queueing a snapshot from a job. The
+     * scene calls apply_deferred_moves() once the jobs have finished.
+     */
+    bool defer_moves_ = false;
+    std::mutex deferred_moves_mutex_;
+    std::vector<Object*> deferred_moves_;
+    void defer_move(Object* object);
+    void apply_deferred_moves();
+
+    std::mutex handoff_mutex_;
+    std::vector<std::function<void ()>> handoff_;
+
     friend class Scene;
+    friend class Object;
 };
 
 
@@ -1,8 +1,11 @@
 #include <GLee.h>
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 #include <boost/lexical_cast.hpp>
 #include "utils/gl_thread_check.h"
+#include "utils/gl_state.h"
+#include "render_stats.h"
 #include "kazbase/logging.h"
 
 #include "window_base.h"
@@ -13,6 +16,7 @@ namespace kglt {
 
 Texture::~Texture() {
     if(gl_tex_) {
+        GLState::get().texture_deleted(gl_tex_);
         glDeleteTextures(1, &gl_tex_);
     }
 }
@@ -26,6 +30,8 @@ void Texture::resize(uint32_t width, uint32_t height) {
     width_ = width;
     height_ = height;
 
+    compiled_ = CompiledTexture();
+
     data_.clear();
     data_.resize(width * height * (bpp_ / 8));
 }
@@ -70,7 +76,7 @@ void Texture::__do_upload(bool free_after, bool generate_mipmaps, bool repeat, b
         glGenTextures(1, &gl_tex_);
     }
 
-    glBindTexture(GL_TEXTURE_2D, gl_tex_);
+    GLState::get().bind_texture(0, gl_tex_);
 
     if(repeat) {
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -88,26 +94,113 @@ void Texture::__do_upload(bool free_after, bool generate_mipmaps, bool repeat, b
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     }
 
-    if(generate_mipmaps) {
-        glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+    if(is_compiled()) {
+        upload_compiled();
+    } else {
+        if(generate_mipmaps) {
+            glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+        }
+
+        assert(glGetError() == GL_NO_ERROR);
+        glTexImage2D(
+            GL_TEXTURE_2D,
+            0, (bpp_ == 32)? GL_RGBA: GL_RGB,
+            width_, height_, 0,
+            (bpp_ == 32) ? GL_RGBA : GL_RGB,
+            GL_UNSIGNED_BYTE, &data_[0]
+        );
+        RenderStats::totals().texture_bytes_uploaded += data_.size();
     }
 
-    assert(glGetError() == GL_NO_ERROR);
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0, (bpp_ == 32)? GL_RGBA: GL_RGB,
-        width_, height_, 0,
+    int error = glGetError();
+    if(error != GL_NO_ERROR) {
+        throw std::runtime_error("OpenGL error: " + boost::lexical_cast<std::string>(error));
+    }
+
+    if(free_after) {
+        free();
+    }
+}
+
+void Texture::__do_upload_region(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint8_t* pixels) {
+    if(!gl_tex_) {
+        throw std::logic_error("Tried to update part of a texture that hasn't been uploaded");
+    }
+
+    if(x + width > width_ || y + height > height_) {
+        throw std::logic_error("Out of bounds error while updating part of a texture");
+    }
+
+    GLState::get().bind_texture(0, gl_tex_);
+
+    glTexSubImage2D(
+        GL_TEXTURE_2D, 0,
+        x, y, width, height,
         (bpp_ == 32) ? GL_RGBA : GL_RGB,
-        GL_UNSIGNED_BYTE, &data_[0]
+        GL_UNSIGNED_BYTE, pixels
     );
+    RenderStats::totals().texture_bytes_uploaded += width * height * (bpp_ / 8);
 
     int error = glGetError();
     if(error != GL_NO_ERROR) {
         throw std::runtime_error("OpenGL error: " + boost::lexical_cast<std::string>(error));
     }
+}
 
-    if(free_after) {
-        free();
+void Texture::upload_compiled() {
+    GLenum internal_format = GL_RGBA, format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+    bool compressed = false;
+
+    switch(compiled_.format) {
+        case TEXTURE_FORMAT_RGB_888:
+            internal_format = format = GL_RGB;
+        break;
+        case TEXTURE_FORMAT_RGBA_8888:
+        break;
+        case TEXTURE_FORMAT_RGB_565:
+            internal_format = GL_RGB5;
+            format = GL_RGB;
+            type = GL_UNSIGNED_SHORT_5_6_5;
+        break;
+        case TEXTURE_FORMAT_RGBA_4444:
+            internal_format = GL_RGBA4;
+            type = GL_UNSIGNED_SHORT_4_4_4_4;
+        break;
+        case TEXTURE_FORMAT_DXT1:
+            internal_format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            compressed = true;
+        break;
+        case TEXTURE_FORMAT_DXT5:
+            internal_format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            compressed = true;
+        break;
+    }
+
+    if(compressed && !GLEE_EXT_texture_compression_s3tc) {
+        throw std::runtime_error("Tried to upload an S3TC compressed texture, but the driver doesn't support S3TC");
+    }
+
+    //Whatever isn't there can't be sampled, so a short chain is still complete
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, compiled_.levels.size() - 1);
+
+    for(uint32_t i = 0; i < compiled_.levels.size(); ++i) {
+        const TextureLevel& level = compiled_.levels[i];
+
+        if(compressed) {
+            glCompressedTexImage2D(
+                GL_TEXTURE_2D, i, internal_format,
+                level.width, level.height, 0,
+                level.size, level.data
+            );
+        } else {
+            glTexImage2D(
+                GL_TEXTURE_2D, i, internal_format,
+                level.width, level.height, 0,
+                format, type, level.data
+            );
+        }
+
+        RenderStats::totals().texture_bytes_uploaded += level.size;
     }
 }
 
@@ -119,12 +212,12 @@ void Texture::upload(bool free_after, bool generate_mipmaps, bool repeat, bool l
         //FIXME: This might get hairy if more than one thread is messing with the texture
         //as we do an unlocked access here (which is fine when it's only this thread and the
         //main thread, but if there's another one then, that could be bad news)
-        resource_manager().window().idle().add_once([=] {
+        IdleTaskToken uploaded = resource_manager().window().idle().add_once([=] {
             this->__do_upload(free_after, generate_mipmaps, repeat, linear);
-        });
+        }, IDLE_TASK_PRIORITY_UPLOAD);
 
-        //Wait for the main thread to process the upload
-        resource_manager().window().idle().wait();
+        //Wait for the main thread to process the upload, rethrowing anything it threw
+        uploaded.wait();
     }
 }
 
@@ -132,23 +225,51 @@ void Texture::flip_vertically() {
     /**
      *  Flips the texture data vertically
      */
-    for(uint32_t j = 0; j * 2 < (uint32_t) height(); ++j)
-    {
-        int index1 = j * width() * channels();
-        int index2 = (height() - 1 - j) * width() * channels();
-        for(uint32_t i = width() * channels(); i > 0; --i )
-        {
-            uint8_t temp = data()[index1];
-            data()[index1] = data()[index2];
-            data()[index2] = temp;
-            ++index1;
-            ++index2;
-        }
+    const uint32_t row_size = width() * channels();
+    if(data_.size() < row_size * height()) {
+        return;
+    }
+
+    for(uint32_t j = 0; j * 2 < (uint32_t) height(); ++j) {
+        uint8_t* top = &data_[j * row_size];
+        uint8_t* bottom = &data_[(height() - 1 - j) * row_size];
+        std::swap_ranges(top, top + row_size, bottom);
     }
 }
 
 void Texture::free() {
     data_.clear();
+    compiled_.storage.reset();
+    compiled_.levels.clear();
+}
+
+void Texture::set_compiled(const CompiledTexture& compiled) {
+    if(compiled.levels.empty()) {
+        throw std::logic_error("Tried to set a compiled texture with no levels");
+    }
+
+    data_.clear();
+    compiled_ = compiled;
+
+    width_ = compiled.levels[0].width;
+    height_ = compiled.levels[0].height;
+
+    switch(compiled.format) {
+        case TEXTURE_FORMAT_RGB_888: bpp_ = 24; break;
+        case TEXTURE_FORMAT_RGBA_8888: bpp_ = 32; break;
+        case TEXTURE_FORMAT_RGB_565:
+        case TEXTURE_FORMAT_RGBA_4444: bpp_ = 16; break;
+        case TEXTURE_FORMAT_DXT1: bpp_ = 4; break;
+        case TEXTURE_FORMAT_DXT5: bpp_ = 8; break;
+    }
+}
+
+TextureFormat Texture::format() const {
+    if(is_compiled()) {
+        return compiled_.format;
+    }
+
+    return (bpp_ == 32) ? TEXTURE_FORMAT_RGBA_8888 : TEXTURE_FORMAT_RGB_888;
 }
 
 }
@@ -11,6 +11,36 @@
 
 namespace kglt {
 
+enum TextureFormat {
+    TEXTURE_FORMAT_RGB_888,
+    TEXTURE_FORMAT_RGBA_8888,
+    TEXTURE_FORMAT_RGB_565,
+    TEXTURE_FORMAT_RGBA_4444,
+    TEXTURE_FORMAT_DXT1, //Opaque, 8 bytes per 4x4 block
+    TEXTURE_FORMAT_DXT5 //16 bytes per 4x4 block
+};
+
+/*
+ * One mipmap level of a compiled texture. Rows are bottom first and padded to a
+ * multiple of 4 bytes, which is what GL expects by default (and what KTX files store).
+ */
+struct TextureLevel {
+    uint32_t width;
+    uint32_t height;
+    const uint8_t* data;
+    uint32_t size;
+};
+
+/*
+ * A texture that's ready to go straight to GL: every level already in its final
+ * format. The levels point into storage, which might be a buffer or a mapped file.
+ */
+struct CompiledTexture {
+    TextureFormat format;
+    std::vector<TextureLevel> levels;
+    std::shared_ptr<const void> storage;
+};
+
 class Texture :
     public Resource,
     public Loadable,
@@ -41,9 +71,20 @@ public:
 
     void __do_upload(bool free_after, bool generate_mipmaps, bool repeat, bool linear);
 
+    //Replaces part of what's already uploaded, pixels are laid out like data(). Main thread only
+    void __do_upload_region(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint8_t* pixels);
+
     void flip_vertically();
     void free(); //Frees the data used to construct the texture
 
+    /*
+     * Uploads these levels as they are instead of data(), no mipmaps are generated.
+     * Anything that resizes the texture goes back to using data().
+     */
+    void set_compiled(const CompiledTexture& compiled);
+    bool is_compiled() const { return !compiled_.levels.empty(); }
+    TextureFormat format() const;
+
     uint32_t width() const { return width_; }
     uint32_t height() const { return height_; }
     uint32_t bpp() const { return bpp_; }
@@ -59,8 +100,11 @@ private:
     uint32_t bpp_;
 
     Texture::Data data_;
+    CompiledTexture compiled_;
 
     uint32_t gl_tex_;
+
+    void upload_compiled();
 };
 
 }
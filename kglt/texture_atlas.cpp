@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <boost/lexical_cast.hpp>
+
+#include "texture_atlas.h"
+#include "resource_manager.h"
+#include "scene.h"
+#include "window_base.h"
+#include "loaders/texture_loader.h"
+#include "utils/gl_thread_check.h"
+
+namespace kglt {
+
+namespace {
+
+//Rectangles are rounded up to this, so they all start on a multiple of it
+const uint32_t ATLAS_ALIGNMENT = 4;
+
+uint32_t align(uint32_t value) {
+    return (value + ATLAS_ALIGNMENT - 1) / ATLAS_ALIGNMENT * ATLAS_ALIGNMENT;
+}
+
+}
+
+RectanglePacker::RectanglePacker(uint32_t width, uint32_t height):
+    width_(width),
+    height_(height),
+    used_area_(0) {
+
+    Segment floor = { 0, 0, width };
+    skyline_.push_back(floor);
+}
+
+bool RectanglePacker::fits(uint32_t index, uint32_t width, uint32_t height, uint32_t& y) const {
+    const uint32_t x = skyline_[index].x;
+    if(x + width > width_) {
+        return false;
+    }
+
+    //It sits on the highest segment underneath it
+    y = 0;
+    for(uint32_t i = index; i < skyline_.size() && skyline_[i].x < x + width; ++i) {
+        y = std::max(y, skyline_[i].y);
+        if(y + height > height_) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool RectanglePacker::pack(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y) {
+    if(!width || !height) {
+        throw std::logic_error("Tried to pack an empty rectangle");
+    }
+
+    uint32_t best = skyline_.size();
+    uint32_t best_y = height_;
+    uint32_t best_width = width_ + 1;
+
+    for(uint32_t i = 0; i < skyline_.size(); ++i) {
+        uint32_t candidate_y;
+        if(fits(i, width, height, candidate_y)) {
+            //Lowest first, then the narrowest gap so wide gaps are kept for wide things
+            if(candidate_y < best_y || (candidate_y == best_y && skyline_[i].width < best_width)) {
+                best = i;
+                best_y = candidate_y;
+                best_width = skyline_[i].width;
+            }
+        }
+    }
+
+    if(best == skyline_.size()) {
+        return false;
+    }
+
+    x = skyline_[best].x;
+    y = best_y;
+
+    Segment top = { x, y + height, width };
+    skyline_.insert(skyline_.begin() + best, top);
+
+    //Cut back whatever the new segment now covers
+    for(uint32_t i = best + 1; i < skyline_.size();) {
+        Segment& previous = skyline_[i - 1];
+        Segment& segment = skyline_[i];
+
+        const uint32_t previous_end = previous.x + previous.width;
+        if(segment.x >= previous_end) {
+            break;
+        }
+
+        const uint32_t overlap = previous_end - segment.x;
+        if(overlap >= segment.width) {
+            skyline_.erase(skyline_.begin() + i);
+        } else {
+            segment.x += overlap;
+            segment.width -= overlap;
+            break;
+        }
+    }
+
+    //Neighbours at the same height are one segment
+    for(uint32_t i = 1; i < skyline_.size();) {
+        if(skyline_[i - 1].y == skyline_[i].y) {
+            skyline_[i - 1].width += skyline_[i].width;
+            skyline_.erase(skyline_.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+
+    used_area_ += uint64_t(width) * height;
+    return true;
+}
+
+float RectanglePacker::occupancy() const {
+    return float(double(used_area_) / (double(width_) * double(height_)));
+}
+
+TextureAtlas::TextureAtlas(ResourceManager& resource_manager, uint32_t page_size, uint32_t padding):
+    resource_manager_(resource_manager),
+    page_size_(page_size),
+    padding_(padding) {
+
+}
+
+uint32_t TextureAtlas::page_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pages_.size();
+}
+
+TextureID TextureAtlas::page_texture(uint32_t page) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pages_.at(page)->texture->id();
+}
+
+MaterialID TextureAtlas::page_material(uint32_t page) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Page& p = *pages_.at(page);
+    if(!p.material) {
+        p.material = resource_manager_.material(resource_manager_.scene().clone_default_material()).__object;
+        p.material->technique().pass(0).set_texture_unit(0, p.texture->id());
+        p.material->technique().pass(0).set_blending(BLEND_ALPHA);
+    }
+
+    return p.material->id();
+}
+
+TextureAtlas::Page& TextureAtlas::new_page(Uploads& uploads) {
+    std::unique_ptr<Page> page(new Page(page_size_));
+
+    page->texture = resource_manager_.texture(resource_manager_.new_texture()).__object;
+    page->texture->set_bpp(32);
+    page->texture->resize(page_size_, page_size_); //Transparent black
+
+    //Mipmaps are regenerated by GL whenever a region is updated
+    TexturePtr texture = page->texture;
+    uploads.push_back([texture]() {
+        texture->__do_upload(true, true, false, false);
+    });
+
+    pages_.push_back(std::move(page));
+    return *pages_.back();
+}
+
+AtlasRegion TextureAtlas::place(const uint8_t* pixels, uint32_t stride, uint32_t width, uint32_t height, uint32_t channels, Uploads& uploads) {
+    if(channels != 3 && channels != 4) {
+        throw std::logic_error("Only RGB and RGBA images can be added to a texture atlas");
+    }
+
+    const uint32_t padded_width = width + padding_ * 2;
+    const uint32_t padded_height = height + padding_ * 2;
+
+    if(align(padded_width) > page_size_ || align(padded_height) > page_size_) {
+        throw std::logic_error(
+            "Image is too big for the atlas pages: " +
+            boost::lexical_cast<std::string>(width) + "x" + boost::lexical_cast<std::string>(height)
+        );
+    }
+
+    uint32_t page_index = 0, x = 0, y = 0;
+    for(; page_index < pages_.size(); ++page_index) {
+        if(pages_[page_index]->packer.pack(align(padded_width), align(padded_height), x, y)) {
+            break;
+        }
+    }
+
+    if(page_index == pages_.size()) {
+        Page& page = new_page(uploads);
+        page.packer.pack(align(padded_width), align(padded_height), x, y);
+    }
+
+    //The padding repeats the nearest edge pixel, which is what clamping would have sampled
+    std::shared_ptr<std::vector<uint8_t> > padded = std::make_shared<std::vector<uint8_t> >(padded_width * padded_height * 4);
+    for(uint32_t j = 0; j < padded_height; ++j) {
+        const uint32_t source_y = std::min(uint32_t(std::max(int32_t(j) - int32_t(padding_), 0)), height - 1);
+        const uint8_t* source_row = pixels + source_y * stride;
+        uint8_t* dest = &(*padded)[j * padded_width * 4];
+
+        for(uint32_t i = 0; i < padded_width; ++i, dest += 4) {
+            const uint32_t source_x = std::min(uint32_t(std::max(int32_t(i) - int32_t(padding_), 0)), width - 1);
+            const uint8_t* source = source_row + source_x * channels;
+
+            std::memcpy(dest, source, channels);
+            if(channels == 3) {
+                dest[3] = 255;
+            }
+        }
+    }
+
+    TexturePtr texture = pages_[page_index]->texture;
+    uploads.push_back([=]() {
+        texture->__do_upload_region(x, y, padded_width, padded_height, padded->data());
+    });
+
+    AtlasRegion region;
+    region.page = page_index;
+    region.texture = texture->id();
+    region.x = x + padding_;
+    region.y = y + padding_;
+    region.width = width;
+    region.height = height;
+    region.u0 = float(region.x) / float(page_size_);
+    region.v0 = float(region.y) / float(page_size_);
+    region.u1 = float(region.x + width) / float(page_size_);
+    region.v1 = float(region.y + height) / float(page_size_);
+    return region;
+}
+
+void TextureAtlas::run_uploads(const Uploads& uploads) {
+    //Everything goes through the queue, so pages queued by other threads are created first
+    IdleTaskManager& idle = resource_manager_.window().idle();
+
+    std::vector<IdleTaskToken> done;
+    for(const std::function<void ()>& upload: uploads) {
+        done.push_back(idle.add_once(upload, IDLE_TASK_PRIORITY_UPLOAD));
+    }
+
+    if(GLThreadCheck::is_current()) {
+        idle.flush(IDLE_TASK_PRIORITY_UPLOAD);
+    }
+
+    for(IdleTaskToken& token: done) {
+        token.wait();
+    }
+}
+
+AtlasRegion TextureAtlas::add(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels) {
+    AtlasRegion region;
+    Uploads uploads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        region = place(pixels, width * channels, width, height, channels, uploads);
+    }
+
+    run_uploads(uploads);
+    return region;
+}
+
+AtlasRegion TextureAtlas::add_texture(TextureID texture) {
+    auto tex = resource_manager_.texture(texture);
+
+    if(tex->is_compiled() || tex->data().empty()) {
+        throw std::logic_error("Only textures that still have their data can be added to an atlas");
+    }
+
+    return add(&tex->data()[0], tex->width(), tex->height(), tex->channels());
+}
+
+AtlasRegion TextureAtlas::add_image(const unicode& path) {
+    return add_file(path, 0, 0).at(0);
+}
+
+std::vector<AtlasRegion> TextureAtlas::add_sheet(const unicode& path, uint32_t frame_width, uint32_t frame_height) {
+    if(!frame_width) {
+        throw std::logic_error("Sprite sheet frames need a width");
+    }
+
+    return add_file(path, frame_width, frame_height);
+}
+
+std::vector<AtlasRegion> TextureAtlas::add_file(const unicode& path, uint32_t frame_width, uint32_t frame_height) {
+    const std::string key = path.encode() + ":" +
+        boost::lexical_cast<std::string>(frame_width) + "x" +
+        boost::lexical_cast<std::string>(frame_height);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = files_.find(key);
+        if(it != files_.end()) {
+            return it->second;
+        }
+    }
+
+    //Decoded without the texture cache, compiled textures can't be copied into a page
+    Texture image(&resource_manager_, TextureID());
+    LoaderOptions options;
+    options["dont_fallback"] = "true";
+    loaders::TextureLoader(resource_manager_.window().resource_locator().locate_file(path)).into(image, options);
+
+    const uint32_t width = (frame_width) ? frame_width : image.width();
+    const uint32_t height = (frame_height) ? frame_height : image.height();
+
+    if(image.width() % width != 0 || image.height() % height != 0) {
+        throw std::logic_error(
+            "Image size isn't a multiple of the frame size: " + path.encode()
+        );
+    }
+
+    const uint32_t channels = image.channels();
+    const uint32_t stride = image.width() * channels;
+    const uint32_t across = image.width() / width;
+    const uint32_t down = image.height() / height;
+
+    std::vector<AtlasRegion> regions;
+    Uploads uploads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        //Another thread might have got here first
+        auto it = files_.find(key);
+        if(it != files_.end()) {
+            return it->second;
+        }
+
+        //The data is bottom row first, so the top row of frames is at the end
+        for(uint32_t row = 0; row < down; ++row) {
+            for(uint32_t column = 0; column < across; ++column) {
+                const uint32_t y = (down - 1 - row) * height;
+                const uint8_t* start = &image.data()[y * stride + column * width * channels];
+                regions.push_back(place(start, stride, width, height, channels, uploads));
+            }
+        }
+
+        files_[key] = regions;
+    }
+
+    run_uploads(uploads);
+    return regions;
+}
+
+}
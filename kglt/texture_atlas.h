@@ -0,0 +1,147 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kazbase/unicode.h"
+#include "types.h"
+
+namespace kglt {
+
+class ResourceManager;
+
+/*
+ * Packs rectangles into a fixed size area, lowest first (a "skyline" packer). It
+ * only keeps the top edge of what's been placed so far, so space under an overhang
+ * is lost, but packing is quick and does well with lots of similar sized images.
+ */
+class RectanglePacker {
+public:
+    RectanglePacker(uint32_t width, uint32_t height);
+
+    //Returns false if there's no room left for it
+    bool pack(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y);
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+
+    //How much of the area has been handed out, from 0 to 1
+    float occupancy() const;
+
+private:
+    struct Segment {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+    };
+
+    uint32_t width_;
+    uint32_t height_;
+    uint64_t used_area_;
+
+    std::vector<Segment> skyline_;
+
+    bool fits(uint32_t index, uint32_t width, uint32_t height, uint32_t& y) const;
+};
+
+struct AtlasRegion {
+    uint32_t page;
+    TextureID texture; //The page's texture
+
+    //In pixels, not counting the padding
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+
+    //Texture coordinates of the bottom left and top right corners
+    float u0;
+    float v0;
+    float u1;
+    float v1;
+};
+
+/*
+ * Shares a few big textures ("pages") between lots of small images, so that things
+ * drawn with any of them can be batched together instead of each binding its own
+ * texture. Every image is surrounded by padding pixels copied from its edges and
+ * starts on a 4 pixel boundary, so neither linear filtering nor the first few
+ * mipmap levels bleed in colour from the neighbours. Pages clamp, so anything that
+ * relies on the texture repeating has to keep a texture of its own.
+ *
+ * Images are added once and stay until the atlas is destroyed. Adding from the main
+ * thread uploads straight away; from any other thread it waits for the main thread
+ * to do it, like Texture::upload().
+ */
+class TextureAtlas {
+public:
+    static const uint32_t DEFAULT_PAGE_SIZE = 1024;
+    static const uint32_t DEFAULT_PADDING = 4;
+
+    TextureAtlas(ResourceManager& resource_manager,
+                 uint32_t page_size=DEFAULT_PAGE_SIZE,
+                 uint32_t padding=DEFAULT_PADDING);
+
+    /*
+     * pixels has channels (3 or 4) bytes per pixel, tightly packed, bottom row first
+     * like Texture::data(). Throws std::logic_error if it won't fit on a page.
+     */
+    AtlasRegion add(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels);
+    AtlasRegion add_texture(TextureID texture);
+
+    /*
+     * Adding the same file again returns the regions it already has. Sheets are cut
+     * into frames in reading order, starting at the top left; a frame_height of 0
+     * means the whole height of the image (a strip).
+     */
+    AtlasRegion add_image(const unicode& path);
+    std::vector<AtlasRegion> add_sheet(const unicode& path, uint32_t frame_width, uint32_t frame_height=0);
+
+    uint32_t page_size() const { return page_size_; }
+    uint32_t padding() const { return padding_; }
+
+    uint32_t page_count() const;
+    TextureID page_texture(uint32_t page) const;
+
+    //A copy of the default material with the page on its first unit and alpha blending
+    MaterialID page_material(uint32_t page);
+
+private:
+    struct Page {
+        Page(uint32_t size):
+            packer(size, size) {}
+
+        TexturePtr texture;
+        MaterialPtr material;
+        RectanglePacker packer;
+    };
+
+    ResourceManager& resource_manager_;
+    uint32_t page_size_;
+    uint32_t padding_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Page> > pages_;
+    std::unordered_map<std::string, std::vector<AtlasRegion> > files_;
+
+    typedef std::vector<std::function<void ()> > Uploads;
+
+    //Called with mutex_ held, the GL work is added to uploads rather than done
+    AtlasRegion place(const uint8_t* pixels, uint32_t stride, uint32_t width, uint32_t height, uint32_t channels, Uploads& uploads);
+    Page& new_page(Uploads& uploads);
+
+    //Called without mutex_, so the main thread can use the atlas while we wait for it
+    void run_uploads(const Uploads& uploads);
+
+    std::vector<AtlasRegion> add_file(const unicode& path, uint32_t frame_width, uint32_t frame_height);
+};
+
+}
+
+#endif // TEXTURE_ATLAS_H
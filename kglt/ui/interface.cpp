@@ -16,6 +16,8 @@
 #include "../scene.h"
 #include "../camera.h"
 #include "../render_sequence.h"
+#include "../shader.h"
+#include "../utils/gl_state.h"
 
 #include "interface.h"
 #include "ui_private.h"
@@ -99,26 +101,34 @@ public:
         glPushMatrix();
         glTranslatef(translation.x, translation.y, 0.0);
 
-        glUseProgram(0);
-        glActiveTexture(GL_TEXTURE0);
+        //Go through ShaderProgram so that it knows no program is bound any more
+        if(ShaderProgram::active_shader()) {
+            ShaderProgram::active_shader()->deactivate();
+        } else {
+            GLState::get().use_program(0);
+        }
+
+        //All of this goes through GLState, so only the first piece of geometry each frame changes anything
+        GLState& state = GLState::get();
+        state.active_texture(0);
 
         if(texture) {
-            glEnable(GL_TEXTURE_2D);
+            state.enable(GL_TEXTURE_2D);
             GLuint tex_id = textures_[texture]->gl_tex();
-            glBindTexture(GL_TEXTURE_2D, tex_id);
+            state.bind_texture(0, tex_id);
             glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
         } else {
-            glDisable(GL_TEXTURE_2D);
+            state.disable(GL_TEXTURE_2D);
         }
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glEnable(GL_ALPHA_TEST);
+        state.enable(GL_BLEND);
+        state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        state.enable(GL_ALPHA_TEST);
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_LIGHTING);
+        state.bind_buffer(GL_ARRAY_BUFFER, 0);
+        state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        state.disable(GL_DEPTH_TEST);
+        state.disable(GL_LIGHTING);
 
         glBegin(GL_TRIANGLES);
         for(int32_t i = 0; i < num_indices; ++i) {
@@ -138,11 +148,7 @@ public:
 
 
     void EnableScissorRegion(bool enable) {
-        if(enable) {
-            glEnable(GL_SCISSOR_TEST);
-        } else {
-            glDisable(GL_SCISSOR_TEST);
-        }
+        GLState::get().set_enabled(GL_SCISSOR_TEST, enable);
     }
 
     void SetScissorRegion(int x, int y, int width, int height) {
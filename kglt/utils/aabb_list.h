@@ -0,0 +1,106 @@
+#ifndef KGLT_AABB_LIST_H
+#define KGLT_AABB_LIST_H
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include <kazmath/aabb.h>
+
+namespace kglt {
+
+/*
+ * A list of AABBs stored in groups of four, with each group laid out as
+ * min_x[4], min_y[4], min_z[4], max_x[4], max_y[4], max_z[4]. Each component
+ * of a group can then be loaded straight into a SIMD register (see
+ * Frustum::intersects_aabbs) and the whole list is a single allocation. The
+ * unused lanes of the last group are zeroed.
+ */
+class AABBList {
+public:
+    static const uint32_t GROUP_SIZE = 4;
+    static const uint32_t FLOATS_PER_GROUP = GROUP_SIZE * 6;
+
+    enum Component {
+        MIN_X = 0,
+        MIN_Y,
+        MIN_Z,
+        MAX_X,
+        MAX_Y,
+        MAX_Z
+    };
+
+    uint32_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    uint32_t group_count() const { return data_.size() / FLOATS_PER_GROUP; }
+
+    const float* component(uint32_t group, Component which) const {
+        return &data_[(group * FLOATS_PER_GROUP) + (which * GROUP_SIZE)];
+    }
+
+    void push_back(const kmAABB& box) {
+        if(size_ % GROUP_SIZE == 0) {
+            data_.resize(data_.size() + FLOATS_PER_GROUP, 0.0f);
+        }
+        set(size_++, box);
+    }
+
+    void set(uint32_t i, const kmAABB& box) {
+        assert(i < size_);
+
+        float* group = &data_[(i / GROUP_SIZE) * FLOATS_PER_GROUP];
+        const uint32_t lane = i % GROUP_SIZE;
+
+        group[(MIN_X * GROUP_SIZE) + lane] = box.min.x;
+        group[(MIN_Y * GROUP_SIZE) + lane] = box.min.y;
+        group[(MIN_Z * GROUP_SIZE) + lane] = box.min.z;
+        group[(MAX_X * GROUP_SIZE) + lane] = box.max.x;
+        group[(MAX_Y * GROUP_SIZE) + lane] = box.max.y;
+        group[(MAX_Z * GROUP_SIZE) + lane] = box.max.z;
+    }
+
+    kmAABB get(uint32_t i) const {
+        assert(i < size_);
+
+        const float* group = &data_[(i / GROUP_SIZE) * FLOATS_PER_GROUP];
+        const uint32_t lane = i % GROUP_SIZE;
+
+        kmAABB box;
+        box.min.x = group[(MIN_X * GROUP_SIZE) + lane];
+        box.min.y = group[(MIN_Y * GROUP_SIZE) + lane];
+        box.min.z = group[(MIN_Z * GROUP_SIZE) + lane];
+        box.max.x = group[(MAX_X * GROUP_SIZE) + lane];
+        box.max.y = group[(MAX_Y * GROUP_SIZE) + lane];
+        box.max.z = group[(MAX_Z * GROUP_SIZE) + lane];
+        return box;
+    }
+
+    ///Moves the last box into slot i, the caller must do the same with anything indexed in parallel
+    void swap_and_pop(uint32_t i) {
+        assert(i < size_);
+
+        const uint32_t last = size_ - 1;
+        if(i != last) {
+            set(i, get(last));
+        }
+
+        set(last, kmAABB());
+        --size_;
+
+        if(size_ % GROUP_SIZE == 0) {
+            data_.resize(data_.size() - FLOATS_PER_GROUP);
+        }
+    }
+
+    void clear() {
+        data_.clear();
+        size_ = 0;
+    }
+
+private:
+    std::vector<float> data_;
+    uint32_t size_ = 0;
+};
+
+}
+
+#endif // KGLT_AABB_LIST_H
@@ -2,6 +2,7 @@
 
 #include "../kazbase/logging.h"
 #include "geometry_buffer.h"
+#include "gl_state.h"
 
 namespace kglt {
 
@@ -118,14 +119,14 @@ uint32_t GeometryBuffer::count() const {
 GLuint GeometryBuffer::vbo() {
     if(!vertex_buffer_) {
         glGenBuffers(1, &vertex_buffer_);
-        glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+        GLState::get().bind_buffer(GL_ARRAY_BUFFER, vertex_buffer_);
         if(!buffer_.empty()) {
             glBufferData(GL_ARRAY_BUFFER, buffer_.size() * sizeof(float), &buffer_[0], GL_STATIC_DRAW);
         } else {
             L_WARN("Tried to create a VBO with no data");
         }
     } else {
-        glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+        GLState::get().bind_buffer(GL_ARRAY_BUFFER, vertex_buffer_);
         //glBufferData(GL_ARRAY_BUFFER, buffer_.size() * sizeof(float), &buffer_[0], GL_STATIC_DRAW);
     }
 
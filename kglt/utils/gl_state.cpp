@@ -0,0 +1,198 @@
+#include <GLee.h>
+
+#include "gl_state.h"
+#include "../render_stats.h"
+
+namespace kglt {
+
+/*
+ * GL_TEXTURE_2D isn't in here as it's per texture unit, so it goes straight
+ * through to GL
+ */
+static const GLenum TRACKED_CAPS[] = {
+    GL_DEPTH_TEST,
+    GL_BLEND,
+    GL_CULL_FACE,
+    GL_SCISSOR_TEST,
+    GL_ALPHA_TEST,
+    GL_LIGHTING,
+    GL_MULTISAMPLE,
+    GL_POLYGON_SMOOTH,
+    GL_LINE_SMOOTH,
+    GL_POINT_SMOOTH
+};
+
+static_assert(sizeof(TRACKED_CAPS) / sizeof(GLenum) == 10, "TRACKED_CAP_COUNT is out of date");
+
+GLState& GLState::get() {
+    static GLState state;
+    return state;
+}
+
+GLState::GLState() {
+    invalidate();
+}
+
+void GLState::invalidate() {
+    for(uint8_t i = 0; i < TRACKED_CAP_COUNT; ++i) {
+        caps_[i] = STATE_UNKNOWN;
+    }
+
+    blend_source_ = blend_destination_ = -1;
+    depth_func_ = -1;
+    depth_mask_ = STATE_UNKNOWN;
+    point_size_ = line_width_ = -1.0f;
+
+    active_texture_ = -1;
+    for(uint8_t i = 0; i < MAX_TEXTURE_UNITS; ++i) {
+        textures_[i] = -1;
+    }
+
+    array_buffer_ = element_array_buffer_ = -1;
+    vertex_array_ = -1;
+    program_ = -1;
+}
+
+void GLState::new_frame() {
+    last_frame_ = current_frame_;
+    current_frame_ = GLStateStats();
+}
+
+void GLState::set_enabled(uint32_t cap, bool enabled) {
+    uint8_t i = 0;
+    for(; i < TRACKED_CAP_COUNT; ++i) {
+        if(TRACKED_CAPS[i] == cap) {
+            break;
+        }
+    }
+
+    if(i == TRACKED_CAP_COUNT) {
+        ++current_frame_.issued;
+    } else if(!update(caps_[i], (enabled) ? STATE_ON : STATE_OFF)) {
+        return;
+    }
+
+    if(enabled) {
+        glEnable(cap);
+    } else {
+        glDisable(cap);
+    }
+}
+
+void GLState::blend_func(uint32_t source, uint32_t destination) {
+    if(blend_source_ == source && blend_destination_ == destination) {
+        ++current_frame_.elided;
+        return;
+    }
+
+    blend_source_ = source;
+    blend_destination_ = destination;
+    ++current_frame_.issued;
+    glBlendFunc(source, destination);
+}
+
+void GLState::depth_func(uint32_t func) {
+    if(update(depth_func_, func)) {
+        glDepthFunc(func);
+    }
+}
+
+void GLState::depth_mask(bool write) {
+    if(update(depth_mask_, (write) ? STATE_ON : STATE_OFF)) {
+        glDepthMask((write) ? GL_TRUE : GL_FALSE);
+    }
+}
+
+void GLState::point_size(float size) {
+    if(update(point_size_, size)) {
+        glPointSize(size);
+    }
+}
+
+void GLState::line_width(float width) {
+    if(update(line_width_, width)) {
+        glLineWidth(width);
+    }
+}
+
+void GLState::active_texture(uint8_t unit) {
+    if(update(active_texture_, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+void GLState::bind_texture(uint8_t unit, uint32_t texture) {
+    if(unit >= MAX_TEXTURE_UNITS) {
+        //Not tracked, and GL is left on a unit we don't know about
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        current_frame_.issued += 2;
+        ++RenderStats::totals().texture_binds;
+        active_texture_ = -1;
+        return;
+    }
+
+    if(textures_[unit] == texture) {
+        ++current_frame_.elided;
+        return;
+    }
+
+    active_texture(unit);
+    update(textures_[unit], texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    ++RenderStats::totals().texture_binds;
+}
+
+void GLState::bind_buffer(uint32_t target, uint32_t buffer) {
+    int64_t& current = (target == GL_ELEMENT_ARRAY_BUFFER) ? element_array_buffer_ : array_buffer_;
+    if(update(current, buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLState::bind_vertex_array(uint32_t vao) {
+    if(update(vertex_array_, vao)) {
+        glBindVertexArray(vao);
+
+        //The element array binding belongs to the vertex array, so we no longer know what it is
+        element_array_buffer_ = -1;
+    }
+}
+
+void GLState::use_program(uint32_t program) {
+    if(update(program_, program)) {
+        glUseProgram(program);
+        ++RenderStats::totals().shader_binds;
+    }
+}
+
+void GLState::texture_deleted(uint32_t texture) {
+    //Deleting a bound texture reverts the unit to texture 0
+    for(uint8_t i = 0; i < MAX_TEXTURE_UNITS; ++i) {
+        if(textures_[i] == texture) {
+            textures_[i] = 0;
+        }
+    }
+}
+
+void GLState::program_deleted(uint32_t program) {
+    //A program in use isn't really deleted until something else is used, so forget it
+    //to make sure the next use_program() call goes through even if the name is reused
+    if(program_ == program) {
+        program_ = -1;
+    }
+}
+
+void GLState::buffer_deleted(uint32_t buffer) {
+    //Deleting a bound buffer reverts the binding to 0
+    if(array_buffer_ == buffer) {
+        array_buffer_ = 0;
+    }
+
+    //The element array binding belongs to the vertex array, so it may not be the one we know of
+    if(element_array_buffer_ == buffer) {
+        element_array_buffer_ = -1;
+    }
+}
+
+}
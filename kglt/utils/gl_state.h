@@ -0,0 +1,105 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <cstdint>
+
+namespace kglt {
+
+struct GLStateStats {
+    uint32_t issued = 0; //State changes that reached GL
+    uint32_t elided = 0; //State changes that were skipped because GL was already in that state
+};
+
+/*
+ * A shadow of the GL state that KGLT changes while rendering. Everything that
+ * enables caps, sets the blend function or depth mask, or binds textures,
+ * buffers, vertex arrays or programs goes through here, and a change to the
+ * value GL already has is dropped. That means nothing needs to restore state
+ * when it is done with it; whoever draws next sets what it depends on.
+ *
+ * Everything starts out unknown, so the first change to each piece of state
+ * is always issued. Code that calls GL directly behind this cache's back must
+ * call invalidate() afterwards. Only ever used from the GL thread.
+ */
+class GLState {
+public:
+    static GLState& get();
+
+    void enable(uint32_t cap) { set_enabled(cap, true); }
+    void disable(uint32_t cap) { set_enabled(cap, false); }
+    void set_enabled(uint32_t cap, bool enabled);
+
+    void blend_func(uint32_t source, uint32_t destination);
+    void depth_func(uint32_t func);
+    void depth_mask(bool write);
+
+    void point_size(float size);
+    void line_width(float width);
+
+    void active_texture(uint8_t unit);
+    void bind_texture(uint8_t unit, uint32_t texture); //GL_TEXTURE_2D only
+
+    void bind_buffer(uint32_t target, uint32_t buffer); //GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER
+    void bind_vertex_array(uint32_t vao);
+    void use_program(uint32_t program);
+
+    //Must be called before the texture, program or buffer is deleted, GL unbinds them itself
+    void texture_deleted(uint32_t texture);
+    void program_deleted(uint32_t program);
+    void buffer_deleted(uint32_t buffer);
+
+    void invalidate();
+
+    void new_frame();
+    const GLStateStats& frame_stats() const { return current_frame_; } //So far this frame
+    const GLStateStats& last_frame_stats() const { return last_frame_; }
+
+    static const uint8_t MAX_TEXTURE_UNITS = 16;
+
+private:
+    GLState();
+
+    enum Tristate {
+        STATE_UNKNOWN = -1,
+        STATE_OFF = 0,
+        STATE_ON = 1
+    };
+
+    static const uint8_t TRACKED_CAP_COUNT = 10;
+    int8_t caps_[TRACKED_CAP_COUNT];
+
+    int64_t blend_source_;
+    int64_t blend_destination_;
+    int64_t depth_func_;
+    int8_t depth_mask_;
+    float point_size_;
+    float line_width_;
+
+    int32_t active_texture_;
+    int64_t textures_[MAX_TEXTURE_UNITS];
+
+    int64_t array_buffer_;
+    int64_t element_array_buffer_;
+    int64_t vertex_array_;
+    int64_t program_;
+
+    GLStateStats current_frame_;
+    GLStateStats last_frame_;
+
+    //Returns true (and counts it as issued) if the value has changed
+    template<typename T, typename U>
+    bool update(T& current, U value) {
+        if(current == T(value)) {
+            ++current_frame_.elided;
+            return false;
+        }
+
+        current = T(value);
+        ++current_frame_.issued;
+        return true;
+    }
+};
+
+}
+
+#endif // GL_STATE_H
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <stdexcept>
+#include <boost/lexical_cast.hpp>
+
+#include "job_system.h"
+#include "profiler.h"
+
+namespace kglt {
+
+namespace {
+
+//Which JobSystem (if any) the current thread is a worker of, and which queue is its own
+thread_local const JobSystem* current_system = nullptr;
+thread_local uint32_t current_queue_index = 0;
+
+}
+
+ScratchArena::ScratchArena(std::size_t block_size):
+    block_size_(block_size),
+    current_block_(0),
+    offset_(0),
+    used_(0) {
+
+}
+
+void* ScratchArena::allocate(std::size_t bytes, std::size_t alignment) {
+    while(true) {
+        if(current_block_ < blocks_.size()) {
+            Block& block = blocks_[current_block_];
+
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+            uintptr_t aligned = (base + offset_ + alignment - 1) & ~(uintptr_t(alignment) - 1);
+            std::size_t end = (aligned - base) + bytes;
+
+            if(end <= block.size) {
+                used_ += end - offset_;
+                offset_ = end;
+                return reinterpret_cast<void*>(aligned);
+            }
+
+            //Doesn't fit, the rest of this block is wasted until the next reset()
+            ++current_block_;
+            offset_ = 0;
+            continue;
+        }
+
+        //Allocations bigger than a block get a block of their own
+        Block block;
+        block.size = std::max(block_size_, bytes + alignment);
+        block.data.reset(new uint8_t[block.size]);
+        blocks_.push_back(std::move(block));
+    }
+}
+
+void ScratchArena::reset() {
+    current_block_ = 0;
+    offset_ = 0;
+    used_ = 0;
+}
+
+std::size_t ScratchArena::capacity() const {
+    std::size_t total = 0;
+    for(const Block& block: blocks_) {
+        total += block.size;
+    }
+    return total;
+}
+
+JobSystem::JobSystem(uint32_t worker_count):
+    owner_(std::this_thread::get_id()),
+    queued_(0),
+    steal_start_(0),
+    sleeping_(0),
+    stopping_(false) {
+
+    start_workers(worker_count);
+}
+
+JobSystem::~JobSystem() {
+    stop_workers();
+}
+
+void JobSystem::set_worker_count(uint32_t worker_count) {
+    stop_workers();
+    start_workers(worker_count);
+}
+
+void JobSystem::start_workers(uint32_t worker_count) {
+    if(worker_count == AUTOMATIC_WORKER_COUNT) {
+        uint32_t cores = std::thread::hardware_concurrency();
+        worker_count = (cores > 1) ? cores - 1 : 0;
+    }
+
+    queues_.resize(worker_count + 1);
+    arenas_.resize(worker_count + 1);
+    for(uint32_t i = 0; i < worker_count + 1; ++i) {
+        if(!queues_[i]) {
+            queues_[i].reset(new Queue());
+        }
+        if(!arenas_[i]) {
+            arenas_[i].reset(new ScratchArena());
+        }
+    }
+
+    for(uint32_t i = 0; i < worker_count; ++i) {
+        workers_.push_back(std::thread(&JobSystem::worker_main, this, i + 1));
+    }
+}
+
+void JobSystem::stop_workers() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+
+    sleep_condition_.notify_all();
+
+    for(std::thread& worker: workers_) {
+        worker.join();
+    }
+
+    workers_.clear();
+    stopping_ = false;
+}
+
+uint32_t JobSystem::current_queue() const {
+    return (current_system == this) ? current_queue_index : 0;
+}
+
+void JobSystem::run(Job job, JobCounter& counter) {
+    ++counter.count_;
+
+    Queue& queue = *queues_[current_queue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::make_pair(job, &counter));
+    }
+
+    ++queued_;
+
+    //A worker going to sleep counts itself before checking queued_, so it either
+    //sees the job above or is counted here and gets woken up
+    if(sleeping_ > 0) {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+        sleep_condition_.notify_one();
+    }
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    const uint32_t queue = current_queue();
+
+    std::pair<Job, JobCounter*> job;
+    while(counter.count_ > 0) {
+        if(take_job(queue, job)) {
+            execute(job);
+        } else {
+            //Whatever we're waiting for is running on another thread
+            std::this_thread::yield();
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(counter.error_mutex_);
+        std::swap(error, counter.error_);
+    }
+
+    if(error) {
+        std::rethrow_exception(error);
+    }
+}
+
+bool JobSystem::take_job(uint32_t queue_index, std::pair<Job, JobCounter*>& out) {
+    if(queued_ == 0) {
+        return false;
+    }
+
+    //Newest first from our own queue...
+    {
+        Queue& own = *queues_[queue_index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if(!own.jobs.empty()) {
+            out = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            --queued_;
+            return true;
+        }
+    }
+
+    //...then oldest first from anyone else's, starting somewhere different each time
+    //so that the thieves don't all pile onto the same queue
+    const uint32_t queue_count = queues_.size();
+    const uint32_t start = steal_start_++;
+
+    for(uint32_t i = 0; i < queue_count; ++i) {
+        uint32_t victim = (start + i) % queue_count;
+        if(victim == queue_index) {
+            continue;
+        }
+
+        Queue& queue = *queues_[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.jobs.empty()) {
+            out = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            --queued_;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobSystem::execute(std::pair<Job, JobCounter*>& job) {
+    JobCounter* counter = job.second;
+
+    try {
+        job.first();
+    } catch(...) {
+        std::lock_guard<std::mutex> lock(counter->error_mutex_);
+        if(!counter->error_) {
+            counter->error_ = std::current_exception();
+        }
+    }
+
+    job.first = Job();
+
+    //The waiting thread may destroy the counter as soon as this hits zero
+    --counter->count_;
+}
+
+void JobSystem::worker_main(uint32_t queue_index) {
+    current_system = this;
+    current_queue_index = queue_index;
+
+    Profiler::get().set_thread_name("Job worker " + boost::lexical_cast<std::string>(queue_index));
+
+    std::pair<Job, JobCounter*> job;
+    while(true) {
+        if(take_job(queue_index, job)) {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        ++sleeping_;
+        sleep_condition_.wait(lock, [this]() { return stopping_ || queued_ > 0; });
+        --sleeping_;
+
+        if(stopping_) {
+            return;
+        }
+    }
+}
+
+ScratchArena& JobSystem::scratch() {
+    if(current_system == this) {
+        return *arenas_[current_queue_index];
+    }
+
+    if(std::this_thread::get_id() == owner_) {
+        return *arenas_[0];
+    }
+
+    throw std::logic_error("Scratch memory is only available to job workers and the thread that owns the job system");
+}
+
+void JobSystem::new_frame() {
+    for(std::unique_ptr<ScratchArena>& arena: arenas_) {
+        arena->reset();
+    }
+}
+
+TaskGraph::TaskID TaskGraph::add(JobSystem::Job job) {
+    Task task;
+    task.job = job;
+    task.dependency_count = 0;
+
+    tasks_.push_back(task);
+    return tasks_.size() - 1;
+}
+
+void TaskGraph::add_dependency(TaskID task, TaskID dependency) {
+    if(task >= tasks_.size() || dependency >= tasks_.size()) {
+        throw std::logic_error("Tried to add a dependency to a task that isn't in the graph");
+    }
+
+    if(task == dependency) {
+        throw std::logic_error("A task can't depend on itself");
+    }
+
+    tasks_[dependency].dependents.push_back(task);
+    tasks_[task].dependency_count++;
+}
+
+void TaskGraph::check_for_cycles() const {
+    //Kahn's algorithm, anything that never becomes ready is part of (or behind) a cycle
+    std::vector<uint32_t> remaining(tasks_.size());
+    std::vector<TaskID> ready;
+
+    for(TaskID i = 0; i < tasks_.size(); ++i) {
+        remaining[i] = tasks_[i].dependency_count;
+        if(!remaining[i]) {
+            ready.push_back(i);
+        }
+    }
+
+    uint32_t visited = 0;
+    while(!ready.empty()) {
+        TaskID next = ready.back();
+        ready.pop_back();
+        ++visited;
+
+        for(TaskID dependent: tasks_[next].dependents) {
+            if(!--remaining[dependent]) {
+                ready.push_back(dependent);
+            }
+        }
+    }
+
+    if(visited != tasks_.size()) {
+        throw std::logic_error("The task graph contains a cycle");
+    }
+}
+
+void TaskGraph::run(JobSystem& jobs) {
+    check_for_cycles();
+
+    std::unique_ptr<std::atomic<uint32_t>[]> remaining(new std::atomic<uint32_t>[tasks_.size()]);
+    for(TaskID i = 0; i < tasks_.size(); ++i) {
+        remaining[i] = tasks_[i].dependency_count;
+    }
+
+    JobCounter counter;
+
+    //Each task starts its dependents before it finishes, so the counter only reaches
+    //zero once the whole graph has run (or been skipped after an exception)
+    std::function<void (TaskID)> start = [&](TaskID id) {
+        jobs.run([&, id]() {
+            const Task& task = tasks_[id];
+            task.job();
+
+            for(TaskID dependent: task.dependents) {
+                if(!--remaining[dependent]) {
+                    start(dependent);
+                }
+            }
+        }, counter);
+    };
+
+    for(TaskID i = 0; i < tasks_.size(); ++i) {
+        if(!tasks_[i].dependency_count) {
+            start(i);
+        }
+    }
+
+    jobs.wait(counter);
+}
+
+}
@@ -0,0 +1,235 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kglt {
+
+/*
+ * Counts the jobs started with it that haven't finished yet. Pass the same
+ * counter to several JobSystem::run() calls to wait for all of them at once.
+ * The first exception thrown by any of its jobs is rethrown by JobSystem::wait().
+ */
+class JobCounter {
+public:
+    JobCounter():
+        count_(0) {}
+
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool is_done() const { return count_ == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> count_;
+
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+};
+
+/*
+ * A bump allocator for memory that only has to last until the end of the frame.
+ * Allocating is a pointer increment, nothing is ever freed individually, and
+ * reset() makes all of it available again without returning it to the system.
+ * Destructors are never run, so only use it for trivially destructible types.
+ */
+class ScratchArena {
+public:
+    static const std::size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    ScratchArena(std::size_t block_size=DEFAULT_BLOCK_SIZE);
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    void* allocate(std::size_t bytes, std::size_t alignment=alignof(std::max_align_t));
+
+    template<typename T>
+    T* allocate_array(std::size_t count) {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void reset();
+
+    //Bytes handed out since the last reset()
+    std::size_t used() const { return used_; }
+    //Bytes held on to, including the unused part of each block
+    std::size_t capacity() const;
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> data;
+        std::size_t size;
+    };
+
+    std::size_t block_size_;
+    std::vector<Block> blocks_;
+    uint32_t current_block_;
+    std::size_t offset_;
+    std::size_t used_;
+};
+
+/*
+ * A work-stealing scheduler for splitting engine work across the cores. Each
+ * worker has its own queue; it takes its newest job first (so nested jobs stay
+ * in cache) and when its queue is empty it steals the oldest job from somebody
+ * else's. Threads that aren't workers (e.g. the main thread) share one more queue.
+ *
+ * wait() never just blocks: the waiting thread runs queued jobs until its counter
+ * reaches zero, so jobs can start and wait for other jobs without deadlocking,
+ * and with no workers at all everything still runs, on the waiting thread.
+ *
+ * Jobs must not touch GL, and anything they share has to be safe to use from
+ * several threads at once.
+ */
+class JobSystem {
+public:
+    typedef std::function<void ()> Job;
+
+    //One less than the number of cores, the thread that waits makes up the difference
+    static const uint32_t AUTOMATIC_WORKER_COUNT = 0xFFFFFFFF;
+
+    //With no workers at all, every job runs on whichever thread waits for it
+    JobSystem(uint32_t worker_count=AUTOMATIC_WORKER_COUNT);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    //The workers plus the thread that waits
+    uint32_t thread_count() const { return workers_.size() + 1; }
+
+    /*
+     * Stops the workers and starts worker_count new ones. Mainly for measuring how
+     * things scale, don't call it while any jobs are queued or running.
+     */
+    void set_worker_count(uint32_t worker_count);
+
+    void run(Job job, JobCounter& counter);
+    void wait(JobCounter& counter);
+
+    /*
+     * Calls func(first, last) on ranges covering [begin, end) from as many threads as
+     * are free, and returns once all of them have. Ranges are at least grain long (except
+     * the last) so that tiny ranges don't cost more to schedule than to run. Anything
+     * smaller than one grain runs straight away on the calling thread.
+     */
+    template<typename Func>
+    void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, Func func) {
+        if(begin >= end) {
+            return;
+        }
+
+        grain = (grain) ? grain : 1;
+
+        const uint32_t count = end - begin;
+        if(count <= grain || workers_.empty()) {
+            func(begin, end);
+            return;
+        }
+
+        //A few ranges per thread so that stealing can even out uneven ranges
+        uint32_t ranges = (count + grain - 1) / grain;
+        const uint32_t max_ranges = thread_count() * RANGES_PER_THREAD;
+        ranges = (ranges < max_ranges) ? ranges : max_ranges;
+
+        const uint32_t range_size = (count + ranges - 1) / ranges;
+
+        JobCounter counter;
+        for(uint32_t first = begin; first < end; first += range_size) {
+            const uint32_t last = (end - first > range_size) ? first + range_size : end;
+            run([&func, first, last]() { func(first, last); }, counter);
+        }
+
+        wait(counter);
+    }
+
+    /*
+     * The arena belonging to the calling thread, either a worker or the thread that
+     * created the JobSystem. It's reset by new_frame(), so it's only for data that
+     * doesn't outlive the frame. Throws std::logic_error on any other thread.
+     */
+    ScratchArena& scratch();
+
+    //Resets every thread's arena, call between frames when no jobs are running
+    void new_frame();
+
+private:
+    static const uint32_t RANGES_PER_THREAD = 4;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::pair<Job, JobCounter*> > jobs;
+    };
+
+    //Queue 0 is shared by every thread that isn't a worker, worker i owns queue i + 1
+    std::vector<std::unique_ptr<Queue> > queues_;
+    std::vector<std::unique_ptr<ScratchArena> > arenas_;
+    std::vector<std::thread> workers_;
+    std::thread::id owner_;
+
+    std::atomic<uint32_t> queued_;
+    std::atomic<uint32_t> steal_start_;
+    std::atomic<uint32_t> sleeping_;
+
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_condition_;
+    bool stopping_;
+
+    void start_workers(uint32_t worker_count);
+    void stop_workers();
+
+    void worker_main(uint32_t queue_index);
+    uint32_t current_queue() const;
+    bool take_job(uint32_t queue_index, std::pair<Job, JobCounter*>& out);
+    void execute(std::pair<Job, JobCounter*>& job);
+};
+
+/*
+ * Jobs that have to run in a particular order. Add the jobs, say which ones have
+ * to finish before which, then run() starts everything as soon as whatever it
+ * depends on has finished and returns when the whole graph has. A graph can be
+ * run any number of times. If a task throws, the tasks depending on it (directly
+ * or not) are skipped and run() rethrows once the rest have finished.
+ */
+class TaskGraph {
+public:
+    typedef uint32_t TaskID;
+
+    TaskID add(JobSystem::Job job);
+
+    //task won't start until dependency has finished
+    void add_dependency(TaskID task, TaskID dependency);
+
+    uint32_t task_count() const { return tasks_.size(); }
+
+    //Throws std::logic_error if the dependencies form a cycle
+    void run(JobSystem& jobs);
+
+private:
+    struct Task {
+        JobSystem::Job job;
+        std::vector<TaskID> dependents;
+        uint32_t dependency_count;
+    };
+
+    std::vector<Task> tasks_;
+
+    void check_for_cycles() const;
+};
+
+}
+
+#endif // JOB_SYSTEM_H
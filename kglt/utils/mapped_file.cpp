@@ -0,0 +1,89 @@
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <boost/lexical_cast.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../kazbase/exceptions.h"
+#include "mapped_file.h"
+
+namespace kglt {
+
+std::shared_ptr<const MappedFile> MappedFile::map(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw IOError("Couldn't open the file: " + filename);
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0) {
+        close(fd);
+        throw IOError("Couldn't read the size of the file: " + filename);
+    }
+
+    const std::size_t size = info.st_size;
+    if(!size) {
+        //There's nothing to map, and mmap refuses to map nothing
+        close(fd);
+        return std::shared_ptr<const MappedFile>(new MappedFile(nullptr, 0));
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); //The mapping keeps the file open
+
+    if(data == MAP_FAILED) {
+        throw IOError("Couldn't map the file: " + filename);
+    }
+
+    //Everything mapped here is read start to finish shortly after
+    madvise(data, size, MADV_WILLNEED);
+
+    return std::shared_ptr<const MappedFile>(new MappedFile(data, size));
+}
+
+MappedFile::~MappedFile() {
+    if(data_) {
+        munmap(data_, size_);
+    }
+}
+
+void replace_file(const std::string& filename, std::function<void (std::ostream&)> write) {
+    //Unique for each thread and process that might be writing the same file
+    static std::atomic<uint32_t> counter(0);
+    const std::string temporary = filename + "." +
+        boost::lexical_cast<std::string>(getpid()) + "." +
+        boost::lexical_cast<std::string>(counter++) + ".tmp";
+
+    {
+        std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+        if(!file) {
+            throw IOError("Couldn't open the file for writing: " + temporary);
+        }
+
+        try {
+            write(file);
+        } catch(...) {
+            file.close();
+            unlink(temporary.c_str());
+            throw;
+        }
+
+        file.flush();
+        if(!file) {
+            file.close();
+            unlink(temporary.c_str());
+            throw IOError("Couldn't write the file: " + temporary);
+        }
+    }
+
+    if(rename(temporary.c_str(), filename.c_str()) != 0) {
+        unlink(temporary.c_str());
+        throw IOError("Couldn't replace the file: " + filename);
+    }
+}
+
+}
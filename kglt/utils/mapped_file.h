@@ -0,0 +1,48 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace kglt {
+
+/*
+ * A whole file mapped read only. Compiled resources point straight into it, and
+ * keep it mapped by holding on to the shared_ptr it came in.
+ */
+class MappedFile {
+public:
+    //Throws IOError if the file can't be opened or mapped
+    static std::shared_ptr<const MappedFile> map(const std::string& filename);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    //Null when the file is empty
+    const uint8_t* data() const { return static_cast<const uint8_t*>(data_); }
+    std::size_t size() const { return size_; }
+
+private:
+    MappedFile(void* data, std::size_t size):
+        data_(data),
+        size_(size) {}
+
+    void* data_;
+    std::size_t size_;
+};
+
+/*
+ * Calls write with a temporary file which is then renamed to filename, so anything
+ * reading filename at the same time never sees half of it. Throws IOError if any
+ * of it fails, in which case the temporary file is removed.
+ */
+void replace_file(const std::string& filename, std::function<void (std::ostream&)> write);
+
+}
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "../kazbase/logging.h"
+#include "../mesh.h"
+#include "../material.h"
+#include "../texture.h"
+#include "../scene.h"
+#include "../resource_manager.h"
+#include "mesh_compiler.h"
+#include "mapped_file.h"
+#include "profiler.h"
+
+namespace kglt {
+
+namespace {
+
+const char KGLMESH_IDENTIFIER[8] = { 'K', 'G', 'L', 'M', 'E', 'S', 'H', '\n' };
+const uint32_t KGLMESH_ENDIANNESS = 0x04030201;
+const uint32_t KGLMESH_VERSION = 1;
+
+//Buffers start on this, so they can be read in place whatever their type
+const uint64_t KGLMESH_ALIGNMENT = 16;
+
+struct KGLMeshHeader {
+    char identifier[8];
+    uint32_t endianness;
+    uint32_t version;
+    uint32_t vertex_block_count;
+    uint32_t submesh_count;
+    uint32_t string_bytes;
+    uint32_t reserved;
+};
+
+struct KGLMeshVertexBlock {
+    int32_t attributes;
+    int32_t byte_encoded;
+    uint8_t tex_coord_dimensions[8];
+    uint32_t count;
+    uint32_t stride;
+    uint64_t offset;
+};
+
+struct KGLMeshSubMesh {
+    uint32_t vertex_block;
+    uint32_t arrangement;
+    uint32_t index_type;
+    uint32_t index_count;
+    uint64_t index_offset;
+    float bounds_min[3];
+    float bounds_max[3];
+    uint32_t material_type;
+    uint32_t material_offset; //Into the strings, which follow the submeshes
+    uint32_t material_length;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(KGLMeshHeader) == 32, "kglmesh headers are 32 bytes");
+static_assert(sizeof(KGLMeshVertexBlock) == 32, "kglmesh vertex blocks are 32 bytes");
+static_assert(sizeof(KGLMeshSubMesh) == 64, "kglmesh submeshes are 64 bytes");
+
+uint64_t aligned(uint64_t offset) {
+    return (offset + KGLMESH_ALIGNMENT - 1) / KGLMESH_ALIGNMENT * KGLMESH_ALIGNMENT;
+}
+
+uint32_t index_size(IndexType type) {
+    switch(type) {
+        case INDEX_TYPE_8_BIT: return 1;
+        case INDEX_TYPE_16_BIT: return 2;
+    default:
+        return 4;
+    }
+}
+
+uint32_t read_index(const PackedIndices& indices, uint32_t i) {
+    switch(indices.type) {
+        case INDEX_TYPE_8_BIT:
+            return indices.data[i];
+        case INDEX_TYPE_16_BIT: {
+            uint16_t value;
+            std::memcpy(&value, indices.data + i * 2, 2);
+            return value;
+        }
+    default: {
+            uint32_t value;
+            std::memcpy(&value, indices.data + i * 4, 4);
+            return value;
+        }
+    }
+}
+
+void material_source(Mesh& mesh, SubMesh& submesh, CompiledSubMesh& out) {
+    out.material_type = MATERIAL_SOURCE_DEFAULT;
+
+    ResourceManager& resource_manager = mesh.resource_manager();
+    if(submesh.material_id() == resource_manager.scene().default_material_id()) {
+        return;
+    }
+
+    auto material = resource_manager.material(submesh.material_id());
+    if(!material->source_file().empty()) {
+        out.material_type = MATERIAL_SOURCE_SCRIPT;
+        out.material_file = material->source_file();
+        return;
+    }
+
+    MaterialPass& pass = material->technique().pass(0);
+    if(pass.texture_unit_count()) {
+        TextureID texture_id = pass.texture_unit(0).texture_id();
+        if(texture_id && resource_manager.has_texture(texture_id)) {
+            const std::string& source = resource_manager.texture(texture_id)->source_file();
+            if(!source.empty()) {
+                out.material_type = MATERIAL_SOURCE_TEXTURE;
+                out.material_file = source;
+                return;
+            }
+        }
+    }
+
+    L_WARN("A submesh's material wasn't loaded from a file, it will be saved as the default material");
+}
+
+}
+
+CompiledMesh compile_mesh(Mesh& mesh) {
+    KGLT_PROFILE_SCOPE("compile_mesh");
+
+    CompiledMesh result;
+    result.vertices.push_back(mesh.shared_data().packed());
+
+    for(SubMeshIndex idx: mesh.submesh_ids()) {
+        SubMesh& submesh = mesh.submesh(idx);
+
+        CompiledSubMesh compiled;
+        if(&submesh.vertex_data() == &mesh.shared_data()) {
+            compiled.vertices = 0;
+        } else {
+            compiled.vertices = result.vertices.size();
+            result.vertices.push_back(submesh.vertex_data().packed());
+        }
+
+        compiled.arrangement = submesh.arrangement();
+        compiled.indices = submesh.index_data().packed();
+        compiled.bounds = submesh.bounds();
+        material_source(mesh, submesh, compiled);
+
+        result.submeshes.push_back(compiled);
+    }
+
+    return result;
+}
+
+void save_kglmesh(Mesh& mesh, const std::string& filename) {
+    save_kglmesh(compile_mesh(mesh), filename);
+}
+
+void save_kglmesh(const CompiledMesh& mesh, const std::string& filename) {
+    if(mesh.vertices.empty()) {
+        throw std::logic_error("A compiled mesh needs at least the shared vertices");
+    }
+
+    std::string strings;
+    std::vector<KGLMeshVertexBlock> blocks;
+    std::vector<KGLMeshSubMesh> submeshes;
+
+    //The tables come first, then the buffers in the same order
+    uint64_t offset = sizeof(KGLMeshHeader) +
+        mesh.vertices.size() * sizeof(KGLMeshVertexBlock) +
+        mesh.submeshes.size() * sizeof(KGLMeshSubMesh);
+
+    for(const CompiledSubMesh& compiled: mesh.submeshes) {
+        strings += compiled.material_file;
+    }
+    offset += strings.size();
+
+    for(const PackedVertices& vertices: mesh.vertices) {
+        KGLMeshVertexBlock block = KGLMeshVertexBlock();
+        block.attributes = vertices.attributes;
+        block.byte_encoded = vertices.byte_encoded;
+        std::copy(vertices.tex_coord_dimensions, vertices.tex_coord_dimensions + 8, block.tex_coord_dimensions);
+        block.count = vertices.count;
+        block.stride = vertices.stride;
+        block.offset = offset = aligned(offset);
+        blocks.push_back(block);
+
+        offset += uint64_t(vertices.count) * vertices.stride;
+    }
+
+    uint32_t string_offset = 0;
+    for(const CompiledSubMesh& compiled: mesh.submeshes) {
+        if(compiled.vertices >= mesh.vertices.size()) {
+            throw std::logic_error("A compiled submesh uses vertices that don't exist");
+        }
+
+        KGLMeshSubMesh submesh = KGLMeshSubMesh();
+        submesh.vertex_block = compiled.vertices;
+        submesh.arrangement = compiled.arrangement;
+        submesh.index_type = compiled.indices.type;
+        submesh.index_count = compiled.indices.count;
+        submesh.index_offset = offset = aligned(offset);
+        std::memcpy(submesh.bounds_min, &compiled.bounds.min, sizeof(float) * 3);
+        std::memcpy(submesh.bounds_max, &compiled.bounds.max, sizeof(float) * 3);
+        submesh.material_type = compiled.material_type;
+        submesh.material_offset = string_offset;
+        submesh.material_length = compiled.material_file.size();
+        submeshes.push_back(submesh);
+
+        string_offset += compiled.material_file.size();
+        offset += uint64_t(compiled.indices.count) * index_size(compiled.indices.type);
+    }
+
+    KGLMeshHeader header = KGLMeshHeader();
+    std::memcpy(header.identifier, KGLMESH_IDENTIFIER, sizeof(KGLMESH_IDENTIFIER));
+    header.endianness = KGLMESH_ENDIANNESS;
+    header.version = KGLMESH_VERSION;
+    header.vertex_block_count = blocks.size();
+    header.submesh_count = submeshes.size();
+    header.string_bytes = strings.size();
+
+    replace_file(filename, [&](std::ostream& file) {
+        uint64_t written = 0;
+        auto write = [&](const void* data, uint64_t size) {
+            file.write(static_cast<const char*>(data), size);
+            written += size;
+        };
+
+        auto pad_to = [&](uint64_t position) {
+            static const char ZEROS[KGLMESH_ALIGNMENT] = {};
+            write(ZEROS, position - written);
+        };
+
+        write(&header, sizeof(header));
+        if(!blocks.empty()) {
+            write(&blocks[0], blocks.size() * sizeof(KGLMeshVertexBlock));
+        }
+        if(!submeshes.empty()) {
+            write(&submeshes[0], submeshes.size() * sizeof(KGLMeshSubMesh));
+        }
+        write(strings.data(), strings.size());
+
+        for(uint32_t i = 0; i < blocks.size(); ++i) {
+            pad_to(blocks[i].offset);
+            write(mesh.vertices[i].data, uint64_t(blocks[i].count) * blocks[i].stride);
+        }
+
+        for(uint32_t i = 0; i < submeshes.size(); ++i) {
+            pad_to(submeshes[i].index_offset);
+            write(mesh.submeshes[i].indices.data, uint64_t(submeshes[i].index_count) * index_size(mesh.submeshes[i].indices.type));
+        }
+    });
+}
+
+CompiledMesh map_kglmesh(const std::string& filename) {
+    KGLT_PROFILE_SCOPE("map_kglmesh");
+
+    std::shared_ptr<const MappedFile> mapping = MappedFile::map(filename);
+    const uint64_t size = mapping->size();
+
+    if(size < sizeof(KGLMeshHeader)) {
+        throw std::runtime_error("Not a kglmesh file: " + filename);
+    }
+
+    KGLMeshHeader header;
+    std::memcpy(&header, mapping->data(), sizeof(header));
+
+    if(std::memcmp(header.identifier, KGLMESH_IDENTIFIER, sizeof(KGLMESH_IDENTIFIER)) != 0) {
+        throw std::runtime_error("Not a kglmesh file: " + filename);
+    }
+
+    if(header.endianness != KGLMESH_ENDIANNESS) {
+        throw std::runtime_error("kglmesh file was written with the other byte order: " + filename);
+    }
+
+    if(header.version != KGLMESH_VERSION) {
+        throw std::runtime_error("Unsupported kglmesh version in: " + filename);
+    }
+
+    const uint64_t blocks_start = sizeof(KGLMeshHeader);
+    const uint64_t submeshes_start = blocks_start + uint64_t(header.vertex_block_count) * sizeof(KGLMeshVertexBlock);
+    const uint64_t strings_start = submeshes_start + uint64_t(header.submesh_count) * sizeof(KGLMeshSubMesh);
+
+    if(!header.vertex_block_count || strings_start + header.string_bytes > size) {
+        throw std::runtime_error("kglmesh file is truncated: " + filename);
+    }
+
+    //The buffers are only checked to be in the file, whether the layouts add up is VertexData's job
+    auto check_range = [&](uint64_t offset, uint64_t bytes) {
+        if(offset % KGLMESH_ALIGNMENT != 0 || offset > size || bytes > size - offset) {
+            throw std::runtime_error("kglmesh file has a buffer outside of it: " + filename);
+        }
+    };
+
+    CompiledMesh result;
+    for(uint32_t i = 0; i < header.vertex_block_count; ++i) {
+        KGLMeshVertexBlock block;
+        std::memcpy(&block, mapping->data() + blocks_start + i * sizeof(block), sizeof(block));
+
+        check_range(block.offset, uint64_t(block.count) * block.stride);
+
+        PackedVertices vertices;
+        vertices.attributes = block.attributes;
+        vertices.byte_encoded = block.byte_encoded;
+        std::copy(block.tex_coord_dimensions, block.tex_coord_dimensions + 8, vertices.tex_coord_dimensions);
+        vertices.count = block.count;
+        vertices.stride = block.stride;
+        vertices.data = (block.count) ? mapping->data() + block.offset : nullptr;
+        vertices.storage = mapping;
+        result.vertices.push_back(vertices);
+    }
+
+    const char* strings = reinterpret_cast<const char*>(mapping->data() + strings_start);
+
+    for(uint32_t i = 0; i < header.submesh_count; ++i) {
+        KGLMeshSubMesh submesh;
+        std::memcpy(&submesh, mapping->data() + submeshes_start + i * sizeof(submesh), sizeof(submesh));
+
+        if(submesh.vertex_block >= header.vertex_block_count ||
+            submesh.arrangement > MESH_ARRANGEMENT_LINE_STRIP ||
+            submesh.index_type > INDEX_TYPE_32_BIT ||
+            submesh.material_type > MATERIAL_SOURCE_SCRIPT ||
+            uint64_t(submesh.material_offset) + submesh.material_length > header.string_bytes) {
+            throw std::runtime_error("kglmesh file has an invalid submesh: " + filename);
+        }
+
+        CompiledSubMesh compiled;
+        compiled.vertices = submesh.vertex_block;
+        compiled.arrangement = MeshArrangement(submesh.arrangement);
+        compiled.material_type = MaterialSourceType(submesh.material_type);
+        compiled.material_file = std::string(strings + submesh.material_offset, submesh.material_length);
+        kmVec3Fill(&compiled.bounds.min, submesh.bounds_min[0], submesh.bounds_min[1], submesh.bounds_min[2]);
+        kmVec3Fill(&compiled.bounds.max, submesh.bounds_max[0], submesh.bounds_max[1], submesh.bounds_max[2]);
+
+        compiled.indices.type = IndexType(submesh.index_type);
+        compiled.indices.count = submesh.index_count;
+        check_range(submesh.index_offset, uint64_t(submesh.index_count) * index_size(compiled.indices.type));
+        compiled.indices.data = (submesh.index_count) ? mapping->data() + submesh.index_offset : nullptr;
+        compiled.indices.storage = mapping;
+
+        //An index past the end of the vertices would have GL read past the end of the buffer
+        const uint32_t vertex_count = result.vertices[compiled.vertices].count;
+        for(uint32_t j = 0; j < compiled.indices.count; ++j) {
+            if(read_index(compiled.indices, j) >= vertex_count) {
+                throw std::runtime_error("kglmesh file has an index past the end of its vertices: " + filename);
+            }
+        }
+
+        result.submeshes.push_back(compiled);
+    }
+
+    return result;
+}
+
+}
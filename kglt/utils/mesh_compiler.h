@@ -0,0 +1,67 @@
+#ifndef MESH_COMPILER_H
+#define MESH_COMPILER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <kazmath/aabb.h>
+
+#include "../types.h"
+#include "../vertex_data.h"
+
+namespace kglt {
+
+class Mesh;
+
+enum MaterialSourceType {
+    MATERIAL_SOURCE_DEFAULT, //The scene's default material
+    MATERIAL_SOURCE_TEXTURE, //An image, made into a material with create_material_from_texture()
+    MATERIAL_SOURCE_SCRIPT //A material script
+};
+
+struct CompiledSubMesh {
+    uint32_t vertices; //Which of CompiledMesh::vertices it uses, 0 is the shared data
+    MeshArrangement arrangement;
+    PackedIndices indices;
+    kmAABB bounds;
+
+    MaterialSourceType material_type;
+    std::string material_file;
+};
+
+/*
+ * A mesh in the form it's uploaded in, so loading it is only a matter of handing the
+ * buffers to GL. vertices[0] is the mesh's shared data, the rest belong to submeshes
+ * with vertices of their own.
+ */
+struct CompiledMesh {
+    std::vector<PackedVertices> vertices;
+    std::vector<CompiledSubMesh> submeshes;
+};
+
+/*
+ * Materials are kept as the file they were loaded from: a material script, or the
+ * image on the first texture unit for materials made from a texture. Anything else
+ * is saved as the default material, with a warning.
+ */
+CompiledMesh compile_mesh(Mesh& mesh);
+
+/*
+ * Writes a .kglmesh file, through a temporary file which is then renamed. These
+ * are a header followed by tables of the vertex blocks and submeshes, the material
+ * file names and then the buffers themselves, each starting on a 16 byte boundary.
+ * Everything is in the byte order of the machine that wrote it.
+ */
+void save_kglmesh(const CompiledMesh& mesh, const std::string& filename);
+void save_kglmesh(Mesh& mesh, const std::string& filename);
+
+/*
+ * Maps a .kglmesh file into memory, the buffers point straight into the mapping and
+ * keep it around. Throws IOError if the file can't be read and std::runtime_error
+ * if it isn't a valid .kglmesh.
+ */
+CompiledMesh map_kglmesh(const std::string& filename);
+
+}
+
+#endif // MESH_COMPILER_H
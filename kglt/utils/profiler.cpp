@@ -0,0 +1,149 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <boost/lexical_cast.hpp>
+
+#include "../kazbase/logging.h"
+#include "profiler.h"
+
+namespace kglt {
+
+typedef std::chrono::steady_clock ProfileClock;
+
+uint64_t Profiler::now() {
+    static const ProfileClock::time_point epoch = ProfileClock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(ProfileClock::now() - epoch).count();
+}
+
+Profiler& Profiler::get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler():
+    enabled_(true),
+    spike_threshold_(0),
+    frame_start_(0),
+    frame_count_(0),
+    last_spike_dump_(0) {
+
+}
+
+Profiler::ThreadBuffer& Profiler::buffer_for_this_thread() {
+    static thread_local ThreadBuffer* buffer = nullptr;
+
+    if(!buffer) {
+        //Owned by the profiler rather than the thread so that it can still be dumped after the thread exits
+        std::shared_ptr<ThreadBuffer> new_buffer(new ThreadBuffer());
+        new_buffer->events.resize(EVENTS_PER_THREAD);
+
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        new_buffer->id = buffers_.size() + 1;
+        new_buffer->name = "Thread " + boost::lexical_cast<std::string>(new_buffer->id);
+        buffers_.push_back(new_buffer);
+        buffer = new_buffer.get();
+    }
+
+    return *buffer;
+}
+
+void Profiler::set_thread_name(const std::string& name) {
+    ThreadBuffer& buffer = buffer_for_this_thread();
+
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+    ThreadBuffer& buffer = buffer_for_this_thread();
+
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    ProfileEvent& event = buffer.events[buffer.written % EVENTS_PER_THREAD];
+    event.name = name;
+    event.start = start;
+    event.duration = end - start;
+    ++buffer.written;
+}
+
+void Profiler::new_frame() {
+    uint64_t frame_end = now();
+    uint64_t frame_start = frame_start_;
+    frame_start_ = frame_end;
+
+    if(!frame_count_++ || spike_threshold_ <= 0 || !enabled_) {
+        return;
+    }
+
+    double frame_time = double(frame_end - frame_start) / 1000000.0;
+    if(frame_time < spike_threshold_) {
+        return;
+    }
+
+    const uint64_t interval = uint64_t(SPIKE_DUMP_INTERVAL) * 1000000000;
+    if(last_spike_dump_ && frame_end - last_spike_dump_ < interval) {
+        return;
+    }
+
+    last_spike_dump_ = frame_end;
+
+    std::string filename = "kglt_spike_" + boost::lexical_cast<std::string>(frame_count_ - 1) + ".json";
+    L_WARN("Frame took " + boost::lexical_cast<std::string>(frame_time) + "ms, writing a trace to " + filename);
+    dump(filename);
+}
+
+void Profiler::clear() {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    for(auto buffer: buffers_) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        buffer->written = 0;
+    }
+}
+
+static std::string escape(const std::string& s) {
+    std::string result;
+    for(char c: s) {
+        if(c == '"' || c == '\\') {
+            result.push_back('\\');
+        }
+        result.push_back(c);
+    }
+    return result;
+}
+
+bool Profiler::dump(const std::string& filename) {
+    std::ofstream file(filename.c_str());
+    if(!file.good()) {
+        L_ERROR("Unable to open " + filename + " to write the profile");
+        return false;
+    }
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    for(auto buffer: buffers_) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+
+        file << ((first) ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+             << ",\"args\":{\"name\":\"" << escape(buffer->name) << "\"}}";
+        first = false;
+
+        //Oldest first, if the ring has wrapped that's the slot that will be written next
+        uint64_t count = (buffer->written < EVENTS_PER_THREAD) ? buffer->written : EVENTS_PER_THREAD;
+        for(uint64_t i = buffer->written - count; i < buffer->written; ++i) {
+            const ProfileEvent& event = buffer->events[i % EVENTS_PER_THREAD];
+
+            //Timestamps are in microseconds
+            file << ",\n{\"name\":\"" << escape(event.name) << "\",\"cat\":\"kglt\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+                 << ",\"ts\":" << double(event.start) / 1000.0
+                 << ",\"dur\":" << double(event.duration) / 1000.0 << "}";
+        }
+    }
+
+    file << "\n]}\n";
+    return file.good();
+}
+
+}
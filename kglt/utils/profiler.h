@@ -0,0 +1,109 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace kglt {
+
+struct ProfileEvent {
+    const char* name; //Always a string literal, so only the pointer is kept
+    uint64_t start; //Nanoseconds since the profiler was created
+    uint64_t duration;
+};
+
+/*
+ * A scoped CPU profiler. Each thread records the scopes it leaves into its
+ * own fixed size ring buffer, so only the last EVENTS_PER_THREAD events of each
+ * thread are kept and recording never allocates. dump() writes out whatever
+ * the buffers hold in the Chrome trace event format, which can be loaded into
+ * about:tracing or Perfetto.
+ *
+ * If a spike threshold is set, new_frame() dumps the buffers by itself
+ * whenever a frame takes longer than that, at most once every
+ * SPIKE_DUMP_INTERVAL seconds.
+ *
+ * Use the KGLT_PROFILE_SCOPE macro rather than ProfileScope directly so that
+ * defining KGLT_DISABLE_PROFILER compiles the markers out completely.
+ */
+class Profiler {
+public:
+    static const uint32_t EVENTS_PER_THREAD = 16384;
+    static const uint32_t SPIKE_DUMP_INTERVAL = 5;
+
+    static Profiler& get();
+    static uint64_t now();
+
+    bool is_enabled() const { return enabled_; }
+    void set_enabled(bool value) { enabled_ = value; }
+
+    //In milliseconds, 0 (the default) turns automatic dumps off
+    double spike_threshold() const { return spike_threshold_; }
+    void set_spike_threshold(double milliseconds) { spike_threshold_ = milliseconds; }
+
+    void set_thread_name(const std::string& name);
+
+    void record(const char* name, uint64_t start, uint64_t end);
+    void new_frame();
+
+    bool dump(const std::string& filename);
+    void clear();
+
+private:
+    Profiler();
+
+    struct ThreadBuffer {
+        uint32_t id;
+        std::string name;
+        std::mutex mutex; //Only ever contended while dumping
+        std::vector<ProfileEvent> events;
+        uint64_t written = 0;
+    };
+
+    ThreadBuffer& buffer_for_this_thread();
+
+    std::atomic<bool> enabled_;
+    double spike_threshold_;
+
+    std::mutex buffers_mutex_;
+    std::vector<std::shared_ptr<ThreadBuffer> > buffers_;
+
+    uint64_t frame_start_;
+    uint64_t frame_count_;
+    uint64_t last_spike_dump_;
+};
+
+class ProfileScope {
+public:
+    ProfileScope(const char* name):
+        name_(name),
+        active_(Profiler::get().is_enabled()),
+        start_((active_) ? Profiler::now() : 0) {}
+
+    ~ProfileScope() {
+        if(active_) {
+            Profiler::get().record(name_, start_, Profiler::now());
+        }
+    }
+
+private:
+    const char* name_;
+    bool active_;
+    uint64_t start_;
+};
+
+}
+
+#ifdef KGLT_DISABLE_PROFILER
+#define KGLT_PROFILE_SCOPE(name)
+#else
+#define KGLT_PROFILE_CONCAT_(a, b) a##b
+#define KGLT_PROFILE_CONCAT(a, b) KGLT_PROFILE_CONCAT_(a, b)
+#define KGLT_PROFILE_SCOPE(name) kglt::ProfileScope KGLT_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#endif
+
+#endif // PROFILER_H
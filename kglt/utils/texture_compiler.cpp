@@ -0,0 +1,622 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <SOIL/SOIL.h>
+#include <boost/lexical_cast.hpp>
+
+#include "../kazbase/exceptions.h"
+#include "../kazbase/logging.h"
+#include "texture_compiler.h"
+#include "mapped_file.h"
+#include "profiler.h"
+
+namespace kglt {
+
+namespace {
+
+//The GL enums KTX headers are made of, the same values GLee defines
+const uint32_t KTX_GL_UNSIGNED_BYTE = 0x1401;
+const uint32_t KTX_GL_UNSIGNED_SHORT_4_4_4_4 = 0x8033;
+const uint32_t KTX_GL_UNSIGNED_SHORT_5_6_5 = 0x8363;
+const uint32_t KTX_GL_RGB = 0x1907;
+const uint32_t KTX_GL_RGBA = 0x1908;
+const uint32_t KTX_GL_RGB8 = 0x8051;
+const uint32_t KTX_GL_RGBA8 = 0x8058;
+const uint32_t KTX_GL_RGB565 = 0x8D62;
+const uint32_t KTX_GL_RGBA4 = 0x8056;
+const uint32_t KTX_GL_COMPRESSED_RGB_S3TC_DXT1 = 0x83F0;
+const uint32_t KTX_GL_COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+
+const uint8_t KTX_IDENTIFIER[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+const uint32_t KTX_ENDIANNESS = 0x04030201;
+
+struct KTXHeader {
+    uint8_t identifier[12];
+    uint32_t endianness;
+    uint32_t gl_type;
+    uint32_t gl_type_size;
+    uint32_t gl_format;
+    uint32_t gl_internal_format;
+    uint32_t gl_base_internal_format;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t array_elements;
+    uint32_t faces;
+    uint32_t mipmap_levels;
+    uint32_t key_value_bytes;
+};
+
+static_assert(sizeof(KTXHeader) == 64, "KTX headers are 64 bytes");
+
+struct KTXFormat {
+    TextureFormat format;
+    uint32_t gl_type; //0 when compressed
+    uint32_t gl_type_size;
+    uint32_t gl_format; //0 when compressed
+    uint32_t gl_internal_format;
+    uint32_t gl_base_internal_format;
+};
+
+const KTXFormat KTX_FORMATS[] = {
+    { TEXTURE_FORMAT_RGB_888, KTX_GL_UNSIGNED_BYTE, 1, KTX_GL_RGB, KTX_GL_RGB8, KTX_GL_RGB },
+    { TEXTURE_FORMAT_RGBA_8888, KTX_GL_UNSIGNED_BYTE, 1, KTX_GL_RGBA, KTX_GL_RGBA8, KTX_GL_RGBA },
+    { TEXTURE_FORMAT_RGB_565, KTX_GL_UNSIGNED_SHORT_5_6_5, 2, KTX_GL_RGB, KTX_GL_RGB565, KTX_GL_RGB },
+    { TEXTURE_FORMAT_RGBA_4444, KTX_GL_UNSIGNED_SHORT_4_4_4_4, 2, KTX_GL_RGBA, KTX_GL_RGBA4, KTX_GL_RGBA },
+    { TEXTURE_FORMAT_DXT1, 0, 1, 0, KTX_GL_COMPRESSED_RGB_S3TC_DXT1, KTX_GL_RGB },
+    { TEXTURE_FORMAT_DXT5, 0, 1, 0, KTX_GL_COMPRESSED_RGBA_S3TC_DXT5, KTX_GL_RGBA }
+};
+
+const KTXFormat& ktx_format(TextureFormat format) {
+    for(const KTXFormat& info: KTX_FORMATS) {
+        if(info.format == format) {
+            return info;
+        }
+    }
+
+    throw std::logic_error("Unknown texture format");
+}
+
+const KTXFormat* ktx_format_for(const KTXHeader& header) {
+    for(const KTXFormat& info: KTX_FORMATS) {
+        if(info.gl_type) {
+            //Some tools write unsized internal formats, the type and format say it all anyway
+            if(header.gl_type == info.gl_type && header.gl_format == info.gl_format) {
+                return &info;
+            }
+        } else if(!header.gl_type && header.gl_internal_format == info.gl_internal_format) {
+            return &info;
+        }
+    }
+
+    return nullptr;
+}
+
+bool is_compressed(TextureFormat format) {
+    return format == TEXTURE_FORMAT_DXT1 || format == TEXTURE_FORMAT_DXT5;
+}
+
+uint32_t bytes_per_pixel(TextureFormat format) {
+    switch(format) {
+        case TEXTURE_FORMAT_RGB_888: return 3;
+        case TEXTURE_FORMAT_RGBA_8888: return 4;
+        case TEXTURE_FORMAT_RGB_565:
+        case TEXTURE_FORMAT_RGBA_4444: return 2;
+        default:
+            throw std::logic_error("Compressed formats don't have a size per pixel");
+    }
+}
+
+uint32_t row_size(TextureFormat format, uint32_t width) {
+    return (width * bytes_per_pixel(format) + 3) & ~3u;
+}
+
+uint32_t next_level_size(uint32_t size) {
+    return (size > 1) ? size / 2 : 1;
+}
+
+uint32_t scale(uint8_t value, uint32_t max) {
+    return (value * max + 127) / 255;
+}
+
+uint16_t pack_565(const uint8_t* rgb) {
+    return (scale(rgb[0], 31) << 11) | (scale(rgb[1], 63) << 5) | scale(rgb[2], 31);
+}
+
+void unpack_565(uint16_t colour, uint8_t* rgb) {
+    uint8_t r = colour >> 11, g = (colour >> 5) & 63, b = colour & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+void write_u16(uint8_t* out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+/*
+ * The endpoints are the corners of the block's colour range, pulled in a little
+ * so that the two interpolated colours land nearer to where most pixels are.
+ */
+void encode_colour_block(const uint8_t pixels[16][4], uint8_t* out) {
+    uint8_t low[3] = {255, 255, 255}, high[3] = {0, 0, 0};
+    for(uint32_t i = 0; i < 16; ++i) {
+        for(uint32_t c = 0; c < 3; ++c) {
+            low[c] = std::min(low[c], pixels[i][c]);
+            high[c] = std::max(high[c], pixels[i][c]);
+        }
+    }
+
+    for(uint32_t c = 0; c < 3; ++c) {
+        uint8_t inset = (high[c] - low[c]) / 16;
+        low[c] += inset;
+        high[c] -= inset;
+    }
+
+    //Packing keeps the order of each channel, so this is never less than colour1
+    uint16_t colour0 = pack_565(high);
+    uint16_t colour1 = pack_565(low);
+
+    write_u16(out, colour0);
+    write_u16(out + 2, colour1);
+    std::memset(out + 4, 0, 4);
+
+    if(colour0 == colour1) {
+        return; //Every pixel is colour0
+    }
+
+    int32_t palette[4][3];
+    uint8_t rgb[3];
+    unpack_565(colour0, rgb);
+    for(uint32_t c = 0; c < 3; ++c) palette[0][c] = rgb[c];
+    unpack_565(colour1, rgb);
+    for(uint32_t c = 0; c < 3; ++c) palette[1][c] = rgb[c];
+    for(uint32_t c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    for(uint32_t i = 0; i < 16; ++i) {
+        uint32_t best = 0;
+        int32_t best_distance = 0x7FFFFFFF;
+        for(uint32_t p = 0; p < 4; ++p) {
+            int32_t distance = 0;
+            for(uint32_t c = 0; c < 3; ++c) {
+                int32_t delta = int32_t(pixels[i][c]) - palette[p][c];
+                distance += delta * delta;
+            }
+
+            if(distance < best_distance) {
+                best = p;
+                best_distance = distance;
+            }
+        }
+
+        out[4 + i / 4] |= best << ((i % 4) * 2);
+    }
+}
+
+void encode_alpha_block(const uint8_t pixels[16][4], uint8_t* out) {
+    uint8_t low = 255, high = 0;
+    for(uint32_t i = 0; i < 16; ++i) {
+        low = std::min(low, pixels[i][3]);
+        high = std::max(high, pixels[i][3]);
+    }
+
+    out[0] = high;
+    out[1] = low;
+    std::memset(out + 2, 0, 6);
+
+    if(high == low) {
+        return;
+    }
+
+    //high > low selects the mode with six interpolated values
+    int32_t palette[8] = { high, low };
+    for(int32_t p = 1; p < 7; ++p) {
+        palette[p + 1] = ((7 - p) * high + p * low) / 7;
+    }
+
+    uint64_t bits = 0;
+    for(uint32_t i = 0; i < 16; ++i) {
+        uint64_t best = 0;
+        int32_t best_distance = 256;
+        for(uint32_t p = 0; p < 8; ++p) {
+            int32_t distance = std::abs(int32_t(pixels[i][3]) - palette[p]);
+            if(distance < best_distance) {
+                best = p;
+                best_distance = distance;
+            }
+        }
+
+        bits |= best << (i * 3);
+    }
+
+    for(uint32_t i = 0; i < 6; ++i) {
+        out[2 + i] = (bits >> (i * 8)) & 0xFF;
+    }
+}
+
+//rgba is tightly packed, bottom row first, the output rows are padded as TextureLevel says
+void encode_level(TextureFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out) {
+    if(is_compressed(format)) {
+        const uint32_t block_size = (format == TEXTURE_FORMAT_DXT1) ? 8 : 16;
+
+        uint8_t pixels[16][4];
+        for(uint32_t by = 0; by < height; by += 4) {
+            for(uint32_t bx = 0; bx < width; bx += 4) {
+                //Blocks hanging off the edge repeat the last row and column
+                for(uint32_t i = 0; i < 16; ++i) {
+                    uint32_t x = std::min(bx + i % 4, width - 1);
+                    uint32_t y = std::min(by + i / 4, height - 1);
+                    std::memcpy(pixels[i], &rgba[(y * width + x) * 4], 4);
+                }
+
+                if(format == TEXTURE_FORMAT_DXT5) {
+                    encode_alpha_block(pixels, out);
+                    encode_colour_block(pixels, out + 8);
+                } else {
+                    encode_colour_block(pixels, out);
+                }
+
+                out += block_size;
+            }
+        }
+        return;
+    }
+
+    const uint32_t stride = row_size(format, width);
+    for(uint32_t y = 0; y < height; ++y) {
+        const uint8_t* source = &rgba[y * width * 4];
+        uint8_t* row = out + y * stride;
+
+        for(uint32_t x = 0; x < width; ++x, source += 4) {
+            switch(format) {
+                case TEXTURE_FORMAT_RGB_888:
+                    std::memcpy(row + x * 3, source, 3);
+                break;
+                case TEXTURE_FORMAT_RGBA_8888:
+                    std::memcpy(row + x * 4, source, 4);
+                break;
+                case TEXTURE_FORMAT_RGB_565: {
+                    uint16_t packed = pack_565(source);
+                    std::memcpy(row + x * 2, &packed, 2); //GL reads these in the machine's byte order
+                } break;
+                case TEXTURE_FORMAT_RGBA_4444: {
+                    uint16_t packed = (scale(source[0], 15) << 12) | (scale(source[1], 15) << 8) |
+                                      (scale(source[2], 15) << 4) | scale(source[3], 15);
+                    std::memcpy(row + x * 2, &packed, 2);
+                } break;
+                default:
+                    break;
+            }
+        }
+
+        std::fill(row + width * bytes_per_pixel(format), row + stride, 0);
+    }
+}
+
+std::vector<uint8_t> downsample(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height) {
+    const uint32_t new_width = next_level_size(width);
+    const uint32_t new_height = next_level_size(height);
+
+    std::vector<uint8_t> result(new_width * new_height * 4);
+    for(uint32_t y = 0; y < new_height; ++y) {
+        const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+
+        for(uint32_t x = 0; x < new_width; ++x) {
+            const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+
+            for(uint32_t c = 0; c < 4; ++c) {
+                uint32_t sum = rgba[(y0 * width + x0) * 4 + c] + rgba[(y0 * width + x1) * 4 + c] +
+                               rgba[(y1 * width + x0) * 4 + c] + rgba[(y1 * width + x1) * 4 + c];
+                result[(y * new_width + x) * 4 + c] = (sum + 2) / 4;
+            }
+        }
+    }
+
+    return result;
+}
+
+std::string hex(std::size_t value) {
+    static const char DIGITS[] = "0123456789abcdef";
+
+    std::string result;
+    for(uint32_t i = 0; i < sizeof(value) * 2; ++i) {
+        result.insert(result.begin(), DIGITS[value & 0xF]);
+        value >>= 4;
+    }
+    return result;
+}
+
+bool modification_time(const std::string& filename, time_t& out) {
+    struct stat info;
+    if(stat(filename.c_str(), &info) != 0) {
+        return false;
+    }
+
+    out = info.st_mtime;
+    return true;
+}
+
+}
+
+uint32_t texture_level_size(TextureFormat format, uint32_t width, uint32_t height) {
+    if(is_compressed(format)) {
+        const uint32_t block_size = (format == TEXTURE_FORMAT_DXT1) ? 8 : 16;
+        return ((width + 3) / 4) * ((height + 3) / 4) * block_size;
+    }
+
+    return row_size(format, width) * height;
+}
+
+TextureCompiler::TextureCompiler(TextureFormat opaque_format, TextureFormat alpha_format, bool mipmaps):
+    opaque_format_(opaque_format),
+    alpha_format_(alpha_format),
+    mipmaps_(mipmaps) {
+
+}
+
+CompiledTexture TextureCompiler::compile(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels) const {
+    KGLT_PROFILE_SCOPE("TextureCompiler::compile");
+
+    if(!width || !height) {
+        throw std::logic_error("Tried to compile an empty texture");
+    }
+
+    if(channels < 1 || channels > 4) {
+        throw std::logic_error("Textures can only be compiled from 1 to 4 channels");
+    }
+
+    //Expand to RGBA and flip on the way, rows are copied whole where possible
+    std::vector<uint8_t> rgba(width * height * 4);
+    bool has_alpha = false;
+
+    for(uint32_t y = 0; y < height; ++y) {
+        const uint8_t* source = pixels + (height - 1 - y) * width * channels;
+        uint8_t* dest = &rgba[y * width * 4];
+
+        if(channels == 4) {
+            std::memcpy(dest, source, width * 4);
+        }
+
+        for(uint32_t x = 0; x < width; ++x, source += channels, dest += 4) {
+            switch(channels) {
+                case 1:
+                    dest[0] = dest[1] = dest[2] = source[0];
+                    dest[3] = 255;
+                break;
+                case 2:
+                    dest[0] = dest[1] = dest[2] = source[0];
+                    dest[3] = source[1];
+                break;
+                case 3:
+                    std::memcpy(dest, source, 3);
+                    dest[3] = 255;
+                break;
+                default:
+                break;
+            }
+
+            has_alpha = has_alpha || dest[3] != 255;
+        }
+    }
+
+    CompiledTexture result;
+    result.format = (has_alpha) ? alpha_format_ : opaque_format_;
+
+    //Work out the whole chain first so it all goes in one buffer
+    uint32_t total_size = 0;
+    uint32_t level_count = 0;
+    for(uint32_t w = width, h = height; ; w = next_level_size(w), h = next_level_size(h)) {
+        total_size += texture_level_size(result.format, w, h);
+        ++level_count;
+
+        if(!mipmaps_ || (w == 1 && h == 1)) {
+            break;
+        }
+    }
+
+    std::shared_ptr<std::vector<uint8_t> > storage = std::make_shared<std::vector<uint8_t> >(total_size);
+    result.storage = storage;
+
+    uint32_t offset = 0;
+    uint32_t w = width, h = height;
+    for(uint32_t i = 0; i < level_count; ++i) {
+        if(i) {
+            rgba = downsample(rgba, w, h);
+            w = next_level_size(w);
+            h = next_level_size(h);
+        }
+
+        TextureLevel level;
+        level.width = w;
+        level.height = h;
+        level.data = storage->data() + offset;
+        level.size = texture_level_size(result.format, w, h);
+
+        encode_level(result.format, rgba.data(), w, h, storage->data() + offset);
+
+        result.levels.push_back(level);
+        offset += level.size;
+    }
+
+    return result;
+}
+
+CompiledTexture TextureCompiler::compile_file(const std::string& filename) const {
+    int width, height, channels;
+    unsigned char* data = SOIL_load_image(filename.c_str(), &width, &height, &channels, SOIL_LOAD_AUTO);
+    if(!data) {
+        throw IOError("Couldn't load the file: " + filename);
+    }
+
+    try {
+        CompiledTexture result = compile(data, width, height, channels);
+        SOIL_free_image_data(data);
+        return result;
+    } catch(...) {
+        SOIL_free_image_data(data);
+        throw;
+    }
+}
+
+void save_ktx(const CompiledTexture& texture, const std::string& filename) {
+    if(texture.levels.empty()) {
+        throw std::logic_error("Tried to save a texture with no levels");
+    }
+
+    const KTXFormat& format = ktx_format(texture.format);
+
+    KTXHeader header;
+    std::memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    header.endianness = KTX_ENDIANNESS;
+    header.gl_type = format.gl_type;
+    header.gl_type_size = format.gl_type_size;
+    header.gl_format = format.gl_format;
+    header.gl_internal_format = format.gl_internal_format;
+    header.gl_base_internal_format = format.gl_base_internal_format;
+    header.pixel_width = texture.levels[0].width;
+    header.pixel_height = texture.levels[0].height;
+    header.pixel_depth = 0;
+    header.array_elements = 0;
+    header.faces = 1;
+    header.mipmap_levels = texture.levels.size();
+    header.key_value_bytes = 0;
+
+    replace_file(filename, [&](std::ostream& file) {
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        //Every level is a multiple of 4 bytes already, so there's never any mip padding
+        for(const TextureLevel& level: texture.levels) {
+            file.write(reinterpret_cast<const char*>(&level.size), sizeof(level.size));
+            file.write(reinterpret_cast<const char*>(level.data), level.size);
+        }
+    });
+}
+
+CompiledTexture map_ktx(const std::string& filename) {
+    KGLT_PROFILE_SCOPE("map_ktx");
+
+    std::shared_ptr<const MappedFile> mapping = MappedFile::map(filename);
+    const std::size_t size = mapping->size();
+    if(size < sizeof(KTXHeader)) {
+        throw std::runtime_error("Not a KTX file: " + filename);
+    }
+
+    KTXHeader header;
+    std::memcpy(&header, mapping->data(), sizeof(header));
+
+    if(std::memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0) {
+        throw std::runtime_error("Not a KTX file: " + filename);
+    }
+
+    if(header.endianness != KTX_ENDIANNESS) {
+        throw std::runtime_error("KTX file was written with the other byte order: " + filename);
+    }
+
+    if(!header.pixel_width || !header.pixel_height || header.pixel_depth > 1 ||
+        header.array_elements > 1 || header.faces != 1) {
+        throw std::runtime_error("Only 2D KTX textures are supported: " + filename);
+    }
+
+    const KTXFormat* format = ktx_format_for(header);
+    if(!format) {
+        throw std::runtime_error("Unsupported format in KTX file: " + filename);
+    }
+
+    CompiledTexture result;
+    result.format = format->format;
+    result.storage = mapping;
+
+    std::size_t offset = sizeof(KTXHeader) + std::size_t(header.key_value_bytes);
+    uint32_t width = header.pixel_width, height = header.pixel_height;
+
+    const uint32_t level_count = std::max(header.mipmap_levels, 1u);
+    for(uint32_t i = 0; i < level_count; ++i) {
+        uint32_t image_size = 0;
+        if(offset + sizeof(image_size) > size) {
+            throw std::runtime_error("KTX file is truncated: " + filename);
+        }
+        std::memcpy(&image_size, mapping->data() + offset, sizeof(image_size));
+        offset += sizeof(image_size);
+
+        if(image_size != texture_level_size(result.format, width, height) || offset + image_size > size) {
+            throw std::runtime_error("KTX file has a level of the wrong size: " + filename);
+        }
+
+        TextureLevel level;
+        level.width = width;
+        level.height = height;
+        level.data = mapping->data() + offset;
+        level.size = image_size;
+        result.levels.push_back(level);
+
+        offset += image_size + (3 - ((image_size + 3) % 4));
+
+        width = next_level_size(width);
+        height = next_level_size(height);
+    }
+
+    return result;
+}
+
+TextureCache::TextureCache(const std::string& directory, const TextureCompiler& compiler):
+    directory_(directory),
+    compiler_(compiler) {
+
+    if(mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw IOError("Couldn't create the texture cache directory: " + directory_);
+    }
+}
+
+std::string TextureCache::path_for(const std::string& source) const {
+    std::string settings = source + ":" +
+        boost::lexical_cast<std::string>(compiler_.opaque_format()) + ":" +
+        boost::lexical_cast<std::string>(compiler_.alpha_format()) + ":" +
+        boost::lexical_cast<std::string>(compiler_.mipmaps());
+
+    std::string name = source.substr(source.find_last_of("/\\") + 1);
+    return directory_ + "/" + name + "-" + hex(std::hash<std::string>()(settings)) + ".ktx";
+}
+
+CompiledTexture TextureCache::load(const std::string& source) const {
+    time_t source_time = 0, cache_time = 0;
+    if(!modification_time(source, source_time)) {
+        throw IOError("Couldn't load the file: " + source);
+    }
+
+    const std::string cached = path_for(source);
+    if(modification_time(cached, cache_time) && cache_time >= source_time) {
+        try {
+            return map_ktx(cached);
+        } catch(std::exception& e) {
+            L_WARN("Recompiling unreadable cached texture: " + cached);
+        }
+    }
+
+    CompiledTexture compiled = compiler_.compile_file(source);
+
+    try {
+        save_ktx(compiled, cached);
+    } catch(std::exception& e) {
+        //Not fatal, it just gets compiled again next time
+        L_WARN(std::string("Couldn't save the compiled texture: ") + e.what());
+    }
+
+    return compiled;
+}
+
+}
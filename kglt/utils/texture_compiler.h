@@ -0,0 +1,85 @@
+#ifndef TEXTURE_COMPILER_H
+#define TEXTURE_COMPILER_H
+
+#include <cstdint>
+#include <string>
+
+#include "../texture.h"
+
+namespace kglt {
+
+/*
+ * Turns decoded images into CompiledTextures: flipped so the bottom row comes first,
+ * with the whole mipmap chain (box filtered) and converted to the format they'll have
+ * in VRAM, so loading them is nothing more than reading the levels and handing them
+ * to GL. Images with any transparency get alpha_format, the rest opaque_format.
+ *
+ * The S3TC encoder picks the block endpoints from the colour range of each block,
+ * which is quick enough to run on first load but not as good as an offline tool.
+ */
+class TextureCompiler {
+public:
+    TextureCompiler(TextureFormat opaque_format=TEXTURE_FORMAT_RGB_888,
+                    TextureFormat alpha_format=TEXTURE_FORMAT_RGBA_8888,
+                    bool mipmaps=true);
+
+    TextureFormat opaque_format() const { return opaque_format_; }
+    TextureFormat alpha_format() const { return alpha_format_; }
+    bool mipmaps() const { return mipmaps_; }
+
+    //pixels holds 1 to 4 channels (L, LA, RGB or RGBA) per pixel, tightly packed, top row first
+    CompiledTexture compile(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels) const;
+
+    //Decodes anything SOIL can read (PNG, JPG, TGA...), throws IOError if it can't
+    CompiledTexture compile_file(const std::string& filename) const;
+
+private:
+    TextureFormat opaque_format_;
+    TextureFormat alpha_format_;
+    bool mipmaps_;
+};
+
+//Bytes taken by one level, including the padding at the end of each row
+uint32_t texture_level_size(TextureFormat format, uint32_t width, uint32_t height);
+
+/*
+ * Writes a KTX 1.1 file. It's written to a temporary file which is then renamed,
+ * so anything reading filename at the same time never sees half of it.
+ */
+void save_ktx(const CompiledTexture& texture, const std::string& filename);
+
+/*
+ * Maps a KTX file into memory, the levels point straight into the mapping, which
+ * stays around for as long as the storage does. Only 2D textures in one of the
+ * TextureFormats are supported, and a file without levels gets no mipmaps. Throws
+ * IOError if the file can't be read and std::runtime_error if it's not one of those.
+ */
+CompiledTexture map_ktx(const std::string& filename);
+
+/*
+ * Compiled copies of source images, kept as KTX files in a directory of their own.
+ * The first load of an image compiles and saves it; after that it's mapped straight
+ * from the cache until the source is modified. The compiler's settings are part of
+ * each file's name, so changing them recompiles everything.
+ */
+class TextureCache {
+public:
+    //The directory is created if it doesn't exist (its parent has to)
+    TextureCache(const std::string& directory, const TextureCompiler& compiler=TextureCompiler());
+
+    const std::string& directory() const { return directory_; }
+    const TextureCompiler& compiler() const { return compiler_; }
+
+    std::string path_for(const std::string& source) const;
+
+    //Safe to call from several threads at once, even for the same source
+    CompiledTexture load(const std::string& source) const;
+
+private:
+    std::string directory_;
+    TextureCompiler compiler_;
+};
+
+}
+
+#endif // TEXTURE_COMPILER_H
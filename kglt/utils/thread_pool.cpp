@@ -0,0 +1,72 @@
+#include <boost/lexical_cast.hpp>
+
+#include "../kazbase/logging.h"
+#include "thread_pool.h"
+#include "profiler.h"
+
+namespace kglt {
+
+ThreadPool::ThreadPool(const std::string& name, uint32_t thread_count):
+    stopping_(false) {
+
+    if(!thread_count) {
+        uint32_t cores = std::thread::hardware_concurrency();
+        thread_count = (cores > 1) ? cores - 1 : 1;
+    }
+
+    for(uint32_t i = 0; i < thread_count; ++i) {
+        std::string thread_name = name + " " + boost::lexical_cast<std::string>(i + 1);
+        threads_.push_back(std::thread(&ThreadPool::run, this, thread_name));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        tasks_.clear();
+    }
+
+    condition_.notify_all();
+
+    for(std::thread& thread: threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void ()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(task);
+    }
+
+    condition_.notify_one();
+}
+
+void ThreadPool::run(const std::string& name) {
+    Profiler::get().set_thread_name(name);
+
+    while(true) {
+        std::function<void ()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+
+            if(stopping_) {
+                return;
+            }
+
+            task = tasks_.front();
+            tasks_.pop_front();
+        }
+
+        try {
+            task();
+        } catch(std::exception& e) {
+            //Tasks are expected to report their own errors, this just keeps the thread alive
+            L_ERROR(std::string("Unhandled exception in a pool task: ") + e.what());
+        }
+    }
+}
+
+}
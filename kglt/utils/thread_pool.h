@@ -0,0 +1,45 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kglt {
+
+/*
+ * A fixed number of threads running queued tasks in order. Used to decode
+ * resources off the main thread; anything a task needs to do with GL has to
+ * be queued on the window's idle tasks with IDLE_TASK_PRIORITY_UPLOAD. Tasks
+ * still queued when the pool is destroyed are dropped, the running ones are
+ * waited for.
+ */
+class ThreadPool {
+public:
+    //0 means one less than the number of cores (but at least one)
+    ThreadPool(const std::string& name, uint32_t thread_count=0);
+    ~ThreadPool();
+
+    void submit(std::function<void ()> task);
+
+    uint32_t thread_count() const { return threads_.size(); }
+
+private:
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<std::function<void ()> > tasks_;
+    bool stopping_;
+
+    void run(const std::string& name);
+};
+
+}
+
+#endif // THREAD_POOL_H
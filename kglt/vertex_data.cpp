@@ -1,5 +1,10 @@
 #include <GLee.h>
 #include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <memory>
+#include <algorithm>
+#include <limits>
 #include "vertex_data.h"
 #include "scene.h"
 #include "window_base.h"
@@ -8,6 +13,8 @@
 namespace kglt {
 
 void VertexData::check_or_add_attribute(AttributeBitMask attr) {
+    unpack();
+
     if(data_.size() > 1 && ((enabled_bitmask_ & attr) != attr)) {
         throw std::logic_error("Attempted to add an attribute that didn't exist on the first vertex");
     }
@@ -18,6 +25,12 @@ void VertexData::check_or_add_attribute(AttributeBitMask attr) {
 VertexData::VertexData(Scene &scene):
     scene_(scene),
     enabled_bitmask_(0),
+    byte_encoded_bitmask_(0),
+    stride_(0),
+    uploaded_count_(0),
+    uploaded_stride_(0),
+    dirty_begin_(0),
+    dirty_end_(0),
     cursor_position_(0),
     buffer_object_(BUFFER_OBJECT_VERTEX_DATA) {
 
@@ -25,6 +38,156 @@ VertexData::VertexData(Scene &scene):
     for(uint8_t i = 0; i < 8; ++i) {
         set_texture_coordinate_dimensions(i, 2);
     }
+
+    for(uint8_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+        offsets_[i] = uploaded_offsets_[i] = 0;
+    }
+}
+
+static uint8_t attribute_index(AttributeBitMask attr) {
+    for(uint8_t i = 0; i < 32; ++i) {
+        if(attr == (1 << i)) {
+            return i;
+        }
+    }
+
+    throw std::logic_error("Expected a single attribute");
+}
+
+void VertexData::set_attribute_encoding(AttributeBitMask attr, AttributeEncoding encoding) {
+    unpack();
+
+    if(encoding == ATTRIBUTE_ENCODING_NORMALIZED_BYTE) {
+        if(attr != BM_NORMALS && attr != BM_DIFFUSE && attr != BM_SPECULAR) {
+            throw std::logic_error("Only normals and colours can be encoded as normalized bytes");
+        }
+
+        byte_encoded_bitmask_ |= attr;
+    } else {
+        byte_encoded_bitmask_ &= ~attr;
+    }
+}
+
+AttributeEncoding VertexData::attribute_encoding(AttributeBitMask attr) const {
+    return (byte_encoded_bitmask_ & attr) ? ATTRIBUTE_ENCODING_NORMALIZED_BYTE : ATTRIBUTE_ENCODING_FLOAT;
+}
+
+uint8_t VertexData::attribute_components(AttributeBitMask attr) const {
+    switch(attr) {
+        case BM_POSITIONS: return 3;
+        //Byte encoded normals are padded to 4 to keep everything 4-byte aligned
+        case BM_NORMALS: return (attribute_encoding(attr) == ATTRIBUTE_ENCODING_FLOAT) ? 3 : 4;
+        case BM_TEXCOORD_0: return tex_coord_dimensions_[0];
+        case BM_TEXCOORD_1: return tex_coord_dimensions_[1];
+        case BM_TEXCOORD_2: return tex_coord_dimensions_[2];
+        case BM_TEXCOORD_3: return tex_coord_dimensions_[3];
+        case BM_TEXCOORD_4: return tex_coord_dimensions_[4];
+        case BM_DIFFUSE:
+        case BM_SPECULAR:
+            return 4;
+    default:
+        throw std::logic_error("Invalid attribute");
+    }
+}
+
+uint32_t VertexData::attribute_offset(AttributeBitMask attr) const {
+    if(!has_attribute(attr)) {
+        throw std::logic_error("Attempted to get the offset of an attribute that isn't in use");
+    }
+
+    return offsets_[attribute_index(attr)];
+}
+
+void VertexData::recalc_layout() {
+    uint32_t offset = 0;
+    for(uint8_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+        AttributeBitMask attr = AttributeBitMask(1 << i);
+        offsets_[i] = 0;
+
+        if(!has_attribute(attr)) {
+            continue;
+        }
+
+        offsets_[i] = offset;
+
+        if(attribute_encoding(attr) == ATTRIBUTE_ENCODING_NORMALIZED_BYTE) {
+            offset += 4;
+        } else {
+            offset += attribute_components(attr) * sizeof(float);
+        }
+    }
+
+    stride_ = offset;
+}
+
+static void pack_normal_bytes(uint8_t* out, const kmVec3& n) {
+    int8_t* dest = (int8_t*) out;
+    dest[0] = int8_t(roundf(std::max(-1.0f, std::min(n.x, 1.0f)) * 127.0f));
+    dest[1] = int8_t(roundf(std::max(-1.0f, std::min(n.y, 1.0f)) * 127.0f));
+    dest[2] = int8_t(roundf(std::max(-1.0f, std::min(n.z, 1.0f)) * 127.0f));
+    dest[3] = 0;
+}
+
+static void pack_colour_bytes(uint8_t* out, const Colour& c) {
+    out[0] = uint8_t(roundf(std::max(0.0f, std::min(c.r, 1.0f)) * 255.0f));
+    out[1] = uint8_t(roundf(std::max(0.0f, std::min(c.g, 1.0f)) * 255.0f));
+    out[2] = uint8_t(roundf(std::max(0.0f, std::min(c.b, 1.0f)) * 255.0f));
+    out[3] = uint8_t(roundf(std::max(0.0f, std::min(c.a, 1.0f)) * 255.0f));
+}
+
+void VertexData::pack(std::vector<uint8_t>& out, uint32_t first, uint32_t count) const {
+    out.resize(count * stride_);
+    if(!count) {
+        return;
+    }
+
+    uint8_t* dest = &out[0];
+    for(uint32_t v = first; v < first + count; ++v) {
+        const Vertex& vert = data_[v];
+        for(uint8_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+            AttributeBitMask attr = AttributeBitMask(1 << i);
+            if(!has_attribute(attr)) {
+                continue;
+            }
+
+            uint8_t* field = dest + offsets_[i];
+            bool as_bytes = attribute_encoding(attr) == ATTRIBUTE_ENCODING_NORMALIZED_BYTE;
+
+            switch(attr) {
+                case BM_POSITIONS:
+                    memcpy(field, &vert.position, sizeof(float) * 3);
+                break;
+                case BM_NORMALS:
+                    if(as_bytes) {
+                        pack_normal_bytes(field, vert.normal);
+                    } else {
+                        memcpy(field, &vert.normal, sizeof(float) * 3);
+                    }
+                break;
+                case BM_TEXCOORD_0:
+                case BM_TEXCOORD_1:
+                case BM_TEXCOORD_2:
+                case BM_TEXCOORD_3:
+                case BM_TEXCOORD_4:
+                    //The texcoord bits are consecutive, starting at BM_TEXCOORD_0
+                    memcpy(field, &vert.tex_coords[i - attribute_index(BM_TEXCOORD_0)], sizeof(float) * attribute_components(attr));
+                break;
+                case BM_DIFFUSE:
+                case BM_SPECULAR: {
+                    const Colour& colour = (attr == BM_DIFFUSE) ? vert.diffuse : vert.specular;
+                    if(as_bytes) {
+                        pack_colour_bytes(field, colour);
+                    } else {
+                        memcpy(field, &colour, sizeof(float) * 4);
+                    }
+                } break;
+            default:
+                break;
+            }
+        }
+
+        dest += stride_;
+    }
 }
 
 void VertexData::set_texture_coordinate_dimensions(uint8_t coord_index, uint8_t count) {
@@ -32,17 +195,36 @@ void VertexData::set_texture_coordinate_dimensions(uint8_t coord_index, uint8_t
         throw std::out_of_range("coord_index must be less than 8");
     }
 
-    if(count >= 4) {
-        throw std::out_of_range("Texture coordinates can only have up to 4 parts");
+    if(count == 0 || count > 4) {
+        throw std::out_of_range("Texture coordinates can only have 1 to 4 parts");
     }
 
+    unpack();
+
     tex_coord_dimensions_[coord_index] = count;
 }
 
 void VertexData::clear() {
+    packed_ = PackedVertices();
     data_.clear();
     cursor_position_ = 0;    
     enabled_bitmask_ = 0;
+    dirty_begin_ = dirty_end_ = 0;
+}
+
+VertexData::Vertex& VertexData::current_vertex() {
+    Vertex& vert = data_.at(cursor_position_);
+
+    //Widen the range that needs uploading on the next done()
+    if(dirty_begin_ == dirty_end_) {
+        dirty_begin_ = cursor_position_;
+        dirty_end_ = cursor_position_ + 1;
+    } else {
+        dirty_begin_ = std::min<uint32_t>(dirty_begin_, cursor_position_);
+        dirty_end_ = std::max<uint32_t>(dirty_end_, cursor_position_ + 1);
+    }
+
+    return vert;
 }
 
 void VertexData::position(float x, float y, float z) {
@@ -56,7 +238,7 @@ void VertexData::position(float x, float y, float z) {
         throw std::out_of_range("Cursor moved out of range");
     }
 
-    Vertex& vert = data_.at(cursor_position_);
+    Vertex& vert = current_vertex();
 
     vert.position.x = x;
     vert.position.y = y;
@@ -70,7 +252,7 @@ void VertexData::position(const kmVec3& pos) {
 void VertexData::normal(float x, float y, float z) {
     check_or_add_attribute(BM_NORMALS);
 
-    Vertex& vert = data_.at(cursor_position_);
+    Vertex& vert = current_vertex();
     vert.normal.x = x;
     vert.normal.y = y;
     vert.normal.z = z;
@@ -108,7 +290,7 @@ void VertexData::tex_coordX(uint8_t which, float u) {
     //FIXME: throw an exception
     assert(tex_coord_dimensions_[which] >= 1);
 
-    Vertex& vert = data_.at(cursor_position_);
+    Vertex& vert = current_vertex();
     vert.tex_coords[which].x = u;
 }
 
@@ -118,7 +300,7 @@ void VertexData::tex_coordX(uint8_t which, float u, float v) {
     //FIXME: throw an exception
     assert(tex_coord_dimensions_[which] >= 2);
 
-    Vertex& vert = data_.at(cursor_position_);
+    Vertex& vert = current_vertex();
     vert.tex_coords[which].x = u;
     vert.tex_coords[which].y = v;
 }
@@ -129,7 +311,7 @@ void VertexData::tex_coordX(uint8_t which, float u, float v, float w) {
     //FIXME: throw an exception
     assert(tex_coord_dimensions_[which] >= 3);
 
-    Vertex& vert = data_.at(cursor_position_);
+    Vertex& vert = current_vertex();
     vert.tex_coords[which].x = u;
     vert.tex_coords[which].y = v;
     vert.tex_coords[which].z = w;
@@ -141,7 +323,7 @@ void VertexData::tex_coordX(uint8_t which, float u, float v, float w, float x) {
     //FIXME: throw an exception
     assert(tex_coord_dimensions_[which] >= 4);
 
-    Vertex& vert = data_.at(cursor_position_);
+    Vertex& vert = current_vertex();
     vert.tex_coords[which].x = u;
     vert.tex_coords[which].y = v;
     vert.tex_coords[which].z = w;
@@ -215,7 +397,7 @@ void VertexData::tex_coord3(float u, float v, float w, float x) {
 void VertexData::diffuse(float r, float g, float b, float a) {
     check_or_add_attribute(BM_DIFFUSE);
 
-    Vertex& vert = data_.at(cursor_position_);
+    Vertex& vert = current_vertex();
     vert.diffuse.r = r;
     vert.diffuse.g = g;
     vert.diffuse.b = b;
@@ -231,14 +413,17 @@ void VertexData::move_to_start() {
 }
 
 void VertexData::move_to_end() {
+    unpack();
     move_to(data_.size());
 }
 
-void VertexData::move_by(int16_t amount) {
+void VertexData::move_by(int32_t amount) {
     cursor_position_ += amount;
 }
 
-void VertexData::move_to(uint16_t index) {
+void VertexData::move_to(uint32_t index) {
+    unpack();
+
     if(index > data_.size()) {
         throw std::out_of_range("Tried to move outside the range of the data");
     }
@@ -246,7 +431,9 @@ void VertexData::move_to(uint16_t index) {
     cursor_position_ = index;
 }
 
-uint16_t VertexData::move_next() {
+uint32_t VertexData::move_next() {
+    unpack();
+
     cursor_position_++;
 
     //cursor_position_ == data_.size() is allowed (see position())
@@ -258,42 +445,434 @@ uint16_t VertexData::move_next() {
 }
 
 void VertexData::reset(BufferObjectUsage usage) {
-    buffer_object_ = BufferObject(BUFFER_OBJECT_VERTEX_DATA, usage);
+    buffer_object_.reset(usage);
+    uploaded_count_ = uploaded_stride_ = 0;
     clear();
 }
 
+bool VertexData::layout_matches_upload() const {
+    if(!uploaded_stride_ || uploaded_stride_ != stride_ || uploaded_count_ != data_.size()) {
+        return false;
+    }
+
+    return std::equal(offsets_, offsets_ + ATTRIBUTE_COUNT, uploaded_offsets_);
+}
+
 void VertexData::done() {
-    scene_.window().idle().add_once([&](){
-        buffer_object_.create(data_.size() * sizeof(Vertex), &data_[0]);
+    if(is_packed()) {
+        //Nothing has changed since set_packed() uploaded them
+        signal_update_complete_();
+        return;
+    }
+
+    recalc_layout();
+
+    uint32_t first = 0;
+    uint32_t count = data_.size();
+    bool partial = !buffer_object_.is_streamed() && layout_matches_upload();
+
+    if(partial) {
+        //Same layout and size as last time, only send what was touched
+        if(dirty_begin_ == dirty_end_) {
+            signal_update_complete_();
+            return;
+        }
+
+        first = dirty_begin_;
+        count = dirty_end_ - dirty_begin_;
+    }
+
+    //Pack now, on whatever thread we are on, so the main thread only has to upload
+    std::shared_ptr<std::vector<uint8_t> > packed(new std::vector<uint8_t>());
+    pack(*packed, first, count);
+
+    uint32_t byte_offset = first * stride_;
+    auto upload = [=]() {
+        const void* bytes = (packed->empty()) ? nullptr : &(*packed)[0];
+        if(buffer_object_.is_streamed()) {
+            buffer_object_.stream(packed->size(), bytes);
+        } else if(partial) {
+            buffer_object_.modify(byte_offset, packed->size(), bytes);
+        } else {
+            buffer_object_.create(packed->size(), bytes);
+        }
+        assert(glGetError() == GL_NO_ERROR);
+    };
+
+    if(GLThreadCheck::is_current()) {
+        upload();
+    } else {
+        //The upload uses this object, and uploaded_* must only describe what's really in the buffer
+        scene_.window().idle().add_once(upload, IDLE_TASK_PRIORITY_UPLOAD).wait();
+    }
+
+    uploaded_count_ = data_.size();
+    uploaded_stride_ = stride_;
+    std::copy(offsets_, offsets_ + ATTRIBUTE_COUNT, uploaded_offsets_);
+    dirty_begin_ = dirty_end_ = 0;
+
+    signal_update_complete_();
+}
+
+PackedVertices VertexData::packed() {
+    if(is_packed()) {
+        return packed_;
+    }
+
+    recalc_layout();
+
+    std::shared_ptr<std::vector<uint8_t> > bytes(new std::vector<uint8_t>());
+    pack(*bytes, 0, data_.size());
+
+    PackedVertices result;
+    result.attributes = enabled_bitmask_;
+    result.byte_encoded = byte_encoded_bitmask_;
+    std::copy(tex_coord_dimensions_, tex_coord_dimensions_ + 8, result.tex_coord_dimensions);
+    result.count = data_.size();
+    result.stride = stride_;
+    result.data = (bytes->empty()) ? nullptr : &(*bytes)[0];
+    result.storage = bytes;
+    return result;
+}
+
+void VertexData::set_packed(const PackedVertices& vertices) {
+    const int32_t all_attributes = (1 << ATTRIBUTE_COUNT) - 1;
+    const int32_t byte_attributes = BM_NORMALS | BM_DIFFUSE | BM_SPECULAR;
+
+    if((vertices.attributes & ~all_attributes) || (vertices.byte_encoded & ~byte_attributes)) {
+        throw std::logic_error("Packed vertices have attributes that don't exist");
+    }
+
+    if(vertices.count && !vertices.data) {
+        throw std::logic_error("Packed vertices are missing their data");
+    }
+
+    clear();
+
+    for(uint8_t i = 0; i < 8; ++i) {
+        set_texture_coordinate_dimensions(i, vertices.tex_coord_dimensions[i]);
+    }
+
+    enabled_bitmask_ = vertices.attributes;
+    byte_encoded_bitmask_ = vertices.byte_encoded;
+    recalc_layout();
+
+    if(vertices.count && vertices.stride != stride_) {
+        throw std::logic_error("Packed vertices don't have the stride their attributes need");
+    }
+
+    if(vertices.count) {
+        packed_ = vertices;
+    }
+
+    //The storage is kept by the copy of vertices until the upload has happened
+    auto upload = [=]() {
+        const uint32_t size = vertices.count * vertices.stride;
+        if(buffer_object_.is_streamed()) {
+            buffer_object_.stream(size, vertices.data);
+        } else {
+            buffer_object_.create(size, vertices.data);
+        }
         assert(glGetError() == GL_NO_ERROR);
-    });
+    };
+
+    if(GLThreadCheck::is_current()) {
+        upload();
+    } else {
+        //The upload uses this object, and uploaded_* must only describe what's really in the buffer
+        scene_.window().idle().add_once(upload, IDLE_TASK_PRIORITY_UPLOAD).wait();
+    }
+
+    uploaded_count_ = vertices.count;
+    uploaded_stride_ = stride_;
+    std::copy(offsets_, offsets_ + ATTRIBUTE_COUNT, uploaded_offsets_);
+    dirty_begin_ = dirty_end_ = 0;
 
     signal_update_complete_();
 }
 
+VertexData::Vertex VertexData::vertex_at(uint32_t idx) const {
+    if(!is_packed()) {
+        return data_.at(idx);
+    }
+
+    if(idx >= packed_.count) {
+        throw std::out_of_range("Tried to read a vertex that doesn't exist");
+    }
+
+    Vertex vert = Vertex();
+    const uint8_t* source = packed_.data + idx * stride_;
+
+    for(uint8_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+        AttributeBitMask attr = AttributeBitMask(1 << i);
+        if(!has_attribute(attr)) {
+            continue;
+        }
+
+        const uint8_t* field = source + offsets_[i];
+        bool as_bytes = attribute_encoding(attr) == ATTRIBUTE_ENCODING_NORMALIZED_BYTE;
+
+        switch(attr) {
+            case BM_POSITIONS:
+                memcpy(&vert.position, field, sizeof(float) * 3);
+            break;
+            case BM_NORMALS:
+                if(as_bytes) {
+                    const int8_t* n = (const int8_t*) field;
+                    kmVec3Fill(&vert.normal, n[0] / 127.0f, n[1] / 127.0f, n[2] / 127.0f);
+                } else {
+                    memcpy(&vert.normal, field, sizeof(float) * 3);
+                }
+            break;
+            case BM_TEXCOORD_0:
+            case BM_TEXCOORD_1:
+            case BM_TEXCOORD_2:
+            case BM_TEXCOORD_3:
+            case BM_TEXCOORD_4:
+                memcpy(&vert.tex_coords[i - attribute_index(BM_TEXCOORD_0)], field, sizeof(float) * attribute_components(attr));
+            break;
+            case BM_DIFFUSE:
+            case BM_SPECULAR: {
+                Colour& colour = (attr == BM_DIFFUSE) ? vert.diffuse : vert.specular;
+                if(as_bytes) {
+                    colour = Colour(field[0] / 255.0f, field[1] / 255.0f, field[2] / 255.0f, field[3] / 255.0f);
+                } else {
+                    memcpy(&colour, field, sizeof(float) * 4);
+                }
+            } break;
+        default:
+            break;
+        }
+    }
+
+    return vert;
+}
+
+void VertexData::unpack() {
+    if(!is_packed()) {
+        return;
+    }
+
+    //The buffer object already has these, so afterwards only what's changed is uploaded
+    std::vector<Vertex> vertices;
+    vertices.reserve(packed_.count);
+    for(uint32_t i = 0; i < packed_.count; ++i) {
+        vertices.push_back(vertex_at(i));
+    }
+
+    data_.swap(vertices);
+    packed_ = PackedVertices();
+}
+
+kmVec3 VertexData::position_at(uint32_t idx) const {
+    if(!is_packed()) {
+        return data_.at(idx).position;
+    }
+
+    if(idx >= packed_.count || !has_positions()) {
+        throw std::out_of_range("Tried to read a position that doesn't exist");
+    }
+
+    //Bounds are calculated from these, so they're read without unpacking the rest
+    kmVec3 result;
+    memcpy(&result, packed_.data + idx * stride_ + offsets_[attribute_index(BM_POSITIONS)], sizeof(float) * 3);
+    return result;
+}
+
+kmVec3 VertexData::normal_at(uint32_t idx) const {
+    return vertex_at(idx).normal;
+}
+
+bool VertexData::operator==(const VertexData& other) const {
+    if(!is_packed() && !other.is_packed()) {
+        return this->data_ == other.data_;
+    }
+
+    if(count() != other.count()) {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < count(); ++i) {
+        if(!(vertex_at(i) == other.vertex_at(i))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 IndexData::IndexData(Scene& scene):
     scene_(scene),
+    max_index_(0),
+    index_type_(INDEX_TYPE_16_BIT),
+    uploaded_count_(0),
+    uploaded_type_(INDEX_TYPE_16_BIT),
+    dirty_from_(0),
     buffer_object_(BUFFER_OBJECT_INDEX_DATA) {
 
 }
 
 void IndexData::reset(BufferObjectUsage usage) {
-    buffer_object_ = BufferObject(BUFFER_OBJECT_INDEX_DATA, usage);
+    buffer_object_.reset(usage);
+    uploaded_count_ = 0;
     clear();
 }
 
+template<typename T>
+static void encode_as(const std::vector<uint32_t>& indices, uint32_t first, std::vector<uint8_t>& out) {
+    out.resize((indices.size() - first) * sizeof(T));
+
+    T* dest = (T*) ((out.empty()) ? nullptr : &out[0]);
+    for(uint32_t i = first; i < indices.size(); ++i) {
+        *dest++ = T(indices[i]);
+    }
+}
+
+void IndexData::encode(IndexType type, uint32_t first, std::vector<uint8_t>& out) const {
+    switch(type) {
+        case INDEX_TYPE_8_BIT:
+            encode_as<uint8_t>(indices_, first, out);
+        break;
+        case INDEX_TYPE_16_BIT:
+            encode_as<uint16_t>(indices_, first, out);
+        break;
+        case INDEX_TYPE_32_BIT:
+            encode_as<uint32_t>(indices_, first, out);
+        break;
+    }
+}
+
+static uint8_t index_type_size(IndexType type) {
+    switch(type) {
+        case INDEX_TYPE_8_BIT: return 1;
+        case INDEX_TYPE_16_BIT: return 2;
+    default:
+        return 4;
+    }
+}
+
+IndexType IndexData::narrowest_type() const {
+    if(max_index_ <= std::numeric_limits<uint8_t>::max()) {
+        return INDEX_TYPE_8_BIT;
+    } else if(max_index_ <= std::numeric_limits<uint16_t>::max()) {
+        return INDEX_TYPE_16_BIT;
+    } else {
+        return INDEX_TYPE_32_BIT;
+    }
+}
+
 void IndexData::done() {
+    index_type_ = narrowest_type();
+
+    bool partial = !buffer_object_.is_streamed() &&
+        uploaded_count_ && uploaded_count_ == indices_.size() && uploaded_type_ == index_type_;
+
+    uint32_t first = (partial) ? std::min<uint32_t>(dirty_from_, indices_.size()) : 0;
+
+    if(partial && first == indices_.size()) {
+        //Nothing has changed since the last upload
+        signal_update_complete_();
+        return;
+    }
+
+    std::shared_ptr<std::vector<uint8_t> > encoded(new std::vector<uint8_t>());
+    encode(index_type_, first, *encoded);
+
+    uint32_t byte_offset = first * index_type_size(index_type_);
+    auto upload = [=]() {
+        const void* bytes = (encoded->empty()) ? nullptr : &(*encoded)[0];
+        if(buffer_object_.is_streamed()) {
+            buffer_object_.stream(encoded->size(), bytes);
+        } else if(partial) {
+            buffer_object_.modify(byte_offset, encoded->size(), bytes);
+        } else {
+            buffer_object_.create(encoded->size(), bytes);
+        }
+    };
+
     if(GLThreadCheck::is_current()) {
-        buffer_object_.create(indices_.size() * sizeof(uint16_t), &indices_[0]);
+        upload();
     } else {
-        //Ensure we only call GL stuff from the main thread
-        scene_.window().idle().add_once([&](){
-            buffer_object_.create(indices_.size() * sizeof(uint16_t), &indices_[0]);
-        });
+        //Ensure we only call GL stuff from the main thread. Like VertexData this waits, the
+        //upload uses this object and the bookkeeping below has to describe what was uploaded
+        scene_.window().idle().add_once(upload, IDLE_TASK_PRIORITY_UPLOAD).wait();
+    }
+
+    uploaded_count_ = indices_.size();
+    uploaded_type_ = index_type_;
+    dirty_from_ = indices_.size();
 
-        scene_.window().idle().wait();
+    signal_update_complete_();
+}
+
+PackedIndices IndexData::packed() const {
+    std::shared_ptr<std::vector<uint8_t> > bytes(new std::vector<uint8_t>());
+
+    PackedIndices result;
+    result.type = narrowest_type();
+    encode(result.type, 0, *bytes);
+
+    result.count = indices_.size();
+    result.data = (bytes->empty()) ? nullptr : &(*bytes)[0];
+    result.storage = bytes;
+    return result;
+}
+
+template<typename T>
+static void decode_as(const uint8_t* data, uint32_t count, std::vector<uint32_t>& out) {
+    out.resize(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        T value;
+        memcpy(&value, data + i * sizeof(T), sizeof(T));
+        out[i] = value;
+    }
+}
+
+void IndexData::set_packed(const PackedIndices& indices) {
+    if(indices.count && !indices.data) {
+        throw std::logic_error("Packed indices are missing their data");
+    }
+
+    clear();
+
+    switch(indices.type) {
+        case INDEX_TYPE_8_BIT:
+            decode_as<uint8_t>(indices.data, indices.count, indices_);
+        break;
+        case INDEX_TYPE_16_BIT:
+            decode_as<uint16_t>(indices.data, indices.count, indices_);
+        break;
+        case INDEX_TYPE_32_BIT:
+            decode_as<uint32_t>(indices.data, indices.count, indices_);
+        break;
+    default:
+        throw std::logic_error("Packed indices have an unknown type");
     }
 
+    max_index_ = (indices_.empty()) ? 0 : *std::max_element(indices_.begin(), indices_.end());
+    index_type_ = indices.type;
+
+    //The storage is kept by the copy of indices until the upload has happened
+    auto upload = [=]() {
+        const uint32_t size = indices.count * index_type_size(indices.type);
+        if(buffer_object_.is_streamed()) {
+            buffer_object_.stream(size, indices.data);
+        } else {
+            buffer_object_.create(size, indices.data);
+        }
+    };
+
+    if(GLThreadCheck::is_current()) {
+        upload();
+    } else {
+        //The upload uses this object, and uploaded_* must only describe what's really in the buffer
+        scene_.window().idle().add_once(upload, IDLE_TASK_PRIORITY_UPLOAD).wait();
+    }
+
+    uploaded_count_ = indices_.size();
+    uploaded_type_ = index_type_;
+    dirty_from_ = indices_.size();
+
     signal_update_complete_();
 }
 
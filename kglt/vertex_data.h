@@ -2,7 +2,9 @@
 #define VERTEX_DATA_H
 
 #include <cstdint>
+#include <memory>
 #include <vector>
+#include <algorithm>
 
 #include <sigc++/sigc++.h>
 
@@ -29,15 +31,31 @@ enum AttributeBitMask {
     BM_SPECULAR = 256
 };
 
+enum AttributeEncoding {
+    ATTRIBUTE_ENCODING_FLOAT,
+    ATTRIBUTE_ENCODING_NORMALIZED_BYTE //Normals and colours only, 4 bytes instead of 12 or 16
+};
+
+/*
+ *  Vertices packed the way VertexData::done() packs them, for saving and loading compiled
+ *  meshes. data points into storage, which keeps it alive.
+ */
+struct PackedVertices {
+    int32_t attributes = 0; //AttributeBitMask values
+    int32_t byte_encoded = 0; //The attributes stored as ATTRIBUTE_ENCODING_NORMALIZED_BYTE
+    uint8_t tex_coord_dimensions[8] = { 2, 2, 2, 2, 2, 2, 2, 2 };
+    uint32_t count = 0;
+    uint32_t stride = 0;
+    const uint8_t* data = nullptr;
+    std::shared_ptr<const void> storage;
+};
+
 /*
- *  FIXME:
- *  The BufferObject maintained by VertexData includes all attributes, even if some of them
- *  haven't been used - this is ridiculously inefficient. Also the values returned from the *_offset
- *  methods are fixed and don't vary according to the attributes being used. What should happen
- *  is the buffer object should only include the attributes in use, and the offset methods should
- *  throw an exception if they are called on a VertexData instance that doesn't have the associated
- *  attribute in use. Similarly, texture coordinates should only take up the correct size in the
- *  buffer object and not always the full 4 floats.
+ *  VertexData keeps a full Vertex per element on the CPU side so it can be edited freely, but
+ *  when done() is called it packs only the enabled attributes into the buffer object. Texture
+ *  coordinates take up as many floats as set_texture_coordinate_dimensions says, and normals
+ *  and colours can be stored as normalized bytes. The *_offset() methods and stride() describe
+ *  the packed layout and throw if the attribute isn't in use.
  */
 class VertexData :
     public Managed<VertexData> {
@@ -47,29 +65,36 @@ public:
 
     void reset(BufferObjectUsage usage=MODIFY_ONCE_USED_FOR_RENDERING);
     void set_texture_coordinate_dimensions(uint8_t coord_index, uint8_t count);
+    void set_attribute_encoding(AttributeBitMask attr, AttributeEncoding encoding);
 
     void clear();
     void move_to_start();
-    void move_by(int16_t amount);
-    void move_to(uint16_t index);
+    void move_by(int32_t amount);
+    void move_to(uint32_t index);
     void move_to_end();
-    uint16_t move_next();
+    uint32_t move_next();
 
     void done();
 
+    /*
+     * set_packed() sends vertices that are already packed straight to the buffer object
+     * without making a Vertex for each one. Reads go to the packed copy until something
+     * changes the vertices, which unpacks them first. Throws std::logic_error if the
+     * stride doesn't match the layout the attributes give.
+     */
+    PackedVertices packed();
+    void set_packed(const PackedVertices& vertices);
+    bool is_packed() const { return packed_.data != nullptr; }
+
     void position(float x, float y, float z);
     void position(const kmVec3& pos);
 
-    kmVec3 position_at(uint16_t idx) {
-        return data_.at(idx).position;
-    }
+    kmVec3 position_at(uint32_t idx) const;
 
     void normal(float x, float y, float z);
     void normal(const kmVec3& n);
 
-    kmVec3 normal_at(uint16_t idx) {
-        return data_.at(idx).normal;
-    }
+    kmVec3 normal_at(uint32_t idx) const;
 
     void tex_coord0(float u);
     void tex_coord0(float u, float v);
@@ -117,62 +142,31 @@ public:
     bool has_diffuse() const { return enabled_bitmask_ & BM_DIFFUSE; }
     bool has_specular() const { return enabled_bitmask_ & BM_SPECULAR; }
 
-    uint16_t count() const { return data_.size(); }
+    uint32_t count() const { return (is_packed()) ? packed_.count : data_.size(); }
 
-    bool operator==(const VertexData& other) const {
-        return this->data_ == other.data_;
-    }
+    bool operator==(const VertexData& other) const;
 
     bool operator!=(const VertexData& other) const {
         return !(*this == other);
     }
 
-    uint32_t stride() const { return sizeof(Vertex); }
-
-    uint32_t position_offset() const {
-        Vertex vert;
-        return uint64_t(&vert.position) - uint64_t(&vert);
-    }
-
-    uint32_t normal_offset() const {
-        Vertex vert;
-        return uint64_t(&vert.normal) - uint64_t(&vert);
-    }
-
-    uint32_t texcoord0_offset() const {
-        Vertex vert;
-        return uint64_t(&vert.tex_coords[0]) - uint64_t(&vert);
-    }
-
-    uint32_t texcoord1_offset() const {
-        Vertex vert;
-        return uint64_t(&vert.tex_coords[1]) - uint64_t(&vert);
-    }
-
-    uint32_t texcoord2_offset() const {
-        Vertex vert;
-        return uint64_t(&vert.tex_coords[2]) - uint64_t(&vert);
-    }
-
-    uint32_t texcoord3_offset() const {
-        Vertex vert;
-        return uint64_t(&vert.tex_coords[3]) - uint64_t(&vert);
-    }
+    bool has_attribute(AttributeBitMask attr) const { return enabled_bitmask_ & attr; }
 
-    uint32_t texcoord4_offset() const {
-        Vertex vert;
-        return uint64_t(&vert.tex_coords[4]) - uint64_t(&vert);
-    }
+    uint32_t stride() const { return stride_; }
 
-    uint32_t diffuse_offset() const {
-        Vertex vert;
-        return uint64_t(&vert.diffuse) - uint64_t(&vert);
-    }
+    uint32_t attribute_offset(AttributeBitMask attr) const;
+    uint8_t attribute_components(AttributeBitMask attr) const;
+    AttributeEncoding attribute_encoding(AttributeBitMask attr) const;
 
-    uint32_t specular_offset() const {
-        Vertex vert;
-        return uint64_t(&vert.specular) - uint64_t(&vert);
-    }
+    uint32_t position_offset() const { return attribute_offset(BM_POSITIONS); }
+    uint32_t normal_offset() const { return attribute_offset(BM_NORMALS); }
+    uint32_t texcoord0_offset() const { return attribute_offset(BM_TEXCOORD_0); }
+    uint32_t texcoord1_offset() const { return attribute_offset(BM_TEXCOORD_1); }
+    uint32_t texcoord2_offset() const { return attribute_offset(BM_TEXCOORD_2); }
+    uint32_t texcoord3_offset() const { return attribute_offset(BM_TEXCOORD_3); }
+    uint32_t texcoord4_offset() const { return attribute_offset(BM_TEXCOORD_4); }
+    uint32_t diffuse_offset() const { return attribute_offset(BM_DIFFUSE); }
+    uint32_t specular_offset() const { return attribute_offset(BM_SPECULAR); }
 
     BufferObject& buffer_object() {
         return buffer_object_;
@@ -195,8 +189,21 @@ private:
     Scene& scene_;
 
     int32_t enabled_bitmask_;
+    int32_t byte_encoded_bitmask_;
     uint8_t tex_coord_dimensions_[8];
 
+    //Offsets into the packed vertex, indexed by the bit position of the AttributeBitMask
+    static const uint8_t ATTRIBUTE_COUNT = 9;
+    uint32_t offsets_[ATTRIBUTE_COUNT];
+    uint32_t stride_;
+
+    //What was last sent to the buffer object, and the range of vertices written since
+    uint32_t uploaded_offsets_[ATTRIBUTE_COUNT];
+    uint32_t uploaded_count_;
+    uint32_t uploaded_stride_;
+    uint32_t dirty_begin_;
+    uint32_t dirty_end_;
+
     struct Vertex {
         kmVec3 position;
         kmVec3 normal;
@@ -223,8 +230,19 @@ private:
     int32_t cursor_position_;
     BufferObject buffer_object_;
 
+    //Set by set_packed() and dropped by unpack()
+    PackedVertices packed_;
+
+    void unpack();
+    Vertex vertex_at(uint32_t idx) const;
+
     void check_or_add_attribute(AttributeBitMask attr);
 
+    void recalc_layout();
+    bool layout_matches_upload() const;
+    void pack(std::vector<uint8_t>& out, uint32_t first, uint32_t count) const;
+    Vertex& current_vertex();
+
     void tex_coordX(uint8_t which, float u);
     void tex_coordX(uint8_t which, float u, float v);
     void tex_coordX(uint8_t which, float u, float v, float w);
@@ -235,19 +253,58 @@ private:
 };
 
 
+/*
+ *  Indices are always stored as 32 bit on the CPU side, but done() uploads them using the
+ *  narrowest type that can hold the largest index, so most meshes still only cost 2 bytes
+ *  per index on the GPU while large static geometry can go out in a single draw.
+ */
+enum IndexType {
+    INDEX_TYPE_8_BIT,
+    INDEX_TYPE_16_BIT,
+    INDEX_TYPE_32_BIT
+};
+
+//Indices encoded the way IndexData::done() encodes them, data points into storage
+struct PackedIndices {
+    IndexType type = INDEX_TYPE_16_BIT;
+    uint32_t count = 0;
+    const uint8_t* data = nullptr;
+    std::shared_ptr<const void> storage;
+};
+
 class IndexData {
 public:
     IndexData(Scene &scene_);
 
     void reset(BufferObjectUsage usage=MODIFY_ONCE_USED_FOR_RENDERING);
-    void clear() { indices_.clear(); }
-    void reserve(uint16_t size) { indices_.reserve(size); }
-    void index(uint16_t idx) { indices_.push_back(idx); }
+    void clear() { indices_.clear(); max_index_ = 0; dirty_from_ = 0; }
+    void reserve(uint32_t size) { indices_.reserve(size); }
+    void index(uint32_t idx) {
+        dirty_from_ = std::min<uint32_t>(dirty_from_, indices_.size());
+        indices_.push_back(idx);
+        if(idx > max_index_) {
+            max_index_ = idx;
+        }
+    }
     void done();
 
-    uint16_t count() const { return indices_.size(); }
+    /*
+     * set_packed() sends the encoded indices straight to the buffer object. The 32 bit
+     * copy is still made, but only by widening them.
+     */
+    PackedIndices packed() const;
+    void set_packed(const PackedIndices& indices);
+
+    uint32_t count() const { return indices_.size(); }
+    uint32_t max_index() const { return max_index_; }
 
-    const std::vector<uint16_t>& all() const { return indices_; }
+    /*
+     * The type of the indices in the buffer object, this is only
+     * valid after done() has been called
+     */
+    IndexType index_type() const { return index_type_; }
+
+    const std::vector<uint32_t>& all() const { return indices_; }
 
     bool operator==(const IndexData& other) const {
         return this->indices_ == other.indices_;
@@ -270,13 +327,22 @@ public:
 private:
     Scene& scene_;
 
-    std::vector<uint16_t> indices_;
+    std::vector<uint32_t> indices_;
+    uint32_t max_index_;
+    IndexType index_type_;
+
+    uint32_t uploaded_count_;
+    IndexType uploaded_type_;
+    uint32_t dirty_from_;
+
     BufferObject buffer_object_;
 
+    IndexType narrowest_type() const;
+    void encode(IndexType type, uint32_t first, std::vector<uint8_t>& out) const;
+
     sigc::signal<void> signal_update_complete_;
 };
 
-
 }
 
 #endif // VERTEX_DATA_H
@@ -3,6 +3,7 @@
 #include "viewport.h"
 #include "window.h"
 #include "scene.h"
+#include "utils/gl_state.h"
 
 #include "kglt/kazbase/exceptions.h"
 
@@ -54,6 +55,9 @@ void Viewport::set_orthographic_projection_from_height(float desired_height_in_u
 void Viewport::clear() {
     apply();
 
+    //The last depth group may have turned depth writes off, which would stop the clear too
+    GLState::get().depth_mask(true);
+
     glClearColor(colour_.r, colour_.g, colour_.b, colour_.a);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
@@ -61,7 +65,7 @@ void Viewport::clear() {
 void Viewport::apply() const {
     double x, y, width, height;
 
-	glDisable(GL_SCISSOR_TEST);
+	GLState::get().disable(GL_SCISSOR_TEST);
 	switch(type_) {
 		case VIEWPORT_TYPE_CUSTOM: {
 			x = x_;
@@ -99,7 +103,7 @@ void Viewport::apply() const {
 			assert(0 && "Not Implemented");
 	}
 
-    glEnable(GL_SCISSOR_TEST);
+    GLState::get().enable(GL_SCISSOR_TEST);
     glScissor(x, y, width, height);
     glViewport(x, y, width, height);
 }
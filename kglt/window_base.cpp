@@ -6,18 +6,22 @@
 #include "ui/interface.h"
 #include "input_controller.h"
 #include "loaders/texture_loader.h"
+#include "loaders/ktx_loader.h"
 #include "loaders/material_script.h"
 #include "loaders/q2bsp_loader.h"
 #include "loaders/opt_loader.h"
 #include "loaders/ogg_loader.h"
 #include "loaders/rml_loader.h"
 #include "loaders/obj_loader.h"
+#include "loaders/kglmesh_loader.h"
 #include "sound.h"
 #include "lua/console.h"
 #include "watcher.h"
 
 #include "screens/loading.h"
 #include "utils/gl_thread_check.h"
+#include "utils/gl_state.h"
+#include "utils/profiler.h"
 
 namespace kglt {
 
@@ -27,6 +31,7 @@ WindowBase::WindowBase():
     width_(-1),
     height_(-1),
     is_running_(true),
+    frame_in_flight_(false),
     default_viewport_(0),
     resource_locator_(ResourceLocator::create()),
     frame_counter_time_(0),
@@ -65,6 +70,7 @@ LoaderPtr WindowBase::loader_for(const unicode &filename) {
 
 bool WindowBase::init(int width, int height, int bpp, bool fullscreen) {
     GLThreadCheck::init();
+    Profiler::get().set_thread_name("Main");
 
     set_width(width);
     set_height(height);
@@ -77,13 +83,15 @@ bool WindowBase::init(int width, int height, int bpp, bool fullscreen) {
         watcher_ = Watcher::create(*this);
 
         //Register the default resource loaders
-        register_loader(std::make_shared<kglt::loaders::TextureLoaderType>());
+        register_loader(std::make_shared<kglt::loaders::KTXLoaderType>());
+        register_loader(std::make_shared<kglt::loaders::TextureLoaderType>(this));
         register_loader(std::make_shared<kglt::loaders::MaterialScriptLoaderType>());
         register_loader(std::make_shared<kglt::loaders::OPTLoaderType>());
         register_loader(std::make_shared<kglt::loaders::OGGLoaderType>());
         register_loader(std::make_shared<kglt::loaders::RMLLoaderType>());
         register_loader(std::make_shared<kglt::loaders::Q2BSPLoaderType>());
         register_loader(std::make_shared<kglt::loaders::OBJLoaderType>());
+        register_loader(std::make_shared<kglt::loaders::KGLMeshLoaderType>());
 
         //Create a default viewport
         default_viewport_ = new_viewport();
@@ -99,18 +107,22 @@ bool WindowBase::init(int width, int height, int bpp, bool fullscreen) {
         //This needs to happen after SDL or whatever is initialized
         input_controller_ = InputController::create();
 
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LEQUAL);
-        glEnable(GL_MULTISAMPLE);
+        //A new context, so nothing we knew about the old one holds
+        GLState& state = GLState::get();
+        state.invalidate();
+
+        state.enable(GL_DEPTH_TEST);
+        state.depth_func(GL_LEQUAL);
+        state.enable(GL_MULTISAMPLE);
 
         glHint(GL_LINE_SMOOTH_HINT, GL_NICEST );
         glHint(GL_POLYGON_SMOOTH_HINT, GL_NICEST );
 
-        glEnable(GL_POLYGON_SMOOTH);
-        glEnable(GL_LINE_SMOOTH);
-        glEnable(GL_POINT_SMOOTH);
+        state.enable(GL_POLYGON_SMOOTH);
+        state.enable(GL_LINE_SMOOTH);
+        state.enable(GL_POINT_SMOOTH);
 
-        glEnable(GL_CULL_FACE);
+        state.enable(GL_CULL_FACE);
 
         using std::bind;
 
@@ -134,7 +146,52 @@ void WindowBase::set_logging_level(LoggingLevel level) {
     logging::get_logger("/")->set_level((logging::LOG_LEVEL) level);
 }
 
+void WindowBase::step(double dt) {
+    input_controller().update(dt);
+    scene().update(dt);
+
+    signal_step_(dt); //Trigger any steps
+}
+
+void WindowBase::draw_frame() {
+    GLState::get().new_frame();
+    GLState::get().depth_mask(true);
+
+    glViewport(0, 0, width(), height());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    scene().render_sequence().submit();
+
+    signal_pre_swap_();
+
+    {
+        KGLT_PROFILE_SCOPE("WindowBase::swap_buffers");
+        swap_buffers();
+    }
+
+    //std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+void WindowBase::set_threaded_rendering(bool value) {
+    if(value == threaded_rendering()) {
+        return;
+    }
+
+    if(value) {
+        simulation_thread_.reset(new SimulationThread([this](double dt) { step(dt); }));
+    } else {
+        simulation_thread_.reset();
+    }
+}
+
 bool WindowBase::update() {
+    //Checks whether the last frame was a spike, so it has to come before the scope below is opened
+    Profiler::get().new_frame();
+    KGLT_PROFILE_SCOPE("WindowBase::update");
+
+    //Nothing from the last frame is still running, so its scratch memory can be reused
+    jobs_.new_frame();
+
     signal_frame_started_();
 
     ktiBindTimer(variable_timer_);
@@ -159,31 +216,50 @@ bool WindowBase::update() {
     ktiUpdateFrameTime();
     double fixed_step = ktiGetDeltaTime();
 
-    check_events();
-
-    while(ktiTimerCanUpdate()) {
-        input_controller().update(fixed_step);
-        scene().update(fixed_step);
-
-        signal_step_(fixed_step); //Trigger any steps
+    {
+        KGLT_PROFILE_SCOPE("WindowBase::check_events");
+        check_events();
     }
 
-    idle_.execute(); //Execute idle tasks before render
+    if(simulation_thread_) {
+        //The simulation thread is idle until start(), so up to there this thread has the scene to itself
+        uint32_t steps = 0;
+        while(ktiTimerCanUpdate()) {
+            ++steps;
+        }
 
-    glViewport(0, 0, width(), height());
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        idle_.execute();
+        scene().render_sequence().prepare();
 
-    scene().render();
+        //Steps for the next frame run while this one is drawn from the snapshot
+        frame_in_flight_ = true;
+        simulation_thread_->start(steps, fixed_step);
+        draw_frame();
 
-    signal_pre_swap_();
+        //Clear the flag even if a step threw, the frame has been drawn either way
+        try {
+            simulation_thread_->wait();
+        } catch(...) {
+            frame_in_flight_ = false;
+            throw;
+        }
+        frame_in_flight_ = false;
+    } else {
+        while(ktiTimerCanUpdate()) {
+            step(fixed_step);
+        }
 
-    swap_buffers();
+        idle_.execute(); //Execute idle tasks and queued uploads before render, as the budget allows
 
-    //std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        scene().render_sequence().prepare();
+        draw_frame();
+    }
 
     signal_frame_finished_();
 
     if(!is_running_) {
+        simulation_thread_.reset();
+
         signal_shutdown_();
 
         watcher_.reset();
@@ -191,6 +267,9 @@ bool WindowBase::update() {
         loading_update_connection_.disconnect();
         loading_.reset();
 
+        //Anything still waiting to upload refers to resources owned by the scene
+        idle_.flush(IDLE_TASK_PRIORITY_UPLOAD);
+
         //Shutdown the input controller
         input_controller_.reset();
         //Destroy the scene
@@ -215,6 +294,10 @@ Scene& WindowBase::scene() {
     return *scene_;
 }
 
+void WindowBase::enable_texture_cache(const unicode& directory, const TextureCompiler& compiler) {
+    texture_cache_ = std::make_shared<TextureCache>(directory.encode(), compiler);
+}
+
 void WindowBase::register_loader(LoaderTypePtr loader) {
     if(container::contains(loaders_, loader)) {
         throw LogicError("Tried to add the same loader twice");
@@ -1,6 +1,7 @@
 #ifndef KGLT_WINDOW_BASE_H
 #define KGLT_WINDOW_BASE_H
 
+#include <atomic>
 #include <tr1/memory>
 
 #include <sigc++/sigc++.h>
@@ -10,6 +11,9 @@
 #include "resource_locator.h"
 
 #include "idle_task_manager.h"
+#include "utils/job_system.h"
+#include "simulation_thread.h"
+#include "utils/texture_compiler.h"
 
 #include "kazbase/logging.h"
 #include "generic/manager.h"
@@ -85,7 +89,34 @@ public:
 
     bool update();
 
+    /*
+     * Off by default. When on, update() runs the fixed steps (input, Scene::update()
+     * and signal_step()) on a simulation thread while this thread draws the previous
+     * frame. This thread keeps the events, idle tasks, uploads and all of the GL work.
+     * The two meet at the start of each update(): the simulation is idle while idle
+     * tasks run and the frame is prepared (see RenderSequence::prepare()), which is
+     * when transformations are snapshotted.
+     *
+     * So step handlers and do_update() mustn't call GL, change UI stages, materials,
+     * meshes or lights' colours, delete stages or call set_threaded_rendering().
+     * Anything like that has to go through idle(). Moving objects is fine, rendering
+     * only sees the snapshot. Deleting actors and lights and Actor::set_mesh() are
+     * fine too, the stage holds them back until the frame has been drawn (see
+     * Stage::defer_to_handoff()).
+     *
+     * Handlers of RenderSequence::signal_pipeline_started() run while the simulation
+     * is, so they mustn't activate pipelines either. Building a draw list there would
+     * race with the simulation thread, so a pipeline activated that way is skipped
+     * until the next prepare().
+     */
+    void set_threaded_rendering(bool value=true);
+    bool threaded_rendering() const { return bool(simulation_thread_); }
+
+    //True from when the simulation thread is started until the frame it runs alongside is drawn
+    bool frame_in_flight() const { return frame_in_flight_; }
+
     IdleTaskManager& idle() { return idle_; }
+    JobSystem& jobs() { return jobs_; }
 
     ViewportID new_viewport();
     Viewport& viewport(ViewportID viewport=ViewportID());
@@ -94,6 +125,15 @@ public:
 
     ResourceLocator& resource_locator() { return *resource_locator_; }
 
+    /*
+     * Off by default. Textures loaded from images are compiled into directory the first
+     * time and mapped from there afterwards (see TextureCache). Set it up before loading
+     * anything, loads that are already running keep whichever cache they started with.
+     */
+    void enable_texture_cache(const unicode& directory, const TextureCompiler& compiler=TextureCompiler());
+    void disable_texture_cache() { texture_cache_.reset(); }
+    std::shared_ptr<TextureCache> texture_cache() const { return texture_cache_; }
+
     Keyboard& keyboard();
     Mouse& mouse();
     Joypad& joypad(uint8_t idx);
@@ -148,6 +188,12 @@ private:
     bool is_running_;
         
     IdleTaskManager idle_;
+    JobSystem jobs_;
+    std::unique_ptr<SimulationThread> simulation_thread_;
+    std::atomic<bool> frame_in_flight_;
+
+    void step(double dt);
+    void draw_frame();
 
     KTIuint fixed_timer_;
     KTIuint variable_timer_;
@@ -158,6 +204,7 @@ private:
     ViewportID default_viewport_;
 
     ResourceLocator::ptr resource_locator_;
+    std::shared_ptr<TextureCache> texture_cache_;
     std::shared_ptr<InputController> input_controller_;
 
     double frame_counter_time_;
@@ -0,0 +1,84 @@
+#ifndef TEST_BUFFER_OBJECT_H
+#define TEST_BUFFER_OBJECT_H
+
+#include <vector>
+#include <GLee.h>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/kglt.h"
+#include "kglt/buffer_object.h"
+#include "global.h"
+
+class BufferObjectTest : public TestCase {
+public:
+    void set_up() {
+        if(!window) {
+            window = kglt::Window::create();
+            window->set_logging_level(kglt::LOG_LEVEL_NONE);
+        }
+    }
+
+    void test_streaming_cycles_through_the_regions() {
+        kglt::BufferObject buffer(kglt::BUFFER_OBJECT_VERTEX_DATA, kglt::MODIFY_ONCE_USED_FOR_LIMITED_RENDERING);
+        std::vector<uint8_t> data(64, 1);
+
+        buffer.stream(data.size(), &data[0]);
+
+        if(!GLEE_ARB_sync || !GLEE_ARB_map_buffer_range) {
+            //Falls back to orphaning, which always writes from the start of a new buffer
+            assert_equal(64, buffer.size());
+            assert_equal(0, buffer.base_offset());
+            return;
+        }
+
+        //Half as much again as was asked for, for each region
+        const uint32_t region = 96;
+        assert_equal(region * kglt::BUFFER_OBJECT_STREAM_REGIONS, buffer.size());
+        assert_equal(0, buffer.base_offset());
+
+        uint64_t generation = buffer.generation();
+        for(uint32_t i = 1; i <= kglt::BUFFER_OBJECT_STREAM_REGIONS; ++i) {
+            buffer.stream(data.size(), &data[0]);
+
+            //Wraps back around to the first region, which was fenced when it was left
+            assert_equal((i % kglt::BUFFER_OBJECT_STREAM_REGIONS) * region, buffer.base_offset());
+            assert_true(buffer.generation() != generation);
+            generation = buffer.generation();
+        }
+
+        //Anything bigger than a region respecifies the storage and starts from the beginning
+        std::vector<uint8_t> bigger(200, 2);
+        buffer.stream(bigger.size(), &bigger[0]);
+
+        assert_equal(300 * kglt::BUFFER_OBJECT_STREAM_REGIONS, buffer.size());
+        assert_equal(0, buffer.base_offset());
+        assert_true(buffer.generation() != generation);
+
+        //Smaller writes fit in the regions that are already there
+        buffer.stream(data.size(), &data[0]);
+        assert_equal(300 * kglt::BUFFER_OBJECT_STREAM_REGIONS, buffer.size());
+        assert_equal(300, buffer.base_offset());
+    }
+
+    void test_reset_starts_again() {
+        kglt::BufferObject buffer(kglt::BUFFER_OBJECT_INDEX_DATA);
+        std::vector<uint8_t> data(32, 1);
+
+        buffer.create(data.size(), &data[0]);
+        assert_true(buffer.is_initialized());
+
+        uint64_t generation = buffer.generation();
+        buffer.reset(kglt::MODIFY_ONCE_USED_FOR_LIMITED_RENDERING);
+
+        assert_false(buffer.is_initialized());
+        assert_equal(0, buffer.size());
+        assert_true(buffer.is_streamed());
+        assert_true(buffer.generation() != generation);
+
+        buffer.stream(data.size(), &data[0]);
+        assert_true(buffer.is_initialized());
+    }
+};
+
+#endif // TEST_BUFFER_OBJECT_H
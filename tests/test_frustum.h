@@ -84,6 +84,47 @@ public:
         assert_close(2.0, frustum.far_height(), 0.0001);
         assert_close(9.0, frustum.depth(), 0.0001);
     }
+
+    void test_intersects_aabbs() {
+        Frustum frustum;
+
+        kmMat4 projection;
+        kmMat4OrthographicProjection(&projection, -1.0, 1.0, -1.0, 1.0, 1.0, 10.0);
+        frustum.build(&projection);
+
+        //Alternate boxes inside and outside, with a partial group at the end
+        AABBList boxes;
+        for(uint32_t i = 0; i < 6; ++i) {
+            kmVec3 centre;
+            kmVec3Fill(&centre, (i % 2) ? 5.0 : 0.0, 0, -5.0);
+
+            kmAABB box;
+            kmAABBInitialize(&box, &centre, 0.5, 0.5, 0.5);
+            boxes.push_back(box);
+        }
+
+        assert_equal(6, boxes.size());
+        assert_equal(2, boxes.group_count());
+
+        assert_equal(0x5, frustum.intersects_aabbs(boxes, 0));
+        assert_equal(0x1, frustum.intersects_aabbs(boxes, 1));
+
+        //Removing box 1 moves the last box (outside) into its slot
+        boxes.swap_and_pop(1);
+        assert_equal(5, boxes.size());
+        assert_equal(0x5, frustum.intersects_aabbs(boxes, 0));
+        assert_equal(0x1, frustum.intersects_aabbs(boxes, 1));
+
+        //Removing another drops the second group entirely
+        boxes.swap_and_pop(0);
+        assert_equal(1, boxes.group_count());
+        assert_equal(0x5, frustum.intersects_aabbs(boxes, 0));
+
+        for(uint32_t i = 0; i < boxes.size(); ++i) {
+            bool inside = frustum.intersects_aabb(boxes.get(i));
+            assert_equal(inside, bool(frustum.intersects_aabbs(boxes, 0) & (1 << i)));
+        }
+    }
 };
 
 #endif // TEST_FRUSTUM_H
@@ -0,0 +1,78 @@
+#ifndef TEST_GL_STATE_H
+#define TEST_GL_STATE_H
+
+#include <GLee.h>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/kglt.h"
+#include "kglt/utils/gl_state.h"
+#include "global.h"
+
+class GLStateTest : public TestCase {
+public:
+    void set_up() {
+        if(!window) {
+            window = kglt::Window::create();
+            window->set_logging_level(kglt::LOG_LEVEL_NONE);
+        }
+
+        kglt::GLState::get().invalidate();
+        kglt::GLState::get().new_frame();
+    }
+
+    void test_redundant_changes_are_elided() {
+        kglt::GLState& state = kglt::GLState::get();
+
+        state.enable(GL_BLEND);
+        state.enable(GL_BLEND);
+        state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        state.depth_mask(false);
+        state.depth_mask(false);
+
+        assert_equal(3, state.frame_stats().issued);
+        assert_equal(3, state.frame_stats().elided);
+        assert_true(glIsEnabled(GL_BLEND));
+
+        state.disable(GL_BLEND);
+        assert_equal(4, state.frame_stats().issued);
+        assert_false(glIsEnabled(GL_BLEND));
+
+        state.new_frame();
+        assert_equal(4, state.last_frame_stats().issued);
+        assert_equal(0, state.frame_stats().issued);
+        assert_equal(0, state.frame_stats().elided);
+
+        state.depth_mask(true);
+    }
+
+    void test_texture_bindings() {
+        kglt::GLState& state = kglt::GLState::get();
+
+        GLuint tex = 0;
+        glGenTextures(1, &tex);
+
+        //Binding to a unit activates it first
+        state.bind_texture(1, tex);
+        assert_equal(2, state.frame_stats().issued);
+
+        state.bind_texture(1, tex);
+        assert_equal(1, state.frame_stats().elided);
+
+        //A different unit, so the active unit changes as well as its binding
+        state.bind_texture(0, tex);
+        assert_equal(4, state.frame_stats().issued);
+
+        //Deleting a bound texture unbinds it, so binding the name again must go through
+        state.texture_deleted(tex);
+        state.bind_texture(0, tex);
+        assert_equal(5, state.frame_stats().issued);
+        assert_equal(2, state.frame_stats().elided);
+
+        state.texture_deleted(tex);
+        glDeleteTextures(1, &tex);
+    }
+};
+
+#endif // TEST_GL_STATE_H
@@ -0,0 +1,119 @@
+#ifndef TEST_IDLE_TASK_MANAGER_H
+#define TEST_IDLE_TASK_MANAGER_H
+
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/idle_task_manager.h"
+
+class IdleTaskManagerTest : public TestCase {
+public:
+    void test_priorities_and_removal() {
+        kglt::IdleTaskManager idle;
+
+        std::vector<int> order;
+        idle.add_once([&]() { order.push_back(2); }, kglt::IDLE_TASK_PRIORITY_LOW);
+        idle.add_once([&]() { order.push_back(1); });
+        idle.add_once([&]() { order.push_back(0); }, kglt::IDLE_TASK_PRIORITY_HIGH);
+
+        kglt::IdleTaskToken removed = idle.add_once([&]() { order.push_back(3); });
+        idle.remove(removed.id());
+
+        idle.execute();
+
+        assert_equal(3, order.size());
+        assert_equal(0, order[0]);
+        assert_equal(1, order[1]);
+        assert_equal(2, order[2]);
+
+        bool broken = false;
+        try {
+            removed.wait();
+        } catch(std::future_error& e) {
+            broken = true;
+        }
+        assert_true(broken);
+    }
+
+    void test_budget_carries_over() {
+        kglt::IdleTaskManager idle;
+        idle.set_budget(0.001);
+
+        for(int i = 0; i < 3; ++i) {
+            idle.add_once([]() { std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+        }
+
+        idle.execute();
+        assert_equal(2, idle.pending());
+
+        idle.set_budget(0);
+        idle.execute();
+        assert_equal(0, idle.pending());
+    }
+
+    void test_uploads_share_the_budget() {
+        kglt::IdleTaskManager idle;
+        idle.set_budget(0.001);
+
+        std::vector<int> order;
+        for(int i = 0; i < 3; ++i) {
+            idle.add_once([&order, i]() {
+                order.push_back(i);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }, kglt::IDLE_TASK_PRIORITY_UPLOAD);
+        }
+        idle.add_once([&order]() { order.push_back(3); }, kglt::IDLE_TASK_PRIORITY_LOW);
+
+        idle.execute();
+        assert_equal(1, order.size());
+        assert_equal(3, idle.pending());
+
+        //Flushing runs the rest of the uploads in order, but nothing else
+        idle.flush(kglt::IDLE_TASK_PRIORITY_UPLOAD);
+        assert_equal(3, order.size());
+        assert_equal(2, order[2]);
+        assert_equal(1, idle.pending());
+    }
+
+    void test_failed_upload_goes_to_token() {
+        kglt::IdleTaskManager idle;
+
+        kglt::IdleTaskToken failed = idle.add_once([]() {
+            throw std::runtime_error("Failed");
+        }, kglt::IDLE_TASK_PRIORITY_UPLOAD);
+        kglt::IdleTaskToken succeeded = idle.add_once([]() {}, kglt::IDLE_TASK_PRIORITY_UPLOAD);
+
+        //Doesn't throw, whoever queued the upload hears about it instead
+        idle.execute();
+
+        bool thrown = false;
+        try {
+            failed.wait();
+        } catch(std::runtime_error& e) {
+            thrown = true;
+        }
+
+        assert_true(thrown);
+        succeeded.wait();
+    }
+
+    void test_token_wait() {
+        kglt::IdleTaskManager idle;
+
+        bool ran = false;
+        std::future<void> waiter = std::async(std::launch::async, [&]() {
+            idle.add_once([&]() { ran = true; }).wait();
+        });
+
+        while(waiter.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready) {
+            idle.execute();
+        }
+
+        assert_true(ran);
+    }
+};
+
+#endif // TEST_IDLE_TASK_MANAGER_H
@@ -0,0 +1,120 @@
+#ifndef TEST_JOB_SYSTEM_H
+#define TEST_JOB_SYSTEM_H
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/utils/job_system.h"
+
+class JobSystemTest : public TestCase {
+public:
+    void test_parallel_for_covers_range() {
+        kglt::JobSystem jobs(3);
+
+        std::vector<std::atomic<uint32_t> > hits(10000);
+        for(std::atomic<uint32_t>& hit: hits) {
+            hit = 0;
+        }
+
+        jobs.parallel_for(0, hits.size(), 64, [&](uint32_t first, uint32_t last) {
+            for(uint32_t i = first; i < last; ++i) {
+                ++hits[i];
+            }
+
+            //Nested loops are run by whoever waits, so this can't deadlock
+            jobs.parallel_for(0, 4, 1, [](uint32_t, uint32_t) {});
+        });
+
+        for(std::atomic<uint32_t>& hit: hits) {
+            assert_equal(1, hit.load());
+        }
+
+        bool thrown = false;
+        try {
+            jobs.parallel_for(0, 100, 1, [](uint32_t first, uint32_t last) {
+                if(first <= 50 && 50 < last) {
+                    throw std::runtime_error("Fifty");
+                }
+            });
+        } catch(std::runtime_error& e) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+
+    void test_task_graph_order() {
+        kglt::JobSystem jobs(2);
+
+        std::mutex mutex;
+        std::vector<int> order;
+        auto record = [&](int value) {
+            return [&, value]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(value);
+            };
+        };
+
+        kglt::TaskGraph graph;
+        kglt::TaskGraph::TaskID first = graph.add(record(0));
+        kglt::TaskGraph::TaskID left = graph.add(record(1));
+        kglt::TaskGraph::TaskID right = graph.add(record(1));
+        kglt::TaskGraph::TaskID last = graph.add(record(2));
+
+        graph.add_dependency(left, first);
+        graph.add_dependency(right, first);
+        graph.add_dependency(last, left);
+        graph.add_dependency(last, right);
+
+        for(int i = 0; i < 10; ++i) {
+            order.clear();
+            graph.run(jobs);
+
+            assert_equal(4, order.size());
+            assert_equal(0, order[0]);
+            assert_equal(1, order[1]);
+            assert_equal(1, order[2]);
+            assert_equal(2, order[3]);
+        }
+
+        kglt::TaskGraph cycle;
+        kglt::TaskGraph::TaskID a = cycle.add([]() {});
+        kglt::TaskGraph::TaskID b = cycle.add([]() {});
+        cycle.add_dependency(a, b);
+        cycle.add_dependency(b, a);
+
+        bool thrown = false;
+        try {
+            cycle.run(jobs);
+        } catch(std::logic_error& e) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+
+    void test_scratch_arena() {
+        kglt::ScratchArena arena(256);
+
+        uint8_t* small = arena.allocate_array<uint8_t>(3);
+        double* aligned = arena.allocate_array<double>(4);
+        assert_true(small);
+        assert_equal(0, reinterpret_cast<uintptr_t>(aligned) % alignof(double));
+
+        //Bigger than a block, gets a block of its own
+        uint32_t* big = arena.allocate_array<uint32_t>(1000);
+        big[999] = 1;
+        assert_true(arena.capacity() >= 256 + 4000);
+
+        std::size_t capacity = arena.capacity();
+        arena.reset();
+        assert_equal(0, arena.used());
+
+        arena.allocate_array<uint32_t>(1000);
+        assert_equal(capacity, arena.capacity());
+    }
+};
+
+#endif // TEST_JOB_SYSTEM_H
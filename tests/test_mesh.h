@@ -168,6 +168,32 @@ public:
         assert_equal(kglt::MaterialID(1), actor.subactor(0).material_id());
     }
 
+    void test_subactor_bounds_follow_actor() {
+        kglt::Stage& scene = window->scene().stage();
+
+        kglt::MeshID mid = generate_test_mesh(scene);
+        kglt::Actor& actor = scene.actor(scene.new_actor(mid));
+        kglt::SubActor& subactor = actor.subactor(0);
+
+        actor.move_to(10, 0, 0);
+
+        kmAABB bounds = subactor.absolute_bounds();
+        assert_close(9.0, bounds.min.x, 0.0001);
+        assert_close(11.0, bounds.max.x, 0.0001);
+        assert_close(10.0, subactor.centre().x, 0.0001);
+
+        //Rotating the 2x2 square by 45 degrees should widen the box to cover all the corners
+        actor.rotate_z(45);
+
+        bounds = subactor.absolute_bounds();
+        assert_close(2.0 * sqrt(2.0), bounds.max.x - bounds.min.x, 0.0001);
+        assert_close(2.0 * sqrt(2.0), bounds.max.y - bounds.min.y, 0.0001);
+        assert_close(10.0, subactor.centre().x, 0.0001);
+
+        //The cached world matrix should have the translation in the last column
+        assert_close(10.0, actor.absolute_transformation().mat[12], 0.0001);
+    }
+
     void test_scene_methods() {
         kglt::Stage& scene = window->scene().stage();
 
@@ -0,0 +1,133 @@
+#ifndef TEST_MESH_COMPILER_H
+#define TEST_MESH_COMPILER_H
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <future>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/kglt.h"
+#include "kglt/utils/mesh_compiler.h"
+#include "global.h"
+
+class MeshCompilerTest : public TestCase {
+public:
+    kglt::CompiledMesh triangle(const std::vector<float>& positions, const std::vector<uint16_t>& indices) {
+        kglt::CompiledMesh mesh;
+
+        kglt::PackedVertices vertices;
+        vertices.attributes = kglt::BM_POSITIONS;
+        vertices.count = positions.size() / 3;
+        vertices.stride = sizeof(float) * 3;
+        vertices.data = reinterpret_cast<const uint8_t*>(&positions[0]);
+        mesh.vertices.push_back(vertices);
+
+        kglt::CompiledSubMesh submesh;
+        submesh.vertices = 0;
+        submesh.arrangement = kglt::MESH_ARRANGEMENT_TRIANGLES;
+        submesh.indices.type = kglt::INDEX_TYPE_16_BIT;
+        submesh.indices.count = indices.size();
+        submesh.indices.data = reinterpret_cast<const uint8_t*>(&indices[0]);
+        kmVec3Fill(&submesh.bounds.min, 0, 0, 0);
+        kmVec3Fill(&submesh.bounds.max, 1, 1, 0);
+        submesh.material_type = kglt::MATERIAL_SOURCE_TEXTURE;
+        submesh.material_file = "sample.png";
+        mesh.submeshes.push_back(submesh);
+
+        return mesh;
+    }
+
+    void test_kglmesh_round_trip() {
+        std::vector<float> positions = { 0, 0, 0,  1, 0, 0,  0, 1, 0 };
+        std::vector<uint16_t> indices = { 0, 1, 2 };
+
+        const std::string filename = "/tmp/kglt_test_mesh.kglmesh";
+        kglt::save_kglmesh(triangle(positions, indices), filename);
+
+        kglt::CompiledMesh mapped = kglt::map_kglmesh(filename);
+        std::remove(filename.c_str());
+
+        assert_equal(1, mapped.vertices.size());
+        assert_equal(kglt::BM_POSITIONS, mapped.vertices[0].attributes);
+        assert_equal(3, mapped.vertices[0].count);
+        assert_equal(12, mapped.vertices[0].stride);
+        assert_equal(0, std::memcmp(&positions[0], mapped.vertices[0].data, positions.size() * sizeof(float)));
+
+        //Buffers start on 16 byte boundaries so they can be handed to GL as they are
+        assert_equal(0, reinterpret_cast<uintptr_t>(mapped.vertices[0].data) % 16);
+
+        assert_equal(1, mapped.submeshes.size());
+        const kglt::CompiledSubMesh& submesh = mapped.submeshes[0];
+        assert_equal(kglt::MESH_ARRANGEMENT_TRIANGLES, submesh.arrangement);
+        assert_equal(kglt::INDEX_TYPE_16_BIT, submesh.indices.type);
+        assert_equal(3, submesh.indices.count);
+        assert_equal(0, std::memcmp(&indices[0], submesh.indices.data, indices.size() * sizeof(uint16_t)));
+        assert_close(1.0f, submesh.bounds.max.y, 0.0001f);
+        assert_equal(kglt::MATERIAL_SOURCE_TEXTURE, submesh.material_type);
+        assert_equal("sample.png", submesh.material_file);
+    }
+
+    void test_kglmesh_rejects_bad_indices() {
+        std::vector<float> positions = { 0, 0, 0,  1, 0, 0,  0, 1, 0 };
+        std::vector<uint16_t> indices = { 0, 1, 3 };
+
+        const std::string filename = "/tmp/kglt_test_bad_indices.kglmesh";
+        kglt::save_kglmesh(triangle(positions, indices), filename);
+
+        bool thrown = false;
+        try {
+            kglt::map_kglmesh(filename);
+        } catch(std::runtime_error& e) {
+            thrown = true;
+        }
+        std::remove(filename.c_str());
+
+        assert_true(thrown);
+    }
+};
+
+class KGLMeshLoaderTest : public TestCase {
+public:
+    void set_up() {
+        if(!window) {
+            window = kglt::Window::create();
+            window->set_logging_level(kglt::LOG_LEVEL_NONE);
+        }
+    }
+
+    void test_script_material_loaded_in_the_background() {
+        kglt::Scene& scene = window->scene();
+        const std::string material_file = "kglt/materials/diffuse_render.kglm";
+        const std::string filename = "/tmp/kglt_test_script_material.kglmesh";
+
+        kglt::MeshID source = scene.new_mesh();
+        {
+            kglt::MeshPtr mesh = scene.mesh(source).lock();
+            kglt::SubMeshIndex index = kglt::procedural::mesh::rectangle(mesh, 1.0, 1.0);
+            mesh->submesh(index).set_material_id(scene.new_material_from_file(material_file));
+            kglt::save_kglmesh(*mesh, filename);
+        }
+
+        //The load runs on the loader threads, which can't compile the material's shaders
+        std::shared_future<kglt::MeshID> loading = scene.new_mesh_from_file_async(filename);
+        while(loading.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready) {
+            window->update();
+        }
+
+        kglt::MeshPtr loaded = scene.mesh(loading.get()).lock();
+        std::remove(filename.c_str());
+
+        assert_equal(1, loaded->submesh_ids().size());
+        kglt::MaterialID material = loaded->submesh(loaded->submesh_ids()[0]).material_id();
+
+        assert_true(material != scene.default_material_id());
+        assert_equal(material_file, scene.material(material)->source_file());
+    }
+};
+
+#endif // TEST_MESH_COMPILER_H
@@ -33,7 +33,70 @@ public:
         assert_equal(10, tree.root().strict_diameter());
         assert_equal(20, tree.root().loose_diameter());
 
-        //CONTINUE: write tests for relocate
+        //A small object ends up two levels down, in the node centred at 1.25
+        Object small(2, 2, 2);
+        small.set_centre(kglt::Vec3(2, 2, 2));
+        tree.grow(&small);
+
+        assert_equal(3, tree.node_count());
+        assert_close(1.25, tree.find(&small).centre().x, 0.001);
+
+        //Moving within the same node shouldn't change anything
+        kglt::OctreeNode* before = &tree.find(&small);
+        small.set_centre(kglt::Vec3(1.5, 1.5, 1.5));
+        tree.relocate(&small);
+        assert_true(before == &tree.find(&small));
+
+        //Moving to the opposite corner should leave the old branch behind, and prune it
+        small.set_centre(kglt::Vec3(-2, -2, -2));
+        tree.relocate(&small);
+
+        assert_equal(3, tree.node_count());
+        assert_close(-1.25, tree.find(&small).centre().x, 0.001);
+        assert_equal(2, tree.object_count());
+
+        //Moving outside the root should grow the tree
+        small.set_centre(kglt::Vec3(0, 0, 30));
+        tree.relocate(&small);
+        assert_true(tree.root().strict_diameter() > 10);
+        kmVec3 small_centre = small.centre();
+        assert_true(kmAABBContainsPoint(&tree.find(&small).absolute_loose_bounds(), &small_centre));
+
+        //Removing everything should prune the tree away completely
+        tree.shrink(&small);
+        assert_equal(1, tree.object_count());
+        tree.shrink(&obj);
+        assert_equal(0, tree.object_count());
+        assert_equal(0, tree.node_count());
+        assert_false(tree.has_root());
+    }
+
+    void test_relocating_an_object_with_no_volume() {
+        kglt::Octree tree;
+
+        Object obj(10, 10, 10);
+        tree.grow(&obj);
+
+        Object small(2, 2, 2);
+        small.set_centre(kglt::Vec3(2, 2, 2));
+        tree.grow(&small);
+        assert_equal(3, tree.node_count());
+
+        //It leaves the tree rather than being pushed down node after node
+        small.set_bounds(0, 0, 0);
+        tree.relocate(&small);
+
+        assert_false(tree.contains(&small));
+        assert_equal(1, tree.object_count());
+        assert_equal(1, tree.node_count());
+
+        //And comes back once it has a size again
+        small.set_bounds(2, 2, 2);
+        tree.relocate(&small);
+
+        assert_true(tree.contains(&small));
+        assert_equal(2, tree.object_count());
+        assert_equal(3, tree.node_count());
     }
 
     void test_insertion() {
@@ -105,6 +168,88 @@ public:
          */
 
     }
+
+    void test_objects_visible_from() {
+        kglt::Octree tree;
+
+        //An orthographic frustum from -1 to 1 on x and y, and -1 to -10 on z
+        kmMat4 projection;
+        kmMat4OrthographicProjection(&projection, -1.0, 1.0, -1.0, 1.0, 1.0, 10.0);
+
+        kglt::Frustum frustum;
+        frustum.build(&projection);
+
+        Object inside(0.5, 0.5, 0.5);
+        inside.set_centre(kglt::Vec3(0, 0, -5));
+
+        Object to_the_side(0.5, 0.5, 0.5);
+        to_the_side.set_centre(kglt::Vec3(5, 0, -5));
+
+        Object behind(0.5, 0.5, 0.5);
+        behind.set_centre(kglt::Vec3(0, 0, 5));
+
+        tree.grow(&inside);
+        tree.grow(&to_the_side);
+        tree.grow(&behind);
+
+        std::vector<const kglt::Boundable*> visible;
+        tree.each_object_visible_from(frustum, [&visible](const kglt::Boundable* obj) {
+            visible.push_back(obj);
+        });
+
+        assert_equal(1, visible.size());
+        assert_true(visible[0] == &inside);
+
+        kmAABB box = inside.absolute_bounds();
+        assert_equal(kglt::FRUSTUM_CONTAINS_ALL, frustum.classify_aabb(box));
+
+        box = behind.absolute_bounds();
+        assert_equal(kglt::FRUSTUM_CONTAINS_NONE, frustum.classify_aabb(box));
+
+        kmAABBInitialize(&box, &inside.centre(), 4.0, 0.5, 0.5);
+        assert_equal(kglt::FRUSTUM_CONTAINS_PARTIAL, frustum.classify_aabb(box));
+    }
+
+    void test_lights_within_range() {
+        kglt::StageID stage_id = window->scene().new_stage(kglt::PARTITIONER_OCTREE);
+        kglt::Stage& stage = window->scene().stage(stage_id);
+
+        kglt::Light& near = stage.light(stage.new_light());
+        near.move_to(0, 0, 5);
+        near.set_attenuation_from_range(10.0);
+
+        kglt::Light& far = stage.light(stage.new_light());
+        far.move_to(0, 0, 50);
+        far.set_attenuation_from_range(10.0);
+
+        kglt::Light& sun = stage.light(stage.new_light());
+        sun.set_direction(0, -1, 0);
+
+        kmAABB box;
+        kmVec3 origin;
+        kmVec3Zero(&origin);
+        kmAABBInitialize(&box, &origin, 2.0, 2.0, 2.0);
+
+        //The directional light reaches everything and sorts first, the far light is out of range
+        std::vector<kglt::LightID> lights = stage.partitioner().lights_within_range(box);
+        assert_equal(2, lights.size());
+        assert_true(lights[0] == sun.id());
+        assert_true(lights[1] == near.id());
+
+        //Moving the far light into range should be picked up by the next query
+        far.move_to(0, 0, -8);
+        lights = stage.partitioner().lights_within_range(box);
+        assert_equal(3, lights.size());
+        assert_true(lights[2] == far.id());
+
+        //As should shrinking its range
+        far.set_attenuation_from_range(5.0);
+        lights = stage.partitioner().lights_within_range(box);
+        assert_equal(2, lights.size());
+
+        window->scene().delete_stage(stage_id);
+    }
+
 private:
     class Object :
         public kglt::Boundable {
@@ -0,0 +1,79 @@
+#ifndef TEST_PROFILER_H
+#define TEST_PROFILER_H
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "kglt/kglt.h"
+#include "kglt/kazbase/testing.h"
+#include "kglt/utils/profiler.h"
+#include "global.h"
+
+class ProfilerTest : public TestCase {
+public:
+    void set_up() {
+        if(!window) {
+            window = kglt::Window::create();
+            window->set_logging_level(kglt::LOG_LEVEL_NONE);
+        }
+
+        kglt::Profiler::get().clear();
+    }
+
+    void test_dump() {
+        kglt::Profiler& profiler = kglt::Profiler::get();
+        profiler.set_enabled(true);
+
+        {
+            KGLT_PROFILE_SCOPE("outer");
+            KGLT_PROFILE_SCOPE("inner");
+        }
+
+        //Nothing is recorded while disabled
+        profiler.set_enabled(false);
+        {
+            KGLT_PROFILE_SCOPE("disabled");
+        }
+        profiler.set_enabled(true);
+
+        const std::string filename = "kglt_test_profile.json";
+        assert_true(profiler.dump(filename));
+
+        std::ifstream file(filename.c_str());
+        std::stringstream contents;
+        contents << file.rdbuf();
+        file.close();
+        std::remove(filename.c_str());
+
+        std::string json = contents.str();
+        assert_true(json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == 0);
+        assert_true(json.find("\"name\":\"outer\"") != std::string::npos);
+        assert_true(json.find("\"name\":\"inner\"") != std::string::npos);
+        assert_true(json.find("\"name\":\"disabled\"") == std::string::npos);
+    }
+
+    void test_ring_buffer_wraps() {
+        kglt::Profiler& profiler = kglt::Profiler::get();
+
+        for(uint32_t i = 0; i < kglt::Profiler::EVENTS_PER_THREAD + 10; ++i) {
+            uint64_t now = kglt::Profiler::now();
+            profiler.record((i < 10) ? "old" : "new", now, now);
+        }
+
+        const std::string filename = "kglt_test_profile.json";
+        assert_true(profiler.dump(filename));
+
+        std::ifstream file(filename.c_str());
+        std::stringstream contents;
+        contents << file.rdbuf();
+        file.close();
+        std::remove(filename.c_str());
+
+        //The ten oldest events were overwritten
+        assert_true(contents.str().find("\"name\":\"old\"") == std::string::npos);
+        assert_true(contents.str().find("\"name\":\"new\"") != std::string::npos);
+    }
+};
+
+#endif // TEST_PROFILER_H
@@ -0,0 +1,159 @@
+#ifndef TEST_RENDER_QUEUE_H
+#define TEST_RENDER_QUEUE_H
+
+#include <algorithm>
+#include <vector>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/kglt.h"
+#include "kglt/render_queue.h"
+#include "kglt/renderer.h"
+#include "global.h"
+
+//Records what the queue asks for instead of drawing it
+class RecordingRenderer : public kglt::Renderer {
+public:
+    RecordingRenderer(kglt::Scene& scene, bool instancing):
+        kglt::Renderer(scene),
+        instancing_(instancing) {}
+
+    void render_subactor(kglt::SubActor&, kglt::CameraID) {
+        ++single_draws;
+    }
+
+    bool supports_instancing(kglt::ShaderProgram&) const { return instancing_; }
+
+    void render_instances(const std::vector<kglt::SubActor*>& instances, kglt::CameraID) {
+        batches.push_back(instances.size());
+    }
+
+    uint32_t single_draws = 0;
+    std::vector<uint32_t> batches;
+
+private:
+    bool instancing_;
+};
+
+class RenderQueueTest : public TestCase {
+public:
+    void set_up() {
+        if(!window) {
+            window = kglt::Window::create();
+            window->set_logging_level(LOG_LEVEL_NONE);
+        }
+    }
+
+    void test_radix_sort() {
+        std::vector<kglt::RenderQueueItem> items, scratch;
+
+        uint64_t keys[] = {
+            0xFF00000000000001ull, 5, 3, 0x0000010000000000ull, 3, 0, 0x8000000000000000ull
+        };
+
+        for(uint64_t key: keys) {
+            kglt::RenderQueueItem item = { key, nullptr, nullptr, nullptr };
+            items.push_back(item);
+        }
+
+        kglt::radix_sort(items, scratch);
+
+        assert_equal(7, items.size());
+        for(uint32_t i = 1; i < items.size(); ++i) {
+            assert_true(items[i - 1].key <= items[i].key);
+        }
+
+        assert_equal(0xFF00000000000001ull, items.back().key);
+    }
+
+    void test_priority_sorts_first() {
+        kglt::Stage& stage = window->scene().stage();
+
+        kglt::MeshID mid = stage.new_mesh();
+        kglt::procedural::mesh::rectangle(stage.mesh(mid).lock(), 1.0, 1.0);
+
+        kglt::Actor& background = stage.actor(stage.new_actor(mid));
+        background.set_render_priority(kglt::RENDER_PRIORITY_BACKGROUND);
+
+        kglt::Actor& foreground = stage.actor(stage.new_actor(mid));
+        foreground.set_render_priority(kglt::RENDER_PRIORITY_FOREGROUND);
+
+        kglt::RenderQueue queue;
+        queue.reset(stage, window->scene().camera());
+
+        //Insert in the wrong order, sorting should put the background first
+        queue.insert(foreground.subactor(0));
+        queue.insert(background.subactor(0));
+
+        auto mat = stage.material(background.subactor(0).material_id());
+        assert_equal(mat->technique().pass_count() * 2, queue.size());
+
+        queue.sort();
+
+        assert_true(&queue.items().front().subactor->_parent() == &background);
+        assert_true(&queue.items().back().subactor->_parent() == &foreground);
+
+        //Hidden actors should not be queued
+        queue.reset(stage, window->scene().camera());
+        foreground.set_visible(false);
+        queue.insert(foreground.subactor(0));
+        assert_equal(0, queue.size());
+    }
+
+    void test_instanced_runs() {
+        kglt::Stage& stage = window->scene().stage();
+
+        kglt::MeshID first = stage.new_mesh();
+        kglt::procedural::mesh::rectangle(stage.mesh(first).lock(), 1.0, 1.0);
+        kglt::MeshID second = stage.new_mesh();
+        kglt::procedural::mesh::rectangle(stage.mesh(second).lock(), 1.0, 1.0);
+        kglt::MeshID third = stage.new_mesh();
+        kglt::procedural::mesh::rectangle(stage.mesh(third).lock(), 1.0, 1.0);
+
+        std::vector<kglt::ActorID> actors;
+        for(uint32_t i = 0; i < 3; ++i) {
+            actors.push_back(stage.new_actor(first));
+        }
+        for(uint32_t i = 0; i < 2; ++i) {
+            actors.push_back(stage.new_actor(second));
+        }
+        actors.push_back(stage.new_actor(third)); //On its own, so never a batch
+
+        kglt::RenderQueue queue;
+        queue.reset(stage, window->scene().camera());
+
+        //Interleave the meshes, sorting should bring the copies of each together
+        uint32_t order[] = { 0, 3, 5, 1, 4, 2 };
+        for(uint32_t i: order) {
+            queue.insert(stage.actor(actors[i]).subactor(0));
+        }
+        queue.sort();
+
+        auto mat = stage.material(stage.actor(actors[0]).subactor(0).material_id());
+        const uint32_t passes = mat->technique().pass_count();
+
+        RecordingRenderer instanced(window->scene(), true);
+        queue.render(instanced, window->scene().camera().id());
+
+        std::sort(instanced.batches.begin(), instanced.batches.end());
+        assert_equal(passes * 2, instanced.batches.size());
+        for(uint32_t i = 0; i < passes; ++i) {
+            assert_equal(2, instanced.batches[i]);
+            assert_equal(3, instanced.batches[passes + i]);
+        }
+        assert_equal(passes, instanced.single_draws);
+
+        //Without instancing support every copy is drawn by itself
+        RecordingRenderer fallback(window->scene(), false);
+        queue.render(fallback, window->scene().camera().id());
+
+        assert_equal(0, fallback.batches.size());
+        assert_equal(passes * 6, fallback.single_draws);
+
+        for(kglt::ActorID actor: actors) {
+            stage.delete_actor(actor);
+        }
+    }
+};
+
+#endif // TEST_RENDER_QUEUE_H
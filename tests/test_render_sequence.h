@@ -0,0 +1,55 @@
+#ifndef TEST_RENDER_SEQUENCE_H
+#define TEST_RENDER_SEQUENCE_H
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/kglt.h"
+#include "global.h"
+
+class RenderSequenceTest : public TestCase {
+public:
+    void set_up() {
+        if(!window) {
+            window = kglt::Window::create();
+            window->set_logging_level(kglt::LOG_LEVEL_NONE);
+        }
+    }
+
+    void test_pipelines_share_draw_lists() {
+        kglt::Scene& scene = window->scene();
+        kglt::RenderSequence& sequence = scene.render_sequence();
+
+        window->update();
+        uint32_t existing = sequence.draw_list_count();
+
+        kglt::StageID stage_id = scene.new_stage();
+        kglt::CameraID first_camera = scene.new_camera();
+        kglt::CameraID second_camera = scene.new_camera();
+
+        kglt::PipelineID left = sequence.new_pipeline(stage_id, first_camera);
+        kglt::PipelineID right = sequence.new_pipeline(stage_id, first_camera);
+        kglt::PipelineID other = sequence.new_pipeline(stage_id, second_camera);
+
+        window->update();
+
+        //The two pipelines looking through the same camera share one list
+        assert_equal(existing + 2, sequence.draw_list_count());
+        assert_equal(
+            sequence.pipeline_stats(left).visible_subactors,
+            sequence.pipeline_stats(right).visible_subactors
+        );
+
+        sequence.delete_pipeline(left);
+        sequence.delete_pipeline(right);
+        sequence.delete_pipeline(other);
+
+        window->update();
+        assert_equal(existing, sequence.draw_list_count());
+
+        scene.delete_camera(first_camera);
+        scene.delete_camera(second_camera);
+        scene.delete_stage(stage_id);
+    }
+};
+
+#endif // TEST_RENDER_SEQUENCE_H
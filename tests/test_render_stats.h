@@ -0,0 +1,52 @@
+#ifndef TEST_RENDER_STATS_H
+#define TEST_RENDER_STATS_H
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/kglt.h"
+#include "kglt/render_stats.h"
+#include "global.h"
+
+class RenderStatsTest : public TestCase {
+public:
+    void set_up() {
+        if(!window) {
+            window = kglt::Window::create();
+            window->set_logging_level(kglt::LOG_LEVEL_NONE);
+        }
+    }
+
+    void test_arithmetic() {
+        kglt::RenderStats a, b;
+        a.draw_calls = 10;
+        a.buffer_bytes_uploaded = 100;
+        a.texture_bytes_uploaded = 28;
+        b.draw_calls = 4;
+        b.texture_bytes_uploaded = 8;
+
+        kglt::RenderStats diff = a - b;
+        assert_equal(6, diff.draw_calls);
+        assert_equal(120, diff.bytes_uploaded());
+
+        diff += b;
+        assert_equal(10, diff.draw_calls);
+        assert_equal(128, diff.bytes_uploaded());
+    }
+
+    void test_frame_stats_history() {
+        kglt::RenderSequence& sequence = window->scene().render_sequence();
+        sequence.set_stats_history_size(2);
+
+        window->update();
+        window->update();
+        window->update();
+
+        assert_equal(2, sequence.stats_history().size());
+        assert_true(sequence.pipeline_stats(kglt::PipelineID()).draw_calls == 0);
+
+        sequence.set_stats_history_size(0);
+        assert_true(sequence.stats_history().empty());
+    }
+};
+
+#endif // TEST_RENDER_STATS_H
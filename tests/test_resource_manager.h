@@ -0,0 +1,76 @@
+#ifndef TEST_RESOURCE_MANAGER_H
+#define TEST_RESOURCE_MANAGER_H
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/kglt.h"
+#include "global.h"
+
+class AsyncLoadTest : public TestCase {
+public:
+    void set_up() {
+        if(!window) {
+            window = kglt::Window::create();
+            window->set_logging_level(kglt::LOG_LEVEL_NONE);
+        }
+    }
+
+    void test_missing_files_throw_from_get() {
+        kglt::Scene& scene = window->scene();
+
+        assert_true(get_throws(scene.new_mesh_from_file_async("/tmp/kglt_missing.obj")));
+        assert_true(get_throws(scene.new_texture_from_file_async("/tmp/kglt_missing.png")));
+        assert_true(get_throws(scene.new_material_from_file_async("/tmp/kglt_missing.kglm")));
+    }
+
+    void test_broken_material_throws_from_get() {
+        const std::string filename = "/tmp/kglt_test_broken.kglm";
+        {
+            std::ofstream file(filename.c_str());
+            file << "BEGIN(NOT_A_BLOCK)" << std::endl << "END(NOT_A_BLOCK)" << std::endl;
+        }
+
+        //The script is only parsed on the main thread, after the loader thread has finished
+        bool thrown = get_throws(window->scene().new_material_from_file_async(filename));
+        std::remove(filename.c_str());
+
+        assert_true(thrown);
+    }
+
+    void test_loaded_texture_is_uploaded() {
+        kglt::Scene& scene = window->scene();
+
+        std::shared_future<kglt::TextureID> loading = scene.new_texture_from_file_async("samples/data/crate.png");
+        wait_for(loading);
+
+        assert_false(get_throws(loading));
+        assert_true(scene.texture(loading.get())->gl_tex() != 0);
+    }
+
+private:
+    template<typename T>
+    void wait_for(const std::shared_future<T>& future) {
+        while(future.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready) {
+            window->update();
+        }
+    }
+
+    template<typename T>
+    bool get_throws(const std::shared_future<T>& future) {
+        wait_for(future);
+
+        try {
+            future.get();
+        } catch(std::exception& e) {
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif // TEST_RESOURCE_MANAGER_H
@@ -0,0 +1,69 @@
+#ifndef TEST_SCENE_UPDATE_H
+#define TEST_SCENE_UPDATE_H
+
+#include <memory>
+#include <vector>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/kglt.h"
+#include "global.h"
+
+//Moves itself along x by one on every update
+class SceneUpdateMover : public kglt::Object {
+public:
+    SceneUpdateMover(kglt::Stage* stage):
+        kglt::Object(stage) {}
+
+    void destroy() {}
+
+    void do_update(double dt) {
+        move_to(position().x + 1, 0, 0);
+    }
+};
+
+class SceneUpdateTest : public TestCase {
+public:
+    void set_up() {
+        if(!window) {
+            window = kglt::Window::create();
+            window->set_logging_level(kglt::LOG_LEVEL_NONE);
+        }
+    }
+
+    void test_moves_during_parallel_update() {
+        kglt::Scene& scene = window->scene();
+        kglt::Stage& stage = scene.stage();
+
+        std::vector<std::unique_ptr<SceneUpdateMover> > movers;
+        std::vector<kglt::ActorID> actors;
+        for(uint32_t i = 0; i < 64; ++i) {
+            movers.push_back(std::unique_ptr<SceneUpdateMover>(new SceneUpdateMover(&stage)));
+            movers.back()->set_parent(stage);
+
+            actors.push_back(stage.new_actor());
+            stage.actor(actors.back()).set_parent(*movers.back());
+        }
+
+        scene.snapshot_transformations();
+
+        scene.set_parallel_update(true);
+        scene.update(1.0);
+        scene.set_parallel_update(false);
+
+        //Every actor moved with its parent, but rendering only sees it at the snapshot
+        for(kglt::ActorID actor: actors) {
+            assert_close(1.0f, stage.actor(actor).absolute_position().x, 0.0001f);
+            assert_close(0.0f, stage.actor(actor).render_position().x, 0.0001f);
+        }
+
+        scene.snapshot_transformations();
+
+        for(kglt::ActorID actor: actors) {
+            assert_close(1.0f, stage.actor(actor).render_position().x, 0.0001f);
+            stage.delete_actor(actor);
+        }
+    }
+};
+
+#endif // TEST_SCENE_UPDATE_H
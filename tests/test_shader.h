@@ -49,6 +49,18 @@ public:
         assert_true(s.params().uses_attribute(kglt::SP_ATTR_VERTEX_NORMAL));
         assert_true(s.params().uses_attribute(kglt::SP_ATTR_VERTEX_POSITION));
         assert_false(s.params().uses_attribute(kglt::SP_ATTR_VERTEX_DIFFUSE));
+
+        //The program is already linked, so registering resolves the locations straight away
+        assert_true(s.is_linked());
+        assert_true(s.params().auto_uniform_location(kglt::SP_AUTO_MODELVIEW_PROJECTION_MATRIX) >= 0);
+        assert_true(s.params().attribute_location(kglt::SP_ATTR_VERTEX_POSITION) >= 0);
+        assert_equal(-1, s.params().auto_uniform_location(kglt::SP_AUTO_MATERIAL_SPECULAR));
+        assert_equal(-1, s.params().attribute_location(kglt::SP_ATTR_VERTEX_DIFFUSE));
+
+        //Setting an auto by handle (repeatedly, the second is skipped) or one that isn't used is fine
+        s.params().set_mat4x4(kglt::SP_AUTO_MODELVIEW_PROJECTION_MATRIX, ident);
+        s.params().set_mat4x4(kglt::SP_AUTO_MODELVIEW_PROJECTION_MATRIX, ident);
+        s.params().set_colour(kglt::SP_AUTO_MATERIAL_SPECULAR, kglt::Colour(1, 1, 1, 1));
     }
 
 };
@@ -0,0 +1,65 @@
+#ifndef TEST_SIMULATION_THREAD_H
+#define TEST_SIMULATION_THREAD_H
+
+#include <stdexcept>
+#include <thread>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/simulation_thread.h"
+
+class SimulationThreadTest : public TestCase {
+public:
+    void test_steps_run_on_another_thread() {
+        uint32_t count = 0;
+        double total = 0;
+        std::thread::id ran_on;
+
+        kglt::SimulationThread simulation([&](double dt) {
+            ++count;
+            total += dt;
+            ran_on = std::this_thread::get_id();
+        });
+
+        simulation.start(3, 0.5);
+        simulation.wait();
+
+        assert_equal(3, count);
+        assert_close(1.5, total, 0.0001);
+        assert_true(ran_on != std::this_thread::get_id());
+        assert_false(simulation.is_busy());
+
+        //No steps this frame is fine too
+        simulation.start(0, 0.5);
+        simulation.wait();
+        assert_equal(3, count);
+    }
+
+    void test_exceptions_are_rethrown_by_wait() {
+        uint32_t count = 0;
+        kglt::SimulationThread simulation([&](double) {
+            if(++count == 2) {
+                throw std::runtime_error("Step failed");
+            }
+        });
+
+        simulation.start(5, 0.1);
+
+        bool thrown = false;
+        try {
+            simulation.wait();
+        } catch(std::runtime_error& e) {
+            thrown = true;
+        }
+
+        assert_true(thrown);
+        assert_equal(2, count);
+
+        //The error is only reported once, the next batch starts clean
+        simulation.start(1, 0.1);
+        simulation.wait();
+        assert_equal(3, count);
+    }
+};
+
+#endif // TEST_SIMULATION_THREAD_H
@@ -0,0 +1,127 @@
+#ifndef TEST_SPRITE_BATCH_H
+#define TEST_SPRITE_BATCH_H
+
+#include <stdexcept>
+#include <vector>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/extra/sprite_batch.h"
+
+class SpriteRecordsTest : public TestCase {
+public:
+    std::vector<kglt::AtlasRegion> frames(uint32_t count, uint32_t page) {
+        std::vector<kglt::AtlasRegion> result;
+        for(uint32_t i = 0; i < count; ++i) {
+            kglt::AtlasRegion region = kglt::AtlasRegion();
+            region.page = page;
+            region.u0 = float(i) / float(count);
+            region.u1 = float(i + 1) / float(count);
+            region.v1 = 1.0f;
+            result.push_back(region);
+        }
+        return result;
+    }
+
+    void test_cull() {
+        kglt::extra::SpriteRecords records;
+        uint32_t sheet = records.new_sheet(frames(1, 0));
+
+        kglt::extra::BatchedSpriteID inside = records.new_sprite(sheet);
+        kglt::extra::BatchedSpriteID outside = records.new_sprite(sheet);
+        kglt::extra::BatchedSpriteID edge = records.new_sprite(sheet);
+        kglt::extra::BatchedSpriteID hidden = records.new_sprite(sheet);
+
+        records.move_to(inside, 5, 5);
+        records.move_to(outside, 20, 5);
+        records.move_to(edge, 10.5, 5); //Overlaps by half its width
+        records.move_to(hidden, 5, 5);
+        records.set_visible(hidden, false);
+
+        std::vector<kglt::extra::BatchedSpriteID> visible;
+        records.cull(0, 0, 10, 10, visible);
+
+        assert_equal(2, visible.size());
+        assert_equal(inside, visible[0]);
+        assert_equal(edge, visible[1]);
+
+        //Deleted IDs are reused and start out as new
+        records.delete_sprite(inside);
+        assert_false(records.is_alive(inside));
+        assert_equal(3, records.count());
+
+        kglt::extra::BatchedSpriteID reused = records.new_sprite(sheet);
+        assert_equal(inside, reused);
+        assert_close(0.0f, records.x(reused), 0.0001f);
+
+        bool thrown = false;
+        try {
+            records.move_to(100, 0, 0);
+        } catch(std::logic_error& e) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+
+    void test_corners() {
+        kglt::extra::SpriteRecords records;
+        kglt::extra::BatchedSpriteID sprite = records.new_sprite(records.new_sheet(frames(1, 0)));
+
+        records.move_to(sprite, 1, 2);
+        records.set_scale(sprite, 4, 2);
+
+        float corners[8];
+        records.corners(sprite, corners);
+        assert_close(-1.0f, corners[0], 0.0001f);
+        assert_close(1.0f, corners[1], 0.0001f);
+        assert_close(3.0f, corners[4], 0.0001f);
+        assert_close(3.0f, corners[5], 0.0001f);
+
+        //A quarter turn anticlockwise puts the bottom left corner at the bottom right
+        records.rotate_to(sprite, 90);
+        records.corners(sprite, corners);
+        assert_close(2.0f, corners[0], 0.0001f);
+        assert_close(0.0f, corners[1], 0.0001f);
+    }
+
+    void test_animation() {
+        kglt::extra::SpriteRecords records;
+        std::vector<kglt::AtlasRegion> regions = frames(4, 0);
+        regions[3].page = 1;
+
+        uint32_t sheet = records.new_sheet(regions);
+        records.add_animation(sheet, "walk", kglt::extra::FrameRange(1, 4), 3.0);
+
+        kglt::extra::BatchedSpriteID sprite = records.new_sprite(sheet);
+        assert_false(records.is_animating(sprite));
+
+        records.set_active_animation(sprite, "walk");
+        assert_true(records.is_animating(sprite));
+
+        //One frame a second, the first step moves onto the start of the animation
+        records.update(1.0);
+        assert_equal(1, records.frame(sprite));
+        records.update(1.0);
+        records.update(1.0);
+        assert_equal(3, records.frame(sprite));
+        assert_equal(1, records.page(sprite));
+
+        float uv[4];
+        records.texture_coordinates(sprite, uv);
+        assert_close(0.75f, uv[0], 0.0001f);
+        assert_close(1.0f, uv[2], 0.0001f);
+
+        records.update(1.0);
+        assert_equal(1, records.frame(sprite));
+
+        bool thrown = false;
+        try {
+            records.set_active_animation(sprite, "run");
+        } catch(std::logic_error& e) {
+            thrown = true;
+        }
+        assert_true(thrown);
+    }
+};
+
+#endif // TEST_SPRITE_BATCH_H
@@ -0,0 +1,68 @@
+#ifndef TEST_TEXTURE_ATLAS_H
+#define TEST_TEXTURE_ATLAS_H
+
+#include <vector>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/texture_atlas.h"
+
+class RectanglePackerTest : public TestCase {
+public:
+    void test_rectangles_dont_overlap() {
+        kglt::RectanglePacker packer(64, 64);
+
+        struct Rect { uint32_t x, y, w, h; };
+        std::vector<Rect> placed;
+
+        const uint32_t sizes[][2] = { {16, 16}, {32, 8}, {8, 24}, {16, 16}, {24, 12}, {8, 8}, {40, 4} };
+        for(auto& size: sizes) {
+            Rect r = { 0, 0, size[0], size[1] };
+            assert_true(packer.pack(r.w, r.h, r.x, r.y));
+            assert_true(r.x + r.w <= 64);
+            assert_true(r.y + r.h <= 64);
+
+            for(const Rect& other: placed) {
+                bool apart = r.x + r.w <= other.x || other.x + other.w <= r.x ||
+                             r.y + r.h <= other.y || other.y + other.h <= r.y;
+                assert_true(apart);
+            }
+            placed.push_back(r);
+        }
+    }
+
+    void test_full_packer() {
+        kglt::RectanglePacker packer(32, 32);
+
+        uint32_t x, y;
+        for(uint32_t i = 0; i < 16; ++i) {
+            assert_true(packer.pack(8, 8, x, y));
+        }
+
+        //Exactly full, nothing else fits
+        assert_close(1.0, packer.occupancy(), 0.0001);
+        assert_false(packer.pack(1, 1, x, y));
+
+        kglt::RectanglePacker small(32, 32);
+        assert_false(small.pack(33, 1, x, y));
+        assert_false(small.pack(1, 33, x, y));
+        assert_true(small.pack(32, 32, x, y));
+        assert_equal(0, x);
+        assert_equal(0, y);
+    }
+
+    void test_lowest_position_first() {
+        kglt::RectanglePacker packer(32, 32);
+
+        uint32_t x, y;
+        packer.pack(16, 16, x, y);
+        packer.pack(16, 4, x, y);
+
+        //Goes next to the short one rather than on top of the tall one
+        assert_true(packer.pack(16, 4, x, y));
+        assert_equal(16, x);
+        assert_equal(4, y);
+    }
+};
+
+#endif // TEST_TEXTURE_ATLAS_H
@@ -0,0 +1,122 @@
+#ifndef TEST_TEXTURE_COMPILER_H
+#define TEST_TEXTURE_COMPILER_H
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/utils/texture_compiler.h"
+
+class TextureCompilerTest : public TestCase {
+public:
+    void test_mipmap_chain() {
+        std::vector<uint8_t> pixels(8 * 4 * 3, 128);
+
+        kglt::TextureCompiler compiler;
+        kglt::CompiledTexture compiled = compiler.compile(&pixels[0], 8, 4, 3);
+
+        assert_equal(kglt::TEXTURE_FORMAT_RGB_888, compiled.format);
+        assert_equal(4, compiled.levels.size());
+
+        assert_equal(8, compiled.levels[0].width);
+        assert_equal(4, compiled.levels[0].height);
+        assert_equal(1, compiled.levels[3].width);
+        assert_equal(1, compiled.levels[3].height);
+
+        //2 RGB pixels are 6 bytes, rows are padded to 8
+        assert_equal(8, compiled.levels[2].size);
+        assert_equal(128, compiled.levels[3].data[0]);
+
+        kglt::TextureCompiler no_mipmaps(kglt::TEXTURE_FORMAT_RGB_888, kglt::TEXTURE_FORMAT_RGBA_8888, false);
+        assert_equal(1, no_mipmaps.compile(&pixels[0], 8, 4, 3).levels.size());
+    }
+
+    void test_rows_are_flipped() {
+        //Top row red, bottom row blue
+        uint8_t pixels[] = {
+            255, 0, 0, 255,  255, 0, 0, 255,
+            0, 0, 255, 255,  0, 0, 255, 255
+        };
+
+        kglt::TextureCompiler compiler;
+        kglt::CompiledTexture compiled = compiler.compile(pixels, 2, 2, 4);
+
+        //Fully opaque, so the opaque format is used even though there were 4 channels
+        assert_equal(kglt::TEXTURE_FORMAT_RGB_888, compiled.format);
+        assert_equal(255, compiled.levels[0].data[2]); //Blue comes first
+        assert_equal(255, compiled.levels[0].data[8]); //Red is the second row
+    }
+
+    void test_packed_formats() {
+        uint8_t red[] = { 255, 0, 0, 128 };
+
+        kglt::TextureCompiler compiler(kglt::TEXTURE_FORMAT_RGB_565, kglt::TEXTURE_FORMAT_RGBA_4444, false);
+        kglt::CompiledTexture compiled = compiler.compile(red, 1, 1, 4);
+
+        assert_equal(kglt::TEXTURE_FORMAT_RGBA_4444, compiled.format);
+
+        uint16_t packed;
+        std::memcpy(&packed, compiled.levels[0].data, 2);
+        assert_equal(0xF008, packed);
+
+        compiled = compiler.compile(red, 1, 1, 3);
+        assert_equal(kglt::TEXTURE_FORMAT_RGB_565, compiled.format);
+        std::memcpy(&packed, compiled.levels[0].data, 2);
+        assert_equal(0xF800, packed);
+    }
+
+    void test_s3tc_blocks() {
+        //Red on top, black underneath
+        std::vector<uint8_t> pixels(4 * 4 * 3, 0);
+        for(uint32_t i = 0; i < 8; ++i) {
+            pixels[i * 3] = 255;
+        }
+
+        kglt::TextureCompiler compiler(kglt::TEXTURE_FORMAT_DXT1, kglt::TEXTURE_FORMAT_DXT5, false);
+        kglt::CompiledTexture compiled = compiler.compile(&pixels[0], 4, 4, 3);
+
+        assert_equal(kglt::TEXTURE_FORMAT_DXT1, compiled.format);
+        assert_equal(8, compiled.levels[0].size);
+
+        //Endpoints are a little inside red and black, black rows come first and use colour1
+        const uint8_t expected[] = { 0x00, 0xE8, 0x00, 0x10, 0x55, 0x55, 0x00, 0x00 };
+        for(uint32_t i = 0; i < 8; ++i) {
+            assert_equal(expected[i], compiled.levels[0].data[i]);
+        }
+
+        //Partial blocks round up
+        assert_equal(32, kglt::texture_level_size(kglt::TEXTURE_FORMAT_DXT1, 5, 5));
+        assert_equal(16, kglt::texture_level_size(kglt::TEXTURE_FORMAT_DXT5, 3, 2));
+        assert_equal(8, compiler.compile(&pixels[0], 2, 2, 3).levels[0].size);
+    }
+
+    void test_ktx_round_trip() {
+        std::vector<uint8_t> pixels(16 * 16 * 4);
+        for(uint32_t i = 0; i < pixels.size(); ++i) {
+            pixels[i] = i % 251;
+        }
+
+        kglt::TextureCompiler compiler(kglt::TEXTURE_FORMAT_RGB_888, kglt::TEXTURE_FORMAT_DXT5);
+        kglt::CompiledTexture compiled = compiler.compile(&pixels[0], 16, 16, 4);
+        assert_equal(kglt::TEXTURE_FORMAT_DXT5, compiled.format);
+
+        const std::string filename = "/tmp/kglt_test_texture.ktx";
+        kglt::save_ktx(compiled, filename);
+
+        kglt::CompiledTexture mapped = kglt::map_ktx(filename);
+        std::remove(filename.c_str());
+
+        assert_equal(compiled.format, mapped.format);
+        assert_equal(compiled.levels.size(), mapped.levels.size());
+        for(uint32_t i = 0; i < compiled.levels.size(); ++i) {
+            assert_equal(compiled.levels[i].width, mapped.levels[i].width);
+            assert_equal(compiled.levels[i].height, mapped.levels[i].height);
+            assert_equal(compiled.levels[i].size, mapped.levels[i].size);
+            assert_equal(0, std::memcmp(compiled.levels[i].data, mapped.levels[i].data, mapped.levels[i].size));
+        }
+    }
+};
+
+#endif // TEST_TEXTURE_COMPILER_H
@@ -0,0 +1,67 @@
+#ifndef TEST_THREADED_RENDERING_H
+#define TEST_THREADED_RENDERING_H
+
+#include "kglt/kazbase/testing.h"
+
+#include "kglt/kglt.h"
+#include "global.h"
+
+class ThreadedRenderingTest : public TestCase {
+public:
+    void set_up() {
+        if(!window) {
+            window = kglt::Window::create();
+            window->set_logging_level(kglt::LOG_LEVEL_NONE);
+        }
+    }
+
+    void test_moves_and_deletes_wait_for_prepare() {
+        kglt::Stage& stage = window->scene().stage();
+
+        kglt::ActorID moved = stage.new_actor(stage.new_mesh());
+        kglt::ActorID deleted = stage.new_actor(stage.new_mesh());
+
+        window->scene().render_sequence().prepare();
+
+        bool stepped = false;
+        bool in_flight = false;
+        sigc::connection connection = window->signal_step().connect([&](double) {
+            if(stepped) {
+                return;
+            }
+
+            stepped = true;
+            in_flight = window->frame_in_flight();
+
+            stage.actor(moved).move_to(5, 0, 0);
+            stage.delete_actor(deleted);
+        });
+
+        window->set_threaded_rendering(true);
+
+        //Not every update() has a fixed step to run
+        for(uint32_t i = 0; i < 100 && !stepped; ++i) {
+            window->update();
+        }
+
+        window->set_threaded_rendering(false);
+        connection.disconnect();
+
+        assert_true(stepped);
+        assert_true(in_flight);
+
+        //The frame that was drawn alongside the step saw neither change
+        assert_close(5.0f, stage.actor(moved).absolute_position().x, 0.0001f);
+        assert_close(0.0f, stage.actor(moved).render_position().x, 0.0001f);
+        assert_true(stage.has_actor(deleted));
+
+        window->scene().render_sequence().prepare();
+
+        assert_close(5.0f, stage.actor(moved).render_position().x, 0.0001f);
+        assert_false(stage.has_actor(deleted));
+
+        stage.delete_actor(moved);
+    }
+};
+
+#endif // TEST_THREADED_RENDERING_H
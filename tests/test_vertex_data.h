@@ -20,8 +20,95 @@ public:
     void test_offsets() {
         kglt::VertexData::ptr data = kglt::VertexData::create(window->scene());
 
+        data->position(0, 0, 0);
+        data->normal(0, 0, 1);
+        data->move_next();
+        data->done();
+
         assert_equal(0, (int32_t) data->position_offset());
         assert_equal(sizeof(float) * 3, data->normal_offset());
+        assert_equal(sizeof(float) * 6, data->stride());
+    }
+
+    void test_packed_layout() {
+        kglt::VertexData::ptr data = kglt::VertexData::create(window->scene());
+
+        //A typical sprite vertex, position and uv
+        data->position(0, 0, 0);
+        data->tex_coord0(0, 0);
+        data->move_next();
+        data->done();
+
+        assert_equal(sizeof(float) * 3, data->texcoord0_offset());
+        assert_equal(sizeof(float) * 5, data->stride());
+
+        bool raised = false;
+        try {
+            data->normal_offset();
+        } catch(std::logic_error& e) {
+            raised = true;
+        }
+        assert_true(raised);
+
+        //Colours can be stored as bytes
+        data->clear();
+        data->set_attribute_encoding(kglt::BM_DIFFUSE, kglt::ATTRIBUTE_ENCODING_NORMALIZED_BYTE);
+        data->position(0, 0, 0);
+        data->diffuse(kglt::Colour::white);
+        data->move_next();
+        data->done();
+
+        assert_equal(sizeof(float) * 3, data->diffuse_offset());
+        assert_equal(sizeof(float) * 3 + 4, data->stride());
+        assert_equal(4, data->attribute_components(kglt::BM_DIFFUSE));
+    }
+
+    void test_index_type_selection() {
+        kglt::IndexData data(window->scene());
+
+        data.index(0);
+        data.index(255);
+        data.done();
+        assert_equal(kglt::INDEX_TYPE_8_BIT, data.index_type());
+
+        data.index(65535);
+        data.done();
+        assert_equal(kglt::INDEX_TYPE_16_BIT, data.index_type());
+
+        //Over 16 bit, the index must not wrap
+        data.index(70000);
+        data.done();
+        assert_equal(kglt::INDEX_TYPE_32_BIT, data.index_type());
+        assert_equal(70000, data.all().back());
+        assert_equal(4, data.count());
+
+        data.clear();
+        assert_equal(0, data.max_index());
+    }
+
+    void test_buffer_generation() {
+        kglt::VertexData::ptr data = kglt::VertexData::create(window->scene());
+
+        data->position(0, 0, 0);
+        data->move_next();
+        data->position(1, 0, 0);
+        data->move_next();
+        data->done();
+
+        uint64_t generation = data->buffer_object().generation();
+
+        //Editing a vertex in place only updates the existing storage, so VAOs stay valid
+        data->move_to(1);
+        data->position(2, 0, 0);
+        data->done();
+        assert_equal(generation, data->buffer_object().generation());
+
+        //Adding a vertex respecifies the storage
+        data->move_to_end();
+        data->position(3, 0, 0);
+        data->move_next();
+        data->done();
+        assert_true(generation != data->buffer_object().generation());
     }
 };
 